@@ -88,6 +88,7 @@ if test "$PHP_ASYNC" != "no"; then
   async_source_files="php_async.c \
     src/awaitable.c \
     src/channel.c \
+    src/connection_pool.c \
     src/context.c \
     src/deferred.c \
     src/dns.c \
@@ -104,10 +105,13 @@ if test "$PHP_ASYNC" != "no"; then
     src/task_scheduler.c \
     src/tcp.c \
     src/timer.c \
+    src/timer_wheel.c \
     src/udp.c \
+    src/unix.c \
     src/xp/socket.c \
     src/xp/tcp.c \
-    src/xp/udp.c
+    src/xp/udp.c \
+    src/xp/unix.c
   "
   
   if test "$async_cpu" = 'x86_64'; then
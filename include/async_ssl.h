@@ -31,6 +31,14 @@
 #endif
 #endif
 
+#if defined(HAVE_ASYNC_SSL) && OPENSSL_VERSION_NUMBER >= 0x10100000L && !defined(LIBRESSL_VERSION_NUMBER)
+#define ASYNC_TLS_OFFLOAD 1
+#endif
+
+#if defined(HAVE_ASYNC_SSL) && defined(__linux__) && !defined(OPENSSL_NO_KTLS) && defined(SSL_OP_ENABLE_KTLS) && defined(BIO_CTRL_SET_KTLS)
+#define ASYNC_TLS_KTLS 1
+#endif
+
 typedef struct {
 	/* SSL mode (ASYNC_SSL_MODE_SERVER or ASYNC_SSL_MODE_CLIENT). */
 	zend_bool mode;
@@ -43,6 +51,15 @@ typedef struct {
 
 	/* Maximum verification cert chain length */
 	int verify_depth;
+
+	/* If set record encryption is offloaded to the kernel (if supported). */
+	zend_bool kernel_tls;
+
+	/* If set server handshake steps are performed by the thread pool. */
+	zend_bool offload_handshake;
+
+	/* ALPN protocol list (encoded in wire format). */
+	zend_string *alpn;
 } async_ssl_settings;
 
 typedef struct {
@@ -57,8 +74,25 @@ typedef struct {
 	int uv_error;
 	int ssl_error;
 	zend_string *error;
+	
+	/* Object owning data used by SSL callbacks, kept alive until an offloaded handshake step has finished. */
+	zend_object *ref;
 } async_ssl_handshake_data;
 
+typedef struct {
+	/* Base pointer of the allocated memory. */
+	char *base;
+	
+	/* Read offset (only used for input bytes). */
+	size_t offset;
+	
+	/* Number of buffered bytes. */
+	size_t len;
+	
+	/* Allocated buffer size. */
+	size_t size;
+} async_ssl_buffer;
+
 typedef struct {
 #ifdef HAVE_ASYNC_SSL
 	/* SSL context.*/
@@ -67,11 +101,40 @@ typedef struct {
 	/* SSL encryption engine. */
 	SSL *ssl;
 
-	/* Holds bytes that need to be processed as SSL input data. */
-	BIO *rbio;
-
-	/* Holds processed encrypted bytes that need to be sent. */
-	BIO *wbio;
+	/* Custom BIO being used for both input and output of the SSL engine. */
+	BIO *bio;
+	
+	/* Encrypted input bytes (located in the stream buffer) that have not been consumed yet. */
+	const char *in;
+	size_t in_len;
+	
+	/* Copy of unconsumed input bytes that must survive the next read into the stream buffer. */
+	async_ssl_buffer stash;
+	
+	/* Encrypted output bytes that need to be sent. */
+	async_ssl_buffer out;
+	
+	/* Socket descriptor being used to install kernel TLS keys (only valid if ktls is set). */
+	int ktls_fd;
+	zend_bool ktls;
+	
+	/* Stream handle whose write queue must be empty before records are sent directly. */
+	uv_stream_t *ktls_handle;
+	
+	/* Control records (type, 16 bit length, payload) waiting for preceding writes to complete. */
+	async_ssl_buffer ctrl;
+	
+	/* Is set when outgoing records are being encrypted by the kernel. */
+	zend_bool ktls_send;
+	
+	/* Record type of the next control message sent using kernel TLS. */
+	int ktls_type;
+	
+	/* Is set if the engine is being used by a thread pool worker. */
+	zend_bool worker;
+	
+	/* Pending thread pool operation that uses the SSL engine. */
+	void *offload;
 	
 	/* Number of available (decoded) input bytes. */
 	size_t available;
@@ -87,6 +150,34 @@ typedef struct {
 #endif
 } async_ssl_engine;
 
+typedef struct {
+	/* Async operation structure, must be first element to allow for casting to async_op. */
+	async_op base;
+	
+	/* Thread pool work request. */
+	uv_work_t req;
+	
+	/* SSL engine being updated by the operation, will be NULL if the engine has been disposed. */
+	async_ssl_engine *engine;
+	
+	/* Copy of the engine being used by the worker thread. */
+	async_ssl_engine shadow;
+	
+	/* Copy of the settings (persistent memory) being read by SSL callbacks in the worker thread. */
+	async_ssl_settings settings;
+	
+	/* Settings being used by the SSL engine before the work was queued. */
+	void *ex_data;
+	
+	/* Object that is kept alive until the worker has finished. */
+	zend_object *ref;
+	
+	/* Result of SSL_do_handshake() and related error codes. */
+	int code;
+	int error;
+	unsigned long ssl_error;
+} async_ssl_offload_op;
+
 typedef struct _async_tls_cert async_tls_cert;
 
 struct _async_tls_cert {
@@ -119,6 +210,8 @@ typedef struct {
 
 	async_tls_cert cert;
 	async_tls_cert_queue certs;
+
+	async_ssl_settings settings;
 } async_tls_server_encryption;
 
 #ifdef HAVE_ASYNC_SSL
@@ -126,7 +219,16 @@ SSL_CTX *async_ssl_create_context();
 int async_ssl_create_engine(async_ssl_engine *engine);
 void async_ssl_dispose_engine(async_ssl_engine *engine, zend_bool ctx);
 
+void async_ssl_bio_feed(async_ssl_engine *engine, const char *buf, size_t len);
+void async_ssl_bio_release(async_ssl_engine *engine);
+char *async_ssl_bio_take_output(async_ssl_engine *engine, size_t *len);
+
+void async_ssl_enable_ktls(async_ssl_engine *engine, uv_stream_t *handle);
+int async_ssl_ktls_flush(async_ssl_engine *engine);
+int async_ssl_offload_handshake(uv_loop_t *loop, async_ssl_engine *engine, async_ssl_offload_op *op, zend_object *ref);
+
 void async_ssl_setup_sni(SSL_CTX *ctx, async_tls_server_encryption *encryption);
+SSL_CTX *async_ssl_get_server_context(async_tls_server_encryption *encryption);
 void async_ssl_setup_verify_callback(SSL_CTX *ctx, async_ssl_settings *settings);
 int async_ssl_setup_encryption(SSL *ssl, async_ssl_settings *settings);
 #endif
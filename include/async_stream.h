@@ -47,7 +47,11 @@ typedef struct {
 
 typedef struct {
 	uv_stream_t *handle;
-	uv_timer_t timer;
+	async_timer_wheel *wheel;
+	async_timer_wheel_entry timer;
+#ifdef ASYNC_TLS_KTLS
+	uv_poll_t *ktls_poll;
+#endif
 	uint16_t flags;
 	zend_uchar ref_count;
 	async_ring_buffer buffer;
@@ -69,6 +73,7 @@ typedef struct {
 	zend_string *str;
 	async_stream_write_cb cb;
 	void *arg;
+	zend_bool deferred;
 } async_stream_write_op;
 
 async_stream *async_stream_init(uv_stream_t *handle, size_t bufsize);
@@ -82,6 +87,10 @@ void async_stream_async_write_string(async_stream *stream, zend_string *str, asy
 
 #ifdef HAVE_ASYNC_SSL
 int async_stream_ssl_handshake(async_stream *stream, async_ssl_handshake_data *data);
+
+#ifndef PHP_WIN32
+int async_stream_ssl_poll(async_stream *stream);
+#endif
 #endif
 
 #endif
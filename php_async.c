@@ -70,6 +70,7 @@ void async_init()
 	
 	async_tcp_socket_init();
 	async_udp_socket_init();
+	async_unix_socket_init();
 }
 
 void async_shutdown()
@@ -82,12 +83,19 @@ void async_shutdown()
 		async_dns_shutdown();
 	}
 	
+	if (ASYNC_G(dns_resolver) != NULL) {
+		ASYNC_DELREF(ASYNC_G(dns_resolver));
+		
+		ASYNC_G(dns_resolver) = NULL;
+	}
+	
 	if (ASYNC_G(timer_enabled)) {
 		async_timer_shutdown();
 	}
 	
 	async_tcp_socket_shutdown();
 	async_udp_socket_shutdown();
+	async_unix_socket_shutdown();
 }
 
 char *async_status_label(zend_uchar status)
@@ -218,11 +226,15 @@ static PHP_INI_MH(OnUpdateFiberStackSize)
 
 PHP_INI_BEGIN()
 	STD_PHP_INI_ENTRY("async.dns", "0", PHP_INI_SYSTEM | PHP_INI_PERDIR, OnUpdateBool, dns_enabled, zend_async_globals, async_globals)
+	STD_PHP_INI_ENTRY("async.dns_cache_size", "1024", PHP_INI_SYSTEM | PHP_INI_PERDIR, OnUpdateLong, dns_cache_size, zend_async_globals, async_globals)
+	STD_PHP_INI_ENTRY("async.dns_cache_ttl", "30", PHP_INI_SYSTEM | PHP_INI_PERDIR, OnUpdateLong, dns_cache_ttl, zend_async_globals, async_globals)
+	STD_PHP_INI_ENTRY("async.dns_cache_negative_ttl", "5", PHP_INI_SYSTEM | PHP_INI_PERDIR, OnUpdateLong, dns_cache_negative_ttl, zend_async_globals, async_globals)
 	STD_PHP_INI_ENTRY("async.filesystem", "0", PHP_INI_SYSTEM | PHP_INI_PERDIR, OnUpdateBool, fs_enabled, zend_async_globals, async_globals)
 	STD_PHP_INI_ENTRY("async.stack_size", "0", PHP_INI_SYSTEM, OnUpdateFiberStackSize, stack_size, zend_async_globals, async_globals)
 	STD_PHP_INI_ENTRY("async.timer", "0", PHP_INI_SYSTEM | PHP_INI_PERDIR, OnUpdateBool, timer_enabled, zend_async_globals, async_globals)
 	STD_PHP_INI_ENTRY("async.tcp", "0", PHP_INI_SYSTEM | PHP_INI_PERDIR, OnUpdateBool, tcp_enabled, zend_async_globals, async_globals)
 	STD_PHP_INI_ENTRY("async.udp", "0", PHP_INI_SYSTEM | PHP_INI_PERDIR, OnUpdateBool, udp_enabled, zend_async_globals, async_globals)
+	STD_PHP_INI_ENTRY("async.unix", "0", PHP_INI_SYSTEM | PHP_INI_PERDIR, OnUpdateBool, unix_enabled, zend_async_globals, async_globals)
 PHP_INI_END()
 
 PHP_GINIT_FUNCTION(async)
@@ -232,6 +244,13 @@ PHP_GINIT_FUNCTION(async)
 #endif
 
 	ZEND_SECURE_ZERO(async_globals, sizeof(zend_async_globals));
+	
+	async_dns_cache_init(&async_globals->dns_cache);
+}
+
+PHP_GSHUTDOWN_FUNCTION(async)
+{
+	async_dns_cache_destroy(&async_globals->dns_cache);
 }
 
 PHP_MINIT_FUNCTION(async)
@@ -283,8 +302,10 @@ PHP_MINIT_FUNCTION(async)
 	async_task_ce_register();
 	async_task_scheduler_ce_register();
 	async_tcp_ce_register();
+	async_connection_pool_ce_register();
 	async_timer_ce_register();
 	async_udp_socket_ce_register();
+	async_unix_ce_register();
 
 	REGISTER_INI_ENTRIES();
 
@@ -298,6 +319,7 @@ PHP_MINIT_FUNCTION(async)
 PHP_MSHUTDOWN_FUNCTION(async)
 {
 	async_fiber_ce_unregister();
+	async_ssl_ce_unregister();
 
 	UNREGISTER_INI_ENTRIES();
 
@@ -358,7 +380,7 @@ zend_module_entry async_module_entry = {
 	PHP_ASYNC_VERSION,
 	PHP_MODULE_GLOBALS(async),
 	PHP_GINIT(async),
-	NULL,
+	PHP_GSHUTDOWN(async),
 	NULL,
 	STANDARD_MODULE_PROPERTIES_EX
 };
@@ -116,16 +116,20 @@ ASYNC_API extern zend_class_entry *async_channel_closed_exception_ce;
 ASYNC_API extern zend_class_entry *async_channel_group_ce;
 ASYNC_API extern zend_class_entry *async_channel_iterator_ce;
 ASYNC_API extern zend_class_entry *async_context_ce;
+ASYNC_API extern zend_class_entry *async_connection_pool_ce;
 ASYNC_API extern zend_class_entry *async_context_var_ce;
 ASYNC_API extern zend_class_entry *async_deferred_ce;
 ASYNC_API extern zend_class_entry *async_deferred_awaitable_ce;
+ASYNC_API extern zend_class_entry *async_dns_cache_ce;
 ASYNC_API extern zend_class_entry *async_duplex_stream_ce;
 ASYNC_API extern zend_class_entry *async_fiber_ce;
+ASYNC_API extern zend_class_entry *async_listen_options_ce;
 ASYNC_API extern zend_class_entry *async_pending_read_exception_ce;
 ASYNC_API extern zend_class_entry *async_process_builder_ce;
 ASYNC_API extern zend_class_entry *async_process_ce;
 ASYNC_API extern zend_class_entry *async_readable_pipe_ce;
 ASYNC_API extern zend_class_entry *async_readable_stream_ce;
+ASYNC_API extern zend_class_entry *async_resolver_ce;
 ASYNC_API extern zend_class_entry *async_server_ce;
 ASYNC_API extern zend_class_entry *async_socket_ce;
 ASYNC_API extern zend_class_entry *async_socket_exception_ce;
@@ -145,12 +149,17 @@ ASYNC_API extern zend_class_entry *async_tls_server_encryption_ce;
 ASYNC_API extern zend_class_entry *async_timer_ce;
 ASYNC_API extern zend_class_entry *async_udp_datagram_ce;
 ASYNC_API extern zend_class_entry *async_udp_socket_ce;
+ASYNC_API extern zend_class_entry *async_unix_server_ce;
+ASYNC_API extern zend_class_entry *async_unix_socket_ce;
+ASYNC_API extern zend_class_entry *async_unix_socket_reader_ce;
+ASYNC_API extern zend_class_entry *async_unix_socket_writer_ce;
 ASYNC_API extern zend_class_entry *async_writable_pipe_ce;
 ASYNC_API extern zend_class_entry *async_writable_stream_ce;
 
 
 void async_awaitable_ce_register();
 void async_channel_ce_register();
+void async_connection_pool_ce_register();
 void async_context_ce_register();
 void async_deferred_ce_register();
 void async_dns_ce_register();
@@ -166,25 +175,31 @@ void async_task_scheduler_ce_register();
 void async_tcp_ce_register();
 void async_timer_ce_register();
 void async_udp_socket_ce_register();
+void async_unix_ce_register();
 
 void async_fiber_ce_unregister();
+void async_ssl_ce_unregister();
 
 void async_init();
 void async_shutdown();
 
 void async_dns_init();
+void async_dns_cache_init(async_dns_cache *cache);
 void async_filesystem_init();
 void async_tcp_socket_init();
 void async_timer_init();
 void async_udp_socket_init();
+void async_unix_socket_init();
 
 void async_context_shutdown();
 void async_dns_shutdown();
+void async_dns_cache_destroy(async_dns_cache *cache);
 void async_fiber_shutdown();
 void async_filesystem_shutdown();
 void async_tcp_socket_shutdown();
 void async_timer_shutdown();
 void async_udp_socket_shutdown();
+void async_unix_socket_shutdown();
 
 void async_task_scheduler_run();
 void async_task_scheduler_shutdown();
@@ -226,6 +241,16 @@ typedef struct {
 	async_task *last;
 } async_task_queue;
 
+typedef struct {
+	/* PHP object handle. */
+	zend_object std;
+
+	/* Socket being used to delegate reads or writes. */
+	zend_object *socket;
+} async_socket_delegate;
+
+#define ASYNC_SOCKET_DELEGATE(obj, type) ((type *) ((async_socket_delegate *) (obj))->socket)
+
 typedef struct {
 	zend_execute_data *exec;
 	zend_vm_stack stack;
@@ -301,6 +326,26 @@ struct _async_cancel_cb {
 #define ASYNC_OP_FLAG_CANCELLED 1
 #define ASYNC_OP_FLAG_DEFER 2
 
+/* Maximum number of addresses per family being tried when a socket connection is established. */
+#define ASYNC_DNS_MAX_ADDRESSES 8
+
+typedef struct _async_dns_cache_entry async_dns_cache_entry;
+
+typedef struct {
+	/* Cached lookup results indexed by protocol and lower-case host name. */
+	HashTable entries;
+	
+	/* Cached lookup results ordered from least to most recently used. */
+	async_dns_cache_entry *first;
+	async_dns_cache_entry *last;
+	
+	/* Cache statistics. */
+	zend_long hits;
+	zend_long misses;
+	zend_long evictions;
+	zend_long coalesced;
+} async_dns_cache;
+
 typedef enum {
 	ASYNC_STATUS_PENDING,
 	ASYNC_STATUS_RUNNING,
@@ -615,6 +660,50 @@ typedef struct {
 	size_t len;
 } async_ring_buffer;
 
+#define ASYNC_TIMER_WHEEL_SLOTS 512
+#define ASYNC_TIMER_WHEEL_RESOLUTION 10
+
+typedef struct _async_timer_wheel_entry async_timer_wheel_entry;
+
+typedef void (* async_timer_wheel_cb)(async_timer_wheel_entry *entry);
+
+struct _async_timer_wheel_entry {
+	/* Callback to be invoked when the timeout expires. */
+	async_timer_wheel_cb func;
+	
+	/* Opaque pointer being passed to the callback. */
+	void *arg;
+	
+	/* Number of full wheel rotations before the entry expires. */
+	uint64_t rounds;
+	
+	/* Slot that contains the entry (ASYNC_TIMER_WHEEL_SLOTS refers to the list of expired entries). */
+	uint16_t slot;
+	
+	/* Is set while the entry is scheduled. */
+	zend_bool active;
+	
+	async_timer_wheel_entry *prev;
+	async_timer_wheel_entry *next;
+};
+
+typedef struct {
+	/* Timer being used to advance the wheel while entries are scheduled. */
+	uv_timer_t timer;
+	
+	/* Loop time of the last processed tick (in milliseconds). */
+	uint64_t now;
+	
+	/* Index of the slot that has been processed last. */
+	uint32_t cursor;
+	
+	/* Number of scheduled entries. */
+	uint32_t count;
+	
+	/* Hashed slots (followed by the list of expired entries). */
+	async_timer_wheel_entry *slots[ASYNC_TIMER_WHEEL_SLOTS + 1];
+} async_timer_wheel;
+
 struct _async_task {
 	/* Embedded fiber. */
 	async_fiber fiber;
@@ -680,6 +769,12 @@ struct _async_task_scheduler {
 	uv_timer_t busy;
 	zend_ulong busy_count;
 	
+	/* Hashed timer wheel being used for socket timeouts. */
+	async_timer_wheel wheel;
+	
+	/* Pending DNS lookups indexed by protocol and lower-case host name. */
+	HashTable dns;
+	
 	async_fiber_context fiber;
 	async_fiber_context current;
 	async_fiber_context caller;
@@ -700,8 +795,26 @@ ASYNC_API size_t async_ring_buffer_read_string(async_ring_buffer *buffer, zend_s
 ASYNC_API void async_ring_buffer_consume(async_ring_buffer *buffer, size_t len);
 ASYNC_API void async_ring_buffer_write_move(async_ring_buffer *buffer, size_t offset);
 
+ASYNC_API void async_timer_wheel_init(async_timer_wheel *wheel, uv_loop_t *loop);
+ASYNC_API void async_timer_wheel_close(async_timer_wheel *wheel);
+ASYNC_API void async_timer_wheel_start(async_timer_wheel *wheel, async_timer_wheel_entry *entry, uint64_t timeout);
+ASYNC_API int async_timer_wheel_stop(async_timer_wheel *wheel, async_timer_wheel_entry *entry);
+
 ASYNC_API int async_dns_lookup_ipv4(char *name, struct sockaddr_in *dest, int proto);
 ASYNC_API int async_dns_lookup_ipv6(char *name, struct sockaddr_in6 *dest, int proto);
+ASYNC_API int async_dns_lookup(char *name, int port, struct sockaddr_storage *dest, int max, int proto);
+
+ASYNC_API int async_tcp_connect(uv_tcp_t *handle, char *name, int port, uint64_t timeout);
+ASYNC_API int async_tcp_export(zend_object *object, uv_stream_t **handle);
+ASYNC_API int async_tcp_import(zval *result, uv_stream_t *pipe);
+ASYNC_API int async_tcp_socket_connect(zval *result, zend_string *name, zend_long port, zval *tls, uint64_t timeout);
+ASYNC_API zend_bool async_tcp_socket_is_reusable(zend_object *object);
+
+ASYNC_API zend_object *async_socket_delegate_create(zend_class_entry *ce, zend_object *socket);
+ASYNC_API void async_socket_closed_error(zval *error, zval *previous);
+
+ASYNC_API int async_unix_bind(uv_pipe_t *handle, const char *path, size_t len);
+ASYNC_API int async_unix_connect(uv_pipe_t *handle, const char *path, size_t len);
 
 
 ZEND_BEGIN_MODULE_GLOBALS(async)
@@ -735,12 +848,24 @@ ZEND_BEGIN_MODULE_GLOBALS(async)
 	/* Default fiber C stack size. */
 	zend_long stack_size;
 	
+	/* Process-wide cache of DNS lookup results. */
+	async_dns_cache dns_cache;
+	
+	/* DNS cache settings (max number of entries, TTLs in seconds). */
+	zend_long dns_cache_size;
+	zend_long dns_cache_ttl;
+	zend_long dns_cache_negative_ttl;
+	
+	/* Resolver being used by socket lookups (NULL if the system resolver is used). */
+	zend_object *dns_resolver;
+	
 	/* INI settings. */
 	zend_bool dns_enabled;
 	zend_bool fs_enabled;
 	zend_bool tcp_enabled;
 	zend_bool timer_enabled;
 	zend_bool udp_enabled;
+	zend_bool unix_enabled;
 
 ZEND_END_MODULE_GLOBALS(async)
 
@@ -0,0 +1,695 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-2018 The PHP Group                                |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Martin Schröder <m.schroeder2007@gmail.com>                 |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_async.h"
+#include "async_ssl.h"
+#include "async_task.h"
+
+#include "zend_smart_str.h"
+
+ASYNC_API zend_class_entry *async_connection_pool_ce;
+
+static zend_object_handlers async_connection_pool_handlers;
+
+#define ASYNC_POOL_DEFAULT_MAX_PER_HOST 8
+#define ASYNC_POOL_DEFAULT_IDLE_TIMEOUT 30000
+
+typedef struct _async_pool_host async_pool_host;
+typedef struct _async_pool_entry async_pool_entry;
+
+struct _async_pool_entry {
+	/* Pooled TcpSocket object. */
+	zend_object *socket;
+
+	/* Host the socket is connected to. */
+	async_pool_host *host;
+
+	/* Loop time (in milliseconds) when the socket has been released into the pool. */
+	uint64_t idle;
+
+	async_pool_entry *next;
+	async_pool_entry *prev;
+};
+
+typedef struct {
+	async_pool_entry *first;
+	async_pool_entry *last;
+} async_pool_entry_queue;
+
+struct _async_pool_host {
+	/* Hostname (or IP address) and port being used to connect sockets. */
+	zend_string *name;
+	zend_long port;
+
+	/* TLS client encryption settings (undef if sockets are not encrypted). */
+	zval tls;
+
+	/* Number of open sockets (checked out, idle or connecting). */
+	uint32_t count;
+
+	/* Idle sockets, the most recently released socket is reused first. */
+	async_pool_entry_queue idle;
+
+	/* Tasks waiting for a socket to become available. */
+	async_op_queue waiters;
+};
+
+typedef struct {
+	/* PHP object handle. */
+	zend_object std;
+
+	/* Task scheduler being used. */
+	async_task_scheduler *scheduler;
+
+	/* Maximum number of open sockets per host. */
+	uint32_t max_per_host;
+
+	/* Idle sockets are closed after this number of milliseconds (0 = never). */
+	uint64_t idle_timeout;
+
+	/* Pooled hosts by host, port and TLS settings. */
+	HashTable hosts;
+
+	/* Checked out sockets by object handle. */
+	HashTable leased;
+
+	/* Error being used to close the pool. */
+	zval error;
+
+	/* UV timer handle being used to close expired idle sockets. */
+	uv_timer_t timer;
+
+	async_cancel_cb cancel;
+} async_connection_pool;
+
+
+static zend_string *create_key(zend_string *name, zend_long port, zval *tls)
+{
+#ifdef HAVE_ASYNC_SSL
+	async_tls_client_encryption *encryption;
+#endif
+
+	smart_str key = {0};
+
+	smart_str_append(&key, name);
+	smart_str_appendc(&key, ':');
+	smart_str_append_long(&key, port);
+
+#ifdef HAVE_ASYNC_SSL
+	if (tls != NULL && Z_TYPE_P(tls) != IS_NULL) {
+		encryption = (async_tls_client_encryption *) Z_OBJ_P(tls);
+
+		smart_str_appends(&key, "|tls|");
+		smart_str_append_long(&key, encryption->settings.allow_self_signed);
+		smart_str_appendc(&key, '|');
+		smart_str_append_long(&key, encryption->settings.verify_depth);
+		smart_str_appendc(&key, '|');
+		smart_str_append_long(&key, encryption->settings.kernel_tls);
+		smart_str_appendc(&key, '|');
+
+		if (encryption->settings.peer_name != NULL) {
+			smart_str_append(&key, encryption->settings.peer_name);
+		}
+
+		smart_str_appendc(&key, '|');
+
+		if (encryption->settings.alpn != NULL) {
+			smart_str_append(&key, encryption->settings.alpn);
+		}
+	}
+#endif
+
+	smart_str_0(&key);
+
+	return key.s;
+}
+
+static void dispose_entry(async_pool_entry *entry)
+{
+	OBJ_RELEASE(entry->socket);
+
+	efree(entry);
+}
+
+/* Dequeues the first task that is still waiting, cancelled tasks must not be handed a slot or socket. */
+static async_op *next_waiter(async_pool_host *host)
+{
+	async_op *op;
+
+	while (host->waiters.first != NULL) {
+		ASYNC_DEQUEUE_OP(&host->waiters, op);
+
+		if (op->status == ASYNC_STATUS_RUNNING && !(op->flags & ASYNC_OP_FLAG_CANCELLED)) {
+			return op;
+		}
+	}
+
+	return NULL;
+}
+
+/* Frees a socket slot of the host, the slot is handed to the first waiting task instead if there is one. */
+static void release_slot(async_pool_host *host)
+{
+	async_op *op;
+	zval tmp;
+
+	op = next_waiter(host);
+
+	if (op == NULL) {
+		host->count--;
+	} else {
+		ZVAL_NULL(&tmp);
+
+		ASYNC_RESOLVE_OP(op, &tmp);
+	}
+}
+
+static void host_dtor(zval *zv)
+{
+	async_pool_host *host;
+	async_pool_entry *entry;
+
+	host = (async_pool_host *) Z_PTR_P(zv);
+
+	ZEND_ASSERT(host->waiters.first == NULL);
+
+	while (host->idle.first != NULL) {
+		ASYNC_Q_DEQUEUE(&host->idle, entry);
+
+		dispose_entry(entry);
+	}
+
+	zend_string_release(host->name);
+	zval_ptr_dtor(&host->tls);
+
+	efree(host);
+}
+
+static void leased_dtor(zval *zv)
+{
+	if (Z_PTR_P(zv) != NULL) {
+		dispose_entry((async_pool_entry *) Z_PTR_P(zv));
+	}
+}
+
+static void expire_idle(uv_timer_t *handle)
+{
+	async_connection_pool *pool;
+	async_pool_host *host;
+	async_pool_entry *entry;
+
+	uint64_t now;
+	zend_bool idle;
+
+	pool = (async_connection_pool *) handle->data;
+
+	ZEND_ASSERT(pool != NULL);
+
+	now = uv_now(handle->loop);
+	idle = 0;
+
+	ZEND_HASH_FOREACH_PTR(&pool->hosts, host) {
+		// Idle queues are ordered by release time, expired sockets are always at the front.
+		while (host->idle.first != NULL && (host->idle.first->idle + pool->idle_timeout) <= now) {
+			ASYNC_Q_DEQUEUE(&host->idle, entry);
+
+			dispose_entry(entry);
+			release_slot(host);
+		}
+
+		if (host->idle.first != NULL) {
+			idle = 1;
+		}
+	} ZEND_HASH_FOREACH_END();
+
+	if (!idle) {
+		uv_timer_stop(handle);
+	}
+}
+
+static void close_pool(async_connection_pool *pool)
+{
+	async_pool_host *host;
+	async_pool_entry *entry;
+	async_op *op;
+
+	ZEND_HASH_FOREACH_PTR(&pool->hosts, host) {
+		while (host->idle.first != NULL) {
+			ASYNC_Q_DEQUEUE(&host->idle, entry);
+
+			dispose_entry(entry);
+
+			host->count--;
+		}
+
+		while (host->waiters.first != NULL) {
+			ASYNC_DEQUEUE_OP(&host->waiters, op);
+			ASYNC_FAIL_OP(op, &pool->error);
+		}
+	} ZEND_HASH_FOREACH_END();
+}
+
+static void pool_disposed(uv_handle_t *handle)
+{
+	async_connection_pool *pool;
+
+	pool = (async_connection_pool *) handle->data;
+
+	ZEND_ASSERT(pool != NULL);
+
+	ASYNC_DELREF(&pool->std);
+}
+
+static void shutdown_pool(void *obj, zval *error)
+{
+	async_connection_pool *pool;
+
+	pool = (async_connection_pool *) obj;
+
+	ZEND_ASSERT(pool != NULL);
+
+	pool->cancel.func = NULL;
+
+	if (Z_TYPE_P(&pool->error) == IS_UNDEF) {
+		if (error == NULL) {
+			ASYNC_PREPARE_ERROR(&pool->error, "Connection pool has been closed");
+		} else {
+			ZVAL_COPY(&pool->error, error);
+		}
+	}
+
+	close_pool(pool);
+
+	if (!uv_is_closing((uv_handle_t *) &pool->timer)) {
+		ASYNC_ADDREF(&pool->std);
+
+		uv_close((uv_handle_t *) &pool->timer, pool_disposed);
+	}
+}
+
+/* Establishes a new socket connection using a slot that has already been reserved. */
+static int connect_socket(async_pool_host *host, zval *result)
+{
+	zval retval;
+	zval *tls;
+
+	tls = (Z_TYPE_P(&host->tls) == IS_UNDEF) ? NULL : &host->tls;
+
+	if (FAILURE == async_tcp_socket_connect(result, host->name, host->port, tls, 0)) {
+		release_slot(host);
+
+		return FAILURE;
+	}
+
+	if (tls != NULL) {
+		ZVAL_UNDEF(&retval);
+
+		zend_call_method_with_0_params(result, Z_OBJCE_P(result), NULL, "encrypt", &retval);
+		zval_ptr_dtor(&retval);
+
+		if (UNEXPECTED(EG(exception))) {
+			zval_ptr_dtor(result);
+			release_slot(host);
+
+			return FAILURE;
+		}
+	}
+
+	return SUCCESS;
+}
+
+static void lease_socket(async_connection_pool *pool, async_pool_host *host, async_pool_entry *entry, zval *socket)
+{
+	if (entry == NULL) {
+		entry = emalloc(sizeof(async_pool_entry));
+		ZEND_SECURE_ZERO(entry, sizeof(async_pool_entry));
+
+		entry->host = host;
+		entry->socket = Z_OBJ_P(socket);
+
+		GC_ADDREF(entry->socket);
+	}
+
+	zend_hash_index_update_ptr(&pool->leased, entry->socket->handle, entry);
+}
+
+
+static zend_object *async_connection_pool_object_create(zend_class_entry *ce)
+{
+	async_connection_pool *pool;
+
+	pool = emalloc(sizeof(async_connection_pool));
+	ZEND_SECURE_ZERO(pool, sizeof(async_connection_pool));
+
+	zend_object_std_init(&pool->std, ce);
+	pool->std.handlers = &async_connection_pool_handlers;
+
+	pool->max_per_host = ASYNC_POOL_DEFAULT_MAX_PER_HOST;
+	pool->idle_timeout = ASYNC_POOL_DEFAULT_IDLE_TIMEOUT;
+
+	zend_hash_init(&pool->hosts, 0, NULL, host_dtor, 0);
+	zend_hash_init(&pool->leased, 0, NULL, leased_dtor, 0);
+
+	ZVAL_UNDEF(&pool->error);
+
+	pool->scheduler = async_task_scheduler_get();
+
+	ASYNC_ADDREF(&pool->scheduler->std);
+
+	// The timer must not keep the event loop running, idle sockets are closed when the pool is disposed anyway.
+	uv_timer_init(&pool->scheduler->loop, &pool->timer);
+	uv_unref((uv_handle_t *) &pool->timer);
+
+	pool->timer.data = pool;
+
+	pool->cancel.object = pool;
+	pool->cancel.func = shutdown_pool;
+
+	ASYNC_Q_ENQUEUE(&pool->scheduler->shutdown, &pool->cancel);
+
+	return &pool->std;
+}
+
+static void async_connection_pool_object_dtor(zend_object *object)
+{
+	async_connection_pool *pool;
+
+	pool = (async_connection_pool *) object;
+
+	if (pool->cancel.func != NULL) {
+		ASYNC_Q_DETACH(&pool->scheduler->shutdown, &pool->cancel);
+
+		pool->cancel.func(pool, NULL);
+	}
+}
+
+static void async_connection_pool_object_destroy(zend_object *object)
+{
+	async_connection_pool *pool;
+
+	pool = (async_connection_pool *) object;
+
+	zend_hash_destroy(&pool->leased);
+	zend_hash_destroy(&pool->hosts);
+
+	zval_ptr_dtor(&pool->error);
+
+	ASYNC_DELREF(&pool->scheduler->std);
+
+	zend_object_std_dtor(&pool->std);
+}
+
+ZEND_METHOD(ConnectionPool, __construct)
+{
+	async_connection_pool *pool;
+
+	zend_long max;
+	zend_long timeout;
+
+	max = ASYNC_POOL_DEFAULT_MAX_PER_HOST;
+	timeout = ASYNC_POOL_DEFAULT_IDLE_TIMEOUT;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 2)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_LONG(max)
+		Z_PARAM_LONG(timeout)
+	ZEND_PARSE_PARAMETERS_END();
+
+	ASYNC_CHECK_ERROR(max < 1 || max > UINT32_MAX, "Maximum number of connections per host must be at least 1");
+	ASYNC_CHECK_ERROR(timeout < 0, "Idle timeout must not be negative");
+
+	pool = (async_connection_pool *) Z_OBJ_P(getThis());
+
+	pool->max_per_host = (uint32_t) max;
+	pool->idle_timeout = (uint64_t) timeout;
+}
+
+ZEND_METHOD(ConnectionPool, checkout)
+{
+	async_connection_pool *pool;
+	async_pool_host *host;
+	async_pool_entry *entry;
+	async_op *op;
+
+	zend_string *name;
+	zend_string *key;
+	zend_long port;
+
+	zval *tls;
+	zval socket;
+
+	tls = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 3)
+		Z_PARAM_STR(name)
+		Z_PARAM_LONG(port)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_OBJECT_OF_CLASS_EX(tls, async_tls_client_encryption_ce, 1, 0)
+	ZEND_PARSE_PARAMETERS_END();
+
+	pool = (async_connection_pool *) Z_OBJ_P(getThis());
+
+	if (Z_TYPE_P(&pool->error) != IS_UNDEF) {
+		Z_ADDREF_P(&pool->error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&pool->error);
+		execute_data->opline++;
+
+		return;
+	}
+
+	key = create_key(name, port, tls);
+	host = zend_hash_find_ptr(&pool->hosts, key);
+
+	if (host == NULL) {
+		host = emalloc(sizeof(async_pool_host));
+		ZEND_SECURE_ZERO(host, sizeof(async_pool_host));
+
+		host->name = zend_string_copy(name);
+		host->port = port;
+
+		if (tls == NULL || Z_TYPE_P(tls) == IS_NULL) {
+			ZVAL_UNDEF(&host->tls);
+		} else {
+			ZVAL_COPY(&host->tls, tls);
+		}
+
+		zend_hash_add_ptr(&pool->hosts, key, host);
+	}
+
+	zend_string_release(key);
+
+	// Reuse the most recently released socket that is still healthy.
+	while (host->idle.last != NULL) {
+		entry = host->idle.last;
+
+		ASYNC_Q_DETACH(&host->idle, entry);
+
+		if (async_tcp_socket_is_reusable(entry->socket)) {
+			lease_socket(pool, host, entry, NULL);
+
+			GC_ADDREF(entry->socket);
+
+			RETURN_OBJ(entry->socket);
+		}
+
+		dispose_entry(entry);
+
+		host->count--;
+	}
+
+	if (host->count < pool->max_per_host) {
+		host->count++;
+	} else {
+		ASYNC_ALLOC_OP(op);
+		ASYNC_ENQUEUE_OP(&host->waiters, op);
+
+		if (async_await_op(op) == FAILURE) {
+			ASYNC_FORWARD_OP_ERROR(op);
+			ASYNC_FREE_OP(op);
+
+			return;
+		}
+
+		ZVAL_COPY(&socket, &op->result);
+
+		ASYNC_FREE_OP(op);
+
+		// A released socket has been handed over by another task.
+		if (Z_TYPE_P(&socket) == IS_OBJECT) {
+			lease_socket(pool, host, NULL, &socket);
+
+			RETURN_ZVAL(&socket, 1, 1);
+		}
+	}
+
+	if (FAILURE == connect_socket(host, &socket)) {
+		return;
+	}
+
+	lease_socket(pool, host, NULL, &socket);
+
+	RETURN_ZVAL(&socket, 1, 1);
+}
+
+ZEND_METHOD(ConnectionPool, release)
+{
+	async_connection_pool *pool;
+	async_pool_host *host;
+	async_pool_entry *entry;
+	async_op *op;
+
+	zend_bool reuse;
+
+	zval *val;
+	zval *zv;
+	zval socket;
+	zval retval;
+
+	reuse = 1;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 2)
+		Z_PARAM_OBJECT_OF_CLASS(val, async_tcp_socket_ce)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_BOOL(reuse)
+	ZEND_PARSE_PARAMETERS_END();
+
+	pool = (async_connection_pool *) Z_OBJ_P(getThis());
+	zv = zend_hash_index_find(&pool->leased, Z_OBJ_HANDLE_P(val));
+
+	ASYNC_CHECK_ERROR(zv == NULL, "Socket has not been checked out from this connection pool");
+
+	entry = (async_pool_entry *) Z_PTR_P(zv);
+
+	// Remove the entry without disposing it, the entry is reused or disposed below.
+	ZVAL_PTR(zv, NULL);
+	zend_hash_index_del(&pool->leased, Z_OBJ_HANDLE_P(val));
+
+	host = entry->host;
+
+	if (reuse && Z_TYPE_P(&pool->error) == IS_UNDEF && async_tcp_socket_is_reusable(entry->socket)) {
+		op = next_waiter(host);
+
+		if (op != NULL) {
+			ZVAL_OBJ(&socket, entry->socket);
+
+			ASYNC_RESOLVE_OP(op, &socket);
+
+			dispose_entry(entry);
+		} else {
+			entry->idle = uv_now(&pool->scheduler->loop);
+
+			ASYNC_Q_ENQUEUE(&host->idle, entry);
+
+			if (pool->idle_timeout > 0 && !uv_is_active((uv_handle_t *) &pool->timer)) {
+				uv_timer_start(&pool->timer, expire_idle, pool->idle_timeout, pool->idle_timeout);
+			}
+		}
+
+		return;
+	}
+
+	ZVAL_UNDEF(&retval);
+
+	zend_call_method_with_0_params(val, Z_OBJCE_P(val), NULL, "close", &retval);
+	zval_ptr_dtor(&retval);
+
+	dispose_entry(entry);
+	release_slot(host);
+}
+
+ZEND_METHOD(ConnectionPool, close)
+{
+	async_connection_pool *pool;
+
+	zval error;
+	zval *val;
+
+	val = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	pool = (async_connection_pool *) Z_OBJ_P(getThis());
+
+	if (pool->cancel.func == NULL) {
+		return;
+	}
+
+	ASYNC_PREPARE_ERROR(&error, "Connection pool has been closed");
+
+	if (val != NULL && Z_TYPE_P(val) != IS_NULL) {
+		zend_exception_set_previous(Z_OBJ_P(&error), Z_OBJ_P(val));
+		GC_ADDREF(Z_OBJ_P(val));
+	}
+
+	ASYNC_Q_DETACH(&pool->scheduler->shutdown, &pool->cancel);
+
+	pool->cancel.func(pool, &error);
+
+	zval_ptr_dtor(&error);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_connection_pool_ctor, 0, 0, 0)
+	ZEND_ARG_TYPE_INFO(0, maxPerHost, IS_LONG, 0)
+	ZEND_ARG_TYPE_INFO(0, idleTimeout, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_connection_pool_checkout, 0, 2, Concurrent\\Network\\TcpSocket, 0)
+	ZEND_ARG_TYPE_INFO(0, host, IS_STRING, 0)
+	ZEND_ARG_TYPE_INFO(0, port, IS_LONG, 0)
+	ZEND_ARG_OBJ_INFO(0, tls, Concurrent\\Network\\TlsClientEncryption, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_connection_pool_release, 0, 1, IS_VOID, 0)
+	ZEND_ARG_OBJ_INFO(0, socket, Concurrent\\Network\\TcpSocket, 0)
+	ZEND_ARG_TYPE_INFO(0, reuse, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_connection_pool_close, 0, 0, IS_VOID, 0)
+	ZEND_ARG_OBJ_INFO(0, error, Throwable, 1)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry async_connection_pool_functions[] = {
+	ZEND_ME(ConnectionPool, __construct, arginfo_connection_pool_ctor, ZEND_ACC_PUBLIC)
+	ZEND_ME(ConnectionPool, checkout, arginfo_connection_pool_checkout, ZEND_ACC_PUBLIC)
+	ZEND_ME(ConnectionPool, release, arginfo_connection_pool_release, ZEND_ACC_PUBLIC)
+	ZEND_ME(ConnectionPool, close, arginfo_connection_pool_close, ZEND_ACC_PUBLIC)
+	ZEND_FE_END
+};
+
+
+void async_connection_pool_ce_register()
+{
+	zend_class_entry ce;
+
+	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\ConnectionPool", async_connection_pool_functions);
+	async_connection_pool_ce = zend_register_internal_class(&ce);
+	async_connection_pool_ce->ce_flags |= ZEND_ACC_FINAL;
+	async_connection_pool_ce->create_object = async_connection_pool_object_create;
+	async_connection_pool_ce->serialize = zend_class_serialize_deny;
+	async_connection_pool_ce->unserialize = zend_class_unserialize_deny;
+
+	memcpy(&async_connection_pool_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+	async_connection_pool_handlers.dtor_obj = async_connection_pool_object_dtor;
+	async_connection_pool_handlers.free_obj = async_connection_pool_object_destroy;
+	async_connection_pool_handlers.clone_obj = NULL;
+}
@@ -18,6 +18,12 @@
 
 #include "php_async.h"
 
+#include "ext/standard/php_mt_rand.h"
+#include "ext/standard/php_random.h"
+
+ASYNC_API zend_class_entry *async_dns_cache_ce;
+ASYNC_API zend_class_entry *async_resolver_ce;
+
 
 static zend_function *orig_gethostbyname;
 static zif_handler orig_gethostbyname_handler;
@@ -26,145 +32,523 @@ static zend_function *orig_gethostbynamel;
 static zif_handler orig_gethostbynamel_handler;
 
 
-static void dns_gethostbyname_cb(uv_getaddrinfo_t *req, int status, struct addrinfo *addr)
+typedef union {
+	struct sockaddr sa;
+	struct sockaddr_in in4;
+	struct sockaddr_in6 in6;
+} async_dns_address;
+
+typedef struct {
+	/* Number of cache entries and lookups referencing the result (persistent memory). */
+	uint32_t refcount;
+	
+	int count;
+	async_dns_address addresses[1];
+} async_dns_result;
+
+struct _async_dns_cache_entry {
+	/* Protocol followed by the lower-case host name. */
+	zend_string *key;
+	
+	/* Expiration time (in milliseconds, based on uv_hrtime()). */
+	uint64_t expires;
+	
+	/* Error code of a failed lookup (negative caching), 0 if the lookup succeeded. */
+	int code;
+	
+	async_dns_result *result;
+	
+	async_dns_cache_entry *prev;
+	async_dns_cache_entry *next;
+};
+
+typedef struct {
+	async_op base;
+	int code;
+	async_dns_result *result;
+} async_dns_lookup_op;
+
+typedef struct {
+	uv_getaddrinfo_t req;
+	async_task_scheduler *scheduler;
+	
+	/* Protocol followed by the lower-case host name. */
+	zend_string *key;
+	int proto;
+	
+	/* Set if the lookup has been cancelled because all waiting tasks have been cancelled. */
+	zend_bool cancelled;
+	
+	/* Tasks awaiting the result of the lookup. */
+	async_op_queue waiters;
+} async_dns_flight;
+
+static void dns_release(async_dns_result *result)
+{
+	if (--result->refcount == 0) {
+		pefree(result, 1);
+	}
+}
+
+/* Collects all addresses (the result is NULL if there are none), the full list is needed by gethostbynamel(). */
+static async_dns_result *dns_collect(struct addrinfo *info, int proto)
 {
-	async_uv_op *op;
+	async_dns_result *result;
+	struct addrinfo *entry;
+	
+	size_t len;
+	int count;
+	int i;
 	
-	op = (async_uv_op *) req->data;
+	count = 0;
 	
-	ZEND_ASSERT(op != NULL);
+	for (entry = info; entry != NULL; entry = entry->ai_next) {
+		count++;
+	}
 	
-	if (status == UV_ECANCELED) {
-		ASYNC_FREE_OP(op);
-	} else {	
-		op->code = status;
+	if (count == 0) {
+		return NULL;
+	}
+	
+	result = pemalloc(sizeof(async_dns_result) + sizeof(async_dns_address) * (count - 1), 1);
+	result->refcount = 1;
+	result->count = 0;
+	
+	for (; info != NULL; info = info->ai_next) {
+		if (info->ai_protocol != proto && proto != 0) {
+			continue;
+		}
 		
-		ASYNC_FINISH_OP(op);
+		if (info->ai_family == AF_INET) {
+			len = sizeof(struct sockaddr_in);
+		} else if (info->ai_family == AF_INET6) {
+			len = sizeof(struct sockaddr_in6);
+		} else {
+			continue;
+		}
+		
+		// Lookups without protocol return every address once per socket type.
+		for (i = 0; i < result->count; i++) {
+			if (result->addresses[i].sa.sa_family == info->ai_family && 0 == memcmp(&result->addresses[i], info->ai_addr, len)) {
+				break;
+			}
+		}
+		
+		if (i < result->count) {
+			continue;
+		}
+		
+		memcpy(&result->addresses[result->count++], info->ai_addr, len);
 	}
+	
+	if (result->count == 0) {
+		pefree(result, 1);
+		
+		return NULL;
+	}
+	
+	return result;
 }
 
-static int dns_gethostbyname(uv_getaddrinfo_t *req, char *name, int proto)
+static void dns_cache_remove(async_dns_cache *cache, async_dns_cache_entry *entry)
 {
-	async_task_scheduler *scheduler;
-	async_uv_op *op;
+	ASYNC_Q_DETACH(cache, entry);
 	
-	struct addrinfo hints;
-	int code;
+	zend_hash_del(&cache->entries, entry->key);
+	zend_string_release(entry->key);
 	
-	op = NULL;
-	scheduler = async_task_scheduler_get();
+	if (entry->result != NULL) {
+		dns_release(entry->result);
+	}
 	
-	if (async_cli) {
-		ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_uv_op));
+	pefree(entry, 1);
+}
+
+static void dns_cache_store(async_dns_cache *cache, zend_string *key, int code, async_dns_result *result)
+{
+	async_dns_cache_entry *entry;
+	
+	zend_long ttl;
+	
+	if (ASYNC_G(dns_cache_size) <= 0 || (code != 0 && code != UV_EAI_NONAME && code != UV_EAI_NODATA)) {
+		return;
+	}
+	
+	ttl = (code == 0) ? ASYNC_G(dns_cache_ttl) : ASYNC_G(dns_cache_negative_ttl);
+	
+	if (ttl <= 0) {
+		return;
+	}
+	
+	entry = (async_dns_cache_entry *) zend_hash_find_ptr(&cache->entries, key);
+	
+	if (entry != NULL) {
+		ASYNC_Q_DETACH(cache, entry);
+		
+		if (entry->result != NULL) {
+			dns_release(entry->result);
+		}
+	} else {
+		while (cache->first != NULL && zend_hash_num_elements(&cache->entries) >= (uint32_t) ASYNC_G(dns_cache_size)) {
+			dns_cache_remove(cache, cache->first);
+			
+			cache->evictions++;
+		}
+		
+		entry = pemalloc(sizeof(async_dns_cache_entry), 1);
+		entry->key = zend_string_init(ZSTR_VAL(key), ZSTR_LEN(key), 1);
 		
-		req->data = op;
+		zend_hash_add_ptr(&cache->entries, entry->key, entry);
 	}
 	
+	entry->expires = uv_hrtime() / 1000000 + (uint64_t) ttl * 1000;
+	entry->code = code;
+	entry->result = (code == 0) ? result : NULL;
+	
+	if (entry->result != NULL) {
+		entry->result->refcount++;
+	}
+	
+	ASYNC_Q_ENQUEUE(cache, entry);
+}
+
+static int dns_gethostbyname(char *name, int proto, async_dns_result **result)
+{
+	uv_getaddrinfo_t req;
+	struct addrinfo hints;
+	int code;
+	
+	ZEND_SECURE_ZERO(&req, sizeof(uv_getaddrinfo_t));
 	ZEND_SECURE_ZERO(&hints, sizeof(struct addrinfo));
 	
 	if (proto > 0) {
 		hints.ai_protocol = proto;
 	}
+	
+	code = uv_getaddrinfo(&async_task_scheduler_get()->loop, &req, NULL, name, NULL, &hints);
+	
+	if (code == 0 && NULL == (*result = dns_collect(req.addrinfo, proto))) {
+		code = UV_EAI_NODATA;
+	}
+	
+	uv_freeaddrinfo(req.addrinfo);
+	
+	return code;
+}
 
-	code = uv_getaddrinfo(&scheduler->loop, req, async_cli ? dns_gethostbyname_cb : NULL, name, NULL, &hints);
+static void dns_flight_cb(uv_getaddrinfo_t *req, int status, struct addrinfo *info)
+{
+	async_dns_flight *flight;
+	async_dns_lookup_op *op;
+	async_dns_result *result;
 	
-	if (UNEXPECTED(code < 0)) {
-		if (async_cli) {
-			ASYNC_FREE_OP(op);
+	flight = (async_dns_flight *) req->data;
+	
+	ZEND_ASSERT(flight != NULL);
+	
+	result = NULL;
+	
+	if (status == 0 && NULL == (result = dns_collect(info, flight->proto))) {
+		status = UV_EAI_NODATA;
+	}
+	
+	uv_freeaddrinfo(info);
+	
+	if (!flight->cancelled) {
+		zend_hash_del(&flight->scheduler->dns, flight->key);
+		
+		dns_cache_store(&ASYNC_G(dns_cache), flight->key, status, result);
+	}
+	
+	while (flight->waiters.first != NULL) {
+		ASYNC_DEQUEUE_CUSTOM_OP(&flight->waiters, op, async_dns_lookup_op);
+		
+		// Cancelled tasks that have not been resumed yet are only detached from the lookup.
+		if (op->base.flags & ASYNC_OP_FLAG_CANCELLED) {
+			continue;
+		}
+		
+		op->code = status;
+		op->result = result;
+		
+		if (result != NULL) {
+			result->refcount++;
 		}
+		
+		ASYNC_FINISH_OP(op);
+	}
+	
+	if (result != NULL) {
+		dns_release(result);
+	}
+	
+	zend_string_release(flight->key);
+	
+	efree(flight);
+}
+
+static int dns_await_lookup(zend_string *key, char *name, int proto, async_dns_result **result)
+{
+	async_task_scheduler *scheduler;
+	async_dns_flight *flight;
+	async_dns_lookup_op *op;
 	
-		uv_freeaddrinfo(req->addrinfo);
+	struct addrinfo hints;
+	int code;
+	
+	scheduler = async_task_scheduler_get();
+	
+	// Concurrent lookups of the same host are coalesced into a single request.
+	flight = (async_dns_flight *) zend_hash_find_ptr(&scheduler->dns, key);
+	
+	if (flight == NULL) {
+		flight = emalloc(sizeof(async_dns_flight));
+		ZEND_SECURE_ZERO(flight, sizeof(async_dns_flight));
 		
-		return code;
+		ZEND_SECURE_ZERO(&hints, sizeof(struct addrinfo));
+		
+		if (proto > 0) {
+			hints.ai_protocol = proto;
+		}
+		
+		code = uv_getaddrinfo(&scheduler->loop, &flight->req, dns_flight_cb, name, NULL, &hints);
+		
+		if (UNEXPECTED(code < 0)) {
+			efree(flight);
+			
+			return code;
+		}
+		
+		flight->req.data = flight;
+		flight->scheduler = scheduler;
+		flight->key = zend_string_copy(key);
+		flight->proto = proto;
+		
+		zend_hash_add_ptr(&scheduler->dns, flight->key, flight);
+	} else {
+		ASYNC_G(dns_cache).coalesced++;
 	}
 	
-	if (async_cli) {
-		if (async_await_op((async_op *) op) == FAILURE) {
-			ASYNC_FORWARD_OP_ERROR(op);
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_dns_lookup_op));
+	ASYNC_ENQUEUE_OP(&flight->waiters, op);
+	
+	if (async_await_op((async_op *) op) == FAILURE) {
+		ASYNC_FORWARD_OP_ERROR(op);
+		
+		// The lookup has not completed yet if the op is still queued, it is cancelled when no other task is waiting.
+		if (op->base.q != NULL) {
+			ASYNC_FREE_OP(op);
 			
-			if (0 == uv_cancel((uv_req_t *) req)) {
-				ASYNC_FREE_OP(op);
-			} else {
-				op->base.status = ASYNC_STATUS_FAILED;
+			if (flight->waiters.first == NULL && !flight->cancelled && 0 == uv_cancel((uv_req_t *) &flight->req)) {
+				flight->cancelled = 1;
+				
+				zend_hash_del(&scheduler->dns, flight->key);
 			}
-
-			return FAILURE;
+		} else {
+			if (op->result != NULL) {
+				dns_release(op->result);
+			}
+			
+			ASYNC_FREE_OP(op);
 		}
 		
-		code = op->code;
+		return FAILURE;
+	}
+	
+	code = op->code;
+	
+	*result = op->result;
+	
+	ASYNC_FREE_OP(op);
+	
+	return code;
+}
+
+static int dns_lookup(char *name, int proto, async_dns_result **result);
 
-		ASYNC_FREE_OP(op);
+static int dns_lookup_system(char *name, int proto, async_dns_result **result)
+{
+	async_dns_cache *cache;
+	async_dns_cache_entry *entry;
+	
+	zend_string *key;
+	int code;
+	
+	cache = &ASYNC_G(dns_cache);
+	
+	key = zend_string_alloc(strlen(name) + 1, 0);
+	
+	ZSTR_VAL(key)[0] = (char) proto;
+	
+	zend_str_tolower_copy(ZSTR_VAL(key) + 1, name, ZSTR_LEN(key) - 1);
+	
+	if (ASYNC_G(dns_cache_size) > 0) {
+		entry = (async_dns_cache_entry *) zend_hash_find_ptr(&cache->entries, key);
 		
-		if (UNEXPECTED(code < 0)) {
-			uv_freeaddrinfo(req->addrinfo);
+		if (entry != NULL) {
+			if (entry->expires > uv_hrtime() / 1000000) {
+				cache->hits++;
+				
+				if (entry != cache->last) {
+					ASYNC_Q_DETACH(cache, entry);
+					ASYNC_Q_ENQUEUE(cache, entry);
+				}
+				
+				if (entry->code == 0) {
+					*result = entry->result;
+					(*result)->refcount++;
+				}
+				
+				zend_string_release(key);
+				
+				return entry->code;
+			}
 			
-			return code;
+			dns_cache_remove(cache, entry);
 		}
+		
+		cache->misses++;
 	}
 	
-	return 0;
+	if (async_cli) {
+		code = dns_await_lookup(key, name, proto, result);
+	} else {
+		code = dns_gethostbyname(name, proto, result);
+		
+		dns_cache_store(cache, key, code, (code == 0) ? *result : NULL);
+	}
+	
+	zend_string_release(key);
+	
+	return code;
 }
 
 ASYNC_API int async_dns_lookup_ipv4(char *name, struct sockaddr_in *dest, int proto)
 {
-	uv_getaddrinfo_t req;
-	struct addrinfo *info;
+	async_dns_result *result;
 	int code;
+	int i;
 	
-	code = dns_gethostbyname(&req, name, proto);
+	code = dns_lookup(name, proto, &result);
 	
 	if (code != 0) {
 		return code;
 	}
 	
-	info = req.addrinfo;
+	code = UV_EAI_NODATA;
 	
-	while (info != NULL) {
-		if (info->ai_family == AF_INET && (info->ai_protocol == proto || proto == 0)) {
-			memcpy(dest, info->ai_addr, sizeof(struct sockaddr_in));
-			
-			uv_freeaddrinfo(req.addrinfo);
+	for (i = 0; i < result->count; i++) {
+		if (result->addresses[i].sa.sa_family == AF_INET) {
+			memcpy(dest, &result->addresses[i].in4, sizeof(struct sockaddr_in));
 			
-			return 0;
+			code = 0;
+			break;
 		}
-		
-		info = info->ai_next;
 	}
 	
-	uv_freeaddrinfo(req.addrinfo);
+	dns_release(result);
 	
-	return UV_EAI_NODATA;
+	return code;
 }
 
 ASYNC_API int async_dns_lookup_ipv6(char *name, struct sockaddr_in6 *dest, int proto)
 {
-	uv_getaddrinfo_t req;
-	struct addrinfo *info;
+	async_dns_result *result;
 	int code;
+	int i;
 
-	code = dns_gethostbyname(&req, name, proto);
+	code = dns_lookup(name, proto, &result);
 
 	if (code != 0) {
 		return code;
 	}
+	
+	code = UV_EAI_NODATA;
 
-	info = req.addrinfo;
+	for (i = 0; i < result->count; i++) {
+		if (result->addresses[i].sa.sa_family == AF_INET6) {
+			memcpy(dest, &result->addresses[i].in6, sizeof(struct sockaddr_in6));
 
-	while (info != NULL) {
-		if (info->ai_family == AF_INET6 && (info->ai_protocol == proto || proto == 0)) {
-			memcpy(dest, info->ai_addr, sizeof(struct sockaddr_in6));
+			code = 0;
+			break;
+		}
+	}
+	
+	dns_release(result);
 
-			uv_freeaddrinfo(req.addrinfo);
+	return code;
+}
 
-			return 0;
+static int dns_next_address(async_dns_result *result, int *pos, int family)
+{
+	while (*pos < result->count) {
+		if (result->addresses[(*pos)++].sa.sa_family == family) {
+			return *pos - 1;
 		}
+	}
+	
+	return -1;
+}
 
-		info = info->ai_next;
+/* Resolves all IPv4 and IPv6 addresses of the given host, addresses are interleaved by family starting with IPv6 (RFC 8305). */
+ASYNC_API int async_dns_lookup(char *name, int port, struct sockaddr_storage *dest, int max, int proto)
+{
+	async_dns_result *result;
+	
+	int pos4;
+	int pos6;
+	int count;
+	int code;
+	int i;
+	
+	code = dns_lookup(name, proto, &result);
+	
+	if (code != 0) {
+		return code;
+	}
+	
+	pos4 = 0;
+	pos6 = 0;
+	count = 0;
+	
+	while (count < max && (pos4 < result->count || pos6 < result->count)) {
+		if (count < max && 0 <= (i = dns_next_address(result, &pos6, AF_INET6))) {
+			ZEND_SECURE_ZERO(&dest[count], sizeof(struct sockaddr_storage));
+			memcpy(&dest[count], &result->addresses[i].in6, sizeof(struct sockaddr_in6));
+			
+			((struct sockaddr_in6 *) &dest[count++])->sin6_port = htons(port);
+		}
+		
+		if (count < max && 0 <= (i = dns_next_address(result, &pos4, AF_INET))) {
+			ZEND_SECURE_ZERO(&dest[count], sizeof(struct sockaddr_storage));
+			memcpy(&dest[count], &result->addresses[i].in4, sizeof(struct sockaddr_in));
+			
+			((struct sockaddr_in *) &dest[count++])->sin_port = htons(port);
+		}
 	}
+	
+	dns_release(result);
+	
+	return (count == 0) ? UV_EAI_NODATA : count;
+}
 
-	uv_freeaddrinfo(req.addrinfo);
+void async_dns_cache_init(async_dns_cache *cache)
+{
+	zend_hash_init(&cache->entries, 0, NULL, NULL, 1);
+}
+
+static void dns_cache_flush(async_dns_cache *cache)
+{
+	while (cache->first != NULL) {
+		dns_cache_remove(cache, cache->first);
+	}
+}
 
-	return UV_EAI_NODATA;
+void async_dns_cache_destroy(async_dns_cache *cache)
+{
+	dns_cache_flush(cache);
+	
+	zend_hash_destroy(&cache->entries);
 }
 
 
@@ -173,10 +557,10 @@ static PHP_FUNCTION(asyncgethostbyname)
 	char *name;
 	size_t len;
 	
-	uv_getaddrinfo_t req;
-	struct addrinfo *info;
+	async_dns_result *result;
 	char ip[16];
 	int code;
+	int i;
 
 	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
 		Z_PARAM_STRING(name, len)
@@ -191,26 +575,22 @@ static PHP_FUNCTION(asyncgethostbyname)
 		return;
 	}
 	
-	code = dns_gethostbyname(&req, name, 0);
+	code = dns_lookup(name, 0, &result);
 	
 	if (code != 0) {
 		RETURN_STRINGL(name, len);
 	}
 	
-	info = req.addrinfo;
-	
-	while (info != NULL) {
-		if (info->ai_family == AF_INET) {
-			uv_ip4_name((struct sockaddr_in *) info->ai_addr, ip, info->ai_addrlen);
-			uv_freeaddrinfo(req.addrinfo);
+	for (i = 0; i < result->count; i++) {
+		if (result->addresses[i].sa.sa_family == AF_INET) {
+			uv_ip4_name(&result->addresses[i].in4, ip, sizeof(ip));
 			
-			RETURN_STRING(ip);
+			RETVAL_STRING(ip);
+			break;
 		}
-		
-		info = info->ai_next;
 	}
 	
-	uv_freeaddrinfo(req.addrinfo);
+	dns_release(result);
 }
 
 static PHP_FUNCTION(asyncgethostbynamel)
@@ -218,13 +598,10 @@ static PHP_FUNCTION(asyncgethostbynamel)
 	char *name;
 	size_t len;
 	
-	zval tmp;
-	zend_string *k;
-	
-	uv_getaddrinfo_t req;
-	struct addrinfo *info;
+	async_dns_result *result;
 	char ip[16];
 	int code;
+	int i;
 
 	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
 		Z_PARAM_STRING(name, len)
@@ -239,41 +616,1867 @@ static PHP_FUNCTION(asyncgethostbynamel)
 		return;
 	}
 	
-	code = dns_gethostbyname(&req, name, 0);
+	code = dns_lookup(name, 0, &result);
 	
 	if (code != 0) {
 		RETURN_FALSE;
 	}
-
-	info = req.addrinfo;
 	
-	array_init(&tmp);
+	array_init(return_value);
 	
-	while (info != NULL) {
-		if (info->ai_family == AF_INET) {
-			uv_ip4_name((struct sockaddr_in *) info->ai_addr, ip, info->ai_addrlen);
+	// Addresses have already been deduplicated by the lookup.
+	for (i = 0; i < result->count; i++) {
+		if (result->addresses[i].sa.sa_family == AF_INET) {
+			uv_ip4_name(&result->addresses[i].in4, ip, sizeof(ip));
 			
-			add_assoc_bool_ex(&tmp, ip, strlen(ip), 1);
+			add_next_index_string(return_value, ip);
 		}
-		
-		info = info->ai_next;
 	}
 	
-	uv_freeaddrinfo(req.addrinfo);
-			
-	array_init(return_value);
+	dns_release(result);
+}
+
+#define ASYNC_RESOLVER_TYPE_A 1
+#define ASYNC_RESOLVER_TYPE_TXT 16
+#define ASYNC_RESOLVER_TYPE_AAAA 28
+#define ASYNC_RESOLVER_TYPE_SRV 33
+
+/* Maximum number of name servers being used by a resolver (same limit as the system resolver). */
+#define ASYNC_RESOLVER_MAX_SERVERS 3
+
+#define ASYNC_RESOLVER_DEFAULT_TIMEOUT 5000
+#define ASYNC_RESOLVER_DEFAULT_ATTEMPTS 2
+
+/* Size of the UDP receive buffer (responses without EDNS are limited to 512 bytes). */
+#define ASYNC_RESOLVER_UDP_SIZE 4096
+
+#define ASYNC_RESOLVER_FLAG_UDP4 1
+#define ASYNC_RESOLVER_FLAG_UDP6 2
+#define ASYNC_RESOLVER_FLAG_TCP 4
+#define ASYNC_RESOLVER_FLAG_DONE 8
+#define ASYNC_RESOLVER_FLAG_SENDING 16
+
+typedef struct {
+	zend_object std;
 	
-	ZEND_HASH_FOREACH_STR_KEY(Z_ARRVAL_P(&tmp), k) {
-		add_next_index_str(return_value, zend_string_copy(k));
-	} ZEND_HASH_FOREACH_END();
+	async_task_scheduler *scheduler;
 	
-	zval_ptr_dtor(&tmp);
-}
+	/* Name servers being queried in order. */
+	struct sockaddr_storage servers[ASYNC_RESOLVER_MAX_SERVERS];
+	int server_count;
+	
+	/* Timeout of a single query (in milliseconds). */
+	uint64_t timeout;
+	
+	/* Number of attempts per name server. */
+	int attempts;
+	
+	/* Addresses from the hosts file indexed by lower-case host name. */
+	HashTable hosts;
+	
+	/* Cached records indexed by record type and lower-case host name. */
+	HashTable cache;
+	
+	/* Pending queries indexed by record type and lower-case host name. */
+	HashTable queries;
+} async_resolver;
 
+typedef struct {
+	/* Records (or NULL if the host does not exist). */
+	zval records;
+	
+	/* Creation and expiration time (in milliseconds, based on uv_hrtime()). */
+	uint64_t created;
+	uint64_t expires;
+} async_resolver_cache_entry;
 
-void async_dns_ce_register()
+typedef struct {
+	async_op base;
+	int code;
+} async_resolver_op;
+
+typedef struct {
+	async_resolver *resolver;
+	
+	/* Record type followed by the lower-case host name. */
+	zend_string *key;
+	uint16_t type;
+	
+	uint8_t flags;
+	
+	/* Number of open handles, the query is freed once all handles have been closed. */
+	uint8_t handles;
+	
+	/* Number of queries that have been sent so far. */
+	int attempt;
+	
+	/* Name server that has been queried most recently. */
+	int server;
+	
+	uv_timer_t timer;
+	uv_udp_t udp4;
+	uv_udp_t udp6;
+	uv_udp_send_t send;
+	char buffer[ASYNC_RESOLVER_UDP_SIZE];
+	
+	uv_tcp_t tcp;
+	uv_connect_t connect;
+	uv_write_t write;
+	char *response;
+	size_t received;
+	
+	/* DNS query message prefixed with its length (being used by TCP). */
+	unsigned char packet[2 + 512];
+	size_t length;
+	
+	/* Tasks awaiting the result of the query. */
+	async_op_queue waiters;
+} async_resolver_query;
+
+static zend_object_handlers async_resolver_handlers;
+
+#define ASYNC_RESOLVER_CONST(name, value) \
+	zend_declare_class_constant_long(async_resolver_ce, name, sizeof(name)-1, (zend_long)value);
+
+static void query_send(async_resolver_query *query);
+
+static zend_string *dns_query_key(const char *name, size_t len, uint16_t type)
 {
-	// TODO: Create a contract for a userdefined DNS resolver that works in non-blocking mode.
+	zend_string *key;
+	
+	// Absolute names are stored without the trailing dot.
+	if (len > 1 && name[len - 1] == '.') {
+		len--;
+	}
+	
+	key = zend_string_alloc(len + 2, 0);
+	
+	ZSTR_VAL(key)[0] = (char) (type >> 8);
+	ZSTR_VAL(key)[1] = (char) (type & 0xFF);
+	
+	zend_str_tolower_copy(ZSTR_VAL(key) + 2, name, len);
+	
+	return key;
+}
+
+static int dns_encode_query(unsigned char *buf, size_t *length, uint16_t id, const char *name, size_t len, uint16_t type)
+{
+	unsigned char *p;
+	const char *label;
+	const char *end;
+	const char *dot;
+	
+	if (len == 0 || len > 253) {
+		return UV_EINVAL;
+	}
+	
+	p = buf;
+	
+	// Header with recursion desired and a single question.
+	p[0] = (unsigned char) (id >> 8);
+	p[1] = (unsigned char) (id & 0xFF);
+	p[2] = 0x01;
+	p[3] = 0x00;
+	p[4] = 0x00;
+	p[5] = 0x01;
+	
+	memset(p + 6, 0, 6);
+	
+	p += 12;
+	end = name + len;
+	
+	for (label = name; label < end; label = dot + 1) {
+		dot = memchr(label, '.', end - label);
+		
+		if (dot == NULL) {
+			dot = end;
+		}
+		
+		if (dot == label || (dot - label) > 63) {
+			return UV_EINVAL;
+		}
+		
+		*p++ = (unsigned char) (dot - label);
+		
+		memcpy(p, label, dot - label);
+		
+		p += dot - label;
+	}
+	
+	*p++ = 0x00;
+	*p++ = (unsigned char) (type >> 8);
+	*p++ = (unsigned char) (type & 0xFF);
+	*p++ = 0x00;
+	*p++ = 0x01;
+	
+	*length = p - buf;
+	
+	return 0;
+}
+
+static int dns_read_name(const unsigned char *msg, size_t len, size_t *pos, char *name, size_t size)
+{
+	size_t p;
+	size_t n;
+	int jumps;
+	unsigned char c;
+	
+	p = *pos;
+	n = 0;
+	jumps = 0;
+	
+	while (1) {
+		if (p >= len) {
+			return FAILURE;
+		}
+		
+		c = msg[p];
+		
+		if (c == 0) {
+			p++;
+			break;
+		}
+		
+		// Compressed names continue at the given offset, the number of jumps is limited to prevent loops.
+		if ((c & 0xC0) == 0xC0) {
+			if (p + 1 >= len || ++jumps > 32) {
+				return FAILURE;
+			}
+			
+			if (jumps == 1) {
+				*pos = p + 2;
+			}
+			
+			p = ((c & 0x3F) << 8) | msg[p + 1];
+			
+			continue;
+		}
+		
+		if ((c & 0xC0) != 0 || p + 1 + c > len || n + c + 2 > size) {
+			return FAILURE;
+		}
+		
+		if (n > 0) {
+			name[n++] = '.';
+		}
+		
+		memcpy(name + n, msg + p + 1, c);
+		
+		n += c;
+		p += 1 + c;
+	}
+	
+	if (jumps == 0) {
+		*pos = p;
+	}
+	
+	name[n] = '\0';
+	
+	return SUCCESS;
+}
+
+static zend_always_inline uint16_t dns_read_uint16(const unsigned char *p)
+{
+	return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static zend_always_inline uint32_t dns_read_uint32(const unsigned char *p)
+{
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static int dns_parse_records(async_resolver_query *query, const unsigned char *msg, size_t len, size_t pos, zval *records, uint32_t *ttl)
+{
+	zval record;
+	zend_string *text;
+	
+	char name[256];
+	char ip[64];
+	uint16_t count;
+	uint16_t type;
+	uint16_t size;
+	uint32_t t;
+	size_t end;
+	size_t p;
+	
+	count = dns_read_uint16(msg + 6);
+	
+	array_init(records);
+	
+	*ttl = UINT32_MAX;
+	
+	for (; count > 0; count--) {
+		if (dns_read_name(msg, len, &pos, name, sizeof(name)) == FAILURE || pos + 10 > len) {
+			return UV_EPROTO;
+		}
+		
+		type = dns_read_uint16(msg + pos);
+		t = dns_read_uint32(msg + pos + 4);
+		size = dns_read_uint16(msg + pos + 8);
+		
+		pos += 10;
+		end = pos + size;
+		
+		if (end > len) {
+			return UV_EPROTO;
+		}
+		
+		// Other records (like CNAME records of an alias chain) are skipped.
+		if (type != query->type) {
+			pos = end;
+			continue;
+		}
+		
+		array_init(&record);
+		
+		switch (type) {
+		case ASYNC_RESOLVER_TYPE_A:
+		case ASYNC_RESOLVER_TYPE_AAAA:
+			if (size != ((type == ASYNC_RESOLVER_TYPE_A) ? 4 : 16)) {
+				zval_ptr_dtor(&record);
+				
+				return UV_EPROTO;
+			}
+			
+			uv_inet_ntop((type == ASYNC_RESOLVER_TYPE_A) ? AF_INET : AF_INET6, msg + pos, ip, sizeof(ip));
+			
+			add_assoc_string(&record, "address", ip);
+			break;
+		case ASYNC_RESOLVER_TYPE_SRV:
+			p = pos + 6;
+			
+			if (size < 7 || dns_read_name(msg, len, &p, name, sizeof(name)) == FAILURE) {
+				zval_ptr_dtor(&record);
+				
+				return UV_EPROTO;
+			}
+			
+			add_assoc_string(&record, "target", name);
+			add_assoc_long(&record, "port", dns_read_uint16(msg + pos + 4));
+			add_assoc_long(&record, "priority", dns_read_uint16(msg + pos));
+			add_assoc_long(&record, "weight", dns_read_uint16(msg + pos + 2));
+			break;
+		case ASYNC_RESOLVER_TYPE_TXT:
+			text = zend_string_alloc(size, 0);
+			
+			ZSTR_LEN(text) = 0;
+			
+			// TXT data consists of length-prefixed character strings that are concatenated.
+			for (p = pos; p < end && p + 1 + msg[p] <= end; p += 1 + msg[p]) {
+				memcpy(ZSTR_VAL(text) + ZSTR_LEN(text), msg + p + 1, msg[p]);
+				
+				ZSTR_LEN(text) += msg[p];
+			}
+			
+			ZSTR_VAL(text)[ZSTR_LEN(text)] = '\0';
+			
+			add_assoc_str(&record, "text", text);
+			break;
+		}
+		
+		add_assoc_long(&record, "ttl", t);
+		
+		zend_hash_next_index_insert(Z_ARRVAL_P(records), &record);
+		
+		*ttl = MIN(*ttl, t);
+		pos = end;
+	}
+	
+	if (*ttl == UINT32_MAX) {
+		*ttl = 0;
+	}
+	
+	return 0;
+}
+
+static void resolver_cache_entry_dtor(zval *data)
+{
+	async_resolver_cache_entry *entry;
+	
+	entry = (async_resolver_cache_entry *) Z_PTR_P(data);
+	
+	zval_ptr_dtor(&entry->records);
+	efree(entry);
+}
+
+static void resolver_cache_store(async_resolver *resolver, zend_string *key, zval *records, uint32_t ttl)
+{
+	async_resolver_cache_entry *entry;
+	zend_string *k;
+	
+	if (ttl == 0 || ASYNC_G(dns_cache_size) <= 0) {
+		return;
+	}
+	
+	// Entries are evicted in insertion order, expired entries are removed when they are accessed.
+	while (zend_hash_num_elements(&resolver->cache) >= (uint32_t) ASYNC_G(dns_cache_size)) {
+		ZEND_HASH_FOREACH_STR_KEY(&resolver->cache, k) {
+			break;
+		} ZEND_HASH_FOREACH_END();
+		
+		zend_hash_del(&resolver->cache, k);
+	}
+	
+	entry = emalloc(sizeof(async_resolver_cache_entry));
+	entry->created = uv_hrtime() / 1000000;
+	entry->expires = entry->created + (uint64_t) ttl * 1000;
+	
+	if (records == NULL) {
+		ZVAL_NULL(&entry->records);
+	} else {
+		ZVAL_COPY(&entry->records, records);
+	}
+	
+	zend_hash_update_ptr(&resolver->cache, key, entry);
+}
+
+static void query_closed(uv_handle_t *handle)
+{
+	async_resolver_query *query;
+	
+	query = (async_resolver_query *) handle->data;
+	
+	ZEND_ASSERT(query != NULL);
+	
+	if (--query->handles > 0) {
+		return;
+	}
+	
+	if (query->response != NULL) {
+		efree(query->response);
+	}
+	
+	zend_string_release(query->key);
+	
+	ASYNC_DELREF(&query->resolver->std);
+	
+	efree(query);
+}
+
+static void query_finish(async_resolver_query *query, int code, zval *records, uint32_t ttl)
+{
+	async_resolver_op *op;
+	
+	if (query->flags & ASYNC_RESOLVER_FLAG_DONE) {
+		return;
+	}
+	
+	query->flags |= ASYNC_RESOLVER_FLAG_DONE;
+	
+	zend_hash_del(&query->resolver->queries, query->key);
+	
+	if (code == 0) {
+		resolver_cache_store(query->resolver, query->key, records, ttl);
+	} else if (code == UV_EAI_NONAME) {
+		resolver_cache_store(query->resolver, query->key, NULL, (uint32_t) MAX(0, ASYNC_G(dns_cache_negative_ttl)));
+	}
+	
+	while (query->waiters.first != NULL) {
+		ASYNC_DEQUEUE_CUSTOM_OP(&query->waiters, op, async_resolver_op);
+		
+		// Cancelled tasks that have not been resumed yet are only detached from the query.
+		if (op->base.flags & ASYNC_OP_FLAG_CANCELLED) {
+			continue;
+		}
+		
+		op->code = code;
+		
+		if (code == 0) {
+			ZVAL_COPY(&op->base.result, records);
+		}
+		
+		ASYNC_FINISH_OP(op);
+	}
+	
+	uv_close((uv_handle_t *) &query->timer, query_closed);
+	
+	if (query->flags & ASYNC_RESOLVER_FLAG_UDP4) {
+		uv_close((uv_handle_t *) &query->udp4, query_closed);
+	}
+	
+	if (query->flags & ASYNC_RESOLVER_FLAG_UDP6) {
+		uv_close((uv_handle_t *) &query->udp6, query_closed);
+	}
+	
+	if (query->flags & ASYNC_RESOLVER_FLAG_TCP) {
+		uv_close((uv_handle_t *) &query->tcp, query_closed);
+	}
+}
+
+static void query_tcp(async_resolver_query *query);
+
+static void query_response(async_resolver_query *query, const unsigned char *msg, size_t len)
+{
+	zval records;
+	
+	char name[256];
+	uint16_t flags;
+	uint32_t ttl;
+	size_t pos;
+	int code;
+	
+	if (len < 12 || dns_read_uint16(msg) != dns_read_uint16(query->packet + 2)) {
+		return;
+	}
+	
+	flags = dns_read_uint16(msg + 2);
+	
+	// Ignore anything that is not a response to the query.
+	if (!(flags & 0x8000) || dns_read_uint16(msg + 4) != 1) {
+		return;
+	}
+	
+	pos = 12;
+	
+	if (dns_read_name(msg, len, &pos, name, sizeof(name)) == FAILURE || pos + 4 > len) {
+		return;
+	}
+	
+	if (dns_read_uint16(msg + pos) != query->type || 0 != zend_binary_strcasecmp(name, strlen(name), ZSTR_VAL(query->key) + 2, ZSTR_LEN(query->key) - 2)) {
+		return;
+	}
+	
+	pos += 4;
+	
+	// Truncated responses are retried using TCP.
+	if ((flags & 0x0200) && !(query->flags & ASYNC_RESOLVER_FLAG_TCP)) {
+		query_tcp(query);
+		
+		return;
+	}
+	
+	switch (flags & 0x000F) {
+	case 0:
+		break;
+	case 3:
+		query_finish(query, UV_EAI_NONAME, NULL, 0);
+		return;
+	case 2:
+	case 5:
+		// Server failures are retried using the next name server.
+		if (!(query->flags & ASYNC_RESOLVER_FLAG_TCP) && query->attempt < query->resolver->server_count * query->resolver->attempts) {
+			query_send(query);
+		} else {
+			query_finish(query, UV_EAI_AGAIN, NULL, 0);
+		}
+		return;
+	default:
+		query_finish(query, UV_EAI_FAIL, NULL, 0);
+		return;
+	}
+	
+	code = dns_parse_records(query, msg, len, pos, &records, &ttl);
+	
+	if (code == 0) {
+		// Empty responses are cached using the negative TTL.
+		if (zend_hash_num_elements(Z_ARRVAL_P(&records)) == 0) {
+			ttl = (uint32_t) MAX(0, ASYNC_G(dns_cache_negative_ttl));
+		}
+		
+		query_finish(query, 0, &records, ttl);
+	} else {
+		query_finish(query, code, NULL, 0);
+	}
+	
+	zval_ptr_dtor(&records);
+}
+
+static void query_timeout(uv_timer_t *timer)
+{
+	async_resolver_query *query;
+	
+	query = (async_resolver_query *) timer->data;
+	
+	ZEND_ASSERT(query != NULL);
+	
+	if (!(query->flags & ASYNC_RESOLVER_FLAG_TCP) && query->attempt < query->resolver->server_count * query->resolver->attempts) {
+		query_send(query);
+	} else {
+		query_finish(query, UV_ETIMEDOUT, NULL, 0);
+	}
+}
+
+static int resolver_is_server(async_resolver *resolver, const struct sockaddr *addr)
+{
+	struct sockaddr_in *in4;
+	struct sockaddr_in6 *in6;
+	
+	int i;
+	
+	for (i = 0; i < resolver->server_count; i++) {
+		if (resolver->servers[i].ss_family != addr->sa_family) {
+			continue;
+		}
+		
+		if (addr->sa_family == AF_INET) {
+			in4 = (struct sockaddr_in *) &resolver->servers[i];
+			
+			if (in4->sin_port == ((const struct sockaddr_in *) addr)->sin_port && 0 == memcmp(&in4->sin_addr, &((const struct sockaddr_in *) addr)->sin_addr, sizeof(struct in_addr))) {
+				return 1;
+			}
+		} else {
+			in6 = (struct sockaddr_in6 *) &resolver->servers[i];
+			
+			if (in6->sin6_port == ((const struct sockaddr_in6 *) addr)->sin6_port && 0 == memcmp(&in6->sin6_addr, &((const struct sockaddr_in6 *) addr)->sin6_addr, sizeof(struct in6_addr))) {
+				return 1;
+			}
+		}
+	}
+	
+	return 0;
+}
+
+static void query_alloc_buffer(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buffer)
+{
+	async_resolver_query *query;
+	
+	query = (async_resolver_query *) handle->data;
+	
+	ZEND_ASSERT(query != NULL);
+	
+	buffer->base = query->buffer;
+	buffer->len = sizeof(query->buffer);
+}
+
+static void query_received(uv_udp_t *udp, ssize_t nread, const uv_buf_t *buffer, const struct sockaddr *addr, unsigned int flags)
+{
+	async_resolver_query *query;
+	
+	query = (async_resolver_query *) udp->data;
+	
+	ZEND_ASSERT(query != NULL);
+	
+	if (nread <= 0 || addr == NULL || (flags & UV_UDP_PARTIAL) || (query->flags & ASYNC_RESOLVER_FLAG_TCP)) {
+		return;
+	}
+	
+	if (!resolver_is_server(query->resolver, addr)) {
+		return;
+	}
+	
+	query_response(query, (const unsigned char *) buffer->base, (size_t) nread);
+}
+
+static void query_sent(uv_udp_send_t *req, int status)
+{
+	async_resolver_query *query;
+	
+	query = (async_resolver_query *) req->data;
+	
+	ZEND_ASSERT(query != NULL);
+	
+	// Failed sends are handled by the timeout that will query the next name server.
+	query->flags &= ~ASYNC_RESOLVER_FLAG_SENDING;
+}
+
+static void query_send(async_resolver_query *query)
+{
+	async_resolver *resolver;
+	uv_udp_t *udp;
+	
+	uv_buf_t buffers[1];
+	int code;
+	
+	resolver = query->resolver;
+	
+	query->server = query->attempt % resolver->server_count;
+	query->attempt++;
+	
+	if (resolver->servers[query->server].ss_family == AF_INET6) {
+		udp = &query->udp6;
+		
+		if (!(query->flags & ASYNC_RESOLVER_FLAG_UDP6)) {
+			uv_udp_init(&resolver->scheduler->loop, udp);
+			
+			udp->data = query;
+			
+			query->flags |= ASYNC_RESOLVER_FLAG_UDP6;
+			query->handles++;
+		}
+	} else {
+		udp = &query->udp4;
+		
+		if (!(query->flags & ASYNC_RESOLVER_FLAG_UDP4)) {
+			uv_udp_init(&resolver->scheduler->loop, udp);
+			
+			udp->data = query;
+			
+			query->flags |= ASYNC_RESOLVER_FLAG_UDP4;
+			query->handles++;
+		}
+	}
+	
+	uv_timer_start(&query->timer, query_timeout, resolver->timeout, 0);
+	
+	// The send request can only be reused after the previous send has completed.
+	if (query->flags & ASYNC_RESOLVER_FLAG_SENDING) {
+		return;
+	}
+	
+	buffers[0] = uv_buf_init((char *) query->packet + 2, (unsigned int) query->length);
+	
+	code = uv_udp_send(&query->send, udp, buffers, 1, (const struct sockaddr *) &resolver->servers[query->server], query_sent);
+	
+	if (code == 0) {
+		query->flags |= ASYNC_RESOLVER_FLAG_SENDING;
+		
+		// Receiving is started after the first send has bound the socket to an address of the correct family.
+		uv_udp_recv_start(udp, query_alloc_buffer, query_received);
+	}
+}
+
+static void query_tcp_alloc_buffer(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buffer)
+{
+	async_resolver_query *query;
+	
+	query = (async_resolver_query *) handle->data;
+	
+	ZEND_ASSERT(query != NULL);
+	
+	if (query->response == NULL) {
+		query->response = emalloc(2 + 65535);
+	}
+	
+	buffer->base = query->response + query->received;
+	buffer->len = (2 + 65535) - query->received;
+}
+
+static void query_tcp_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buffer)
+{
+	async_resolver_query *query;
+	
+	size_t len;
+	
+	query = (async_resolver_query *) stream->data;
+	
+	ZEND_ASSERT(query != NULL);
+	
+	if (nread == 0) {
+		return;
+	}
+	
+	if (nread < 0) {
+		query_finish(query, (nread == UV_EOF) ? UV_EAI_FAIL : (int) nread, NULL, 0);
+		
+		return;
+	}
+	
+	query->received += (size_t) nread;
+	
+	if (query->received < 2) {
+		return;
+	}
+	
+	len = dns_read_uint16((const unsigned char *) query->response);
+	
+	if (query->received >= len + 2) {
+		query_response(query, (const unsigned char *) query->response + 2, len);
+		
+		// A response that does not match the query will not be followed by another response.
+		query_finish(query, UV_EAI_FAIL, NULL, 0);
+	}
+}
+
+static void query_tcp_written(uv_write_t *req, int status)
+{
+	async_resolver_query *query;
+	
+	query = (async_resolver_query *) req->data;
+	
+	ZEND_ASSERT(query != NULL);
+	
+	if (status < 0) {
+		query_finish(query, status, NULL, 0);
+	}
+}
+
+static void query_tcp_connected(uv_connect_t *req, int status)
+{
+	async_resolver_query *query;
+	
+	uv_buf_t buffers[1];
+	int code;
+	
+	query = (async_resolver_query *) req->data;
+	
+	ZEND_ASSERT(query != NULL);
+	
+	if (query->flags & ASYNC_RESOLVER_FLAG_DONE) {
+		return;
+	}
+	
+	if (status < 0) {
+		query_finish(query, status, NULL, 0);
+		
+		return;
+	}
+	
+	buffers[0] = uv_buf_init((char *) query->packet, (unsigned int) query->length + 2);
+	
+	code = uv_write(&query->write, (uv_stream_t *) &query->tcp, buffers, 1, query_tcp_written);
+	
+	if (code == 0) {
+		code = uv_read_start((uv_stream_t *) &query->tcp, query_tcp_alloc_buffer, query_tcp_read);
+	}
+	
+	if (code < 0) {
+		query_finish(query, code, NULL, 0);
+	}
+}
+
+static void query_tcp(async_resolver_query *query)
+{
+	async_resolver *resolver;
+	
+	int code;
+	
+	resolver = query->resolver;
+	
+	uv_tcp_init(&resolver->scheduler->loop, &query->tcp);
+	
+	query->tcp.data = query;
+	query->connect.data = query;
+	query->write.data = query;
+	
+	query->flags |= ASYNC_RESOLVER_FLAG_TCP;
+	query->handles++;
+	
+	uv_timer_start(&query->timer, query_timeout, resolver->timeout, 0);
+	
+	code = uv_tcp_connect(&query->connect, &query->tcp, (const struct sockaddr *) &resolver->servers[query->server], query_tcp_connected);
+	
+	if (code < 0) {
+		query_finish(query, code, NULL, 0);
+	}
+}
+
+static async_resolver_query *resolver_query(async_resolver *resolver, zend_string *key, uint16_t type, int *code)
+{
+	async_resolver_query *query;
+	
+	uint16_t id;
+	
+	// Concurrent queries for the same records are coalesced into a single query.
+	query = (async_resolver_query *) zend_hash_find_ptr(&resolver->queries, key);
+	
+	if (query != NULL) {
+		return query;
+	}
+	
+	query = emalloc(sizeof(async_resolver_query));
+	ZEND_SECURE_ZERO(query, sizeof(async_resolver_query));
+	
+	if (FAILURE == php_random_bytes_silent(&id, sizeof(id))) {
+		id = (uint16_t) php_mt_rand();
+	}
+	
+	*code = dns_encode_query(query->packet + 2, &query->length, id, ZSTR_VAL(key) + 2, ZSTR_LEN(key) - 2, type);
+	
+	if (*code < 0) {
+		efree(query);
+		
+		return NULL;
+	}
+	
+	query->packet[0] = (unsigned char) (query->length >> 8);
+	query->packet[1] = (unsigned char) (query->length & 0xFF);
+	
+	query->resolver = resolver;
+	query->key = zend_string_copy(key);
+	query->type = type;
+	
+	uv_timer_init(&resolver->scheduler->loop, &query->timer);
+	
+	query->timer.data = query;
+	query->send.data = query;
+	query->handles = 1;
+	
+	ASYNC_ADDREF(&resolver->std);
+	
+	zend_hash_add_ptr(&resolver->queries, query->key, query);
+	
+	query_send(query);
+	
+	return query;
+}
+
+static void resolver_cancel_query(async_resolver_query *query)
+{
+	// Queries are only cancelled when no other task is waiting for the result.
+	if (query->waiters.first == NULL) {
+		query_finish(query, UV_ECANCELED, NULL, 0);
+	}
+}
+
+static int resolver_add_server(async_resolver *resolver, const char *address)
+{
+	struct sockaddr_storage *dest;
+	
+	char host[64];
+	const char *end;
+	size_t len;
+	int port;
+	
+	port = 53;
+	
+	// Name servers are given as IP address with an optional port ("1.2.3.4:53" or "[::1]:53").
+	if (address[0] == '[') {
+		address++;
+		end = strchr(address, ']');
+		
+		if (end == NULL || (end[1] != '\0' && end[1] != ':')) {
+			return UV_EINVAL;
+		}
+		
+		if (end[1] == ':') {
+			port = atoi(end + 2);
+		}
+	} else {
+		end = strchr(address, ':');
+		
+		if (end != NULL && strchr(end + 1, ':') == NULL) {
+			port = atoi(end + 1);
+		} else {
+			end = address + strlen(address);
+		}
+	}
+	
+	len = end - address;
+	
+	if (len == 0 || len >= sizeof(host) || port < 1 || port > 65535 || resolver->server_count >= ASYNC_RESOLVER_MAX_SERVERS) {
+		return UV_EINVAL;
+	}
+	
+	memcpy(host, address, len);
+	host[len] = '\0';
+	
+	dest = &resolver->servers[resolver->server_count];
+	
+	ZEND_SECURE_ZERO(dest, sizeof(struct sockaddr_storage));
+	
+	if (0 != uv_ip4_addr(host, port, (struct sockaddr_in *) dest) && 0 != uv_ip6_addr(host, port, (struct sockaddr_in6 *) dest)) {
+		return UV_EINVAL;
+	}
+	
+	resolver->server_count++;
+	
+	return 0;
+}
+
+static void resolver_load_config(async_resolver *resolver, const char *path)
+{
+	FILE *fp;
+	
+	char line[512];
+	char *token;
+	char *last;
+	
+	fp = VCWD_FOPEN(path, "r");
+	
+	if (fp == NULL) {
+		return;
+	}
+	
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		token = php_strtok_r(line, " \t\r\n", &last);
+		
+		if (token == NULL || token[0] == '#' || token[0] == ';') {
+			continue;
+		}
+		
+		if (0 == strcmp(token, "nameserver")) {
+			if (NULL != (token = php_strtok_r(NULL, " \t\r\n", &last))) {
+				resolver_add_server(resolver, token);
+			}
+		} else if (0 == strcmp(token, "options")) {
+			while (NULL != (token = php_strtok_r(NULL, " \t\r\n", &last))) {
+				if (0 == strncmp(token, "timeout:", sizeof("timeout:") - 1)) {
+					resolver->timeout = MAX(1, atoi(token + sizeof("timeout:") - 1)) * 1000;
+				} else if (0 == strncmp(token, "attempts:", sizeof("attempts:") - 1)) {
+					resolver->attempts = MAX(1, atoi(token + sizeof("attempts:") - 1));
+				}
+			}
+		}
+	}
+	
+	fclose(fp);
+}
+
+static void resolver_load_hosts(async_resolver *resolver, const char *path)
+{
+	FILE *fp;
+	
+	zval tmp;
+	zval *entry;
+	
+	char line[1024];
+	char addr[16];
+	char *ip;
+	char *token;
+	char *last;
+	size_t len;
+	
+	fp = VCWD_FOPEN(path, "r");
+	
+	if (fp == NULL) {
+		return;
+	}
+	
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (NULL != (token = strchr(line, '#'))) {
+			*token = '\0';
+		}
+		
+		ip = php_strtok_r(line, " \t\r\n", &last);
+		
+		if (ip == NULL || (0 != uv_inet_pton(AF_INET, ip, addr) && 0 != uv_inet_pton(AF_INET6, ip, addr))) {
+			continue;
+		}
+		
+		while (NULL != (token = php_strtok_r(NULL, " \t\r\n", &last))) {
+			len = strlen(token);
+			
+			zend_str_tolower(token, len);
+			
+			if (NULL == (entry = zend_hash_str_find(&resolver->hosts, token, len))) {
+				array_init(&tmp);
+				
+				entry = zend_hash_str_add(&resolver->hosts, token, len, &tmp);
+			}
+			
+			add_next_index_string(entry, ip);
+		}
+	}
+	
+	fclose(fp);
+}
+
+static int resolver_lookup_local(async_resolver *resolver, zend_string *key, uint16_t type, zval *records)
+{
+	async_resolver_cache_entry *entry;
+	
+	zval record;
+	zval *cached;
+	zval *hosts;
+	zval *ttl;
+	zval *ip;
+	
+	char *name;
+	char addr[16];
+	int family;
+	uint64_t now;
+	zend_long elapsed;
+	
+	name = ZSTR_VAL(key) + 2;
+	
+	if (type == ASYNC_RESOLVER_TYPE_A || type == ASYNC_RESOLVER_TYPE_AAAA) {
+		family = (type == ASYNC_RESOLVER_TYPE_A) ? AF_INET : AF_INET6;
+		
+		// IP addresses are returned as-is.
+		if (0 == uv_inet_pton(family, name, addr)) {
+			array_init(records);
+			array_init(&record);
+			
+			add_assoc_str(&record, "address", zend_string_init(name, ZSTR_LEN(key) - 2, 0));
+			add_assoc_long(&record, "ttl", 0);
+			
+			zend_hash_next_index_insert(Z_ARRVAL_P(records), &record);
+			
+			return 1;
+		}
+		
+		hosts = zend_hash_str_find(&resolver->hosts, name, ZSTR_LEN(key) - 2);
+		
+		if (hosts != NULL) {
+			array_init(records);
+			
+			ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(hosts), ip) {
+				if ((strchr(Z_STRVAL_P(ip), ':') == NULL) != (family == AF_INET)) {
+					continue;
+				}
+				
+				array_init(&record);
+				
+				add_assoc_str(&record, "address", zend_string_copy(Z_STR_P(ip)));
+				add_assoc_long(&record, "ttl", 0);
+				
+				zend_hash_next_index_insert(Z_ARRVAL_P(records), &record);
+			} ZEND_HASH_FOREACH_END();
+			
+			if (zend_hash_num_elements(Z_ARRVAL_P(records)) > 0) {
+				return 1;
+			}
+			
+			zval_ptr_dtor(records);
+		}
+	}
+	
+	entry = (async_resolver_cache_entry *) zend_hash_find_ptr(&resolver->cache, key);
+	
+	if (entry == NULL) {
+		return 0;
+	}
+	
+	now = uv_hrtime() / 1000000;
+	
+	if (entry->expires <= now) {
+		zend_hash_del(&resolver->cache, key);
+		
+		return 0;
+	}
+	
+	if (Z_TYPE_P(&entry->records) == IS_NULL) {
+		return UV_EAI_NONAME;
+	}
+	
+	elapsed = (zend_long) ((now - entry->created) / 1000);
+	
+	if (elapsed == 0) {
+		ZVAL_COPY(records, &entry->records);
+		
+		return 1;
+	}
+	
+	array_init_size(records, zend_hash_num_elements(Z_ARRVAL_P(&entry->records)));
+	
+	// Cached records report the remaining TTL.
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(&entry->records), cached) {
+		ZVAL_ARR(&record, zend_array_dup(Z_ARRVAL_P(cached)));
+		
+		ttl = zend_hash_str_find(Z_ARRVAL(record), ZEND_STRL("ttl"));
+		
+		if (ttl != NULL && Z_TYPE_P(ttl) == IS_LONG) {
+			ZVAL_LONG(ttl, MAX(0, Z_LVAL_P(ttl) - elapsed));
+		}
+		
+		zend_hash_next_index_insert(Z_ARRVAL_P(records), &record);
+	} ZEND_HASH_FOREACH_END();
+	
+	return 1;
+}
+
+static zend_object *async_resolver_object_create(zend_class_entry *ce)
+{
+	async_resolver *resolver;
+	
+	resolver = emalloc(sizeof(async_resolver));
+	ZEND_SECURE_ZERO(resolver, sizeof(async_resolver));
+	
+	zend_object_std_init(&resolver->std, ce);
+	resolver->std.handlers = &async_resolver_handlers;
+	
+	resolver->scheduler = async_task_scheduler_get();
+	
+	ASYNC_ADDREF(&resolver->scheduler->std);
+	
+	resolver->timeout = ASYNC_RESOLVER_DEFAULT_TIMEOUT;
+	resolver->attempts = ASYNC_RESOLVER_DEFAULT_ATTEMPTS;
+	
+	resolver_add_server(resolver, "127.0.0.1");
+	
+	zend_hash_init(&resolver->hosts, 0, NULL, ZVAL_PTR_DTOR, 0);
+	zend_hash_init(&resolver->cache, 0, NULL, resolver_cache_entry_dtor, 0);
+	zend_hash_init(&resolver->queries, 0, NULL, NULL, 0);
+	
+	return &resolver->std;
+}
+
+static void async_resolver_object_destroy(zend_object *object)
+{
+	async_resolver *resolver;
+	
+	resolver = (async_resolver *) object;
+	
+	zend_hash_destroy(&resolver->hosts);
+	zend_hash_destroy(&resolver->cache);
+	zend_hash_destroy(&resolver->queries);
+	
+	ASYNC_DELREF(&resolver->scheduler->std);
+	
+	zend_object_std_dtor(&resolver->std);
+}
+
+ZEND_METHOD(Resolver, __construct)
+{
+	async_resolver *resolver;
+	
+	zval *servers;
+	zval *entry;
+	zend_string *hosts;
+	
+#ifdef PHP_WIN32
+	char path[MAXPATHLEN];
+	char *root;
+#endif
+	
+	servers = NULL;
+	hosts = NULL;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 2)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ARRAY_EX(servers, 1, 0)
+		Z_PARAM_STR_EX(hosts, 1, 0)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	resolver = (async_resolver *) Z_OBJ_P(getThis());
+	resolver->server_count = 0;
+	
+	if (servers == NULL) {
+#ifdef PHP_WIN32
+		// The name servers of the network adapters cannot be read from a config file on Windows.
+		zend_throw_error(NULL, "Name servers must be passed to the resolver on Windows");
+		return;
+#else
+		resolver_load_config(resolver, "/etc/resolv.conf");
+#endif
+	} else {
+		ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(servers), entry) {
+			ASYNC_CHECK_ERROR(Z_TYPE_P(entry) != IS_STRING, "Name servers must be given as strings");
+			ASYNC_CHECK_ERROR(resolver->server_count >= ASYNC_RESOLVER_MAX_SERVERS, "At most %d name servers are supported", ASYNC_RESOLVER_MAX_SERVERS);
+			ASYNC_CHECK_ERROR(0 != resolver_add_server(resolver, Z_STRVAL_P(entry)), "Invalid name server address: %s", Z_STRVAL_P(entry));
+		} ZEND_HASH_FOREACH_END();
+	}
+	
+	// Use a name server on the local host if none is configured (same as the system resolver).
+	if (resolver->server_count == 0) {
+		resolver_add_server(resolver, "127.0.0.1");
+	}
+	
+	if (hosts != NULL) {
+		if (ZSTR_LEN(hosts) > 0) {
+			resolver_load_hosts(resolver, ZSTR_VAL(hosts));
+		}
+	} else {
+#ifdef PHP_WIN32
+		root = getenv("SystemRoot");
+		
+		snprintf(path, sizeof(path), "%s\\System32\\drivers\\etc\\hosts", (root == NULL) ? "C:\\Windows" : root);
+		
+		resolver_load_hosts(resolver, path);
+#else
+		resolver_load_hosts(resolver, "/etc/hosts");
+#endif
+	}
+}
+
+ZEND_METHOD(Resolver, resolve)
+{
+	async_resolver *resolver;
+	async_resolver_query *query;
+	async_resolver_op *op;
+	
+	zend_string *name;
+	zend_string *key;
+	zend_long type;
+	
+	int code;
+	
+	type = ASYNC_RESOLVER_TYPE_A;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 2)
+		Z_PARAM_STR(name)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_LONG(type)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	ASYNC_CHECK_ERROR(type != ASYNC_RESOLVER_TYPE_A && type != ASYNC_RESOLVER_TYPE_AAAA && type != ASYNC_RESOLVER_TYPE_SRV && type != ASYNC_RESOLVER_TYPE_TXT, "Unsupported DNS record type: %d", (int) type);
+	
+	resolver = (async_resolver *) Z_OBJ_P(getThis());
+	key = dns_query_key(ZSTR_VAL(name), ZSTR_LEN(name), (uint16_t) type);
+	
+	code = resolver_lookup_local(resolver, key, (uint16_t) type, return_value);
+	
+	if (code != 0) {
+		zend_string_release(key);
+		
+		ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "DNS query for %s failed: %s", ZSTR_VAL(name), uv_strerror(code));
+		
+		return;
+	}
+	
+	query = resolver_query(resolver, key, (uint16_t) type, &code);
+	
+	zend_string_release(key);
+	
+	ASYNC_CHECK_EXCEPTION(query == NULL, async_socket_exception_ce, "DNS query for %s failed: %s", ZSTR_VAL(name), uv_strerror(code));
+	
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_resolver_op));
+	ASYNC_ENQUEUE_OP(&query->waiters, op);
+	
+	if (async_await_op((async_op *) op) == FAILURE) {
+		ASYNC_FORWARD_OP_ERROR(op);
+		
+		// The query has not completed yet if the op is still queued.
+		if (op->base.q != NULL) {
+			ASYNC_FREE_OP(op);
+			
+			resolver_cancel_query(query);
+		} else {
+			ASYNC_FREE_OP(op);
+		}
+		
+		return;
+	}
+	
+	if (op->code < 0) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "DNS query for %s failed: %s", ZSTR_VAL(name), uv_strerror(op->code));
+	} else {
+		ZVAL_COPY(return_value, &op->base.result);
+	}
+	
+	ASYNC_FREE_OP(op);
+}
+
+typedef struct _async_resolver_batch_entry async_resolver_batch_entry;
+
+typedef struct {
+	async_op base;
+	
+	/* Deadline of the batch (only initialized if a timeout is given). */
+	uv_timer_t timer;
+	
+	/* Results indexed by host name. */
+	zval results;
+	
+	/* Number of queries that have not completed yet. */
+	uint32_t pending;
+	
+	/* Queries being awaited by the batch. */
+	async_resolver_batch_entry **entries;
+	uint32_t count;
+} async_resolver_batch;
+
+struct _async_resolver_batch_entry {
+	async_resolver_op op;
+	async_resolver_batch *batch;
+	async_resolver_query *query;
+	zend_string *name;
+};
+
+static void resolver_batch_store(async_resolver_batch *batch, zend_string *name, int code, zval *records)
+{
+	zval error;
+	
+	if (code < 0) {
+		ASYNC_PREPARE_EXCEPTION(&error, async_socket_exception_ce, "DNS query for %s failed: %s", ZSTR_VAL(name), uv_strerror(code));
+		
+		zend_symtable_update(Z_ARRVAL_P(&batch->results), name, &error);
+	} else {
+		Z_TRY_ADDREF_P(records);
+		
+		zend_symtable_update(Z_ARRVAL_P(&batch->results), name, records);
+	}
+}
+
+static void resolver_batch_continue(async_op *op)
+{
+	async_resolver_batch_entry *entry;
+	async_resolver_batch *batch;
+	
+	entry = (async_resolver_batch_entry *) op;
+	batch = entry->batch;
+	
+	resolver_batch_store(batch, entry->name, entry->op.code, &op->result);
+	
+	if (--batch->pending == 0 && batch->base.status == ASYNC_STATUS_RUNNING) {
+		ASYNC_FINISH_OP(batch);
+	}
+}
+
+static void resolver_batch_timeout(uv_timer_t *timer)
+{
+	async_resolver_batch *batch;
+	
+	batch = (async_resolver_batch *) timer->data;
+	
+	if (batch->base.status == ASYNC_STATUS_RUNNING) {
+		ASYNC_FINISH_OP(batch);
+	}
+}
+
+static void resolver_batch_closed(uv_handle_t *handle)
+{
+	async_resolver_batch *batch;
+	
+	batch = (async_resolver_batch *) handle->data;
+	
+	ASYNC_FREE_OP(batch);
+}
+
+ZEND_METHOD(Resolver, resolveMany)
+{
+	async_resolver *resolver;
+	async_resolver_batch *batch;
+	async_resolver_batch_entry *entry;
+	async_resolver_query *query;
+	
+	zend_string *key;
+	zend_long type;
+	zend_long timeout;
+	zend_bool notimeout;
+	
+	zval *names;
+	zval *name;
+	zval records;
+	
+	uint32_t i;
+	int code;
+	
+	type = ASYNC_RESOLVER_TYPE_A;
+	timeout = 0;
+	notimeout = 1;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 3)
+		Z_PARAM_ARRAY(names)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_LONG(type)
+		Z_PARAM_LONG_EX(timeout, notimeout, 1, 0)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	ASYNC_CHECK_ERROR(type != ASYNC_RESOLVER_TYPE_A && type != ASYNC_RESOLVER_TYPE_AAAA && type != ASYNC_RESOLVER_TYPE_SRV && type != ASYNC_RESOLVER_TYPE_TXT, "Unsupported DNS record type: %d", (int) type);
+	ASYNC_CHECK_ERROR(!notimeout && timeout < 0, "Timeout must not be negative");
+	
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(names), name) {
+		ASYNC_CHECK_ERROR(Z_TYPE_P(name) != IS_STRING, "Host names must be given as strings");
+	} ZEND_HASH_FOREACH_END();
+	
+	resolver = (async_resolver *) Z_OBJ_P(getThis());
+	
+	ASYNC_ALLOC_CUSTOM_OP(batch, sizeof(async_resolver_batch));
+	
+	array_init(&batch->results);
+	
+	batch->entries = safe_emalloc(zend_hash_num_elements(Z_ARRVAL_P(names)), sizeof(async_resolver_batch_entry *), 0);
+	
+	// All queries are submitted before the calling task is suspended, duplicate names are only resolved once.
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(names), name) {
+		if (zend_symtable_exists(Z_ARRVAL_P(&batch->results), Z_STR_P(name))) {
+			continue;
+		}
+		
+		key = dns_query_key(Z_STRVAL_P(name), Z_STRLEN_P(name), (uint16_t) type);
+		code = resolver_lookup_local(resolver, key, (uint16_t) type, &records);
+		
+		if (code != 0) {
+			resolver_batch_store(batch, Z_STR_P(name), code, &records);
+			
+			if (code > 0) {
+				zval_ptr_dtor(&records);
+			}
+			
+			zend_string_release(key);
+			
+			continue;
+		}
+		
+		query = resolver_query(resolver, key, (uint16_t) type, &code);
+		
+		zend_string_release(key);
+		
+		if (query == NULL) {
+			resolver_batch_store(batch, Z_STR_P(name), code, NULL);
+			
+			continue;
+		}
+		
+		// Reserve the position of the name in the result array.
+		ZVAL_NULL(&records);
+		zend_symtable_update(Z_ARRVAL_P(&batch->results), Z_STR_P(name), &records);
+		
+		ASYNC_ALLOC_CUSTOM_OP(entry, sizeof(async_resolver_batch_entry));
+		
+		entry->op.base.callback = resolver_batch_continue;
+		entry->batch = batch;
+		entry->query = query;
+		entry->name = zend_string_copy(Z_STR_P(name));
+		
+		ASYNC_ENQUEUE_OP(&query->waiters, entry);
+		
+		batch->entries[batch->count++] = entry;
+		batch->pending++;
+	} ZEND_HASH_FOREACH_END();
+	
+	if (batch->pending > 0) {
+		if (!notimeout) {
+			uv_timer_init(&resolver->scheduler->loop, &batch->timer);
+			
+			batch->timer.data = batch;
+			
+			uv_timer_start(&batch->timer, resolver_batch_timeout, (uint64_t) timeout, 0);
+		}
+		
+		if (async_await_op((async_op *) batch) == FAILURE) {
+			ASYNC_FORWARD_OP_ERROR(batch);
+		}
+	}
+	
+	// Queries that have not completed before the deadline are reported as timed out.
+	for (i = 0; i < batch->count; i++) {
+		entry = batch->entries[i];
+		query = entry->query;
+		
+		if (entry->op.base.q != NULL) {
+			if (EXPECTED(EG(exception) == NULL)) {
+				resolver_batch_store(batch, entry->name, UV_ETIMEDOUT, NULL);
+			}
+			
+			ASYNC_Q_DETACH(entry->op.base.q, (async_op *) entry);
+			entry->op.base.q = NULL;
+			
+			resolver_cancel_query(query);
+		}
+		
+		zend_string_release(entry->name);
+		
+		ASYNC_FREE_OP(entry);
+	}
+	
+	if (EXPECTED(EG(exception) == NULL)) {
+		ZVAL_COPY(return_value, &batch->results);
+	}
+	
+	zval_ptr_dtor(&batch->results);
+	efree(batch->entries);
+	
+	if (batch->timer.data != NULL) {
+		uv_close((uv_handle_t *) &batch->timer, resolver_batch_closed);
+	} else {
+		ASYNC_FREE_OP(batch);
+	}
+}
+
+typedef struct {
+	async_resolver_op op;
+	void *lookup;
+	async_resolver_query *query;
+} async_resolver_lookup_entry;
+
+typedef struct {
+	async_op base;
+	
+	/* Number of queries that have not completed yet. */
+	uint32_t pending;
+} async_resolver_lookup;
+
+static void resolver_lookup_continue(async_op *op)
+{
+	async_resolver_lookup *lookup;
+	
+	lookup = (async_resolver_lookup *) ((async_resolver_lookup_entry *) op)->lookup;
+	
+	if (--lookup->pending == 0 && lookup->base.status == ASYNC_STATUS_RUNNING) {
+		ASYNC_FINISH_OP(lookup);
+	}
+}
+
+/* Resolves A and AAAA records of a host using concurrent queries, used by socket lookups if the resolver is the default. */
+static int resolver_lookup_addresses(async_resolver *resolver, char *name, async_dns_result **result)
+{
+	async_resolver_lookup *lookup;
+	async_resolver_lookup_entry *entries[2];
+	async_resolver_query *query;
+	async_dns_address *addr;
+	
+	zend_string *key;
+	zval records[2];
+	zval *record;
+	zval *ip;
+	
+	uint16_t types[2];
+	uint32_t count;
+	char buf[16];
+	int codes[2];
+	int first;
+	int last;
+	int code;
+	int i;
+	
+	types[0] = ASYNC_RESOLVER_TYPE_AAAA;
+	types[1] = ASYNC_RESOLVER_TYPE_A;
+	
+	first = 0;
+	last = 2;
+	
+	// IP addresses are not looked up using the other address family.
+	if (0 == uv_inet_pton(AF_INET, name, buf)) {
+		first = 1;
+	} else if (0 == uv_inet_pton(AF_INET6, name, buf)) {
+		last = 1;
+	}
+	
+	for (i = 0; i < 2; i++) {
+		entries[i] = NULL;
+		codes[i] = UV_EAI_NODATA;
+		
+		ZVAL_UNDEF(&records[i]);
+	}
+	
+	ASYNC_ALLOC_CUSTOM_OP(lookup, sizeof(async_resolver_lookup));
+	
+	for (i = first; i < last; i++) {
+		key = dns_query_key(name, strlen(name), types[i]);
+		codes[i] = resolver_lookup_local(resolver, key, types[i], &records[i]);
+		
+		if (codes[i] < 1) {
+			ZVAL_UNDEF(&records[i]);
+		}
+		
+		if (codes[i] == 0) {
+			query = resolver_query(resolver, key, types[i], &codes[i]);
+			
+			if (query != NULL) {
+				ASYNC_ALLOC_CUSTOM_OP(entries[i], sizeof(async_resolver_lookup_entry));
+				
+				entries[i]->op.base.callback = resolver_lookup_continue;
+				entries[i]->lookup = lookup;
+				entries[i]->query = query;
+				
+				ASYNC_ENQUEUE_OP(&query->waiters, entries[i]);
+				
+				lookup->pending++;
+			}
+		}
+		
+		zend_string_release(key);
+	}
+	
+	code = SUCCESS;
+	
+	if (lookup->pending > 0 && FAILURE == (code = async_await_op((async_op *) lookup))) {
+		ASYNC_FORWARD_OP_ERROR(lookup);
+	}
+	
+	for (i = 0; i < 2; i++) {
+		if (entries[i] == NULL) {
+			continue;
+		}
+		
+		if (entries[i]->op.base.q != NULL) {
+			ASYNC_Q_DETACH(entries[i]->op.base.q, (async_op *) entries[i]);
+			entries[i]->op.base.q = NULL;
+			
+			resolver_cancel_query(entries[i]->query);
+			
+			codes[i] = UV_ECANCELED;
+		} else {
+			codes[i] = entries[i]->op.code;
+			
+			if (codes[i] == 0) {
+				ZVAL_COPY(&records[i], &entries[i]->op.base.result);
+			}
+		}
+		
+		ASYNC_FREE_OP(entries[i]);
+	}
+	
+	ASYNC_FREE_OP(lookup);
+	
+	count = 0;
+	
+	for (i = 0; i < 2; i++) {
+		if (Z_TYPE_P(&records[i]) == IS_ARRAY) {
+			count += zend_hash_num_elements(Z_ARRVAL_P(&records[i]));
+		}
+	}
+	
+	if (code == FAILURE || count == 0) {
+		zval_ptr_dtor(&records[0]);
+		zval_ptr_dtor(&records[1]);
+		
+		if (code == FAILURE) {
+			return FAILURE;
+		}
+		
+		// Errors of the IPv4 query take precedence, a host without any address is reported as missing data.
+		return (codes[1] < 0) ? codes[1] : ((codes[0] < 0) ? codes[0] : UV_EAI_NODATA);
+	}
+	
+	*result = pemalloc(sizeof(async_dns_result) + sizeof(async_dns_address) * (count - 1), 1);
+	(*result)->refcount = 1;
+	(*result)->count = 0;
+	
+	for (i = 0; i < 2; i++) {
+		if (Z_TYPE_P(&records[i]) != IS_ARRAY) {
+			continue;
+		}
+		
+		ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(&records[i]), record) {
+			ip = zend_hash_str_find(Z_ARRVAL_P(record), ZEND_STRL("address"));
+			addr = &(*result)->addresses[(*result)->count];
+			
+			ZEND_SECURE_ZERO(addr, sizeof(async_dns_address));
+			
+			if (types[i] == ASYNC_RESOLVER_TYPE_A) {
+				addr->in4.sin_family = AF_INET;
+				
+				code = uv_inet_pton(AF_INET, Z_STRVAL_P(ip), &addr->in4.sin_addr);
+			} else {
+				addr->in6.sin6_family = AF_INET6;
+				
+				code = uv_inet_pton(AF_INET6, Z_STRVAL_P(ip), &addr->in6.sin6_addr);
+			}
+			
+			if (code == 0) {
+				(*result)->count++;
+			}
+		} ZEND_HASH_FOREACH_END();
+		
+		zval_ptr_dtor(&records[i]);
+	}
+	
+	if ((*result)->count == 0) {
+		pefree(*result, 1);
+		
+		return UV_EAI_NODATA;
+	}
+	
+	return 0;
+}
+
+/* Resolves the given host, the caller has to release the result if the lookup succeeds. */
+static int dns_lookup(char *name, int proto, async_dns_result **result)
+{
+	async_resolver *resolver;
+	
+	resolver = (async_resolver *) ASYNC_G(dns_resolver);
+	
+	// The default resolver can only be used by the task scheduler that owns its event loop.
+	if (resolver != NULL && async_cli && resolver->scheduler == async_task_scheduler_get()) {
+		return resolver_lookup_addresses(resolver, name, result);
+	}
+	
+	return dns_lookup_system(name, proto, result);
+}
+
+ZEND_METHOD(Resolver, setDefault)
+{
+	zend_object *prev;
+	
+	zval *val;
+	
+	val = NULL;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_OBJECT_OF_CLASS_EX(val, async_resolver_ce, 1, 0)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	prev = ASYNC_G(dns_resolver);
+	
+	if (val == NULL) {
+		ASYNC_G(dns_resolver) = NULL;
+	} else {
+		ASYNC_G(dns_resolver) = Z_OBJ_P(val);
+		
+		ASYNC_ADDREF(Z_OBJ_P(val));
+	}
+	
+	if (prev != NULL) {
+		ASYNC_DELREF(prev);
+	}
+}
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_resolver_ctor, 0, 0, 0)
+	ZEND_ARG_TYPE_INFO(0, nameservers, IS_ARRAY, 1)
+	ZEND_ARG_TYPE_INFO(0, hosts, IS_STRING, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_resolver_resolve, 0, 1, IS_ARRAY, 0)
+	ZEND_ARG_TYPE_INFO(0, name, IS_STRING, 0)
+	ZEND_ARG_TYPE_INFO(0, type, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_resolver_resolve_many, 0, 1, IS_ARRAY, 0)
+	ZEND_ARG_TYPE_INFO(0, names, IS_ARRAY, 0)
+	ZEND_ARG_TYPE_INFO(0, type, IS_LONG, 0)
+	ZEND_ARG_TYPE_INFO(0, timeout, IS_LONG, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_resolver_set_default, 0, 1, IS_VOID, 0)
+	ZEND_ARG_OBJ_INFO(0, resolver, Concurrent\\Network\\Resolver, 1)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry async_resolver_functions[] = {
+	ZEND_ME(Resolver, __construct, arginfo_resolver_ctor, ZEND_ACC_PUBLIC)
+	ZEND_ME(Resolver, resolve, arginfo_resolver_resolve, ZEND_ACC_PUBLIC)
+	ZEND_ME(Resolver, resolveMany, arginfo_resolver_resolve_many, ZEND_ACC_PUBLIC)
+	ZEND_ME(Resolver, setDefault, arginfo_resolver_set_default, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	ZEND_FE_END
+};
+
+ZEND_METHOD(DnsCache, __construct)
+{
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	zend_throw_error(NULL, "DNS cache must not be constructed by userland code");
+}
+
+ZEND_METHOD(DnsCache, flush)
+{
+	ZEND_PARSE_PARAMETERS_NONE();
+	
+	dns_cache_flush(&ASYNC_G(dns_cache));
+}
+
+ZEND_METHOD(DnsCache, getStats)
+{
+	async_dns_cache *cache;
+	
+	ZEND_PARSE_PARAMETERS_NONE();
+	
+	cache = &ASYNC_G(dns_cache);
+	
+	array_init(return_value);
+	
+	add_assoc_long(return_value, "entries", zend_hash_num_elements(&cache->entries));
+	add_assoc_long(return_value, "capacity", MAX(0, ASYNC_G(dns_cache_size)));
+	add_assoc_long(return_value, "hits", cache->hits);
+	add_assoc_long(return_value, "misses", cache->misses);
+	add_assoc_long(return_value, "evictions", cache->evictions);
+	add_assoc_long(return_value, "coalesced", cache->coalesced);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_dns_cache_ctor, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_dns_cache_flush, 0, 0, IS_VOID, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_dns_cache_get_stats, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry async_dns_cache_functions[] = {
+	ZEND_ME(DnsCache, __construct, arginfo_dns_cache_ctor, ZEND_ACC_PRIVATE)
+	ZEND_ME(DnsCache, flush, arginfo_dns_cache_flush, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	ZEND_ME(DnsCache, getStats, arginfo_dns_cache_get_stats, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	ZEND_FE_END
+};
+
+
+void async_dns_ce_register()
+{
+	zend_class_entry ce;
+
+	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\DnsCache", async_dns_cache_functions);
+	async_dns_cache_ce = zend_register_internal_class(&ce);
+	async_dns_cache_ce->ce_flags |= ZEND_ACC_FINAL;
+	async_dns_cache_ce->serialize = zend_class_serialize_deny;
+	async_dns_cache_ce->unserialize = zend_class_unserialize_deny;
+
+	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\Resolver", async_resolver_functions);
+	async_resolver_ce = zend_register_internal_class(&ce);
+	async_resolver_ce->ce_flags |= ZEND_ACC_FINAL;
+	async_resolver_ce->create_object = async_resolver_object_create;
+	async_resolver_ce->serialize = zend_class_serialize_deny;
+	async_resolver_ce->unserialize = zend_class_unserialize_deny;
+
+	memcpy(&async_resolver_handlers, &std_object_handlers, sizeof(zend_object_handlers));
+	async_resolver_handlers.free_obj = async_resolver_object_destroy;
+	async_resolver_handlers.clone_obj = NULL;
+
+	ASYNC_RESOLVER_CONST("A", ASYNC_RESOLVER_TYPE_A);
+	ASYNC_RESOLVER_CONST("AAAA", ASYNC_RESOLVER_TYPE_AAAA);
+	ASYNC_RESOLVER_CONST("SRV", ASYNC_RESOLVER_TYPE_SRV);
+	ASYNC_RESOLVER_CONST("TXT", ASYNC_RESOLVER_TYPE_TXT);
 }
 
 void async_dns_init()
@@ -25,6 +25,49 @@ ASYNC_API zend_class_entry *async_socket_ce;
 ASYNC_API zend_class_entry *async_socket_exception_ce;
 ASYNC_API zend_class_entry *async_socket_stream_ce;
 
+static zend_object_handlers async_socket_delegate_handlers;
+
+
+/* Creates a reader or writer object that delegates to the given socket (the socket is kept alive by the object). */
+ASYNC_API zend_object *async_socket_delegate_create(zend_class_entry *ce, zend_object *socket)
+{
+	async_socket_delegate *delegate;
+
+	delegate = emalloc(sizeof(async_socket_delegate));
+	ZEND_SECURE_ZERO(delegate, sizeof(async_socket_delegate));
+
+	zend_object_std_init(&delegate->std, ce);
+	delegate->std.handlers = &async_socket_delegate_handlers;
+
+	delegate->socket = socket;
+
+	ASYNC_ADDREF(socket);
+
+	return &delegate->std;
+}
+
+static void async_socket_delegate_object_destroy(zend_object *object)
+{
+	async_socket_delegate *delegate;
+
+	delegate = (async_socket_delegate *) object;
+
+	ASYNC_DELREF(delegate->socket);
+
+	zend_object_std_dtor(&delegate->std);
+}
+
+/* Creates the error being used to close a socket (or one direction of it), the previous error is optional. */
+ASYNC_API void async_socket_closed_error(zval *error, zval *previous)
+{
+	ASYNC_PREPARE_EXCEPTION(error, async_stream_closed_exception_ce, "Socket has been closed");
+
+	if (previous != NULL && Z_TYPE_P(previous) != IS_NULL) {
+		zend_exception_set_previous(Z_OBJ_P(error), Z_OBJ_P(previous));
+		GC_ADDREF(Z_OBJ_P(previous));
+	}
+}
+
 
 ZEND_METHOD(Socket, close) { }
 ZEND_METHOD(Socket, getAddress) { }
@@ -118,4 +161,8 @@ void async_socket_ce_register()
 	async_socket_exception_ce = zend_register_internal_class(&ce);
 
 	zend_do_inheritance(async_socket_exception_ce, async_stream_exception_ce);
+
+	memcpy(&async_socket_delegate_handlers, &std_object_handlers, sizeof(zend_object_handlers));
+	async_socket_delegate_handlers.free_obj = async_socket_delegate_object_destroy;
+	async_socket_delegate_handlers.clone_obj = NULL;
 }
@@ -37,6 +37,20 @@ static zend_object_handlers async_tls_server_encryption_handlers;
 #undef X509_EXTENSIONS
 #endif
 
+#ifdef ASYNC_TLS_KTLS
+#include <errno.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
 #define ASYNC_SSL_RETURN_VERIFY_ERROR(ctx) do { \
 	X509_STORE_CTX_set_error(ctx, X509_V_ERR_APPLICATION_VERIFICATION); \
 	return 0; \
@@ -86,9 +100,9 @@ static int ssl_servername_cb(SSL *ssl, int *ad, void *arg)
 {
 	async_tls_cert_queue *q;
 	async_tls_cert *cert;
-	zend_string *key;
 
 	const char *name;
+	size_t len;
 
 	if (ssl == NULL) {
 		return SSL_TLSEXT_ERR_NOACK;
@@ -101,12 +115,13 @@ static int ssl_servername_cb(SSL *ssl, int *ad, void *arg)
 	}
 
 	q = (async_tls_cert_queue *) arg;
-	key = zend_string_init(name, strlen(name), 0);
+	len = strlen(name);
 
 	cert = q->first;
 
+	// Callback may be invoked by a thread pool worker, avoid memory allocations.
 	while (cert != NULL) {
-		if (zend_string_equals(key, cert->host)) {
+		if (ZSTR_LEN(cert->host) == len && 0 == memcmp(ZSTR_VAL(cert->host), name, len)) {
 			SSL_set_SSL_CTX(ssl, cert->ctx);
 			break;
 		}
@@ -114,8 +129,6 @@ static int ssl_servername_cb(SSL *ssl, int *ad, void *arg)
 		cert = cert->next;
 	}
 
-	zend_string_release(key);
-
 	return SSL_TLSEXT_ERR_OK;
 }
 
@@ -290,292 +303,1183 @@ SSL_CTX *async_ssl_create_context()
 	return ctx;
 }
 
-static int configure_engine(SSL_CTX *ctx, SSL *ssl, BIO *rbio, BIO *wbio)
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined (LIBRESSL_VERSION_NUMBER)
+#define SSL_CTX_up_ref(ctx) CRYPTO_add(&(ctx)->references, 1, CRYPTO_LOCK_SSL_CTX)
+#define BIO_get_data(bio) (bio)->ptr
+#define BIO_set_data(bio, val) (bio)->ptr = (val)
+#define BIO_set_init(bio, val) (bio)->init = (val)
+#endif
+
+#ifdef ASYNC_TLS_KTLS
+
+static int ktls_flush(async_ssl_engine *engine)
 {
-	BIO_set_mem_eof_return(rbio, -1);
-	BIO_set_mem_eof_return(wbio, -1);
+	uv_buf_t bufs[1];
+	int code;
 
-	SSL_set_bio(ssl, rbio, wbio);
-	SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE);
+	// uv_try_write() fails while libuv has queued writes, records cannot overtake bytes that are still queued.
+	while (engine->out.len > 0) {
+		bufs[0] = uv_buf_init(engine->out.base + engine->out.offset, (unsigned int) engine->out.len);
 
-#ifdef SSL_MODE_RELEASE_BUFFERS
-	SSL_set_mode(ssl, SSL_get_mode(ssl) | SSL_MODE_RELEASE_BUFFERS);
-#endif
+		code = uv_try_write(engine->ktls_handle, bufs, 1);
 
-	SSL_set_read_ahead(ssl, 1);
+		if (code < 0) {
+			// Remaining bytes are sent by the stream using the write queue.
+			memmove(engine->out.base, engine->out.base + engine->out.offset, engine->out.len);
+			engine->out.offset = 0;
 
-	return SUCCESS;
-}
+			return 0;
+		}
 
-int async_ssl_create_engine(async_ssl_engine *engine)
-{
-	engine->ssl = SSL_new(engine->ctx);
-	engine->rbio = BIO_new(BIO_s_mem());
-	engine->wbio = BIO_new(BIO_s_mem());
-	
-	return configure_engine(engine->ctx, engine->ssl, engine->rbio, engine->wbio);
+		engine->out.offset += code;
+		engine->out.len -= code;
+	}
+
+	engine->out.offset = 0;
+
+	return engine->ktls_handle->write_queue_size == 0;
 }
 
-void async_ssl_dispose_engine(async_ssl_engine *engine, zend_bool ctx)
+static long ktls_enable_send(async_ssl_engine *engine, void *info)
 {
-	if (engine->ssl != NULL) {
-		SSL_free(engine->ssl);
+	socklen_t len;
+
+	// The write queue of the stream must not be used by a thread pool worker.
+	if (engine->worker) {
+		return 0;
 	}
 
-	if (engine->ctx != NULL && ctx) {
-		SSL_CTX_free(engine->ctx);
+	// Size of the crypto info is derived from the cipher type because the OpenSSL wrapper struct is internal.
+	switch (((struct tls_crypto_info *) info)->cipher_type) {
+	case TLS_CIPHER_AES_GCM_128:
+		len = sizeof(struct tls12_crypto_info_aes_gcm_128);
+		break;
+#ifdef TLS_CIPHER_AES_GCM_256
+	case TLS_CIPHER_AES_GCM_256:
+		len = sizeof(struct tls12_crypto_info_aes_gcm_256);
+		break;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	case TLS_CIPHER_CHACHA20_POLY1305:
+		len = sizeof(struct tls12_crypto_info_chacha20_poly1305);
+		break;
+#endif
+	default:
+		return 0;
 	}
 	
-	if (engine->settings.peer_name != NULL) {
-		zend_string_release(engine->settings.peer_name);
-		engine->settings.peer_name = NULL;
+	// Pending records have been encrypted using the old keys and must be sent before keys are installed.
+	if (!ktls_flush(engine)) {
+		return 0;
 	}
-}
 
-#ifdef PHP_WIN32
+	if (setsockopt(engine->ktls_fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0 && errno != EEXIST) {
+		return 0;
+	}
 
-#define RETURN_CERT_VERIFY_FAILURE(code) do { \
-	X509_STORE_CTX_set_error(x509_store_ctx, code); \
-	return 0; \
-} while (0)
+	if (setsockopt(engine->ktls_fd, SOL_TLS, TLS_TX, info, len) < 0) {
+		return 0;
+	}
 
-#define PHP_X509_NAME_ENTRY_TO_UTF8(ne, i, out) ASN1_STRING_to_UTF8(&out, X509_NAME_ENTRY_get_data(X509_NAME_get_entry(ne, i)))
+	engine->ktls_send = 1;
 
-#define php_win_err_free(err) do { \
-	if (err && err[0]) \
-		free(err); \
-} while (0)
+	return 1;
+}
 
-static int ssl_win32_verify_callback(X509_STORE_CTX *x509_store_ctx, void *arg)
+static ssize_t ktls_send_record(async_ssl_engine *engine, int type, const char *buf, size_t len)
 {
-	PCCERT_CONTEXT cert_ctx = NULL;
-	PCCERT_CHAIN_CONTEXT cert_chain_ctx = NULL;
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-	X509 *cert = x509_store_ctx->cert;
-#else
-	X509 *cert = X509_STORE_CTX_get0_cert(x509_store_ctx);
-#endif
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	
+	char cbuf[CMSG_SPACE(sizeof(unsigned char))];
+	ssize_t result;
+	
+	ZEND_SECURE_ZERO(&msg, sizeof(struct msghdr));
 
-	async_ssl_settings *settings;
-	SSL* ssl;
-	zend_bool is_self_signed = 0;
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
 
-	ssl = X509_STORE_CTX_get_ex_data(x509_store_ctx, SSL_get_ex_data_X509_STORE_CTX_idx());
-	settings = (async_ssl_settings *) SSL_get_ex_data(ssl, async_index);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
 
-	{ /* First convert the x509 struct back to a DER encoded buffer and let Windows decode it into a form it can work with */
-		unsigned char *der_buf = NULL;
-		int der_len;
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_TLS;
+	cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
 
-		der_len = i2d_X509(cert, &der_buf);
-		if (der_len < 0) {
-			unsigned long err_code, e;
-			char err_buf[512];
+	*((unsigned char *) CMSG_DATA(cmsg)) = (unsigned char) type;
+	
+	do {
+		result = sendmsg(engine->ktls_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	} while (result < 0 && errno == EINTR);
 
-			while ((e = ERR_get_error()) != 0) {
-				err_code = e;
-			}
+	return (result < 0) ? uv_translate_sys_error(errno) : result;
+}
 
-			php_error_docref(NULL, E_WARNING, "Error encoding X509 certificate: %d: %s", err_code, ERR_error_string(err_code, err_buf));
-			RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
-		}
+static void ktls_queue_control(async_ssl_engine *engine, int type, const char *buf, size_t len)
+{
+	unsigned char *p;
+	size_t size;
 
-		cert_ctx = CertCreateCertificateContext(X509_ASN_ENCODING, der_buf, der_len);
-		OPENSSL_free(der_buf);
+	if (engine->ctrl.offset > 0) {
+		memmove(engine->ctrl.base, engine->ctrl.base + engine->ctrl.offset, engine->ctrl.len);
+		engine->ctrl.offset = 0;
+	}
 
-		if (cert_ctx == NULL) {
-			char *err = php_win_err();
-			php_error_docref(NULL, E_WARNING, "Error creating certificate context: %s", err);
-			php_win_err_free(err);
-			RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
-		}
+	if (engine->ctrl.len + len + 3 > engine->ctrl.size) {
+		size = MAX(engine->ctrl.len + len + 3, 256);
+
+		engine->ctrl.base = erealloc(engine->ctrl.base, size);
+		engine->ctrl.size = size;
 	}
 
-	{ /* Next fetch the relevant cert chain from the store */
-		CERT_ENHKEY_USAGE enhkey_usage = {0};
-		CERT_USAGE_MATCH cert_usage = {0};
-		CERT_CHAIN_PARA chain_params = {sizeof(CERT_CHAIN_PARA)};
-		LPSTR usages[] = {szOID_PKIX_KP_SERVER_AUTH, szOID_SERVER_GATED_CRYPTO, szOID_SGC_NETSCAPE};
-		DWORD chain_flags = 0;
-		unsigned long allowed_depth;
-		unsigned int i;
+	p = (unsigned char *) engine->ctrl.base + engine->ctrl.len;
 
-		enhkey_usage.cUsageIdentifier = 3;
-		enhkey_usage.rgpszUsageIdentifier = usages;
-		cert_usage.dwType = USAGE_MATCH_TYPE_OR;
-		cert_usage.Usage = enhkey_usage;
-		chain_params.RequestedUsage = cert_usage;
-		chain_flags = CERT_CHAIN_CACHE_END_CERT | CERT_CHAIN_REVOCATION_CHECK_CHAIN_EXCLUDE_ROOT;
+	p[0] = (unsigned char) type;
+	p[1] = (unsigned char) (len >> 8);
+	p[2] = (unsigned char) (len & 0xFF);
 
-		if (!CertGetCertificateChain(NULL, cert_ctx, NULL, NULL, &chain_params, chain_flags, NULL, &cert_chain_ctx)) {
-			char *err = php_win_err();
-			php_error_docref(NULL, E_WARNING, "Error getting certificate chain: %s", err);
-			php_win_err_free(err);
-			CertFreeCertificateContext(cert_ctx);
-			RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
-		}
+	memcpy(p + 3, buf, len);
 
-		/* check if the cert is self-signed */
-		if (cert_chain_ctx->cChain > 0 && cert_chain_ctx->rgpChain[0]->cElement > 0
-			&& (cert_chain_ctx->rgpChain[0]->rgpElement[0]->TrustStatus.dwInfoStatus & CERT_TRUST_IS_SELF_SIGNED) != 0) {
-			is_self_signed = 1;
-		}
+	engine->ctrl.len += len + 3;
+}
 
-		/* check the depth */
-		allowed_depth = settings->verify_depth;
+static int ktls_send_control(async_ssl_engine *engine, const char *buf, int len)
+{
+	ssize_t result;
 
-		for (i = 0; i < cert_chain_ctx->cChain; i++) {
-			if (cert_chain_ctx->rgpChain[i]->cElement > allowed_depth) {
-				CertFreeCertificateChain(cert_chain_ctx);
-				CertFreeCertificateContext(cert_ctx);
-				RETURN_CERT_VERIFY_FAILURE(X509_V_ERR_CERT_CHAIN_TOO_LONG);
-			}
+	result = 0;
+
+	// Control records are only sent directly if they do not overtake queued writes or other control records.
+	if (engine->ctrl.len == 0 && ktls_flush(engine)) {
+		result = ktls_send_record(engine, engine->ktls_type, buf, len);
+
+		if (result == len) {
+			return len;
 		}
-	}
 
-	{ /* Then verify it against a policy */
-		SSL_EXTRA_CERT_CHAIN_POLICY_PARA ssl_policy_params = {sizeof(SSL_EXTRA_CERT_CHAIN_POLICY_PARA)};
-		CERT_CHAIN_POLICY_PARA chain_policy_params = {sizeof(CERT_CHAIN_POLICY_PARA)};
-		CERT_CHAIN_POLICY_STATUS chain_policy_status = {sizeof(CERT_CHAIN_POLICY_STATUS)};
-		LPWSTR server_name = NULL;
-		BOOL verify_result;
+		if (result < 0) {
+			if (result != UV_EAGAIN) {
+				return -1;
+			}
 
-		{ /* This looks ridiculous and it is - but we validate the name ourselves using the peer_name
-		     ctx option, so just use the CN from the cert here */
+			result = 0;
+		}
+	}
 
-			X509_NAME *cert_name;
-			unsigned char *cert_name_utf8;
-			int index, cert_name_utf8_len;
-			DWORD num_wchars;
+	// Remaining bytes are sent by the stream once preceding writes have completed, see async_ssl_ktls_flush().
+	ktls_queue_control(engine, engine->ktls_type, buf + result, len - result);
 
-			cert_name = X509_get_subject_name(cert);
-			index = X509_NAME_get_index_by_NID(cert_name, NID_commonName, -1);
-			if (index < 0) {
-				php_error_docref(NULL, E_WARNING, "Unable to locate certificate CN");
-				CertFreeCertificateChain(cert_chain_ctx);
-				CertFreeCertificateContext(cert_ctx);
-				RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
-			}
+	return len;
+}
 
-			cert_name_utf8_len = PHP_X509_NAME_ENTRY_TO_UTF8(cert_name, index, cert_name_utf8);
+int async_ssl_ktls_flush(async_ssl_engine *engine)
+{
+	unsigned char *p;
+	ssize_t result;
+	size_t len;
+	int type;
+
+	while (engine->ctrl.len > 0) {
+		if (!ktls_flush(engine)) {
+			return UV_EAGAIN;
+		}
 
-			num_wchars = MultiByteToWideChar(CP_UTF8, 0, (char*)cert_name_utf8, -1, NULL, 0);
-			if (num_wchars == 0) {
-				php_error_docref(NULL, E_WARNING, "Unable to convert %s to wide character string", cert_name_utf8);
-				OPENSSL_free(cert_name_utf8);
-				CertFreeCertificateChain(cert_chain_ctx);
-				CertFreeCertificateContext(cert_ctx);
-				RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
-			}
+		p = (unsigned char *) engine->ctrl.base + engine->ctrl.offset;
 
-			server_name = emalloc((num_wchars * sizeof(WCHAR)) + sizeof(WCHAR));
+		type = p[0];
+		len = ((size_t) p[1] << 8) | p[2];
 
-			num_wchars = MultiByteToWideChar(CP_UTF8, 0, (char*)cert_name_utf8, -1, server_name, num_wchars);
-			if (num_wchars == 0) {
-				php_error_docref(NULL, E_WARNING, "Unable to convert %s to wide character string", cert_name_utf8);
-				efree(server_name);
-				OPENSSL_free(cert_name_utf8);
-				CertFreeCertificateChain(cert_chain_ctx);
-				CertFreeCertificateContext(cert_ctx);
-				RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
-			}
+		result = ktls_send_record(engine, type, (const char *) p + 3, len);
 
-			OPENSSL_free(cert_name_utf8);
+		if (result < 0) {
+			return (int) result;
 		}
 
-		ssl_policy_params.dwAuthType = (settings->mode == ASYNC_SSL_MODE_CLIENT) ? AUTHTYPE_CLIENT : AUTHTYPE_SERVER;
-		ssl_policy_params.pwszServerName = server_name;
-		chain_policy_params.pvExtraPolicyPara = &ssl_policy_params;
+		// Partially sent records are continued using a new header in front of the remaining bytes.
+		if ((size_t) result < len) {
+			engine->ctrl.offset += result;
+			engine->ctrl.len -= result;
 
-		verify_result = CertVerifyCertificateChainPolicy(CERT_CHAIN_POLICY_SSL, cert_chain_ctx, &chain_policy_params, &chain_policy_status);
+			p += result;
 
-		efree(server_name);
-		CertFreeCertificateChain(cert_chain_ctx);
-		CertFreeCertificateContext(cert_ctx);
+			p[0] = (unsigned char) type;
+			p[1] = (unsigned char) ((len - result) >> 8);
+			p[2] = (unsigned char) ((len - result) & 0xFF);
 
-		if (!verify_result) {
-			char *err = php_win_err();
-			php_error_docref(NULL, E_WARNING, "Error verifying certificate chain policy: %s", err);
-			php_win_err_free(err);
-			RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
+			continue;
 		}
 
-		if (chain_policy_status.dwError != 0) {
-			/* The chain does not match the policy */
-			if (is_self_signed && chain_policy_status.dwError == CERT_E_UNTRUSTEDROOT && settings->allow_self_signed) {
-				/* allow self-signed certs */
-				X509_STORE_CTX_set_error(x509_store_ctx, X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT);
-			} else {
-				RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
-			}
-		}
+		engine->ctrl.offset += len + 3;
+		engine->ctrl.len -= len + 3;
 	}
 
-	return 1;
-}
+	engine->ctrl.offset = 0;
 
-#endif
+	return 0;
+}
 
-void async_ssl_setup_verify_callback(SSL_CTX *ctx, async_ssl_settings *settings)
+void async_ssl_enable_ktls(async_ssl_engine *engine, uv_stream_t *handle)
 {
-	SSL_CTX_set_default_passwd_cb_userdata(ctx, NULL);
-	SSL_CTX_set_verify_depth(ctx, settings->verify_depth);
+	uv_os_fd_t fd;
 
-#ifdef PHP_WIN32
-		SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
-		SSL_CTX_set_cert_verify_callback(ctx, ssl_win32_verify_callback, settings);
-#else
-		SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, ssl_verify_callback);
+	if (0 != uv_fileno((uv_handle_t *) handle, &fd)) {
+		return;
+	}
+
+	engine->ktls = 1;
+	engine->ktls_fd = (int) fd;
+	engine->ktls_handle = handle;
+
+	SSL_set_options(engine->ssl, SSL_OP_ENABLE_KTLS);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	// Session tickets would have to be sent as control messages.
+	SSL_set_num_tickets(engine->ssl, 0);
 #endif
 }
 
-int async_ssl_setup_encryption(SSL *ssl, async_ssl_settings *settings)
+#else
+
+void async_ssl_enable_ktls(async_ssl_engine *engine, uv_stream_t *handle)
 {
-	return SSL_set_ex_data(ssl, async_index, settings);
+	// Kernel TLS is not supported, all records are encrypted in userspace.
 }
 
-void async_ssl_setup_sni(SSL_CTX *ctx, async_tls_server_encryption *encryption)
+int async_ssl_ktls_flush(async_ssl_engine *engine)
 {
-	SSL_CTX_set_tlsext_servername_callback(ctx, ssl_servername_cb);
-	SSL_CTX_set_tlsext_servername_arg(ctx, &encryption->certs);
+	return 0;
 }
 
 #endif
 
-
-static zend_object *async_tls_client_encryption_object_create(zend_class_entry *ce)
+static int bio_write(BIO *bio, const char *buf, int len)
 {
-	async_tls_client_encryption *encryption;
+	async_ssl_engine *engine;
+	size_t size;
 
-	encryption = emalloc(sizeof(async_tls_client_encryption));
-	ZEND_SECURE_ZERO(encryption, sizeof(async_tls_client_encryption));
+	engine = (async_ssl_engine *) BIO_get_data(bio);
 
-	zend_object_std_init(&encryption->std, ce);
-	encryption->std.handlers = &async_tls_client_encryption_handlers;
+	ZEND_ASSERT(engine != NULL);
 
-	encryption->settings.verify_depth = ASYNC_SSL_DEFAULT_VERIFY_DEPTH;
+	BIO_clear_retry_flags(bio);
 
-	return &encryption->std;
-}
+	if (len < 1) {
+		return 0;
+	}
 
-async_tls_client_encryption *async_clone_client_encryption(async_tls_client_encryption *encryption)
-{
-	async_tls_client_encryption *result;
+#ifdef ASYNC_TLS_KTLS
+	if (engine->ktls_send && engine->ktls_type != 0) {
+		return ktls_send_control(engine, buf, len);
+	}
+#endif
 
-	result = (async_tls_client_encryption *) async_tls_client_encryption_object_create(async_tls_client_encryption_ce);
-	result->settings.allow_self_signed = encryption->settings.allow_self_signed;
-	result->settings.verify_depth = encryption->settings.verify_depth;
+	if (engine->out.len + len > engine->out.size) {
+		size = MAX(engine->out.size * 2, MAX(engine->out.len + len, 4096));
 
-	if (encryption->settings.peer_name != NULL) {
-		result->settings.peer_name = zend_string_copy(encryption->settings.peer_name);
+		// Thread pool workers must not use the Zend memory manager.
+		engine->out.base = perealloc(engine->out.base, size, engine->worker);
+		engine->out.size = size;
 	}
 
-	return result;
+	memcpy(engine->out.base + engine->out.len, buf, len);
+	engine->out.len += len;
+
+	return len;
 }
 
-static void async_tls_client_encryption_object_destroy(zend_object *object)
+static int bio_read(BIO *bio, char *buf, int len)
 {
-	async_tls_client_encryption *encryption;
+	async_ssl_engine *engine;
+	size_t count;
+	size_t n;
+
+	engine = (async_ssl_engine *) BIO_get_data(bio);
+
+	ZEND_ASSERT(engine != NULL);
+
+	BIO_clear_retry_flags(bio);
+
+	if (len < 1) {
+		return 0;
+	}
+
+	count = 0;
+
+	if (engine->stash.len > 0) {
+		n = MIN((size_t) len, engine->stash.len);
+
+		memcpy(buf, engine->stash.base + engine->stash.offset, n);
+
+		engine->stash.offset += n;
+		engine->stash.len -= n;
+
+		if (engine->stash.len == 0) {
+			engine->stash.offset = 0;
+		}
+
+		count += n;
+	}
+
+	if (count < (size_t) len && engine->in_len > 0) {
+		n = MIN((size_t) len - count, engine->in_len);
+
+		memcpy(buf + count, engine->in, n);
+
+		engine->in += n;
+		engine->in_len -= n;
+
+		count += n;
+	}
+
+	if (count == 0) {
+		BIO_set_retry_read(bio);
+
+		return -1;
+	}
+
+	return (int) count;
+}
+
+static long bio_ctrl(BIO *bio, int cmd, long num, void *ptr)
+{
+	async_ssl_engine *engine;
+
+	engine = (async_ssl_engine *) BIO_get_data(bio);
+
+	switch (cmd) {
+	case BIO_CTRL_FLUSH:
+		return 1;
+	case BIO_CTRL_PENDING:
+		return (engine == NULL) ? 0 : (long) (engine->stash.len + engine->in_len);
+	case BIO_CTRL_WPENDING:
+		return (engine == NULL) ? 0 : (long) engine->out.len;
+#ifdef ASYNC_TLS_KTLS
+	case BIO_CTRL_SET_KTLS:
+		// Only outgoing records are offloaded, libuv cannot receive record types of incoming control messages.
+		return (engine != NULL && engine->ktls && num) ? ktls_enable_send(engine, ptr) : 0;
+	case BIO_CTRL_GET_KTLS_SEND:
+		return (engine == NULL) ? 0 : engine->ktls_send;
+	case BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG:
+		engine->ktls_type = (int) num;
+		return 1;
+	case BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG:
+		engine->ktls_type = 0;
+		return 1;
+#endif
+	}
+
+	return 0;
+}
+
+static int bio_create(BIO *bio)
+{
+	BIO_set_init(bio, 1);
+	BIO_set_data(bio, NULL);
+
+	return 1;
+}
+
+static int bio_destroy(BIO *bio)
+{
+	if (bio == NULL) {
+		return 0;
+	}
+
+	BIO_set_data(bio, NULL);
+
+	return 1;
+}
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined (LIBRESSL_VERSION_NUMBER)
+
+static BIO_METHOD async_bio_method = {
+	BIO_TYPE_SOURCE_SINK,
+	"async",
+	bio_write,
+	bio_read,
+	NULL,
+	NULL,
+	bio_ctrl,
+	bio_create,
+	bio_destroy,
+	NULL
+};
+
+static BIO_METHOD *bio_method = &async_bio_method;
+
+#else
+
+static BIO_METHOD *bio_method;
+
+#endif
+
+void async_ssl_bio_feed(async_ssl_engine *engine, const char *buf, size_t len)
+{
+	engine->in = buf;
+	engine->in_len = len;
+}
+
+void async_ssl_bio_release(async_ssl_engine *engine)
+{
+	size_t size;
+
+	if (engine->in_len == 0) {
+		engine->in = NULL;
+
+		return;
+	}
+
+	if (engine->stash.offset > 0) {
+		memmove(engine->stash.base, engine->stash.base + engine->stash.offset, engine->stash.len);
+		engine->stash.offset = 0;
+	}
+
+	if (engine->stash.len + engine->in_len > engine->stash.size) {
+		size = MAX(engine->stash.len + engine->in_len, 4096);
+
+		engine->stash.base = erealloc(engine->stash.base, size);
+		engine->stash.size = size;
+	}
+
+	memcpy(engine->stash.base + engine->stash.len, engine->in, engine->in_len);
+	engine->stash.len += engine->in_len;
+
+	engine->in = NULL;
+	engine->in_len = 0;
+}
+
+char *async_ssl_bio_take_output(async_ssl_engine *engine, size_t *len)
+{
+	char *base;
+
+	base = engine->out.base;
+	*len = engine->out.len;
+
+	if (*len == 0) {
+		return NULL;
+	}
+
+	engine->out.base = NULL;
+	engine->out.len = 0;
+	engine->out.size = 0;
+
+	return base;
+}
+
+#ifdef ASYNC_TLS_OFFLOAD
+
+static void offload_work(uv_work_t *req)
+{
+	async_ssl_offload_op *op;
+
+	op = (async_ssl_offload_op *) req->data;
+
+	// OpenSSL error queue is thread-local, errors have to be collected in the worker.
+	ERR_clear_error();
+
+	op->code = SSL_do_handshake(op->shadow.ssl);
+	op->error = SSL_get_error(op->shadow.ssl, op->code);
+	op->ssl_error = ERR_get_error();
+}
+
+static zend_string *copy_persistent(zend_string *str)
+{
+	if (str == NULL) {
+		return NULL;
+	}
+	
+	return zend_string_init(ZSTR_VAL(str), ZSTR_LEN(str), 1);
+}
+
+static void release_persistent(zend_string *str)
+{
+	if (str != NULL) {
+		zend_string_free(str);
+	}
+}
+
+static void offload_done(uv_work_t *req, int status)
+{
+	async_ssl_offload_op *op;
+	async_ssl_engine *engine;
+	size_t size;
+
+	op = (async_ssl_offload_op *) req->data;
+	engine = op->engine;
+
+	if (engine != NULL) {
+		BIO_set_data(engine->bio, engine);
+		SSL_set_ex_data(engine->ssl, async_index, op->ex_data);
+
+		engine->offload = NULL;
+		engine->ktls_send = op->shadow.ktls_send;
+
+		// Input bytes that have not been consumed by the worker are moved back into the stash of the engine.
+		if (op->shadow.stash.len > 0) {
+			if (op->shadow.stash.len > engine->stash.size) {
+				size = MAX(op->shadow.stash.len, 4096);
+
+				engine->stash.base = erealloc(engine->stash.base, size);
+				engine->stash.size = size;
+			}
+
+			memcpy(engine->stash.base, op->shadow.stash.base + op->shadow.stash.offset, op->shadow.stash.len);
+
+			engine->stash.offset = 0;
+			engine->stash.len = op->shadow.stash.len;
+		}
+
+		if (op->shadow.out.len > 0) {
+			if (engine->out.len + op->shadow.out.len > engine->out.size) {
+				size = MAX(engine->out.len + op->shadow.out.len, 4096);
+
+				engine->out.base = erealloc(engine->out.base, size);
+				engine->out.size = size;
+			}
+
+			memcpy(engine->out.base + engine->out.len, op->shadow.out.base, op->shadow.out.len);
+			engine->out.len += op->shadow.out.len;
+		}
+	}
+
+	if (op->shadow.stash.base != NULL) {
+		pefree(op->shadow.stash.base, 1);
+	}
+
+	if (op->shadow.out.base != NULL) {
+		pefree(op->shadow.out.base, 1);
+	}
+
+	release_persistent(op->settings.peer_name);
+	release_persistent(op->settings.alpn);
+
+	SSL_free(op->shadow.ssl);
+
+	if (op->ref != NULL) {
+		ASYNC_DELREF(op->ref);
+	}
+
+	if (status < 0) {
+		op->code = -1;
+		op->error = SSL_ERROR_SYSCALL;
+	}
+
+	if (op->base.flags & ASYNC_OP_FLAG_CANCELLED) {
+		ASYNC_FREE_OP(op);
+	} else {
+		ASYNC_FINISH_OP(op);
+	}
+}
+
+int async_ssl_offload_handshake(uv_loop_t *loop, async_ssl_engine *engine, async_ssl_offload_op *op, zend_object *ref)
+{
+	async_ssl_settings *settings;
+	size_t len;
+	int code;
+
+	memcpy(&op->shadow, engine, sizeof(async_ssl_engine));
+	ZEND_SECURE_ZERO(&op->shadow.out, sizeof(async_ssl_buffer));
+	ZEND_SECURE_ZERO(&op->shadow.stash, sizeof(async_ssl_buffer));
+
+	op->shadow.worker = 1;
+	op->shadow.in = NULL;
+	op->shadow.in_len = 0;
+
+	op->engine = engine;
+	op->req.data = op;
+
+	// Buffered input bytes are copied into memory owned by the worker.
+	len = engine->stash.len + engine->in_len;
+
+	if (len > 0) {
+		op->shadow.stash.base = pemalloc(len, 1);
+		op->shadow.stash.len = len;
+		op->shadow.stash.size = len;
+
+		memcpy(op->shadow.stash.base, engine->stash.base + engine->stash.offset, engine->stash.len);
+		memcpy(op->shadow.stash.base + engine->stash.len, engine->in, engine->in_len);
+	}
+
+	// SSL callbacks read settings from a snapshot, the settings of the engine may be changed or released meanwhile.
+	settings = (async_ssl_settings *) SSL_get_ex_data(engine->ssl, async_index);
+
+	if (settings != NULL) {
+		op->settings = *settings;
+		op->settings.peer_name = copy_persistent(settings->peer_name);
+		op->settings.alpn = copy_persistent(settings->alpn);
+	}
+
+	op->ex_data = settings;
+	op->ref = ref;
+
+	// Worker uses the shadow engine, the SSL object is kept alive until the work is done.
+	BIO_set_data(engine->bio, &op->shadow);
+	SSL_set_ex_data(engine->ssl, async_index, (settings == NULL) ? NULL : &op->settings);
+	SSL_up_ref(engine->ssl);
+
+	code = uv_queue_work(loop, &op->req, offload_work, offload_done);
+
+	if (code < 0) {
+		BIO_set_data(engine->bio, engine);
+		SSL_set_ex_data(engine->ssl, async_index, settings);
+		SSL_free(engine->ssl);
+
+		if (op->shadow.stash.base != NULL) {
+			pefree(op->shadow.stash.base, 1);
+		}
+
+		release_persistent(op->settings.peer_name);
+		release_persistent(op->settings.alpn);
+
+		return code;
+	}
+
+	engine->offload = op;
+
+	engine->stash.offset = 0;
+	engine->stash.len = 0;
+	engine->in = NULL;
+	engine->in_len = 0;
+
+	if (ref != NULL) {
+		ASYNC_ADDREF(ref);
+	}
+
+	return 0;
+}
+
+#else
+
+int async_ssl_offload_handshake(uv_loop_t *loop, async_ssl_engine *engine, async_ssl_offload_op *op, zend_object *ref)
+{
+	return UV_ENOTSUP;
+}
+
+#endif
+
+static int configure_engine(SSL_CTX *ctx, SSL *ssl, BIO *bio)
+{
+	SSL_set_bio(ssl, bio, bio);
+	SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE);
+
+#ifdef SSL_MODE_RELEASE_BUFFERS
+	SSL_set_mode(ssl, SSL_get_mode(ssl) | SSL_MODE_RELEASE_BUFFERS);
+#endif
+
+	SSL_set_read_ahead(ssl, 1);
+
+	return SUCCESS;
+}
+
+int async_ssl_create_engine(async_ssl_engine *engine)
+{
+	engine->ssl = SSL_new(engine->ctx);
+	engine->bio = BIO_new(bio_method);
+
+	BIO_set_data(engine->bio, engine);
+	
+	return configure_engine(engine->ctx, engine->ssl, engine->bio);
+}
+
+void async_ssl_dispose_engine(async_ssl_engine *engine, zend_bool ctx)
+{
+	if (engine->offload != NULL) {
+		((async_ssl_offload_op *) engine->offload)->engine = NULL;
+		engine->offload = NULL;
+	}
+
+	if (engine->ssl != NULL) {
+		SSL_free(engine->ssl);
+	}
+	
+	if (engine->stash.base != NULL) {
+		efree(engine->stash.base);
+		engine->stash.base = NULL;
+	}
+	
+	if (engine->out.base != NULL) {
+		efree(engine->out.base);
+		engine->out.base = NULL;
+	}
+	
+	if (engine->ctrl.base != NULL) {
+		efree(engine->ctrl.base);
+		engine->ctrl.base = NULL;
+	}
+
+	if (engine->ctx != NULL && ctx) {
+		SSL_CTX_free(engine->ctx);
+	}
+	
+	if (engine->settings.peer_name != NULL) {
+		zend_string_release(engine->settings.peer_name);
+		engine->settings.peer_name = NULL;
+	}
+}
+
+#ifdef PHP_WIN32
+
+#define RETURN_CERT_VERIFY_FAILURE(code) do { \
+	X509_STORE_CTX_set_error(x509_store_ctx, code); \
+	return 0; \
+} while (0)
+
+#define PHP_X509_NAME_ENTRY_TO_UTF8(ne, i, out) ASN1_STRING_to_UTF8(&out, X509_NAME_ENTRY_get_data(X509_NAME_get_entry(ne, i)))
+
+#define php_win_err_free(err) do { \
+	if (err && err[0]) \
+		free(err); \
+} while (0)
+
+static int ssl_win32_verify_callback(X509_STORE_CTX *x509_store_ctx, void *arg)
+{
+	PCCERT_CONTEXT cert_ctx = NULL;
+	PCCERT_CHAIN_CONTEXT cert_chain_ctx = NULL;
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	X509 *cert = x509_store_ctx->cert;
+#else
+	X509 *cert = X509_STORE_CTX_get0_cert(x509_store_ctx);
+#endif
+
+	async_ssl_settings *settings;
+	SSL* ssl;
+	zend_bool is_self_signed = 0;
+
+	ssl = X509_STORE_CTX_get_ex_data(x509_store_ctx, SSL_get_ex_data_X509_STORE_CTX_idx());
+	settings = (async_ssl_settings *) SSL_get_ex_data(ssl, async_index);
+
+	{ /* First convert the x509 struct back to a DER encoded buffer and let Windows decode it into a form it can work with */
+		unsigned char *der_buf = NULL;
+		int der_len;
+
+		der_len = i2d_X509(cert, &der_buf);
+		if (der_len < 0) {
+			unsigned long err_code, e;
+			char err_buf[512];
+
+			while ((e = ERR_get_error()) != 0) {
+				err_code = e;
+			}
+
+			php_error_docref(NULL, E_WARNING, "Error encoding X509 certificate: %d: %s", err_code, ERR_error_string(err_code, err_buf));
+			RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
+		}
+
+		cert_ctx = CertCreateCertificateContext(X509_ASN_ENCODING, der_buf, der_len);
+		OPENSSL_free(der_buf);
+
+		if (cert_ctx == NULL) {
+			char *err = php_win_err();
+			php_error_docref(NULL, E_WARNING, "Error creating certificate context: %s", err);
+			php_win_err_free(err);
+			RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
+		}
+	}
+
+	{ /* Next fetch the relevant cert chain from the store */
+		CERT_ENHKEY_USAGE enhkey_usage = {0};
+		CERT_USAGE_MATCH cert_usage = {0};
+		CERT_CHAIN_PARA chain_params = {sizeof(CERT_CHAIN_PARA)};
+		LPSTR usages[] = {szOID_PKIX_KP_SERVER_AUTH, szOID_SERVER_GATED_CRYPTO, szOID_SGC_NETSCAPE};
+		DWORD chain_flags = 0;
+		unsigned long allowed_depth;
+		unsigned int i;
+
+		enhkey_usage.cUsageIdentifier = 3;
+		enhkey_usage.rgpszUsageIdentifier = usages;
+		cert_usage.dwType = USAGE_MATCH_TYPE_OR;
+		cert_usage.Usage = enhkey_usage;
+		chain_params.RequestedUsage = cert_usage;
+		chain_flags = CERT_CHAIN_CACHE_END_CERT | CERT_CHAIN_REVOCATION_CHECK_CHAIN_EXCLUDE_ROOT;
+
+		if (!CertGetCertificateChain(NULL, cert_ctx, NULL, NULL, &chain_params, chain_flags, NULL, &cert_chain_ctx)) {
+			char *err = php_win_err();
+			php_error_docref(NULL, E_WARNING, "Error getting certificate chain: %s", err);
+			php_win_err_free(err);
+			CertFreeCertificateContext(cert_ctx);
+			RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
+		}
+
+		/* check if the cert is self-signed */
+		if (cert_chain_ctx->cChain > 0 && cert_chain_ctx->rgpChain[0]->cElement > 0
+			&& (cert_chain_ctx->rgpChain[0]->rgpElement[0]->TrustStatus.dwInfoStatus & CERT_TRUST_IS_SELF_SIGNED) != 0) {
+			is_self_signed = 1;
+		}
+
+		/* check the depth */
+		allowed_depth = settings->verify_depth;
+
+		for (i = 0; i < cert_chain_ctx->cChain; i++) {
+			if (cert_chain_ctx->rgpChain[i]->cElement > allowed_depth) {
+				CertFreeCertificateChain(cert_chain_ctx);
+				CertFreeCertificateContext(cert_ctx);
+				RETURN_CERT_VERIFY_FAILURE(X509_V_ERR_CERT_CHAIN_TOO_LONG);
+			}
+		}
+	}
+
+	{ /* Then verify it against a policy */
+		SSL_EXTRA_CERT_CHAIN_POLICY_PARA ssl_policy_params = {sizeof(SSL_EXTRA_CERT_CHAIN_POLICY_PARA)};
+		CERT_CHAIN_POLICY_PARA chain_policy_params = {sizeof(CERT_CHAIN_POLICY_PARA)};
+		CERT_CHAIN_POLICY_STATUS chain_policy_status = {sizeof(CERT_CHAIN_POLICY_STATUS)};
+		LPWSTR server_name = NULL;
+		BOOL verify_result;
+
+		{ /* This looks ridiculous and it is - but we validate the name ourselves using the peer_name
+		     ctx option, so just use the CN from the cert here */
+
+			X509_NAME *cert_name;
+			unsigned char *cert_name_utf8;
+			int index, cert_name_utf8_len;
+			DWORD num_wchars;
+
+			cert_name = X509_get_subject_name(cert);
+			index = X509_NAME_get_index_by_NID(cert_name, NID_commonName, -1);
+			if (index < 0) {
+				php_error_docref(NULL, E_WARNING, "Unable to locate certificate CN");
+				CertFreeCertificateChain(cert_chain_ctx);
+				CertFreeCertificateContext(cert_ctx);
+				RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
+			}
+
+			cert_name_utf8_len = PHP_X509_NAME_ENTRY_TO_UTF8(cert_name, index, cert_name_utf8);
+
+			num_wchars = MultiByteToWideChar(CP_UTF8, 0, (char*)cert_name_utf8, -1, NULL, 0);
+			if (num_wchars == 0) {
+				php_error_docref(NULL, E_WARNING, "Unable to convert %s to wide character string", cert_name_utf8);
+				OPENSSL_free(cert_name_utf8);
+				CertFreeCertificateChain(cert_chain_ctx);
+				CertFreeCertificateContext(cert_ctx);
+				RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
+			}
+
+			server_name = emalloc((num_wchars * sizeof(WCHAR)) + sizeof(WCHAR));
+
+			num_wchars = MultiByteToWideChar(CP_UTF8, 0, (char*)cert_name_utf8, -1, server_name, num_wchars);
+			if (num_wchars == 0) {
+				php_error_docref(NULL, E_WARNING, "Unable to convert %s to wide character string", cert_name_utf8);
+				efree(server_name);
+				OPENSSL_free(cert_name_utf8);
+				CertFreeCertificateChain(cert_chain_ctx);
+				CertFreeCertificateContext(cert_ctx);
+				RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
+			}
+
+			OPENSSL_free(cert_name_utf8);
+		}
+
+		ssl_policy_params.dwAuthType = (settings->mode == ASYNC_SSL_MODE_CLIENT) ? AUTHTYPE_CLIENT : AUTHTYPE_SERVER;
+		ssl_policy_params.pwszServerName = server_name;
+		chain_policy_params.pvExtraPolicyPara = &ssl_policy_params;
+
+		verify_result = CertVerifyCertificateChainPolicy(CERT_CHAIN_POLICY_SSL, cert_chain_ctx, &chain_policy_params, &chain_policy_status);
+
+		efree(server_name);
+		CertFreeCertificateChain(cert_chain_ctx);
+		CertFreeCertificateContext(cert_ctx);
+
+		if (!verify_result) {
+			char *err = php_win_err();
+			php_error_docref(NULL, E_WARNING, "Error verifying certificate chain policy: %s", err);
+			php_win_err_free(err);
+			RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
+		}
+
+		if (chain_policy_status.dwError != 0) {
+			/* The chain does not match the policy */
+			if (is_self_signed && chain_policy_status.dwError == CERT_E_UNTRUSTEDROOT && settings->allow_self_signed) {
+				/* allow self-signed certs */
+				X509_STORE_CTX_set_error(x509_store_ctx, X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT);
+			} else {
+				RETURN_CERT_VERIFY_FAILURE(SSL_R_CERTIFICATE_VERIFY_FAILED);
+			}
+		}
+	}
+
+	return 1;
+}
+
+#endif
+
+void async_ssl_setup_verify_callback(SSL_CTX *ctx, async_ssl_settings *settings)
+{
+	SSL_CTX_set_default_passwd_cb_userdata(ctx, NULL);
+	SSL_CTX_set_verify_depth(ctx, settings->verify_depth);
+
+#ifdef PHP_WIN32
+		SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+		SSL_CTX_set_cert_verify_callback(ctx, ssl_win32_verify_callback, settings);
+#else
+		SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, ssl_verify_callback);
+#endif
+}
+
+int async_ssl_setup_encryption(SSL *ssl, async_ssl_settings *settings)
+{
+	return SSL_set_ex_data(ssl, async_index, settings);
+}
+
+void async_ssl_setup_sni(SSL_CTX *ctx, async_tls_server_encryption *encryption)
+{
+	SSL_CTX_set_tlsext_servername_callback(ctx, ssl_servername_cb);
+	SSL_CTX_set_tlsext_servername_arg(ctx, &encryption->certs);
+}
+
+#ifdef ASYNC_TLS_ALPN
+
+static int ssl_alpn_select_cb(SSL *ssl, const unsigned char **out, unsigned char *outlen, const unsigned char *in, unsigned int inlen, void *arg)
+{
+	async_ssl_settings *settings;
+
+	settings = (async_ssl_settings *) SSL_get_ex_data(ssl, async_index);
+
+	if (settings == NULL || settings->alpn == NULL) {
+		return SSL_TLSEXT_ERR_NOACK;
+	}
+
+	// Server preference order is used to select the protocol.
+	if (OPENSSL_NPN_NEGOTIATED != SSL_select_next_proto((unsigned char **) out, outlen, (const unsigned char *) ZSTR_VAL(settings->alpn), (unsigned int) ZSTR_LEN(settings->alpn), in, inlen)) {
+		return SSL_TLSEXT_ERR_ALERT_FATAL;
+	}
+
+	return SSL_TLSEXT_ERR_OK;
+}
+
+#endif
+
+#define ASYNC_SSL_IS_PEM(str) (ZSTR_LEN(str) > 10 && 0 == memcmp(ZSTR_VAL(str), "-----BEGIN", 10))
+
+static int use_certificate(SSL_CTX *ctx, async_tls_cert *cert)
+{
+	BIO *bio;
+	X509 *x509;
+	EVP_PKEY *key;
+
+	int result;
+
+	SSL_CTX_set_default_passwd_cb_userdata(ctx, cert);
+
+	if (ASYNC_SSL_IS_PEM(cert->file)) {
+		bio = BIO_new_mem_buf(ZSTR_VAL(cert->file), (int) ZSTR_LEN(cert->file));
+		x509 = PEM_read_bio_X509_AUX(bio, NULL, ssl_cert_passphrase_cb, cert);
+
+		result = (x509 != NULL && 1 == SSL_CTX_use_certificate(ctx, x509));
+
+		if (x509 != NULL) {
+			X509_free(x509);
+		}
+
+		// Remaining certificates in the PEM string form the chain.
+		while (result && NULL != (x509 = PEM_read_bio_X509(bio, NULL, NULL, NULL))) {
+			if (!SSL_CTX_add_extra_chain_cert(ctx, x509)) {
+				X509_free(x509);
+				result = 0;
+			}
+		}
+
+		BIO_free(bio);
+
+		if (!result) {
+			return FAILURE;
+		}
+
+		// Reading past the last certificate leaves an error in the queue.
+		ERR_clear_error();
+	} else if (1 != SSL_CTX_use_certificate_chain_file(ctx, ZSTR_VAL(cert->file))) {
+		return FAILURE;
+	}
+
+	if (ASYNC_SSL_IS_PEM(cert->key)) {
+		bio = BIO_new_mem_buf(ZSTR_VAL(cert->key), (int) ZSTR_LEN(cert->key));
+		key = PEM_read_bio_PrivateKey(bio, NULL, ssl_cert_passphrase_cb, cert);
+
+		result = (key != NULL && 1 == SSL_CTX_use_PrivateKey(ctx, key));
+
+		if (key != NULL) {
+			EVP_PKEY_free(key);
+		}
+
+		BIO_free(bio);
+
+		if (!result) {
+			return FAILURE;
+		}
+	} else if (1 != SSL_CTX_use_PrivateKey_file(ctx, ZSTR_VAL(cert->key), SSL_FILETYPE_PEM)) {
+		return FAILURE;
+	}
+
+	return (1 == SSL_CTX_check_private_key(ctx)) ? SUCCESS : FAILURE;
+}
+
+static SSL_CTX *create_cert_context(async_tls_cert *cert)
+{
+	SSL_CTX *ctx;
+	unsigned long error;
+
+	ctx = async_ssl_create_context();
+
+	ERR_clear_error();
+
+	if (SUCCESS != use_certificate(ctx, cert)) {
+		error = ERR_get_error();
+
+		SSL_CTX_free(ctx);
+
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to load certificate%s%s: %s",
+			(cert->host == NULL) ? "" : " for host ",
+			(cert->host == NULL) ? "" : ZSTR_VAL(cert->host),
+			(error == 0) ? "Unknown error" : ERR_reason_error_string(error)
+		);
+
+		return NULL;
+	}
+
+#ifdef ASYNC_TLS_ALPN
+	// Protocols are taken from the settings of the server, SNI contexts may be shared between encryption objects.
+	SSL_CTX_set_alpn_select_cb(ctx, ssl_alpn_select_cb, NULL);
+#endif
+
+	return ctx;
+}
+
+SSL_CTX *async_ssl_get_server_context(async_tls_server_encryption *encryption)
+{
+	async_tls_cert *cert;
+	SSL_CTX *ctx;
+
+	// Parsed contexts are cached by the (immutable) encryption object and shared between servers.
+	if (encryption->cert.ctx == NULL) {
+		if (encryption->cert.file == NULL) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "No default certificate has been configured");
+			return NULL;
+		}
+
+		cert = encryption->certs.first;
+
+		while (cert != NULL) {
+			if (cert->ctx == NULL && NULL == (cert->ctx = create_cert_context(cert))) {
+				return NULL;
+			}
+
+			cert = cert->next;
+		}
+
+		if (NULL == (ctx = create_cert_context(&encryption->cert))) {
+			return NULL;
+		}
+
+		async_ssl_setup_sni(ctx, encryption);
+
+		encryption->cert.ctx = ctx;
+	}
+
+	SSL_CTX_up_ref(encryption->cert.ctx);
+
+	return encryption->cert.ctx;
+}
+
+#endif
+
+
+static zend_string *encode_alpn_protocols(HashTable *protocols)
+{
+	zend_string *result;
+	zend_string *str;
+	zval *entry;
+
+	size_t len;
+	char *pos;
+
+	len = 0;
+
+	ZEND_HASH_FOREACH_VAL(protocols, entry) {
+		ZVAL_DEREF(entry);
+
+		if (Z_TYPE_P(entry) != IS_STRING) {
+			zend_throw_error(zend_ce_type_error, "ALPN protocol names must be strings");
+			return NULL;
+		}
+
+		if (Z_STRLEN_P(entry) < 1 || Z_STRLEN_P(entry) > 255) {
+			zend_throw_error(NULL, "ALPN protocol names must be between 1 and 255 bytes long");
+			return NULL;
+		}
+
+		len += Z_STRLEN_P(entry) + 1;
+	} ZEND_HASH_FOREACH_END();
+
+	if (len == 0) {
+		return NULL;
+	}
+
+	// The encoded list is sent with a 16-bit length prefix in the TLS extension.
+	if (len > 65535) {
+		zend_throw_error(NULL, "ALPN protocol list must not exceed 65535 bytes");
+		return NULL;
+	}
+
+	result = zend_string_alloc(len, 0);
+	pos = ZSTR_VAL(result);
+
+	// Wire format: every protocol name is prefixed with a single length byte.
+	ZEND_HASH_FOREACH_VAL(protocols, entry) {
+		ZVAL_DEREF(entry);
+
+		str = Z_STR_P(entry);
+
+		*pos++ = (char) ZSTR_LEN(str);
+
+		memcpy(pos, ZSTR_VAL(str), ZSTR_LEN(str));
+		pos += ZSTR_LEN(str);
+	} ZEND_HASH_FOREACH_END();
+
+	*pos = '\0';
+
+	return result;
+}
+
+static zend_object *async_tls_client_encryption_object_create(zend_class_entry *ce)
+{
+	async_tls_client_encryption *encryption;
+
+	encryption = emalloc(sizeof(async_tls_client_encryption));
+	ZEND_SECURE_ZERO(encryption, sizeof(async_tls_client_encryption));
+
+	zend_object_std_init(&encryption->std, ce);
+	encryption->std.handlers = &async_tls_client_encryption_handlers;
+
+	encryption->settings.verify_depth = ASYNC_SSL_DEFAULT_VERIFY_DEPTH;
+
+	return &encryption->std;
+}
+
+async_tls_client_encryption *async_clone_client_encryption(async_tls_client_encryption *encryption)
+{
+	async_tls_client_encryption *result;
+
+	result = (async_tls_client_encryption *) async_tls_client_encryption_object_create(async_tls_client_encryption_ce);
+	result->settings.allow_self_signed = encryption->settings.allow_self_signed;
+	result->settings.verify_depth = encryption->settings.verify_depth;
+	result->settings.kernel_tls = encryption->settings.kernel_tls;
+
+	if (encryption->settings.alpn != NULL) {
+		result->settings.alpn = zend_string_copy(encryption->settings.alpn);
+	}
+
+	if (encryption->settings.peer_name != NULL) {
+		result->settings.peer_name = zend_string_copy(encryption->settings.peer_name);
+	}
+
+	return result;
+}
+
+static void async_tls_client_encryption_object_destroy(zend_object *object)
+{
+	async_tls_client_encryption *encryption;
 
 	encryption = (async_tls_client_encryption *) object;
 
@@ -583,6 +1487,10 @@ static void async_tls_client_encryption_object_destroy(zend_object *object)
 		zend_string_release(encryption->settings.peer_name);
 	}
 
+	if (encryption->settings.alpn != NULL) {
+		zend_string_release(encryption->settings.alpn);
+	}
+
 	zend_object_std_dtor(&encryption->std);
 }
 
@@ -645,6 +1553,56 @@ ZEND_METHOD(TlsClientEncryption, withPeerName)
 	RETURN_ZVAL(&obj, 1, 1);
 }
 
+ZEND_METHOD(TlsClientEncryption, withKernelTls)
+{
+	async_tls_client_encryption *encryption;
+
+	zend_bool enable;
+	zval obj;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_BOOL(enable)
+	ZEND_PARSE_PARAMETERS_END();
+
+	encryption = async_clone_client_encryption((async_tls_client_encryption *) Z_OBJ_P(getThis()));
+	encryption->settings.kernel_tls = enable;
+
+	ZVAL_OBJ(&obj, &encryption->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(TlsClientEncryption, withAlpnProtocols)
+{
+	async_tls_client_encryption *encryption;
+
+	zend_string *alpn;
+	HashTable *protocols;
+	zval obj;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_ARRAY_HT(protocols)
+	ZEND_PARSE_PARAMETERS_END();
+
+	alpn = encode_alpn_protocols(protocols);
+
+	if (UNEXPECTED(EG(exception))) {
+		return;
+	}
+
+	encryption = async_clone_client_encryption((async_tls_client_encryption *) Z_OBJ_P(getThis()));
+
+	if (encryption->settings.alpn != NULL) {
+		zend_string_release(encryption->settings.alpn);
+	}
+
+	encryption->settings.alpn = alpn;
+
+	ZVAL_OBJ(&obj, &encryption->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
 ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tls_client_encryption_with_allow_self_signed, 0, 1, Concurrent\\Network\\TlsClientEncryption, 0)
 	ZEND_ARG_TYPE_INFO(0, allow, _IS_BOOL, 0)
 ZEND_END_ARG_INFO()
@@ -657,10 +1615,20 @@ ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tls_client_encryption_with_peer_n
 	ZEND_ARG_TYPE_INFO(0, name, IS_STRING, 0)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tls_client_encryption_with_kernel_tls, 0, 1, Concurrent\\Network\\TlsClientEncryption, 0)
+	ZEND_ARG_TYPE_INFO(0, enable, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tls_client_encryption_with_alpn_protocols, 0, 1, Concurrent\\Network\\TlsClientEncryption, 0)
+	ZEND_ARG_TYPE_INFO(0, protocols, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
 static const zend_function_entry async_tls_client_encryption_functions[] = {
 	ZEND_ME(TlsClientEncryption, withAllowSelfSigned, arginfo_tls_client_encryption_with_allow_self_signed, ZEND_ACC_PUBLIC)
 	ZEND_ME(TlsClientEncryption, withVerifyDepth, arginfo_tls_client_encryption_with_verify_depth, ZEND_ACC_PUBLIC)
 	ZEND_ME(TlsClientEncryption, withPeerName, arginfo_tls_client_encryption_with_peer_name, ZEND_ACC_PUBLIC)
+	ZEND_ME(TlsClientEncryption, withKernelTls, arginfo_tls_client_encryption_with_kernel_tls, ZEND_ACC_PUBLIC)
+	ZEND_ME(TlsClientEncryption, withAlpnProtocols, arginfo_tls_client_encryption_with_alpn_protocols, ZEND_ACC_PUBLIC)
 	ZEND_FE_END
 };
 
@@ -678,22 +1646,91 @@ static zend_object *async_tls_server_encryption_object_create(zend_class_entry *
 	return &encryption->std;
 }
 
+static void copy_cert(async_tls_cert *to, async_tls_cert *from)
+{
+	if (from->host != NULL) {
+		to->host = zend_string_copy(from->host);
+	}
+
+	if (from->file != NULL) {
+		to->file = zend_string_copy(from->file);
+	}
+
+	if (from->key != NULL) {
+		to->key = zend_string_copy(from->key);
+	}
+
+	if (from->passphrase != NULL) {
+		to->passphrase = zend_string_copy(from->passphrase);
+	}
+}
+
+static void dispose_cert(async_tls_cert *cert)
+{
+	if (cert->host != NULL) {
+		zend_string_release(cert->host);
+		cert->host = NULL;
+	}
+
+	if (cert->file != NULL) {
+		zend_string_release(cert->file);
+		cert->file = NULL;
+	}
+
+	if (cert->key != NULL) {
+		zend_string_release(cert->key);
+		cert->key = NULL;
+	}
+
+	if (cert->passphrase != NULL) {
+		zend_string_release(cert->passphrase);
+		cert->passphrase = NULL;
+	}
+
+#ifdef HAVE_ASYNC_SSL
+	if (cert->ctx != NULL) {
+		SSL_CTX_free(cert->ctx);
+		cert->ctx = NULL;
+	}
+#endif
+}
+
 static async_tls_server_encryption *clone_server_encryption(async_tls_server_encryption *encryption)
 {
 	async_tls_server_encryption *result;
+	async_tls_cert *current;
+	async_tls_cert *cert;
 
 	result = (async_tls_server_encryption *) async_tls_server_encryption_object_create(async_tls_server_encryption_ce);
 
-	if (encryption->cert.file != NULL) {
-		result->cert.file = zend_string_copy(encryption->cert.file);
-	}
+	copy_cert(&result->cert, &encryption->cert);
+
+	current = encryption->certs.first;
+
+	while (current != NULL) {
+		cert = emalloc(sizeof(async_tls_cert));
+		ZEND_SECURE_ZERO(cert, sizeof(async_tls_cert));
+
+		copy_cert(cert, current);
+
+#ifdef HAVE_ASYNC_SSL
+		// Parsed SNI contexts are immutable and can be shared between encryption objects.
+		if (current->ctx != NULL) {
+			SSL_CTX_up_ref(current->ctx);
+			cert->ctx = current->ctx;
+		}
+#endif
+
+		ASYNC_Q_ENQUEUE(&result->certs, cert);
 
-	if (encryption->cert.key != NULL) {
-		result->cert.key = zend_string_copy(encryption->cert.key);
+		current = current->next;
 	}
+	
+	result->settings.kernel_tls = encryption->settings.kernel_tls;
+	result->settings.offload_handshake = encryption->settings.offload_handshake;
 
-	if (encryption->cert.passphrase != NULL) {
-		result->cert.passphrase = zend_string_copy(encryption->cert.passphrase);
+	if (encryption->settings.alpn != NULL) {
+		result->settings.alpn = zend_string_copy(encryption->settings.alpn);
 	}
 
 	return result;
@@ -702,26 +1739,22 @@ static async_tls_server_encryption *clone_server_encryption(async_tls_server_enc
 static void async_tls_server_encryption_object_destroy(zend_object *object)
 {
 	async_tls_server_encryption *encryption;
+	async_tls_cert *cert;
 
 	encryption = (async_tls_server_encryption *) object;
 
-	if (encryption->cert.file != NULL) {
-		zend_string_release(encryption->cert.file);
-	}
+	dispose_cert(&encryption->cert);
 
-	if (encryption->cert.key != NULL) {
-		zend_string_release(encryption->cert.key);
-	}
+	while (encryption->certs.first != NULL) {
+		ASYNC_Q_DEQUEUE(&encryption->certs, cert);
 
-	if (encryption->cert.passphrase != NULL) {
-		zend_string_release(encryption->cert.passphrase);
+		dispose_cert(cert);
+		efree(cert);
 	}
 
-#ifdef HAVE_ASYNC_SSL
-	if (encryption->cert.ctx != NULL) {
-		SSL_CTX_free(encryption->cert.ctx);
+	if (encryption->settings.alpn != NULL) {
+		zend_string_release(encryption->settings.alpn);
 	}
-#endif
 
 	zend_object_std_dtor(&encryption->std);
 }
@@ -747,6 +1780,8 @@ ZEND_METHOD(TlsServerEncryption, withDefaultCertificate)
 
 	encryption = clone_server_encryption((async_tls_server_encryption *) Z_OBJ_P(getThis()));
 
+	dispose_cert(&encryption->cert);
+
 	encryption->cert.file = zend_string_copy(file);
 	encryption->cert.key = zend_string_copy(key);
 
@@ -772,6 +1807,8 @@ ZEND_METHOD(TlsServerEncryption, withCertificate)
 
 	zval obj;
 
+	passphrase = NULL;
+
 	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 3, 4)
 		Z_PARAM_STR(host)
 		Z_PARAM_STR(file)
@@ -793,21 +1830,14 @@ ZEND_METHOD(TlsServerEncryption, withCertificate)
 		cert->passphrase = zend_string_copy(passphrase);
 	}
 
-#ifdef HAVE_ASYNC_SSL
-	cert->ctx = async_ssl_create_context();
-
-	SSL_CTX_set_default_passwd_cb(cert->ctx, ssl_cert_passphrase_cb);
-	SSL_CTX_set_default_passwd_cb_userdata(cert->ctx, cert);
-
-	SSL_CTX_use_certificate_file(cert->ctx, ZSTR_VAL(cert->file), SSL_FILETYPE_PEM);
-	SSL_CTX_use_PrivateKey_file(cert->ctx, ZSTR_VAL(cert->key), SSL_FILETYPE_PEM);
-#endif
-
 	current = encryption->certs.first;
 
 	while (current != NULL) {
 		if (zend_string_equals(current->host, cert->host)) {
 			ASYNC_Q_DETACH(&encryption->certs, current);
+			
+			dispose_cert(current);
+			efree(current);
 			break;
 		}
 
@@ -821,6 +1851,75 @@ ZEND_METHOD(TlsServerEncryption, withCertificate)
 	RETURN_ZVAL(&obj, 1, 1);
 }
 
+ZEND_METHOD(TlsServerEncryption, withKernelTls)
+{
+	async_tls_server_encryption *encryption;
+
+	zend_bool enable;
+	zval obj;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_BOOL(enable)
+	ZEND_PARSE_PARAMETERS_END();
+
+	encryption = clone_server_encryption((async_tls_server_encryption *) Z_OBJ_P(getThis()));
+	encryption->settings.kernel_tls = enable;
+
+	ZVAL_OBJ(&obj, &encryption->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(TlsServerEncryption, withHandshakeOffload)
+{
+	async_tls_server_encryption *encryption;
+
+	zend_bool enable;
+	zval obj;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_BOOL(enable)
+	ZEND_PARSE_PARAMETERS_END();
+
+	encryption = clone_server_encryption((async_tls_server_encryption *) Z_OBJ_P(getThis()));
+	encryption->settings.offload_handshake = enable;
+
+	ZVAL_OBJ(&obj, &encryption->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(TlsServerEncryption, withAlpnProtocols)
+{
+	async_tls_server_encryption *encryption;
+
+	zend_string *alpn;
+	HashTable *protocols;
+	zval obj;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_ARRAY_HT(protocols)
+	ZEND_PARSE_PARAMETERS_END();
+
+	alpn = encode_alpn_protocols(protocols);
+
+	if (UNEXPECTED(EG(exception))) {
+		return;
+	}
+
+	encryption = clone_server_encryption((async_tls_server_encryption *) Z_OBJ_P(getThis()));
+
+	if (encryption->settings.alpn != NULL) {
+		zend_string_release(encryption->settings.alpn);
+	}
+
+	encryption->settings.alpn = alpn;
+
+	ZVAL_OBJ(&obj, &encryption->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
 ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tls_server_encryption_with_default_certificate, 0, 2, Concurrent\\Network\\TlsServerEncryption, 0)
 	ZEND_ARG_TYPE_INFO(0, cert, IS_STRING, 0)
 	ZEND_ARG_TYPE_INFO(0, key, IS_STRING, 0)
@@ -834,9 +1933,24 @@ ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tls_server_encryption_with_certif
 	ZEND_ARG_TYPE_INFO(0, passphrase, IS_STRING, 1)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tls_server_encryption_with_kernel_tls, 0, 1, Concurrent\\Network\\TlsServerEncryption, 0)
+	ZEND_ARG_TYPE_INFO(0, enable, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tls_server_encryption_with_handshake_offload, 0, 1, Concurrent\\Network\\TlsServerEncryption, 0)
+	ZEND_ARG_TYPE_INFO(0, enable, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tls_server_encryption_with_alpn_protocols, 0, 1, Concurrent\\Network\\TlsServerEncryption, 0)
+	ZEND_ARG_TYPE_INFO(0, protocols, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
 static const zend_function_entry async_tls_server_encryption_functions[] = {
 	ZEND_ME(TlsServerEncryption, withDefaultCertificate, arginfo_tls_server_encryption_with_default_certificate, ZEND_ACC_PUBLIC)
 	ZEND_ME(TlsServerEncryption, withCertificate, arginfo_tls_server_encryption_with_certificate, ZEND_ACC_PUBLIC)
+	ZEND_ME(TlsServerEncryption, withKernelTls, arginfo_tls_server_encryption_with_kernel_tls, ZEND_ACC_PUBLIC)
+	ZEND_ME(TlsServerEncryption, withHandshakeOffload, arginfo_tls_server_encryption_with_handshake_offload, ZEND_ACC_PUBLIC)
+	ZEND_ME(TlsServerEncryption, withAlpnProtocols, arginfo_tls_server_encryption_with_alpn_protocols, ZEND_ACC_PUBLIC)
 	ZEND_FE_END
 };
 
@@ -865,5 +1979,25 @@ void async_ssl_ce_register()
 	
 #ifdef HAVE_ASYNC_SSL
 	async_index = SSL_get_ex_new_index(0, "async", NULL, NULL, NULL);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L && !defined (LIBRESSL_VERSION_NUMBER)
+	bio_method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "async");
+
+	BIO_meth_set_write(bio_method, bio_write);
+	BIO_meth_set_read(bio_method, bio_read);
+	BIO_meth_set_ctrl(bio_method, bio_ctrl);
+	BIO_meth_set_create(bio_method, bio_create);
+	BIO_meth_set_destroy(bio_method, bio_destroy);
+#endif
+#endif
+}
+
+void async_ssl_ce_unregister()
+{
+#if defined(HAVE_ASYNC_SSL) && OPENSSL_VERSION_NUMBER >= 0x10100000L && !defined (LIBRESSL_VERSION_NUMBER)
+	if (bio_method != NULL) {
+		BIO_meth_free(bio_method);
+		bio_method = NULL;
+	}
 #endif
 }
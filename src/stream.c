@@ -21,6 +21,10 @@
 #include "async_stream.h"
 #include "zend_inheritance.h"
 
+#ifdef ASYNC_TLS_KTLS
+#include <fcntl.h>
+#endif
+
 ASYNC_API zend_class_entry *async_duplex_stream_ce;
 ASYNC_API zend_class_entry *async_pending_read_exception_ce;
 ASYNC_API zend_class_entry *async_readable_stream_ce;
@@ -30,6 +34,17 @@ ASYNC_API zend_class_entry *async_writable_stream_ce;
 
 #define ASYNC_STREAM_SHOULD_READ(stream) (((stream)->buffer.size - (stream)->buffer.len) >= 4096)
 
+#ifdef ASYNC_TLS_KTLS
+#define ASYNC_STREAM_KTLS_PENDING(stream) ((stream)->ssl.ktls_send && (stream)->ssl.ctrl.len > 0)
+
+static void flush_ktls_control(async_stream *stream);
+static void close_ktls_poll(async_stream *stream);
+#else
+#define ASYNC_STREAM_KTLS_PENDING(stream) 0
+#endif
+
+static void timeout_read(async_timer_wheel_entry *entry);
+
 //////////////////////////////////////////////////////////
 // FIXME: Implement proper SSL shutdown!
 /*
@@ -93,12 +108,13 @@ async_stream *async_stream_init(uv_stream_t *handle, size_t bufsize)
 	stream->handle = handle;
 	handle->data = stream;
 	
-	uv_timer_init(handle->loop, &stream->timer);
+	// Read timeouts are scheduled on the timer wheel of the task scheduler that owns the loop of the handle.
+	stream->wheel = &((async_task_scheduler *) (((char *) handle->loop) - XtOffsetOf(async_task_scheduler, loop)))->wheel;
 	
-	stream->timer.data = stream;
+	stream->timer.func = timeout_read;
+	stream->timer.arg = stream;
 	
 	uv_unref((uv_handle_t *) handle);
-	uv_unref((uv_handle_t *) &stream->timer);
 	
 	return stream;
 }
@@ -119,9 +135,11 @@ void async_stream_close(async_stream *stream, uv_close_cb callback, void *data)
 	
 	async_stream_shutdown(stream, ASYNC_STREAM_SHUT_RD);
 	
-	if (!uv_is_closing((uv_handle_t *) &stream->timer)) {
-		uv_close((uv_handle_t *) &stream->timer, NULL);
-	}
+	async_timer_wheel_stop(stream->wheel, &stream->timer);
+	
+#ifdef ASYNC_TLS_KTLS
+	close_ktls_poll(stream);
+#endif
 	
 	stream->handle->data = data;
 	
@@ -210,6 +228,27 @@ static inline int is_ssl_continue_error(SSL *ssl, int code)
 	return 0;
 }
 
+static inline size_t ssl_output_len(async_stream *stream)
+{
+	size_t len;
+	
+	len = async_ring_buffer_write_len(&stream->buffer);
+	
+	if (stream->ssl.in_len == 0) {
+		return len;
+	}
+	
+	// Unconsumed encrypted bytes are located behind the write position, decrypted bytes must not reach them.
+	if (stream->ssl.in > stream->buffer.wpos) {
+		return MIN(len, (size_t) (stream->ssl.in - stream->buffer.wpos));
+	}
+	
+	// No space left in front of the encrypted bytes (records started in the stash), move them out of the way.
+	async_ssl_bio_release(&stream->ssl);
+	
+	return len;
+}
+
 static inline int process_input_bytes(async_stream *stream, int count)
 {
 	int len;
@@ -221,11 +260,15 @@ static inline int process_input_bytes(async_stream *stream, int count)
 		return SUCCESS;
 	}
 	
+	// Encrypted bytes are read by the SSL engine directly from the stream buffer.
 	if (count > 0) {
-		len = BIO_write(stream->ssl.rbio, stream->buffer.wpos, count);
+		async_ssl_bio_feed(&stream->ssl, stream->buffer.wpos, count);
 	}
 	
 	if (!SSL_is_init_finished(stream->ssl.ssl)) {
+		// Handshake bytes are consumed later on, they would be overwritten by the next read.
+		async_ssl_bio_release(&stream->ssl);
+	
 		return SUCCESS;
 	}
 	
@@ -235,11 +278,13 @@ static inline int process_input_bytes(async_stream *stream, int count)
 		do {
 			ERR_clear_error();
 			
-			len = SSL_read(stream->ssl.ssl, stream->buffer.wpos, async_ring_buffer_write_len(&stream->buffer));
+			len = SSL_read(stream->ssl.ssl, stream->buffer.wpos, ssl_output_len(stream));
 			code = SSL_get_error(stream->ssl.ssl, len);
 			
 			if (len < 1) {
 				if (!is_ssl_continue_error(stream->ssl.ssl, len)) {
+					async_ssl_bio_release(&stream->ssl);
+				
 					return ERR_get_error();
 				}
 				
@@ -259,6 +304,15 @@ static inline int process_input_bytes(async_stream *stream, int count)
 		stream->ssl.pending = 0;
 	}
 	
+#ifdef ASYNC_TLS_KTLS
+	// Reading may cause control records to be sent (alerts, key updates).
+	if (ASYNC_STREAM_KTLS_PENDING(stream)) {
+		flush_ktls_control(stream);
+	}
+#endif
+	
+	async_ssl_bio_release(&stream->ssl);
+	
 	return (stream->ssl.available > 0) ? SUCCESS : FAILURE;
 }
 
@@ -394,11 +448,11 @@ static void read_alloc_cb(uv_handle_t *handle, size_t suggested, uv_buf_t *buf)
 	buf->len = async_ring_buffer_write_len(&stream->buffer);
 }
 
-static void timeout_read(uv_timer_t *timer)
+static void timeout_read(async_timer_wheel_entry *entry)
 {
 	async_stream *stream;
 	
-	stream = (async_stream *) timer->data;
+	stream = (async_stream *) entry->arg;
 	
 	ZEND_ASSERT(stream != NULL);
 	
@@ -462,14 +516,12 @@ int async_stream_read(async_stream *stream, char *buf, size_t len, uint64_t time
 	stream->read.error = NULL;
 	
 	if (timeout > 0) {
-		uv_timer_start(&stream->timer, timeout_read, timeout, 0);
+		async_timer_wheel_start(stream->wheel, &stream->timer, timeout);
 	}
 	
 	code = await_op(stream, (async_op *) &stream->read);
 	
-	if (timeout > 0) {
-		uv_timer_stop(&stream->timer);
-	}
+	async_timer_wheel_stop(stream->wheel, &stream->timer);
 	
 	if (code == FAILURE) {
 		ASYNC_FORWARD_OP_ERROR(&stream->read);
@@ -544,14 +596,12 @@ int async_stream_read_string(async_stream *stream, zend_string **str, size_t len
 	stream->read.error = NULL;
 	
 	if (timeout > 0) {
-		uv_timer_start(&stream->timer, timeout_read, timeout, 0);
+		async_timer_wheel_start(stream->wheel, &stream->timer, timeout);
 	}
 
 	code = await_op(stream, (async_op *) &stream->read);
 	
-	if (timeout > 0) {
-		uv_timer_stop(&stream->timer);
-	}
+	async_timer_wheel_stop(stream->wheel, &stream->timer);
 
 	if (code == FAILURE) {
 		ASYNC_FORWARD_OP_ERROR(&stream->read);
@@ -612,15 +662,17 @@ static int try_write(async_stream *stream, char *buf, size_t len)
 static void write_cb(uv_write_t *req, int status)
 {
 	async_stream_write_op *op;
+	async_stream *stream;
 	
 	op = (async_stream_write_op *) req->data;
 	
 	ZEND_ASSERT(op != NULL);
 	
+	stream = op->stream;
 	op->code = status;
 	
 #ifdef HAVE_ASYNC_SSL
-	if (op->stream->ssl.ssl != NULL) {
+	if (op->stream->ssl.ssl != NULL && op->data != NULL) {
 		efree(op->data);
 	}
 #endif
@@ -637,6 +689,139 @@ static void write_cb(uv_write_t *req, int status)
 		ASYNC_DELREF(&op->context->std);
 		ASYNC_FREE_OP(op);
 	}
+	
+#ifdef ASYNC_TLS_KTLS
+	if (ASYNC_STREAM_KTLS_PENDING(stream) && stream->handle->write_queue_size == 0) {
+		flush_ktls_control(stream);
+	}
+#endif
+}
+
+#ifdef ASYNC_TLS_KTLS
+
+static void ktls_poll_closed(uv_handle_t *handle)
+{
+	efree(handle);
+}
+
+static void close_ktls_poll(async_stream *stream)
+{
+	uv_os_fd_t fd;
+	
+	if (stream->ktls_poll == NULL) {
+		return;
+	}
+	
+	uv_fileno((const uv_handle_t *) stream->ktls_poll, &fd);
+	
+	// Closing the poll handle removes the duplicated descriptor from the loop, it can be closed right away.
+	uv_close((uv_handle_t *) stream->ktls_poll, ktls_poll_closed);
+	close(fd);
+	
+	stream->ktls_poll = NULL;
+}
+
+static void ktls_writable(uv_poll_t *handle, int status, int events)
+{
+	uv_poll_stop(handle);
+	
+	flush_ktls_control((async_stream *) handle->data);
+}
+
+static int poll_ktls_writable(async_stream *stream)
+{
+	int code;
+	int fd;
+	
+	// The poll handle is only created once a control record could not be sent because the send buffer was full.
+	if (stream->ktls_poll == NULL) {
+		// A duplicated descriptor is polled to avoid interfering with the watcher of the stream.
+		if (0 > (fd = fcntl(stream->ssl.ktls_fd, F_DUPFD_CLOEXEC, 0))) {
+			return -errno;
+		}
+		
+		stream->ktls_poll = emalloc(sizeof(uv_poll_t));
+		
+		if (0 != (code = uv_poll_init(stream->handle->loop, stream->ktls_poll, fd))) {
+			close(fd);
+			efree(stream->ktls_poll);
+			
+			stream->ktls_poll = NULL;
+			
+			return code;
+		}
+		
+		stream->ktls_poll->data = stream;
+		
+		uv_unref((uv_handle_t *) stream->ktls_poll);
+	}
+	
+	return uv_poll_start(stream->ktls_poll, UV_WRITABLE, ktls_writable);
+}
+
+static void flush_ktls_control(async_stream *stream)
+{
+	async_stream_write_op *op;
+	async_op *next;
+	async_op *tmp;
+	
+	int code;
+	
+	if (stream->ssl.ctrl.len == 0 || (stream->flags & ASYNC_STREAM_CLOSED)) {
+		return;
+	}
+	
+	code = async_ssl_ktls_flush(&stream->ssl);
+	
+	if (code == UV_EAGAIN) {
+		// Retried by write_cb() if writes are queued, otherwise once the socket send buffer has room again.
+		if (stream->handle->write_queue_size > 0 || 0 == (code = poll_ktls_writable(stream))) {
+			return;
+		}
+	}
+	
+	if (code < 0) {
+		stream->ssl.ctrl.offset = 0;
+		stream->ssl.ctrl.len = 0;
+	}
+	
+	// Writes that have been deferred to preserve record order are passed to libuv (or failed) in order.
+	for (tmp = stream->writes.first; tmp != NULL; tmp = next) {
+		next = tmp->next;
+		op = (async_stream_write_op *) tmp;
+		
+		if (!op->deferred) {
+			continue;
+		}
+		
+		op->deferred = 0;
+		
+		if (code == 0) {
+			code = uv_write(&op->req, stream->handle, op->bufs, 1, write_cb);
+			
+			if (code == 0) {
+				continue;
+			}
+		}
+		
+		write_cb(&op->req, code);
+	}
+}
+
+#endif
+
+static inline int submit_write(async_stream *stream, async_stream_write_op *op)
+{
+#ifdef ASYNC_TLS_KTLS
+	// Plaintext must not overtake control records that are waiting to be encrypted by the kernel.
+	if (ASYNC_STREAM_KTLS_PENDING(stream)) {
+		op->deferred = 1;
+		
+		return 0;
+	}
+#endif
+
+	return uv_write(&op->req, stream->handle, op->bufs, 1, write_cb);
 }
 
 void async_stream_write(async_stream *stream, char *buf, size_t len)
@@ -657,18 +842,18 @@ void async_stream_write(async_stream *stream, char *buf, size_t len)
 	base = NULL;
 	
 #ifdef HAVE_ASYNC_SSL
-	if (stream->ssl.ssl != NULL) {
+	if (stream->ssl.ssl != NULL && !stream->ssl.ktls_send) {
 		int offset;
-		int blen;
-		
-		blen = 0;
 	
+		// Encrypted records are appended to the BIO output buffer and sent using a single write.
 		while (len > 0) {
 			ERR_clear_error();
 			offset = SSL_write(stream->ssl.ssl, buf, len);
 			
 			if (offset <= 0) {
-				efree(base);
+				if (NULL != (base = async_ssl_bio_take_output(&stream->ssl, &len))) {
+					efree(base);
+				}
 			
 				zend_throw_error(NULL, "SSL error: %d\n", (int) SSL_get_error(stream->ssl.ssl, offset));
 				return;
@@ -676,26 +861,14 @@ void async_stream_write(async_stream *stream, char *buf, size_t len)
 			
 			buf += offset;
 			len -= offset;
-			
-			while ((offset = BIO_ctrl_pending(stream->ssl.wbio)) > 0) {
-				if (base == NULL) {
-					base = emalloc(blen + offset);
-				} else {
-					erealloc(base, blen + offset);
-				}
-				
-				offset = BIO_read(stream->ssl.wbio, base + blen, offset);
-								
-				blen += offset;
-			}
 		}
 		
+		base = async_ssl_bio_take_output(&stream->ssl, &len);
 		buf = base;
-		len = blen;
 	}
 #endif
 
-	if (stream->writes.first == NULL) {
+	if (stream->writes.first == NULL && !ASYNC_STREAM_KTLS_PENDING(stream)) {
 		code = try_write(stream, buf, len);
 		
 		if (code < 0) {
@@ -727,7 +900,7 @@ void async_stream_write(async_stream *stream, char *buf, size_t len)
 	op->data = base;
 	op->req.data = op;
 
-	code = uv_write(&op->req, stream->handle, op->bufs, 1, write_cb);
+	code = submit_write(stream, op);
 	
 	if (code < 0) {
 		if (base != NULL) {
@@ -780,18 +953,18 @@ void async_stream_async_write_string(async_stream *stream, zend_string *str, asy
 	len = ZSTR_LEN(str);
 	
 #ifdef HAVE_ASYNC_SSL
-	if (stream->ssl.ssl != NULL) {
+	if (stream->ssl.ssl != NULL && !stream->ssl.ktls_send) {
 		int offset;
-		int blen;
-		
-		blen = 0;
 	
+		// Encrypted records are appended to the BIO output buffer and sent using a single write.
 		while (len > 0) {
 			ERR_clear_error();
 			offset = SSL_write(stream->ssl.ssl, buf, len);
 			
 			if (offset <= 0) {
-				efree(base);
+				if (NULL != (base = async_ssl_bio_take_output(&stream->ssl, &len))) {
+					efree(base);
+				}
 			
 				zend_throw_error(NULL, "SSL error: %d\n", (int) SSL_get_error(stream->ssl.ssl, offset));
 				return;
@@ -799,26 +972,14 @@ void async_stream_async_write_string(async_stream *stream, zend_string *str, asy
 			
 			buf += offset;
 			len -= offset;
-			
-			while ((offset = BIO_ctrl_pending(stream->ssl.wbio)) > 0) {
-				if (base == NULL) {
-					base = emalloc(blen + offset);
-				} else {
-					erealloc(base, blen + offset);
-				}
-				
-				offset = BIO_read(stream->ssl.wbio, base + blen, offset);
-								
-				blen += offset;
-			}
 		}
 		
+		base = async_ssl_bio_take_output(&stream->ssl, &len);
 		buf = base;
-		len = blen;
 	}
 #endif
 	
-	if (stream->writes.first == NULL) {
+	if (stream->writes.first == NULL && !ASYNC_STREAM_KTLS_PENDING(stream)) {
 		code = try_write(stream, buf, len);
 		
 		if (code < 0) {
@@ -852,7 +1013,7 @@ void async_stream_async_write_string(async_stream *stream, zend_string *str, asy
 	op->data = base;
 	op->req.data = op;
 
-	code = uv_write(&op->req, stream->handle, op->bufs, 1, write_cb);
+	code = submit_write(stream, op);
 	
 	if (code < 0) {
 		if (base != NULL) {
@@ -870,7 +1031,7 @@ void async_stream_async_write_string(async_stream *stream, zend_string *str, asy
 	op->arg = arg;
 	
 #ifdef HAVE_ASYNC_SSL
-	if (stream->ssl.ssl == NULL) {
+	if (base == NULL) {
 		op->str = zend_string_copy(str);
 	}
 #else
@@ -990,11 +1151,7 @@ static int send_handshake_bytes(async_stream *stream, async_ssl_handshake_data *
 	size_t len;
 	int code;
 
-	while ((len = BIO_ctrl_pending(stream->ssl.wbio)) > 0) {
-		// TODO: Avoid memory alloc & copy by using BIO_get_mem_data()
-		base = emalloc(len);
-		len = BIO_read(stream->ssl.wbio, base, len);
-		
+	while (NULL != (base = async_ssl_bio_take_output(&stream->ssl, &len))) {
 		bufs[0] = uv_buf_init(base, len);
 		
 		while (bufs[0].len > 0) {
@@ -1056,6 +1213,62 @@ static int send_handshake_bytes(async_stream *stream, async_ssl_handshake_data *
 	return SUCCESS;
 }
 
+static int do_handshake(async_stream *stream, async_ssl_handshake_data *data)
+{
+	int code;
+
+#ifdef ASYNC_TLS_OFFLOAD
+	async_ssl_offload_op *op;
+	
+	if (data->settings->mode == ASYNC_SSL_MODE_SERVER && data->settings->offload_handshake) {
+		ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_ssl_offload_op));
+		
+		code = async_ssl_offload_handshake(stream->handle->loop, &stream->ssl, op, data->ref);
+		
+		if (code < 0) {
+			ASYNC_FREE_OP(op);
+			data->uv_error = code;
+			
+			return FAILURE;
+		}
+		
+		// A cancelled operation is disposed as soon as the worker has finished.
+		if (await_op(stream, (async_op *) op) == FAILURE) {
+			return FAILURE;
+		}
+		
+		code = op->error;
+		data->ssl_error = op->ssl_error;
+		
+		ASYNC_FREE_OP(op);
+		
+		switch (code) {
+		case SSL_ERROR_NONE:
+		case SSL_ERROR_WANT_READ:
+		case SSL_ERROR_WANT_WRITE:
+		case SSL_ERROR_ZERO_RETURN:
+			data->ssl_error = SSL_ERROR_NONE;
+		
+			return SUCCESS;
+		}
+		
+		return FAILURE;
+	}
+#endif
+
+	ERR_clear_error();
+	
+	code = SSL_do_handshake(stream->ssl.ssl);
+	
+	if (!is_ssl_continue_error(stream->ssl.ssl, code)) {
+		data->ssl_error = ERR_get_error();
+		
+		return FAILURE;
+	}
+	
+	return SUCCESS;
+}
+
 int async_stream_ssl_handshake(async_stream *stream, async_ssl_handshake_data *data)
 {
 	X509 *cert;
@@ -1066,6 +1279,12 @@ int async_stream_ssl_handshake(async_stream *stream, async_ssl_handshake_data *d
 	ZEND_ASSERT(stream->ssl.ssl != NULL);
 	ZEND_ASSERT(data->settings != NULL);
 	
+#ifdef ASYNC_TLS_KTLS
+	if (data->settings->kernel_tls) {
+		async_ssl_enable_ktls(&stream->ssl, stream->handle);
+	}
+#endif
+	
 	if (data->settings->mode == ASYNC_SSL_MODE_SERVER) {
 		SSL_set_accept_state(stream->ssl.ssl);
 	} else {
@@ -1078,6 +1297,12 @@ int async_stream_ssl_handshake(async_stream *stream, async_ssl_handshake_data *d
 			SSL_set_tlsext_host_name(stream->ssl.ssl, ZSTR_VAL(data->host));
 		}
 #endif
+
+#ifdef ASYNC_TLS_ALPN
+		if (data->settings->alpn != NULL) {
+			SSL_set_alpn_protos(stream->ssl.ssl, (const unsigned char *) ZSTR_VAL(data->settings->alpn), (unsigned int) ZSTR_LEN(data->settings->alpn));
+		}
+#endif
 		
 		ERR_clear_error();
 		
@@ -1109,13 +1334,7 @@ int async_stream_ssl_handshake(async_stream *stream, async_ssl_handshake_data *d
 			return FAILURE;
 		}
 		
-		ERR_clear_error();
-		
-		code = SSL_do_handshake(stream->ssl.ssl);
-		
-		if (!is_ssl_continue_error(stream->ssl.ssl, code)) {
-			data->ssl_error = ERR_get_error();
-			
+		if (SUCCESS != do_handshake(stream, data)) {
 			return FAILURE;
 		}
 	}
@@ -1164,6 +1383,65 @@ int async_stream_ssl_handshake(async_stream *stream, async_ssl_handshake_data *d
 	return SUCCESS;
 }
 
+#ifndef PHP_WIN32
+
+int async_stream_ssl_poll(async_stream *stream)
+{
+	uv_os_fd_t fd;
+	ssize_t len;
+	int code;
+	
+	ZEND_ASSERT(stream->ssl.ssl != NULL);
+	
+	// Input bytes are received by libuv while the stream is being read.
+	if (stream->flags & ASYNC_STREAM_READING) {
+		return SUCCESS;
+	}
+	
+	if (0 != uv_fileno((const uv_handle_t *) stream->handle, &fd)) {
+		return FAILURE;
+	}
+	
+	if (stream->buffer.base == NULL) {
+		init_buffer(stream);
+	}
+	
+	while (1) {
+		len = (ssize_t) ssl_output_len(stream);
+		
+		if (len == 0) {
+			return FAILURE;
+		}
+		
+		do {
+			len = recv(fd, stream->buffer.wpos, (size_t) len, MSG_DONTWAIT);
+		} while (len < 0 && errno == EINTR);
+		
+		if (len < 0) {
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ? SUCCESS : FAILURE;
+		}
+		
+		if (len == 0) {
+			stream->flags |= ASYNC_STREAM_EOF;
+			
+			return FAILURE;
+		}
+		
+		code = process_input_bytes(stream, (int) len);
+		
+		// Only records that do not carry application data (session tickets, key updates) are acceptable.
+		if (code != FAILURE || stream->buffer.len > 0 || stream->ssl.pending > 0) {
+			return FAILURE;
+		}
+		
+		if (SSL_get_shutdown(stream->ssl.ssl) & SSL_RECEIVED_SHUTDOWN) {
+			return FAILURE;
+		}
+	}
+}
+
+#endif
+
 #endif
 
 
@@ -263,6 +263,10 @@ static async_task_scheduler *async_task_scheduler_object_create()
 	uv_timer_init(&scheduler->loop, &scheduler->busy);
 	uv_timer_start(&scheduler->busy, busy_timer, 3600 * 1000, 3600 * 1000);	
 	uv_unref((uv_handle_t *) &scheduler->busy);
+	
+	async_timer_wheel_init(&scheduler->wheel, &scheduler->loop);
+	
+	zend_hash_init(&scheduler->dns, 0, NULL, NULL, 0);
 
 	scheduler->idle.data = scheduler;
 	
@@ -307,8 +311,12 @@ static void async_task_scheduler_object_destroy(zend_object *object)
 	uv_close((uv_handle_t *) &scheduler->busy, NULL);
 	uv_close((uv_handle_t *) &scheduler->idle, NULL);
 	
+	async_timer_wheel_close(&scheduler->wheel);
+	
 	// Run loop again to cleanup idle watcher.
 	uv_run(&scheduler->loop, UV_RUN_DEFAULT);
+	
+	zend_hash_destroy(&scheduler->dns);
 
 	ZEND_ASSERT(!uv_loop_alive(&scheduler->loop));
 	ZEND_ASSERT(debug_handles(&scheduler->loop) == 0);
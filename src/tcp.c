@@ -24,22 +24,58 @@
 
 #ifdef ZEND_WIN32
 #include "win32/sockets.h"
+#else
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#endif
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define ASYNC_TCP_ZEROCOPY 1
+#include <fcntl.h>
+#include <linux/errqueue.h>
 #endif
 
 #define ASYNC_SOCKET_TCP_NODELAY 100
 #define ASYNC_SOCKET_TCP_KEEPALIVE 101
+#define ASYNC_SOCKET_TCP_SNDBUF 102
+#define ASYNC_SOCKET_TCP_RCVBUF 103
+#define ASYNC_SOCKET_TCP_QUICKACK 104
+#define ASYNC_SOCKET_TCP_NOTSENT_LOWAT 105
+#define ASYNC_SOCKET_TCP_USER_TIMEOUT 106
+#define ASYNC_SOCKET_TCP_BUSY_POLL 107
+#define ASYNC_SOCKET_TCP_LINGER 108
+#define ASYNC_SOCKET_TCP_TOS 109
+#define ASYNC_SOCKET_TCP_ZEROCOPY 110
+#define ASYNC_SOCKET_TCP_READ_TIMEOUT 111
+#define ASYNC_SOCKET_TCP_WRITE_TIMEOUT 112
+#define ASYNC_SOCKET_TCP_IDLE_TIMEOUT 113
 #define ASYNC_SOCKET_TCP_SIMULTANEOUS_ACCEPTS 150
 
+#ifdef ASYNC_TCP_ZEROCOPY
+/* Maximum time (in milliseconds) a closed socket waits for zero-copy completion notifications. */
+#define ASYNC_TCP_ZEROCOPY_LINGER 5000
+#endif
+
+ASYNC_API zend_class_entry *async_listen_options_ce;
 ASYNC_API zend_class_entry *async_tcp_socket_ce;
 ASYNC_API zend_class_entry *async_tcp_socket_reader_ce;
 ASYNC_API zend_class_entry *async_tcp_socket_writer_ce;
 ASYNC_API zend_class_entry *async_tcp_server_ce;
 
+static zend_object_handlers async_listen_options_handlers;
 static zend_object_handlers async_tcp_socket_handlers;
-static zend_object_handlers async_tcp_socket_reader_handlers;
-static zend_object_handlers async_tcp_socket_writer_handlers;
 static zend_object_handlers async_tcp_server_handlers;
 
+#ifdef HAVE_ASYNC_SSL
+typedef struct {
+	/* Number of servers and sockets referencing the settings. */
+	uint32_t refcount;
+	
+	/* Settings being used by SSL callbacks of accepted connections, they are never modified after creation. */
+	async_ssl_settings settings;
+} async_tcp_server_settings;
+#endif
+
 typedef struct {
 	/* PHP object handle. */
 	zend_object std;
@@ -57,30 +93,88 @@ typedef struct {
 	uint16_t port;
 
 	/* Number of pending connection attempts queued in the backlog. */
-	zend_uchar pending;
+	uint32_t pending;
 
 	/* Error being used to close the server. */
 	zval error;
 	
 	/* Number of referenced accept operations. */
-	zend_uchar ref_count;
+	uint32_t ref_count;
 
 	/* Queue of tasks waiting to accept a socket connection. */
 	async_op_queue accepts;
 	
+	/* Resolved batch accept operation that takes further connections until the task is continued. */
+	void *batch;
+	
+	/* Number of accepted sockets that have not been closed yet. */
+	uint32_t connections;
+	
+	/* Maximum number of concurrently accepted sockets (0 = unlimited). */
+	uint32_t max_connections;
+	
+	/* Accepting is resumed after the number of open connections drops below this value. */
+	uint32_t low_watermark;
+	
+	/* Is set while connections are not accepted due to the connection limit. */
+	zend_bool paused;
+	
+	/* Total number of accepted connections. */
+	zend_ulong accepted;
+	
 	async_cancel_cb cancel;
 
 #ifdef HAVE_ASYNC_SSL
 	/* TLS server encryption settings. */
 	async_tls_server_encryption *encryption;
 	
-	async_ssl_settings settings;
+	/* Shared settings, replaced (not modified) when encryption is updated. */
+	async_tcp_server_settings *settings;
 
 	/* Server SSL context (shared between all socket connections). */
 	SSL_CTX *ctx;
 #endif
 } async_tcp_server;
 
+#define ASYNC_TCP_BROADCAST_BATCH 16
+
+typedef struct {
+	/* Write request being used to send all buffers of the batch. */
+	uv_write_t req;
+	
+	/* Socket the batch is written to. */
+	void *socket;
+	
+	/* Number of buffers and queued bytes. */
+	int count;
+	size_t size;
+	
+	uv_buf_t bufs[ASYNC_TCP_BROADCAST_BATCH];
+	
+	/* Broadcasted strings (shared by all sockets) that are referenced by the buffers. */
+	zend_string *strs[ASYNC_TCP_BROADCAST_BATCH];
+} async_tcp_broadcast_batch;
+
+#ifdef ASYNC_TCP_ZEROCOPY
+typedef struct _async_tcp_zerocopy_buffer async_tcp_zerocopy_buffer;
+
+struct _async_tcp_zerocopy_buffer {
+	/* String being referenced by the kernel until the send operation has completed. */
+	zend_string *str;
+	
+	/* Number of completed zero-copy sends that is needed to release the string. */
+	uint32_t target;
+	
+	async_tcp_zerocopy_buffer *next;
+};
+
+typedef struct {
+	async_op base;
+	uint32_t target;
+	int code;
+} async_tcp_zerocopy_op;
+#endif
+
 typedef struct {
 	/* PHP object handle. */
 	zend_object std;
@@ -112,32 +206,91 @@ typedef struct {
 
 	/* Error being used to close the write stream. */
 	zval write_error;
+	
+	/* Broadcast data that is collected while a broadcast write is in progress. */
+	async_tcp_broadcast_batch *broadcast;
+	
+	/* Number of broadcast writes that have not completed yet. */
+	uint32_t broadcasts;
+	
+	/* Timeouts (in milliseconds) being applied to reads, writes and inactivity (0 = disabled). */
+	uint64_t read_timeout;
+	uint64_t write_timeout;
+	uint64_t idle_timeout;
+	
+	/* Number of write calls that are waiting for their data to be written (using the write timer). */
+	uint32_t writing;
+	
+	/* Timer wheel entries being used to enforce timeouts. */
+	async_timer_wheel_entry read_timer;
+	async_timer_wheel_entry write_timer;
+	async_timer_wheel_entry idle_timer;
+
+#ifdef ASYNC_TCP_ZEROCOPY
+	/* Minimum size of a write that is sent using MSG_ZEROCOPY (0 = disabled). */
+	size_t zerocopy;
+	
+	/* Poll handle (using a duplicated descriptor) that receives completion notifications from the error queue. */
+	uv_poll_t *zc_poll;
+	uv_os_fd_t zc_fd;
+	
+	/* Is set while a closed socket waits for pending zero-copy sends to complete. */
+	zend_bool zc_linger;
+	async_timer_wheel_entry zc_timer;
+	
+	/* Number of referenced wait operations. */
+	uint32_t zc_refs;
+	
+	/* Number of zero-copy sends that have been started / completed. */
+	uint32_t zc_sent;
+	uint32_t zc_completed;
+	
+	/* Buffers that must be kept alive until the kernel reports completion. */
+	async_tcp_zerocopy_buffer *zc_first;
+	async_tcp_zerocopy_buffer *zc_last;
+	
+	/* Queue of tasks waiting for zero-copy sends to complete. */
+	async_op_queue zc_waiters;
+#endif
 
 #ifdef HAVE_ASYNC_SSL
 	/* TLS client encryption settings. */
 	async_tls_client_encryption *encryption;
+	
+	/* Server settings referenced by the SSL engine of an accepted connection. */
+	async_tcp_server_settings *server_settings;
 #endif
 } async_tcp_socket;
 
 typedef struct {
 	/* PHP object handle. */
 	zend_object std;
+	
+	/* Maximum length of the queue of pending connections. */
+	int backlog;
+	
+	/* Allow multiple sockets (processes) to bind to the same port (SO_REUSEPORT). */
+	zend_bool reuse_port;
+	
+	/* Number of seconds to wait for data before a connection is accepted (TCP_DEFER_ACCEPT). */
+	int defer_accept;
+	
+	/* Maximum length of the TCP fast open queue (TCP_FASTOPEN). */
+	int fast_open;
+	
+	/* Disables dual-stack mode of IPv6 sockets. */
+	zend_bool ipv6_only;
+	
+	/* Connection limits being applied to the server (0 = unlimited). */
+	uint32_t max_connections;
+	uint32_t low_watermark;
+} async_listen_options;
 
-	/* Socket being used to delegate reads. */
-	async_tcp_socket *socket;
-} async_tcp_socket_reader;
-
-typedef struct {
-	/* PHP object handle. */
-	zend_object std;
-
-	/* Socket being used to delegate writes. */
-	async_tcp_socket *socket;
-} async_tcp_socket_writer;
+#define ASYNC_TCP_DEFAULT_BACKLOG 128
 
 static async_tcp_socket *async_tcp_socket_object_create();
-static async_tcp_socket_reader *async_tcp_socket_reader_object_create(async_tcp_socket *socket);
-static async_tcp_socket_writer *async_tcp_socket_writer_object_create(async_tcp_socket *socket);
+
+static void release_connection(async_tcp_server *server);
 
 #define ASYNC_TCP_SOCKET_CONST(name, value) \
 	zend_declare_class_constant_long(async_tcp_socket_ce, name, sizeof(name)-1, (zend_long)value);
@@ -145,6 +298,82 @@ static async_tcp_socket_writer *async_tcp_socket_writer_object_create(async_tcp_
 #define ASYNC_TCP_SERVER_CONST(name, value) \
 	zend_declare_class_constant_long(async_tcp_server_ce, name, sizeof(name)-1, (zend_long)value);
 
+/* Delay between staggered connection attempts (RFC 8305 "Connection Attempt Delay"). */
+#define ASYNC_TCP_CONNECT_DELAY 250
+
+#define ASYNC_TCP_CONNECT_MAX_ATTEMPTS (ASYNC_DNS_MAX_ADDRESSES * 2)
+
+typedef struct _async_tcp_connect_op async_tcp_connect_op;
+
+typedef struct {
+	/* Socket handle of the attempt (unused if the target handle is connected directly). */
+	uv_tcp_t handle;
+	
+	/* Handle being connected. */
+	uv_tcp_t *tcp;
+	
+	uv_connect_t req;
+	
+	/* Connect operation and index of the attempt. */
+	async_tcp_connect_op *op;
+	int index;
+	
+	/* Is set while the connect request has not completed. */
+	zend_bool pending;
+} async_tcp_connect_attempt;
+
+struct _async_tcp_connect_op {
+	/* Async operation structure, must be first element to allow for casting to async_op. */
+	async_op base;
+	
+	/* Handle that receives the winning connection. */
+	uv_tcp_t *target;
+	
+	/* Resolved addresses in the order of connection attempts. */
+	struct sockaddr_storage addresses[ASYNC_TCP_CONNECT_MAX_ATTEMPTS];
+	int count;
+	int next;
+	
+	async_tcp_connect_attempt *attempts[ASYNC_TCP_CONNECT_MAX_ATTEMPTS];
+	async_tcp_connect_attempt *winner;
+	
+	/* Number of pending connection attempts. */
+	int pending;
+	
+	/* Result of the operation (error of the last failed attempt if no attempt succeeded). */
+	int code;
+	
+	/* Is set if multiple attempts are raced using separate sockets. */
+	zend_bool race;
+	
+	zend_bool background;
+	zend_bool done;
+	
+	/* Timers being used to start the next attempt and to enforce the connect timeout. */
+	uv_timer_t delay;
+	uv_timer_t timeout;
+	
+	/* Number of references held by the awaiting task, timers and attempts. */
+	int refs;
+};
+
+typedef struct {
+	/* Async operation structure, must be first element to allow for casting to async_op. */
+	async_op base;
+	
+	/* Error code as reported by libuv. */
+	int code;
+	
+	/* Maximum number of connections accepted by the operation. */
+	uint32_t max;
+	
+	/* Number of sockets that have been accepted. */
+	uint32_t count;
+	
+	/* Sockets that have been accepted by the connection callback. */
+	async_tcp_socket **sockets;
+} async_tcp_accept_op;
+
 typedef struct {
 	uv_write_t request;
 	async_tcp_socket *socket;
@@ -197,201 +426,289 @@ static void socket_disposed(uv_handle_t *handle)
 	
 	ZEND_ASSERT(socket != NULL);
 	
+	if (socket->server != NULL) {
+		release_connection(socket->server);
+	}
+	
 	ASYNC_DELREF(&socket->std);
 }
 
-static void shutdown_socket(void *arg, zval *error)
+static void free_broadcast_batch(async_tcp_broadcast_batch *batch)
+{
+	int i;
+	
+	for (i = 0; i < batch->count; i++) {
+		zend_string_release(batch->strs[i]);
+	}
+	
+	efree(batch);
+}
+
+#ifdef ASYNC_TCP_ZEROCOPY
+
+static inline int zerocopy_done(async_tcp_socket *socket, uint32_t target)
+{
+	return ((int32_t) (socket->zc_completed - target)) >= 0;
+}
+
+static void zerocopy_poll_closed(uv_handle_t *handle)
 {
 	async_tcp_socket *socket;
+	async_tcp_zerocopy_buffer *buf;
 	
-	socket = (async_tcp_socket *) arg;
+	socket = (async_tcp_socket *) handle->data;
 	
 	ZEND_ASSERT(socket != NULL);
 	
-	socket->cancel.func = NULL;
+	close(socket->zc_fd);
 	
-	if (error != NULL) {
-		if (Z_TYPE_P(&socket->read_error) == IS_UNDEF) {
-			ZVAL_COPY(&socket->read_error, error);
-		}
+	// Buffers can only be left if the connection has been reset, the kernel does not send them anymore.
+	while (socket->zc_first != NULL) {
+		buf = socket->zc_first;
+		socket->zc_first = buf->next;
 		
-		if (Z_TYPE_P(&socket->write_error) == IS_UNDEF) {
-			ZVAL_COPY(&socket->write_error, error);
-		}
+		zend_string_release(buf->str);
+		efree(buf);
 	}
 	
-	if (socket->stream == NULL) {
-		if (!uv_is_closing((uv_handle_t *) &socket->handle)) {
-			ASYNC_ADDREF(&socket->std);
-			
-			socket->handle.data = socket;
-			
-			uv_close((uv_handle_t *) &socket->handle, socket_disposed);
-		}
-	} else if (!(socket->stream->flags & ASYNC_STREAM_CLOSED)) {
-		ASYNC_ADDREF(&socket->std);
+	socket->zc_last = NULL;
+	socket->zc_poll = NULL;
+	
+	efree(handle);
+	
+	ASYNC_DELREF(&socket->std);
+}
+
+static void close_zerocopy_poll(async_tcp_socket *socket)
+{
+	if (socket->zc_linger) {
+		socket->zc_linger = 0;
 		
-		async_stream_close(socket->stream, socket_disposed, socket);
+		async_timer_wheel_stop(&socket->scheduler->wheel, &socket->zc_timer);
+	} else {
+		ASYNC_ADDREF(&socket->std);
 	}
+	
+	// The reference held while waiting for completions is transferred to the close callback.
+	uv_close((uv_handle_t *) socket->zc_poll, zerocopy_poll_closed);
 }
 
-
-static async_tcp_socket *async_tcp_socket_object_create()
+static void timeout_zerocopy(async_timer_wheel_entry *entry)
 {
 	async_tcp_socket *socket;
-
-	socket = emalloc(sizeof(async_tcp_socket));
-	ZEND_SECURE_ZERO(socket, sizeof(async_tcp_socket));
-
-	zend_object_std_init(&socket->std, async_tcp_socket_ce);
-	socket->std.handlers = &async_tcp_socket_handlers;
 	
-	socket->scheduler = async_task_scheduler_get();
+	struct linger l;
 	
-	ASYNC_ADDREF(&socket->scheduler->std);
+	socket = (async_tcp_socket *) entry->arg;
 	
-	socket->cancel.object = socket;
-	socket->cancel.func = shutdown_socket;
+	// Reset the connection, the kernel discards all queued data instead of sending it from the buffers.
+	l.l_onoff = 1;
+	l.l_linger = 0;
 	
-	ASYNC_Q_ENQUEUE(&socket->scheduler->shutdown, &socket->cancel);
-
-	uv_tcp_init(&socket->scheduler->loop, &socket->handle);
-
-	socket->stream = async_stream_init((uv_stream_t *) &socket->handle, 0);
-
-	return socket;
+	setsockopt(socket->zc_fd, SOL_SOCKET, SO_LINGER, &l, sizeof(struct linger));
+	
+	close_zerocopy_poll(socket);
 }
 
-static void async_tcp_socket_object_dtor(zend_object *object)
+static void process_zerocopy_completions(uv_poll_t *handle, int status, int events)
 {
 	async_tcp_socket *socket;
-
-	socket = (async_tcp_socket *) object;
+	async_tcp_zerocopy_buffer *buf;
+	async_tcp_zerocopy_op *op;
+	async_op *next;
+	async_op *tmp;
 	
-	if (socket->cancel.func != NULL) {
-		ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
+	struct sock_extended_err *err;
+	struct cmsghdr *cm;
+	struct msghdr msg;
+	char control[128];
+	
+	socket = (async_tcp_socket *) handle->data;
+	
+	ZEND_ASSERT(socket != NULL);
+	
+	// Drain the error queue, each notification covers an inclusive range of send sequence numbers.
+	while (1) {
+		ZEND_SECURE_ZERO(&msg, sizeof(struct msghdr));
 		
-		socket->cancel.func(socket, NULL);
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		
+		if (recvmsg(socket->zc_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			
+			break;
+		}
+		
+		for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+				continue;
+			}
+			
+			err = (struct sock_extended_err *) CMSG_DATA(cm);
+			
+			if (err->ee_errno == 0 && err->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+				socket->zc_completed += err->ee_data - err->ee_info + 1;
+			}
+		}
 	}
-}
-
-static void async_tcp_socket_object_destroy(zend_object *object)
-{
-	async_tcp_socket *socket;
 	
-	socket = (async_tcp_socket *) object;
-
-#ifdef HAVE_ASYNC_SSL
-	if (socket->stream->ssl.ssl != NULL) {
-		async_ssl_dispose_engine(&socket->stream->ssl, (socket->server == NULL) ? 1 : 0);
+	while (socket->zc_first != NULL && zerocopy_done(socket, socket->zc_first->target)) {
+		buf = socket->zc_first;
+		socket->zc_first = buf->next;
+		
+		zend_string_release(buf->str);
+		efree(buf);
 	}
-
-	if (socket->encryption != NULL) {
-		ASYNC_DELREF(&socket->encryption->std);
+	
+	if (socket->zc_first == NULL) {
+		socket->zc_last = NULL;
+		
+		// All sends of a closed socket have completed, the descriptor can be closed now.
+		if (socket->zc_linger) {
+			close_zerocopy_poll(socket);
+			
+			return;
+		}
+		
+		uv_poll_stop(handle);
+	} else {
+		// POLLERR stops the poll handle, it has to be restarted as long as sends are pending.
+		uv_poll_start(handle, UV_PRIORITIZED, process_zerocopy_completions);
 	}
-#endif
-
-	if (socket->stream != NULL) {
-		async_stream_free(socket->stream);
+	
+	tmp = socket->zc_waiters.first;
+	
+	while (tmp != NULL) {
+		next = tmp->next;
+		op = (async_tcp_zerocopy_op *) tmp;
+		
+		if (zerocopy_done(socket, op->target)) {
+			ASYNC_FINISH_OP(op);
+		}
+		
+		tmp = next;
 	}
+}
 
-	if (socket->server != NULL) {
-		ASYNC_DELREF(&socket->server->std);
-	}
+static int enable_zerocopy(async_tcp_socket *socket, zend_long threshold)
+{
+	uv_os_fd_t fd;
+	int code;
+	int num;
 	
-	ASYNC_DELREF(&socket->scheduler->std);
-
-	zval_ptr_dtor(&socket->read_error);
-	zval_ptr_dtor(&socket->write_error);
-
-	if (socket->name != NULL) {
-		zend_string_release(socket->name);
+	if (threshold < 1) {
+		socket->zerocopy = 0;
+		
+		return 0;
 	}
 	
-	if (socket->local_addr != NULL) {
-		zend_string_release(socket->local_addr);
+	if (socket->cancel.func == NULL || socket->stream == NULL) {
+		return UV_EBADF;
 	}
 	
-	if (socket->remote_addr != NULL) {
-		zend_string_release(socket->remote_addr);
+	if (socket->zc_poll == NULL) {
+		if (0 != (code = uv_fileno((const uv_handle_t *) &socket->handle, &fd))) {
+			return code;
+		}
+		
+		num = 1;
+		
+		if (0 != setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &num, sizeof(int))) {
+			return -errno;
+		}
+		
+		// A duplicated descriptor is polled to avoid interfering with the watcher of the stream.
+		if (0 > (fd = fcntl(fd, F_DUPFD_CLOEXEC, 0))) {
+			return -errno;
+		}
+		
+		socket->zc_poll = emalloc(sizeof(uv_poll_t));
+		
+		if (0 != (code = uv_poll_init(&socket->scheduler->loop, socket->zc_poll, fd))) {
+			close(fd);
+			efree(socket->zc_poll);
+			
+			socket->zc_poll = NULL;
+			
+			return code;
+		}
+		
+		socket->zc_poll->data = socket;
+		socket->zc_fd = fd;
+		
+		uv_unref((uv_handle_t *) socket->zc_poll);
 	}
-
-	zend_object_std_dtor(&socket->std);
-}
-
-static void connect_cb(uv_connect_t *req, int status)
-{
-	async_uv_op *op;
-
-	op = (async_uv_op *) req->data;
-
-	ZEND_ASSERT(op != NULL);
 	
-	op->code = status;
+	socket->zerocopy = (size_t) threshold;
 	
-	ASYNC_FINISH_OP(op);
+	return 0;
 }
 
-ZEND_METHOD(TcpSocket, connect)
+static void close_zerocopy(async_tcp_socket *socket)
 {
-	async_tcp_socket *socket;
-	async_context *context;
-	async_uv_op *op;
+	async_tcp_zerocopy_op *op;
 	
-	zend_string *name;
-	zend_long port;
-
-	zval *tls;
-	zval obj;
-
-	uv_connect_t req;
-	struct sockaddr_in dest;
-	int code;
-
-	tls = NULL;
-
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 3)
-	    Z_PARAM_STR(name)
-		Z_PARAM_LONG(port)
-		Z_PARAM_OPTIONAL
-		Z_PARAM_ZVAL(tls)
-	ZEND_PARSE_PARAMETERS_END();
+	while (socket->zc_waiters.first != NULL) {
+		ASYNC_DEQUEUE_CUSTOM_OP(&socket->zc_waiters, op, async_tcp_zerocopy_op);
+		
+		op->code = UV_ECANCELED;
+		
+		ASYNC_FINISH_OP(op);
+	}
+	
+	if (socket->zc_poll == NULL || socket->zc_linger || uv_is_closing((uv_handle_t *) socket->zc_poll)) {
+		return;
+	}
 	
-	code = async_dns_lookup_ipv4(ZSTR_VAL(name), &dest, IPPROTO_TCP);
+	if (socket->zc_first == NULL) {
+		close_zerocopy_poll(socket);
+		
+		return;
+	}
 	
-	ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to assemble IP address: %s", uv_strerror(code));
-
-	dest.sin_port = htons(port);
-
-	socket = async_tcp_socket_object_create();
-	socket->name = zend_string_copy(name);
-
-	code = uv_tcp_connect(&req, &socket->handle, (const struct sockaddr *) &dest, connect_cb);
+	// Sent buffers are in use until the kernel reports completion, the socket is kept alive (and open) until then.
+	ASYNC_ADDREF(&socket->std);
+	
+	socket->zc_linger = 1;
+	
+	uv_ref((uv_handle_t *) socket->zc_poll);
+	
+	async_timer_wheel_start(&socket->scheduler->wheel, &socket->zc_timer, ASYNC_TCP_ZEROCOPY_LINGER);
+}
 
-	if (UNEXPECTED(code != 0)) {
-		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to intialize socket connect operation: %s", uv_strerror(code));
-		ASYNC_DELREF(&socket->std);
+static void await_zerocopy(async_tcp_socket *socket, uint32_t target)
+{
+	async_tcp_zerocopy_op *op;
+	async_context *context;
+	
+	int code;
+	
+	if (zerocopy_done(socket, target)) {
 		return;
 	}
 	
-	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_uv_op));
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_tcp_zerocopy_op));
 	
-	req.data = op;
+	op->target = target;
+	
+	ASYNC_ENQUEUE_OP(&socket->zc_waiters, op);
 	
 	context = async_context_get();
 	
-	if (!context->background && 1 == ++socket->stream->ref_count) {
-		uv_ref((uv_handle_t *) &socket->handle);
+	if (!context->background && ++socket->zc_refs == 1) {
+		uv_ref((uv_handle_t *) socket->zc_poll);
 	}
 	
 	code = async_await_op((async_op *) op);
 	
-	if (!context->background && 0 == --socket->stream->ref_count) {
-		uv_unref((uv_handle_t *) &socket->handle);
+	if (!context->background && --socket->zc_refs == 0 && socket->zc_poll != NULL && !socket->zc_linger) {
+		uv_unref((uv_handle_t *) socket->zc_poll);
 	}
 	
-	if (code == FAILURE) {
-		ASYNC_DELREF(&socket->std);
+	if (UNEXPECTED(code == FAILURE)) {
 		ASYNC_FORWARD_OP_ERROR(op);
 		ASYNC_FREE_OP(op);
 		
@@ -402,592 +719,793 @@ ZEND_METHOD(TcpSocket, connect)
 	
 	ASYNC_FREE_OP(op);
 	
-	if (code < 0) {
-		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to connect socket: %s", uv_strerror(code));
-		ASYNC_DELREF(&socket->std);
+	ASYNC_CHECK_EXCEPTION(code < 0, async_stream_exception_ce, "Write operation failed: %s", uv_strerror(code));
+}
+
+static void zerocopy_write(async_tcp_socket *socket, zend_string *data)
+{
+	async_tcp_zerocopy_buffer *buf;
+	
+	uv_os_fd_t fd;
+	uint32_t sends;
+	size_t offset;
+	ssize_t len;
+	int code;
+	
+	uv_fileno((const uv_handle_t *) &socket->handle, &fd);
+	
+	sends = 0;
+	offset = 0;
+	code = 0;
+	
+	while (offset < ZSTR_LEN(data)) {
+		len = send(fd, ZSTR_VAL(data) + offset, ZSTR_LEN(data) - offset, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
 		
-		return;
+		if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			
+			// Socket buffer or optmem limit reached, the remainder is written using a regular (copying) write.
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+				code = -errno;
+			}
+			
+			break;
+		}
+		
+		offset += (size_t) len;
+		sends++;
 	}
-
-	if (tls != NULL && Z_TYPE_P(tls) != IS_NULL) {
-#ifdef HAVE_ASYNC_SSL
-		socket->encryption = async_clone_client_encryption((async_tls_client_encryption *) Z_OBJ_P(tls));
-		socket->encryption->settings.mode = ASYNC_SSL_MODE_CLIENT;
-
-		if (socket->encryption->settings.peer_name == NULL) {
-			socket->encryption->settings.peer_name = zend_string_copy(socket->name);
+	
+	if (sends > 0) {
+		socket->zc_sent += sends;
+		
+		buf = emalloc(sizeof(async_tcp_zerocopy_buffer));
+		buf->str = zend_string_copy(data);
+		buf->target = socket->zc_sent;
+		buf->next = NULL;
+		
+		if (socket->zc_last == NULL) {
+			socket->zc_first = buf;
+		} else {
+			socket->zc_last->next = buf;
+		}
+		
+		socket->zc_last = buf;
+		
+		if (!uv_is_active((uv_handle_t *) socket->zc_poll)) {
+			uv_poll_start(socket->zc_poll, UV_PRIORITIZED, process_zerocopy_completions);
 		}
-#else
-		zend_throw_exception_ex(async_socket_exception_ce, 0, "Socket encryption requires async extension to be compiled with SSL support");
-		ASYNC_DELREF(&socket->std);
-		return;
-#endif
 	}
 	
-	assemble_peer(&socket->handle, 0, &socket->local_addr, &socket->local_port);
-	assemble_peer(&socket->handle, 1, &socket->remote_addr, &socket->remote_port);
-
-	ZVAL_OBJ(&obj, &socket->std);
-
-	RETURN_ZVAL(&obj, 1, 1);
+	ASYNC_CHECK_EXCEPTION(code < 0, async_stream_exception_ce, "Write operation failed: %s", uv_strerror(code));
+	
+	if (offset < ZSTR_LEN(data)) {
+		async_stream_write(socket->stream, ZSTR_VAL(data) + offset, ZSTR_LEN(data) - offset);
+		
+		if (UNEXPECTED(EG(exception))) {
+			return;
+		}
+	}
+	
+	if (sends > 0) {
+		await_zerocopy(socket, socket->zc_sent);
+	}
 }
 
-ZEND_METHOD(TcpSocket, pair)
+#endif
+
+static void shutdown_socket(void *arg, zval *error)
 {
 	async_tcp_socket *socket;
-
-	zval sockets[2];
-	int domain;
-	int i;
-
-	ZEND_PARSE_PARAMETERS_NONE();
-
-	if (!USED_RET()) {
-		return;
+	
+	socket = (async_tcp_socket *) arg;
+	
+	ZEND_ASSERT(socket != NULL);
+	
+	socket->cancel.func = NULL;
+	
+	if (socket->broadcast != NULL) {
+		free_broadcast_batch(socket->broadcast);
+		
+		socket->broadcast = NULL;
 	}
-
-#ifdef ZEND_WIN32
-	SOCKET tmp[2];
-	domain = AF_INET;
-#else
-	int tmp[2];
-	domain = AF_UNIX;
+	
+	async_timer_wheel_stop(&socket->scheduler->wheel, &socket->read_timer);
+	async_timer_wheel_stop(&socket->scheduler->wheel, &socket->write_timer);
+	async_timer_wheel_stop(&socket->scheduler->wheel, &socket->idle_timer);
+	
+#ifdef ASYNC_TCP_ZEROCOPY
+	close_zerocopy(socket);
 #endif
-
-	i = socketpair(domain, SOCK_STREAM, IPPROTO_IP, tmp);
 	
-	ASYNC_CHECK_EXCEPTION(i != 0, async_socket_exception_ce, "Failed to create socket pair");
-
-	array_init_size(return_value, 2);
-
-	for (i = 0; i < 2; i++) {
-		socket = async_tcp_socket_object_create();
-
-		uv_tcp_open(&socket->handle, (uv_os_sock_t) tmp[i]);
-
-		ZVAL_OBJ(&sockets[i], &socket->std);
-
-		zend_hash_index_update(Z_ARRVAL_P(return_value), i, &sockets[i]);
+	if (error != NULL) {
+		if (Z_TYPE_P(&socket->read_error) == IS_UNDEF) {
+			ZVAL_COPY(&socket->read_error, error);
+		}
 		
-		socket->local_addr = zend_string_init("127.0.0.1", sizeof("127.0.0.1")-1, 0);
-		socket->remote_addr = zend_string_init("127.0.0.1", sizeof("127.0.0.1")-1, 0);
+		if (Z_TYPE_P(&socket->write_error) == IS_UNDEF) {
+			ZVAL_COPY(&socket->write_error, error);
+		}
+	}
+	
+	if (socket->stream == NULL) {
+		if (!uv_is_closing((uv_handle_t *) &socket->handle)) {
+			ASYNC_ADDREF(&socket->std);
+			
+			socket->handle.data = socket;
+			
+			uv_close((uv_handle_t *) &socket->handle, socket_disposed);
+		}
+	} else if (!(socket->stream->flags & ASYNC_STREAM_CLOSED)) {
+		ASYNC_ADDREF(&socket->std);
+		
+		async_stream_close(socket->stream, socket_disposed, socket);
 	}
 }
 
-ZEND_METHOD(TcpSocket, close)
+static void timeout_read(async_timer_wheel_entry *entry)
 {
 	async_tcp_socket *socket;
-
-	zval error;
-	zval *val;
-
-	val = NULL;
-
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
-		Z_PARAM_OPTIONAL
-		Z_PARAM_ZVAL(val)
-	ZEND_PARSE_PARAMETERS_END();
 	
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	socket = (async_tcp_socket *) entry->arg;
 	
-	if (socket->cancel.func == NULL) {
-		return;
-	}
-
-	ASYNC_PREPARE_EXCEPTION(&error, async_stream_closed_exception_ce, "Socket has been closed");
-
-	if (val != NULL && Z_TYPE_P(val) != IS_NULL) {
-		zend_exception_set_previous(Z_OBJ_P(&error), Z_OBJ_P(val));
-		GC_ADDREF(Z_OBJ_P(val));
+	if (socket->stream->read.base.status == ASYNC_STATUS_RUNNING) {
+		socket->stream->read.code = UV_ETIMEDOUT;
+		
+		ASYNC_FINISH_OP(&socket->stream->read);
 	}
-
-	ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
-	
-	socket->cancel.func(socket, &error);
-
-	zval_ptr_dtor(&error);
 }
 
-ZEND_METHOD(TcpSocket, getAddress)
+static void timeout_write(async_timer_wheel_entry *entry)
 {
 	async_tcp_socket *socket;
-
-	ZEND_PARSE_PARAMETERS_NONE();
-
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
 	
-	RETURN_STR_COPY(socket->local_addr);
+	zval error;
+	
+	socket = (async_tcp_socket *) entry->arg;
+	
+	// Pending writes cannot be cancelled individually, the connection is considered to be dead.
+	if (socket->cancel.func != NULL) {
+		ASYNC_PREPARE_EXCEPTION(&error, async_stream_exception_ce, "Write operation timed out");
+		
+		ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
+		
+		socket->cancel.func(socket, &error);
+		
+		zval_ptr_dtor(&error);
+	}
 }
 
-ZEND_METHOD(TcpSocket, getPort)
+static void timeout_idle(async_timer_wheel_entry *entry)
 {
 	async_tcp_socket *socket;
-
-	ZEND_PARSE_PARAMETERS_NONE();
-
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
 	
-	RETURN_LONG(socket->local_port);
+	zval error;
+	
+	socket = (async_tcp_socket *) entry->arg;
+	
+	if (socket->cancel.func != NULL) {
+		ASYNC_PREPARE_EXCEPTION(&error, async_stream_closed_exception_ce, "Socket has been closed due to inactivity");
+		
+		ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
+		
+		socket->cancel.func(socket, &error);
+		
+		zval_ptr_dtor(&error);
+	}
 }
 
-ZEND_METHOD(TcpSocket, getRemoteAddress)
+static inline void touch_socket(async_tcp_socket *socket)
 {
-	async_tcp_socket *socket;
-
-	ZEND_PARSE_PARAMETERS_NONE();
-
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
-	
-	RETURN_STR_COPY(socket->remote_addr);
+	if (socket->idle_timeout > 0 && socket->cancel.func != NULL) {
+		async_timer_wheel_start(&socket->scheduler->wheel, &socket->idle_timer, socket->idle_timeout);
+	}
 }
 
-ZEND_METHOD(TcpSocket, getRemotePort)
+static async_tcp_socket *async_tcp_socket_object_create()
 {
 	async_tcp_socket *socket;
 
-	ZEND_PARSE_PARAMETERS_NONE();
+	socket = emalloc(sizeof(async_tcp_socket));
+	ZEND_SECURE_ZERO(socket, sizeof(async_tcp_socket));
 
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	zend_object_std_init(&socket->std, async_tcp_socket_ce);
+	socket->std.handlers = &async_tcp_socket_handlers;
 	
-	RETURN_LONG(socket->remote_port);
+	socket->scheduler = async_task_scheduler_get();
+	
+	ASYNC_ADDREF(&socket->scheduler->std);
+	
+	socket->cancel.object = socket;
+	socket->cancel.func = shutdown_socket;
+	
+	ASYNC_Q_ENQUEUE(&socket->scheduler->shutdown, &socket->cancel);
+	
+	socket->read_timer.func = timeout_read;
+	socket->read_timer.arg = socket;
+	
+	socket->write_timer.func = timeout_write;
+	socket->write_timer.arg = socket;
+	
+	socket->idle_timer.func = timeout_idle;
+	socket->idle_timer.arg = socket;
+	
+#ifdef ASYNC_TCP_ZEROCOPY
+	socket->zc_timer.func = timeout_zerocopy;
+	socket->zc_timer.arg = socket;
+#endif
+
+	uv_tcp_init(&socket->scheduler->loop, &socket->handle);
+
+	socket->stream = async_stream_init((uv_stream_t *) &socket->handle, 0);
+
+	return socket;
 }
 
-ZEND_METHOD(TcpSocket, setOption)
+static void async_tcp_socket_object_dtor(zend_object *object)
 {
 	async_tcp_socket *socket;
 
-	zend_long option;
-	zval *val;
-
-	int code;
-
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 2)
-		Z_PARAM_LONG(option)
-		Z_PARAM_ZVAL(val)
-	ZEND_PARSE_PARAMETERS_END();
-
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
-	code = 0;
-
-	switch ((int) option) {
-	case ASYNC_SOCKET_TCP_NODELAY:
-		code = uv_tcp_nodelay(&socket->handle, Z_LVAL_P(val) ? 1 : 0);
-		break;
-	case ASYNC_SOCKET_TCP_KEEPALIVE:
-		code = uv_tcp_keepalive(&socket->handle, Z_LVAL_P(val) ? 1 : 0, (unsigned int) Z_LVAL_P(val));
-		break;
+	socket = (async_tcp_socket *) object;
+	
+	if (socket->cancel.func != NULL) {
+		ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
+		
+		socket->cancel.func(socket, NULL);
 	}
-
-	RETURN_BOOL((code < 0) ? 0 : 1);
 }
 
-static inline void call_read(async_tcp_socket *socket, zval *return_value, zend_execute_data *execute_data)
+#ifdef HAVE_ASYNC_SSL
+static void release_server_settings(async_tcp_server_settings *settings)
 {
-	zend_string *str;
-	zval *hint;
-	size_t len;
-	int code;
+	if (--settings->refcount > 0) {
+		return;
+	}
 	
-	hint = NULL;
+	if (settings->settings.alpn != NULL) {
+		zend_string_release(settings->settings.alpn);
+	}
 	
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
-		Z_PARAM_OPTIONAL
-		Z_PARAM_ZVAL(hint)
-	ZEND_PARSE_PARAMETERS_END();
+	efree(settings);
+}
+#endif
+
+static void async_tcp_socket_object_destroy(zend_object *object)
+{
+	async_tcp_socket *socket;
 	
-	if (hint == NULL || Z_TYPE_P(hint) == IS_NULL) {
-		len = socket->stream->buffer.size;
-	} else if (Z_LVAL_P(hint) < 1) {
-		zend_throw_exception_ex(async_socket_exception_ce, 0, "Invalid read length: %d", (int) Z_LVAL_P(hint));
-		return;
-	} else {
-		len = (size_t) Z_LVAL_P(hint);
-	}
+	socket = (async_tcp_socket *) object;
+	
+#ifdef ASYNC_TCP_ZEROCOPY
+	// Zero-copy buffers are released when the poll handle has been closed (it holds a reference to the socket).
+	ZEND_ASSERT(socket->zc_first == NULL);
+#endif
 
-	if (Z_TYPE_P(&socket->read_error) != IS_UNDEF) {
-		Z_ADDREF_P(&socket->read_error);
+#ifdef HAVE_ASYNC_SSL
+	if (socket->stream->ssl.ssl != NULL) {
+		async_ssl_dispose_engine(&socket->stream->ssl, (socket->server == NULL) ? 1 : 0);
+	}
 
-		execute_data->opline--;
-		zend_throw_exception_internal(&socket->read_error);
-		execute_data->opline++;
+	if (socket->encryption != NULL) {
+		ASYNC_DELREF(&socket->encryption->std);
+	}
+	
+	if (socket->server_settings != NULL) {
+		release_server_settings(socket->server_settings);
+	}
+#endif
 
-		return;
+	if (socket->stream != NULL) {
+		async_stream_free(socket->stream);
 	}
 
-	code = async_stream_read_string(socket->stream, &str, len, 0);
+	if (socket->server != NULL) {
+		ASYNC_DELREF(&socket->server->std);
+	}
 	
-	if (UNEXPECTED(EG(exception))) {
-		return;
+	ASYNC_DELREF(&socket->scheduler->std);
+
+	zval_ptr_dtor(&socket->read_error);
+	zval_ptr_dtor(&socket->write_error);
+
+	if (socket->name != NULL) {
+		zend_string_release(socket->name);
 	}
 	
-	if (code > 0) {
-		RETURN_STR(str);
+	if (socket->local_addr != NULL) {
+		zend_string_release(socket->local_addr);
 	}
 	
-	ASYNC_CHECK_EXCEPTION(socket->stream->read.error != NULL, async_stream_exception_ce, "Reading from socket failed: %s", socket->stream->read.error);
-	ASYNC_CHECK_EXCEPTION(code < 0, async_stream_exception_ce, "Reading from socket failed: %s", uv_strerror(code));
+	if (socket->remote_addr != NULL) {
+		zend_string_release(socket->remote_addr);
+	}
+
+	zend_object_std_dtor(&socket->std);
 }
 
-ZEND_METHOD(TcpSocket, read)
+static void release_connect_op(async_tcp_connect_op *op)
 {
-	call_read((async_tcp_socket *) Z_OBJ_P(getThis()), return_value, execute_data);
+	if (--op->refs == 0) {
+		ASYNC_FREE_OP(op);
+	}
 }
 
-ZEND_METHOD(TcpSocket, getReadableStream)
+static void connect_timer_closed(uv_handle_t *handle)
 {
-	async_tcp_socket *socket;
+	release_connect_op((async_tcp_connect_op *) handle->data);
+}
 
-	zval obj;
+static void connect_attempt_closed(uv_handle_t *handle)
+{
+	async_tcp_connect_attempt *attempt;
+	async_tcp_connect_op *op;
 
-	ZEND_PARSE_PARAMETERS_NONE();
+	attempt = (async_tcp_connect_attempt *) handle->data;
+	op = attempt->op;
 
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	op->attempts[attempt->index] = NULL;
 
-	ZVAL_OBJ(&obj, &async_tcp_socket_reader_object_create(socket)->std);
+	efree(attempt);
 
-	RETURN_ZVAL(&obj, 1, 1);
+	release_connect_op(op);
 }
 
-static inline void call_write(async_tcp_socket *socket, zval *return_value, zend_execute_data *execute_data)
+static void dispose_connect_attempt(async_tcp_connect_attempt *attempt)
 {
-	zend_string *data;
-	
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
-		Z_PARAM_STR(data)
-	ZEND_PARSE_PARAMETERS_END();
+	async_tcp_connect_op *op;
 
-	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
-		Z_ADDREF_P(&socket->write_error);
+	if (attempt->tcp == &attempt->handle) {
+		if (!uv_is_closing((uv_handle_t *) attempt->tcp)) {
+			uv_close((uv_handle_t *) attempt->tcp, connect_attempt_closed);
+		}
+	} else if (!attempt->pending) {
+		// Attempts using the target handle are released as soon as the connect request has completed.
+		op = attempt->op;
+		op->attempts[attempt->index] = NULL;
 
-		execute_data->opline--;
-		zend_throw_exception_internal(&socket->write_error);
-		execute_data->opline++;
+		efree(attempt);
 
-		return;
+		release_connect_op(op);
 	}
-	
-	async_stream_write(socket->stream, ZSTR_VAL(data), ZSTR_LEN(data));
 }
 
-ZEND_METHOD(TcpSocket, write)
+static void finish_connect(async_tcp_connect_op *op, int code)
 {
-	call_write((async_tcp_socket *) Z_OBJ_P(getThis()), return_value, execute_data);
-}
+	int i;
 
-static void write_async_cb(void *arg)
-{
-	async_tcp_socket *socket;
-	
-	socket = (async_tcp_socket *) arg;
-	
-	ZEND_ASSERT(socket != NULL);
-	
-	ASYNC_DELREF(&socket->std);
+	op->done = 1;
+	op->code = code;
+
+	uv_timer_stop(&op->delay);
+	uv_timer_stop(&op->timeout);
+
+	for (i = 0; i < op->next; i++) {
+		if (op->attempts[i] != NULL && op->attempts[i] != op->winner) {
+			dispose_connect_attempt(op->attempts[i]);
+		}
+	}
+
+	if (op->base.status == ASYNC_STATUS_RUNNING) {
+		ASYNC_FINISH_OP(op);
+	}
 }
 
-ZEND_METHOD(TcpSocket, writeAsync)
+static void start_connect_attempt(async_tcp_connect_op *op);
+
+static void connect_attempt_cb(uv_connect_t *req, int status)
 {
-	async_tcp_socket *socket;
-	
-	zend_string *data;
-	
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
-		Z_PARAM_STR(data)
-	ZEND_PARSE_PARAMETERS_END();
-	
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	async_tcp_connect_attempt *attempt;
+	async_tcp_connect_op *op;
 
-	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
-		Z_ADDREF_P(&socket->write_error);
+	attempt = (async_tcp_connect_attempt *) req->data;
+	op = attempt->op;
 
-		execute_data->opline--;
-		zend_throw_exception_internal(&socket->write_error);
-		execute_data->opline++;
+	attempt->pending = 0;
+	op->pending--;
+
+	if (op->done) {
+		dispose_connect_attempt(attempt);
 
 		return;
 	}
-	
-	ASYNC_ADDREF(&socket->std);
-	
-	async_stream_async_write_string(socket->stream, data, write_async_cb, socket);
-	
-	if (EXPECTED(EG(exception) == NULL)) {		
-		RETURN_LONG(socket->handle.write_queue_size);
-	} else {
-		ASYNC_DELREF(&socket->std);
+
+	if (status == 0) {
+		op->winner = attempt;
+
+		finish_connect(op, 0);
+
+		return;
 	}
-}
 
-ZEND_METHOD(TcpSocket, getWriteQueueSize)
-{
-	async_tcp_socket *socket;
-	
-	ZEND_PARSE_PARAMETERS_NONE();
+	op->code = status;
 
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
-	
-	RETURN_LONG((Z_TYPE_P(&socket->write_error) == IS_UNDEF) ? socket->handle.write_queue_size : 0);
+	dispose_connect_attempt(attempt);
+
+	// A failed attempt starts the next attempt right away instead of waiting for the delay to pass.
+	if (op->next < op->count) {
+		uv_timer_stop(&op->delay);
+
+		start_connect_attempt(op);
+	} else if (op->pending == 0) {
+		finish_connect(op, status);
+	}
 }
 
-ZEND_METHOD(TcpSocket, getWritableStream)
+static void connect_delay_cb(uv_timer_t *timer)
 {
-	async_tcp_socket *socket;
+	async_tcp_connect_op *op;
 
-	zval obj;
+	op = (async_tcp_connect_op *) timer->data;
 
-	ZEND_PARSE_PARAMETERS_NONE();
+	if (!op->done) {
+		start_connect_attempt(op);
+	}
+}
 
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+static void connect_timeout_cb(uv_timer_t *timer)
+{
+	async_tcp_connect_op *op;
 
-	ZVAL_OBJ(&obj, &async_tcp_socket_writer_object_create(socket)->std);
+	op = (async_tcp_connect_op *) timer->data;
 
-	RETURN_ZVAL(&obj, 1, 1);
+	if (!op->done) {
+		finish_connect(op, UV_ETIMEDOUT);
+	}
 }
 
-ZEND_METHOD(TcpSocket, encrypt)
+static void start_connect_attempt(async_tcp_connect_op *op)
 {
-#ifndef HAVE_ASYNC_SSL
-	zend_throw_exception_ex(async_socket_exception_ce, 0, "Async extension was not compiled with SSL support");
-#else
+	async_tcp_connect_attempt *attempt;
 
-	async_tcp_socket *socket;
-	async_ssl_handshake_data handshake;
-	
 	int code;
 
-	ZEND_PARSE_PARAMETERS_NONE();
+	while (op->next < op->count) {
+		attempt = emalloc(sizeof(async_tcp_connect_attempt));
+		ZEND_SECURE_ZERO(attempt, sizeof(async_tcp_connect_attempt));
 
-	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
-	
-	ZEND_SECURE_ZERO(&handshake, sizeof(async_ssl_handshake_data));
-	
-	if (socket->server == NULL) {
-		socket->stream->ssl.ctx = async_ssl_create_context();
-		
-		async_ssl_setup_verify_callback(socket->stream->ssl.ctx, &socket->encryption->settings);
-		
-		handshake.settings = &socket->encryption->settings;
-		handshake.host = socket->name;
-	} else {
-		ASYNC_CHECK_EXCEPTION(socket->server->encryption == NULL, async_socket_exception_ce, "No encryption settings have been passed to TcpServer::listen()");
+		attempt->op = op;
+		attempt->index = op->next;
+		attempt->req.data = attempt;
 
-		socket->stream->ssl.ctx = socket->server->ctx;
-		
-		handshake.settings = &socket->server->settings;
-	}
-	
-	async_ssl_create_engine(&socket->stream->ssl);
-	async_ssl_setup_encryption(socket->stream->ssl.ssl, handshake.settings);
-	
-	uv_tcp_nodelay(&socket->handle, 1);
-	
-	code = async_stream_ssl_handshake(socket->stream, &handshake);
+		if (op->race) {
+			attempt->tcp = &attempt->handle;
 
-	uv_tcp_nodelay(&socket->handle, 0);
-	
-	if (code == FAILURE) {
-		if (handshake.error != NULL) {
-			zend_throw_exception_ex(async_socket_exception_ce, 0, "SSL handshake failed: %s", ZSTR_VAL(handshake.error));
-			zend_string_release(handshake.error);
-			return;
-		}
-	
-		if (handshake.uv_error < 0) {
-			zend_throw_exception_ex(async_socket_exception_ce, 0, "SSL handshake failed due to network error: %s", uv_strerror(handshake.uv_error));
-			return;
+			uv_tcp_init(op->target->loop, attempt->tcp);
+
+			attempt->handle.data = attempt;
+
+			if (op->background) {
+				uv_unref((uv_handle_t *) attempt->tcp);
+			}
+		} else {
+			attempt->tcp = op->target;
 		}
-		
-		if (handshake.ssl_error != SSL_ERROR_NONE) {
-			zend_throw_exception_ex(async_socket_exception_ce, 0, "SSL handshake failed [%d]: %s", handshake.ssl_error, ERR_reason_error_string(handshake.ssl_error));
+
+		op->attempts[op->next] = attempt;
+		op->refs++;
+
+		code = uv_tcp_connect(&attempt->req, attempt->tcp, (const struct sockaddr *) &op->addresses[op->next++], connect_attempt_cb);
+
+		if (EXPECTED(code == 0)) {
+			attempt->pending = 1;
+			op->pending++;
+
+			if (op->next < op->count) {
+				uv_timer_start(&op->delay, connect_delay_cb, ASYNC_TCP_CONNECT_DELAY, 0);
+			}
+
 			return;
 		}
+
+		op->code = code;
+
+		dispose_connect_attempt(attempt);
 	}
-	
-	if (handshake.error != NULL) {
-		zend_string_release(handshake.error);
+
+	if (op->pending == 0) {
+		finish_connect(op, op->code);
 	}
-	
-#endif
 }
 
-ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tcp_socket_connect, 0, 2, Concurrent\\Network\\TcpSocket, 0)
-	ZEND_ARG_TYPE_INFO(0, host, IS_STRING, 0)
-	ZEND_ARG_TYPE_INFO(0, port, IS_LONG, 0)
-	ZEND_ARG_OBJ_INFO(0, tls, Concurrent\\Network\\TlsClientEncryption, 1)
-ZEND_END_ARG_INFO()
-
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_pair, 0, 0, IS_ARRAY, 0)
-ZEND_END_ARG_INFO()
+/* Connects the given TCP handle, all resolved addresses are raced using staggered connection attempts (RFC 8305), the handle must be closed if the connect fails. */
+ASYNC_API int async_tcp_connect(uv_tcp_t *handle, char *name, int port, uint64_t timeout)
+{
+	async_tcp_connect_op *op;
+	async_context *context;
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_close, 0, 0, IS_VOID, 0)
-	ZEND_ARG_OBJ_INFO(0, error, Throwable, 1)
-ZEND_END_ARG_INFO()
+	struct sockaddr_storage addr;
+	int len;
+	int code;
+	int i;
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_address, 0, 0, IS_STRING, 0)
-ZEND_END_ARG_INFO()
+#ifndef PHP_WIN32
+	uv_os_fd_t fd;
+#endif
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_port, 0, 0, IS_LONG, 1)
-ZEND_END_ARG_INFO()
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_tcp_connect_op));
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_remote_address, 0, 0, IS_STRING, 0)
-ZEND_END_ARG_INFO()
+	code = async_dns_lookup(name, port, op->addresses, ASYNC_TCP_CONNECT_MAX_ATTEMPTS, IPPROTO_TCP);
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_remote_port, 0, 0, IS_LONG, 1)
-ZEND_END_ARG_INFO()
+	if (UNEXPECTED(code < 0)) {
+		ASYNC_FREE_OP(op);
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_set_option, 0, 2, _IS_BOOL, 0)
-	ZEND_ARG_TYPE_INFO(0, option, IS_LONG, 0)
-	ZEND_ARG_INFO(0, value)
-ZEND_END_ARG_INFO()
+		return code;
+	}
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_read, 0, 0, IS_STRING, 1)
-	ZEND_ARG_TYPE_INFO(0, length, IS_LONG, 1)
-ZEND_END_ARG_INFO()
+	context = async_context_get();
 
-ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tcp_socket_get_readable_stream, 0, 0, Concurrent\\Stream\\ReadableStream, 0)
-ZEND_END_ARG_INFO()
+	op->target = handle;
+	op->count = code;
+	op->code = UV_ECONNREFUSED;
+	op->background = context->background;
+	op->refs = 3;
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_write, 0, 1, IS_VOID, 0)
-	ZEND_ARG_TYPE_INFO(0, data, IS_STRING, 0)
-ZEND_END_ARG_INFO()
+#ifdef PHP_WIN32
+	op->race = 0;
+#else
+	// Connection attempts race using separate sockets, the winning socket is moved into the target handle later.
+	op->race = (0 != uv_fileno((const uv_handle_t *) handle, &fd));
+#endif
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_write_async, 0, 1, IS_LONG, 0)
-	ZEND_ARG_TYPE_INFO(0, data, IS_STRING, 0)
-ZEND_END_ARG_INFO()
+	if (!op->race) {
+		len = sizeof(struct sockaddr_storage);
+
+		// A handle that has already been bound can only connect to addresses of the same family.
+		if (0 == uv_tcp_getsockname(handle, (struct sockaddr *) &addr, &len)) {
+			for (i = 0; i < op->count; i++) {
+				if (op->addresses[i].ss_family == addr.ss_family) {
+					memcpy(&op->addresses[0], &op->addresses[i], sizeof(struct sockaddr_storage));
+					break;
+				}
+			}
+		}
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_write_queue_size, 0, 0, IS_LONG, 0)
-ZEND_END_ARG_INFO()
+		op->count = 1;
+	}
 
-ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tcp_socket_get_writable_stream, 0, 0, Concurrent\\Stream\\WritableStream, 0)
-ZEND_END_ARG_INFO()
+	uv_timer_init(handle->loop, &op->delay);
+	uv_timer_init(handle->loop, &op->timeout);
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_encrypt, 0, 0, IS_VOID, 0)
-ZEND_END_ARG_INFO()
+	uv_unref((uv_handle_t *) &op->delay);
+	uv_unref((uv_handle_t *) &op->timeout);
 
-static const zend_function_entry async_tcp_socket_functions[] = {
-	ZEND_ME(TcpSocket, connect, arginfo_tcp_socket_connect, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
-	ZEND_ME(TcpSocket, pair, arginfo_tcp_socket_pair, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
-	ZEND_ME(TcpSocket, close, arginfo_tcp_socket_close, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, getAddress, arginfo_tcp_socket_get_address, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, getPort, arginfo_tcp_socket_get_port, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, setOption, arginfo_tcp_socket_set_option, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, getRemoteAddress, arginfo_tcp_socket_get_remote_address, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, getRemotePort, arginfo_tcp_socket_get_remote_port, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, read, arginfo_tcp_socket_read, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, getReadableStream, arginfo_tcp_socket_get_readable_stream, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, write, arginfo_tcp_socket_write, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, writeAsync, arginfo_tcp_socket_write_async, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, getWriteQueueSize, arginfo_tcp_socket_get_write_queue_size, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, getWritableStream, arginfo_tcp_socket_get_writable_stream, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocket, encrypt, arginfo_tcp_socket_encrypt, ZEND_ACC_PUBLIC)
-	ZEND_FE_END
-};
+	op->delay.data = op;
+	op->timeout.data = op;
 
+	if (timeout > 0) {
+		uv_timer_start(&op->timeout, connect_timeout_cb, timeout, 0);
+	}
 
-static async_tcp_socket_reader *async_tcp_socket_reader_object_create(async_tcp_socket *socket)
-{
-	async_tcp_socket_reader *reader;
+	start_connect_attempt(op);
 
-	reader = emalloc(sizeof(async_tcp_socket_reader));
-	ZEND_SECURE_ZERO(reader, sizeof(async_tcp_socket_reader));
+	if (!op->done) {
+		// Attempt handles are referenced, the target handle has to be referenced while it is being connected.
+		if (op->race || op->background || uv_has_ref((uv_handle_t *) handle)) {
+			code = async_await_op((async_op *) op);
+		} else {
+			uv_ref((uv_handle_t *) handle);
+			code = async_await_op((async_op *) op);
+			uv_unref((uv_handle_t *) handle);
+		}
 
-	zend_object_std_init(&reader->std, async_tcp_socket_reader_ce);
-	reader->std.handlers = &async_tcp_socket_reader_handlers;
+		if (code == FAILURE) {
+			ASYNC_FORWARD_OP_ERROR(op);
 
-	reader->socket = socket;
+			finish_connect(op, FAILURE);
+		}
+	}
 
-	ASYNC_ADDREF(&socket->std);
+	code = op->code;
 
-	return reader;
-}
+	if (op->winner != NULL) {
+		if (op->race) {
+#ifndef PHP_WIN32
+			if (0 == (code = uv_fileno((const uv_handle_t *) op->winner->tcp, &fd))) {
+				if (0 > (fd = dup(fd))) {
+					code = -errno;
+				} else if (0 != (code = uv_tcp_open(handle, fd))) {
+					close(fd);
+				}
+			}
+#endif
+		}
 
-static void async_tcp_socket_reader_object_destroy(zend_object *object)
-{
-	async_tcp_socket_reader *reader;
+		dispose_connect_attempt(op->winner);
+	}
 
-	reader = (async_tcp_socket_reader *) object;
+	uv_close((uv_handle_t *) &op->delay, connect_timer_closed);
+	uv_close((uv_handle_t *) &op->timeout, connect_timer_closed);
 
-	ASYNC_DELREF(&reader->socket->std);
+	release_connect_op(op);
 
-	zend_object_std_dtor(&reader->std);
+	return code;
 }
 
-ZEND_METHOD(TcpSocketReader, close)
+ASYNC_API int async_tcp_socket_connect(zval *result, zend_string *name, zend_long port, zval *tls, uint64_t timeout)
 {
-	async_tcp_socket_reader *reader;
 	async_tcp_socket *socket;
 
-	zval *val;
+	int code;
 
-	val = NULL;
+	socket = async_tcp_socket_object_create();
+	socket->name = zend_string_copy(name);
 
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
-		Z_PARAM_OPTIONAL
-		Z_PARAM_ZVAL(val)
-	ZEND_PARSE_PARAMETERS_END();
+	code = async_tcp_connect(&socket->handle, ZSTR_VAL(name), (int) port, timeout);
 
-	reader = (async_tcp_socket_reader *) Z_OBJ_P(getThis());
-	socket = reader->socket;
+	if (UNEXPECTED(code < 0)) {
+		if (!EG(exception)) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to connect socket: %s", uv_strerror(code));
+		}
 
-	if (Z_TYPE_P(&socket->read_error) != IS_UNDEF) {
-		return;
+		// Close the handle right away, a connect request that timed out is still pending and is cancelled by closing.
+		if (socket->cancel.func != NULL) {
+			ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
+
+			socket->cancel.func(socket, NULL);
+		}
+
+		ASYNC_DELREF(&socket->std);
+
+		return FAILURE;
 	}
 
-	ASYNC_PREPARE_EXCEPTION(&socket->read_error, async_stream_closed_exception_ce, "Socket has been closed");
+	if (tls != NULL && Z_TYPE_P(tls) != IS_NULL) {
+#ifdef HAVE_ASYNC_SSL
+		socket->encryption = async_clone_client_encryption((async_tls_client_encryption *) Z_OBJ_P(tls));
+		socket->encryption->settings.mode = ASYNC_SSL_MODE_CLIENT;
 
-	if (val != NULL && Z_TYPE_P(val) != IS_NULL) {
-		zend_exception_set_previous(Z_OBJ_P(&socket->read_error), Z_OBJ_P(val));
-		GC_ADDREF(Z_OBJ_P(val));
+		if (socket->encryption->settings.peer_name == NULL) {
+			socket->encryption->settings.peer_name = zend_string_copy(socket->name);
+		}
+#else
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Socket encryption requires async extension to be compiled with SSL support");
+		ASYNC_DELREF(&socket->std);
+		return FAILURE;
+#endif
 	}
 	
-	async_stream_shutdown(socket->stream, ASYNC_STREAM_SHUT_RD);
+	assemble_peer(&socket->handle, 0, &socket->local_addr, &socket->local_port);
+	assemble_peer(&socket->handle, 1, &socket->remote_addr, &socket->remote_port);
+
+	ZVAL_OBJ(result, &socket->std);
+	
+	return SUCCESS;
 }
 
-ZEND_METHOD(TcpSocketReader, read)
+/* Check if an idle socket can be reused, EOF is detected by peeking at the socket without consuming any data. */
+ASYNC_API zend_bool async_tcp_socket_is_reusable(zend_object *object)
 {
-	call_read(((async_tcp_socket_reader *) Z_OBJ_P(getThis()))->socket, return_value, execute_data);
+	async_tcp_socket *socket;
+	
+#ifndef PHP_WIN32
+	uv_os_fd_t fd;
+#endif
+	
+	socket = (async_tcp_socket *) object;
+	
+	if (socket->cancel.func == NULL || socket->stream == NULL) {
+		return 0;
+	}
+	
+	if (Z_TYPE_P(&socket->read_error) != IS_UNDEF || Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		return 0;
+	}
+	
+	if (socket->stream->flags & (ASYNC_STREAM_EOF | ASYNC_STREAM_CLOSED | ASYNC_STREAM_SHUT_RD | ASYNC_STREAM_SHUT_WR)) {
+		return 0;
+	}
+	
+	// Unread input means the last response has not been consumed completely.
+	if (socket->stream->buffer.len > 0) {
+		return 0;
+	}
+	
+#ifndef PHP_WIN32
+#ifdef HAVE_ASYNC_SSL
+	// Pending records are processed, post-handshake messages (session tickets) are fine but close_notify or EOF is not.
+	if (socket->stream->ssl.ssl != NULL) {
+		return (async_stream_ssl_poll(socket->stream) == SUCCESS);
+	}
+#endif
+
+	if (0 == uv_fileno((const uv_handle_t *) &socket->handle, &fd)) {
+		char c;
+		ssize_t len;
+		
+		do {
+			len = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+		} while (len < 0 && errno == EINTR);
+		
+		if (len == 0) {
+			return 0;
+		}
+		
+		if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			return 0;
+		}
+		
+		if (len > 0) {
+			return 0;
+		}
+	}
+#endif
+	
+	return 1;
 }
 
-static const zend_function_entry async_tcp_socket_reader_functions[] = {
-	ZEND_ME(TcpSocketReader, close, arginfo_tcp_socket_close, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocketReader, read, arginfo_tcp_socket_read, ZEND_ACC_PUBLIC)
-	ZEND_FE_END
-};
+ZEND_METHOD(TcpSocket, connect)
+{
+	zend_string *name;
+	zend_long port;
+	zend_long timeout;
+
+	zval *tls;
+
+	tls = NULL;
+	timeout = 0;
 
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 4)
+	    Z_PARAM_STR(name)
+		Z_PARAM_LONG(port)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(tls)
+		Z_PARAM_LONG(timeout)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	ASYNC_CHECK_ERROR(timeout < 0, "Connect timeout must not be negative");
+	
+	async_tcp_socket_connect(return_value, name, port, tls, (uint64_t) timeout);
+}
 
-static async_tcp_socket_writer *async_tcp_socket_writer_object_create(async_tcp_socket *socket)
+ZEND_METHOD(TcpSocket, pair)
 {
-	async_tcp_socket_writer *writer;
+	async_tcp_socket *socket;
 
-	writer = emalloc(sizeof(async_tcp_socket_writer));
-	ZEND_SECURE_ZERO(writer, sizeof(async_tcp_socket_writer));
+	zval sockets[2];
+	int domain;
+	int i;
 
-	zend_object_std_init(&writer->std, async_tcp_socket_writer_ce);
-	writer->std.handlers = &async_tcp_socket_writer_handlers;
+	ZEND_PARSE_PARAMETERS_NONE();
 
-	writer->socket = socket;
+	if (!USED_RET()) {
+		return;
+	}
 
-	ASYNC_ADDREF(&socket->std);
+#ifdef ZEND_WIN32
+	SOCKET tmp[2];
+	domain = AF_INET;
+#else
+	int tmp[2];
+	domain = AF_UNIX;
+#endif
 
-	return writer;
-}
+	i = socketpair(domain, SOCK_STREAM, IPPROTO_IP, tmp);
+	
+	ASYNC_CHECK_EXCEPTION(i != 0, async_socket_exception_ce, "Failed to create socket pair");
 
-static void async_tcp_socket_writer_object_destroy(zend_object *object)
-{
-	async_tcp_socket_writer *writer;
+	array_init_size(return_value, 2);
+
+	for (i = 0; i < 2; i++) {
+		socket = async_tcp_socket_object_create();
 
-	writer = (async_tcp_socket_writer *) object;
+		uv_tcp_open(&socket->handle, (uv_os_sock_t) tmp[i]);
 
-	ASYNC_DELREF(&writer->socket->std);
+		ZVAL_OBJ(&sockets[i], &socket->std);
 
-	zend_object_std_dtor(&writer->std);
+		zend_hash_index_update(Z_ARRVAL_P(return_value), i, &sockets[i]);
+		
+		socket->local_addr = zend_string_init("127.0.0.1", sizeof("127.0.0.1")-1, 0);
+		socket->remote_addr = zend_string_init("127.0.0.1", sizeof("127.0.0.1")-1, 0);
+	}
 }
 
-ZEND_METHOD(TcpSocketWriter, close)
+ZEND_METHOD(TcpSocket, close)
 {
-	async_tcp_socket_writer *writer;
 	async_tcp_socket *socket;
 
+	zval error;
 	zval *val;
 
 	val = NULL;
@@ -996,411 +1514,2093 @@ ZEND_METHOD(TcpSocketWriter, close)
 		Z_PARAM_OPTIONAL
 		Z_PARAM_ZVAL(val)
 	ZEND_PARSE_PARAMETERS_END();
-
-	writer = (async_tcp_socket_writer *) Z_OBJ_P(getThis());
-	socket = writer->socket;
-
-	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+	
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	
+	if (socket->cancel.func == NULL) {
 		return;
 	}
 
-	ASYNC_PREPARE_EXCEPTION(&socket->write_error, async_stream_closed_exception_ce, "Socket has been closed");
+	async_socket_closed_error(&error, val);
 
-	if (val != NULL && Z_TYPE_P(val) != IS_NULL) {
-		zend_exception_set_previous(Z_OBJ_P(&socket->write_error), Z_OBJ_P(val));
-		GC_ADDREF(Z_OBJ_P(val));
-	}
+	ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
 	
-	async_stream_shutdown(socket->stream, ASYNC_STREAM_SHUT_WR);
+	socket->cancel.func(socket, &error);
+
+	zval_ptr_dtor(&error);
 }
 
-ZEND_METHOD(TcpSocketWriter, write)
+ZEND_METHOD(TcpSocket, getAddress)
 {
-	call_write(((async_tcp_socket_writer *) Z_OBJ_P(getThis()))->socket, return_value, execute_data);
-}
+	async_tcp_socket *socket;
 
-static const zend_function_entry async_tcp_socket_writer_functions[] = {
-	ZEND_ME(TcpSocketWriter, close, arginfo_tcp_socket_close, ZEND_ACC_PUBLIC)
-	ZEND_ME(TcpSocketWriter, write, arginfo_tcp_socket_write, ZEND_ACC_PUBLIC)
-	ZEND_FE_END
-};
+	ZEND_PARSE_PARAMETERS_NONE();
 
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	
+	RETURN_STR_COPY(socket->local_addr);
+}
 
-static void server_disposed(uv_handle_t *handle)
+ZEND_METHOD(TcpSocket, getPort)
 {
-	async_tcp_server *server;
+	async_tcp_socket *socket;
 
-	server = (async_tcp_server *) handle->data;
-	
-	ZEND_ASSERT(server != NULL);
+	ZEND_PARSE_PARAMETERS_NONE();
 
-	ASYNC_DELREF(&server->std);
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	
+	RETURN_LONG(socket->local_port);
 }
 
-static void shutdown_server(void *obj, zval *error)
+ZEND_METHOD(TcpSocket, getRemoteAddress)
 {
-	async_tcp_server *server;
-	async_uv_op *op;
-	
+	async_tcp_socket *socket;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	
+	RETURN_STR_COPY(socket->remote_addr);
+}
+
+ZEND_METHOD(TcpSocket, getRemotePort)
+{
+	async_tcp_socket *socket;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	
+	RETURN_LONG(socket->remote_port);
+}
+
+/* Maps an option to the level and name being used with setsockopt() / getsockopt(), returns FAILURE if not supported by the OS. */
+static int map_socket_option(async_tcp_socket *socket, int option, int *level, int *name)
+{
+	struct sockaddr_storage addr;
+	int len;
+
+	switch (option) {
+	case ASYNC_SOCKET_TCP_NODELAY:
+		*level = IPPROTO_TCP;
+		*name = TCP_NODELAY;
+		return SUCCESS;
+	case ASYNC_SOCKET_TCP_KEEPALIVE:
+		*level = SOL_SOCKET;
+		*name = SO_KEEPALIVE;
+		return SUCCESS;
+#ifdef TCP_QUICKACK
+	case ASYNC_SOCKET_TCP_QUICKACK:
+		*level = IPPROTO_TCP;
+		*name = TCP_QUICKACK;
+		return SUCCESS;
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+	case ASYNC_SOCKET_TCP_NOTSENT_LOWAT:
+		*level = IPPROTO_TCP;
+		*name = TCP_NOTSENT_LOWAT;
+		return SUCCESS;
+#endif
+#ifdef TCP_USER_TIMEOUT
+	case ASYNC_SOCKET_TCP_USER_TIMEOUT:
+		*level = IPPROTO_TCP;
+		*name = TCP_USER_TIMEOUT;
+		return SUCCESS;
+#endif
+#ifdef SO_BUSY_POLL
+	case ASYNC_SOCKET_TCP_BUSY_POLL:
+		*level = SOL_SOCKET;
+		*name = SO_BUSY_POLL;
+		return SUCCESS;
+#endif
+	case ASYNC_SOCKET_TCP_LINGER:
+		*level = SOL_SOCKET;
+		*name = SO_LINGER;
+		return SUCCESS;
+	case ASYNC_SOCKET_TCP_TOS:
+		len = sizeof(struct sockaddr_storage);
+
+		if (0 != uv_tcp_getsockname(&socket->handle, (struct sockaddr *) &addr, &len)) {
+			return FAILURE;
+		}
+
+#ifdef IPV6_TCLASS
+		if (addr.ss_family == AF_INET6) {
+			*level = IPPROTO_IPV6;
+			*name = IPV6_TCLASS;
+			return SUCCESS;
+		}
+#endif
+
+		*level = IPPROTO_IP;
+		*name = IP_TOS;
+		return SUCCESS;
+	}
+
+	return FAILURE;
+}
+
+ZEND_METHOD(TcpSocket, setOption)
+{
+	async_tcp_socket *socket;
+
+	zend_long option;
+	zval *val;
+
+	struct linger lg;
+	uv_os_fd_t fd;
+	int level;
+	int name;
+	int code;
+	int num;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 2)
+		Z_PARAM_LONG(option)
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	code = 0;
+
+	switch ((int) option) {
+	case ASYNC_SOCKET_TCP_NODELAY:
+		code = uv_tcp_nodelay(&socket->handle, Z_LVAL_P(val) ? 1 : 0);
+		break;
+	case ASYNC_SOCKET_TCP_KEEPALIVE:
+		code = uv_tcp_keepalive(&socket->handle, Z_LVAL_P(val) ? 1 : 0, (unsigned int) Z_LVAL_P(val));
+		break;
+	case ASYNC_SOCKET_TCP_SNDBUF:
+		num = (int) zval_get_long(val);
+		code = (num < 1) ? UV_EINVAL : uv_send_buffer_size((uv_handle_t *) &socket->handle, &num);
+		break;
+	case ASYNC_SOCKET_TCP_RCVBUF:
+		num = (int) zval_get_long(val);
+		code = (num < 1) ? UV_EINVAL : uv_recv_buffer_size((uv_handle_t *) &socket->handle, &num);
+		break;
+	case ASYNC_SOCKET_TCP_ZEROCOPY:
+#ifdef ASYNC_TCP_ZEROCOPY
+		code = enable_zerocopy(socket, zval_get_long(val));
+#else
+		code = UV_ENOTSUP;
+#endif
+		break;
+	case ASYNC_SOCKET_TCP_READ_TIMEOUT:
+	case ASYNC_SOCKET_TCP_WRITE_TIMEOUT:
+	case ASYNC_SOCKET_TCP_IDLE_TIMEOUT:
+		if (zval_get_long(val) < 0) {
+			RETURN_FALSE;
+		}
+		
+		if (option == ASYNC_SOCKET_TCP_READ_TIMEOUT) {
+			socket->read_timeout = (uint64_t) zval_get_long(val);
+		} else if (option == ASYNC_SOCKET_TCP_WRITE_TIMEOUT) {
+			socket->write_timeout = (uint64_t) zval_get_long(val);
+		} else {
+			socket->idle_timeout = (uint64_t) zval_get_long(val);
+			
+			if (socket->idle_timeout == 0) {
+				async_timer_wheel_stop(&socket->scheduler->wheel, &socket->idle_timer);
+			} else {
+				touch_socket(socket);
+			}
+		}
+		break;
+	case ASYNC_SOCKET_TCP_QUICKACK:
+	case ASYNC_SOCKET_TCP_NOTSENT_LOWAT:
+	case ASYNC_SOCKET_TCP_USER_TIMEOUT:
+	case ASYNC_SOCKET_TCP_BUSY_POLL:
+	case ASYNC_SOCKET_TCP_LINGER:
+	case ASYNC_SOCKET_TCP_TOS:
+		if (FAILURE == map_socket_option(socket, (int) option, &level, &name)) {
+			RETURN_FALSE;
+		}
+
+		if (0 != uv_fileno((const uv_handle_t *) &socket->handle, &fd)) {
+			RETURN_FALSE;
+		}
+
+		if (option == ASYNC_SOCKET_TCP_LINGER) {
+			// NULL or FALSE disables lingering, a number of seconds enables it (0 resets the connection on close).
+			lg.l_onoff = (Z_TYPE_P(val) == IS_NULL || Z_TYPE_P(val) == IS_FALSE) ? 0 : 1;
+			lg.l_linger = lg.l_onoff ? (int) zval_get_long(val) : 0;
+
+			code = setsockopt((uv_os_sock_t) fd, level, name, (const char *) &lg, sizeof(struct linger));
+		} else {
+			num = (int) zval_get_long(val);
+
+			code = setsockopt((uv_os_sock_t) fd, level, name, (const char *) &num, sizeof(int));
+		}
+		break;
+	}
+
+	RETURN_BOOL((code < 0) ? 0 : 1);
+}
+
+ZEND_METHOD(TcpSocket, getOption)
+{
+	async_tcp_socket *socket;
+
+	zend_long option;
+
+	struct linger lg;
+	socklen_t len;
+	uv_os_fd_t fd;
+	int level;
+	int name;
+	int num;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_LONG(option)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	num = 0;
+
+	switch ((int) option) {
+	case ASYNC_SOCKET_TCP_SNDBUF:
+		if (0 == uv_send_buffer_size((uv_handle_t *) &socket->handle, &num)) {
+			RETURN_LONG(num);
+		}
+		break;
+	case ASYNC_SOCKET_TCP_RCVBUF:
+		if (0 == uv_recv_buffer_size((uv_handle_t *) &socket->handle, &num)) {
+			RETURN_LONG(num);
+		}
+		break;
+	case ASYNC_SOCKET_TCP_ZEROCOPY:
+#ifdef ASYNC_TCP_ZEROCOPY
+		RETURN_LONG((zend_long) socket->zerocopy);
+#endif
+		break;
+	case ASYNC_SOCKET_TCP_READ_TIMEOUT:
+		RETURN_LONG((zend_long) socket->read_timeout);
+	case ASYNC_SOCKET_TCP_WRITE_TIMEOUT:
+		RETURN_LONG((zend_long) socket->write_timeout);
+	case ASYNC_SOCKET_TCP_IDLE_TIMEOUT:
+		RETURN_LONG((zend_long) socket->idle_timeout);
+	default:
+		if (FAILURE == map_socket_option(socket, (int) option, &level, &name)) {
+			break;
+		}
+
+		if (0 != uv_fileno((const uv_handle_t *) &socket->handle, &fd)) {
+			break;
+		}
+
+		if (option == ASYNC_SOCKET_TCP_LINGER) {
+			len = sizeof(struct linger);
+
+			if (0 != getsockopt((uv_os_sock_t) fd, level, name, (char *) &lg, &len)) {
+				break;
+			}
+
+			if (lg.l_onoff) {
+				RETURN_LONG(lg.l_linger);
+			}
+
+			RETURN_FALSE;
+		}
+
+		len = sizeof(int);
+
+		if (0 != getsockopt((uv_os_sock_t) fd, level, name, (char *) &num, &len)) {
+			break;
+		}
+
+		switch ((int) option) {
+		case ASYNC_SOCKET_TCP_NODELAY:
+		case ASYNC_SOCKET_TCP_KEEPALIVE:
+		case ASYNC_SOCKET_TCP_QUICKACK:
+			RETURN_BOOL(num ? 1 : 0);
+		}
+
+		RETURN_LONG(num);
+	}
+
+	RETURN_NULL();
+}
+
+ZEND_METHOD(TcpSocket, getTcpInfo)
+{
+	async_tcp_socket *socket;
+
+#if defined(__linux__) && defined(TCP_INFO)
+	struct tcp_info info;
+	socklen_t len;
+	uv_os_fd_t fd;
+#endif
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+
+#if defined(__linux__) && defined(TCP_INFO)
+	ASYNC_CHECK_EXCEPTION(0 != uv_fileno((const uv_handle_t *) &socket->handle, &fd), async_socket_exception_ce, "Failed to access socket: %s", uv_strerror(UV_EBADF));
+
+	len = sizeof(struct tcp_info);
+	ZEND_SECURE_ZERO(&info, len);
+
+	ASYNC_CHECK_EXCEPTION(0 != getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len), async_socket_exception_ce, "Failed to read TCP_INFO: %s", strerror(errno));
+
+	array_init(return_value);
+
+	// Times are reported in microseconds, window sizes in segments.
+	add_assoc_long(return_value, "state", (zend_long) info.tcpi_state);
+	add_assoc_long(return_value, "rtt", (zend_long) info.tcpi_rtt);
+	add_assoc_long(return_value, "rttvar", (zend_long) info.tcpi_rttvar);
+	add_assoc_long(return_value, "cwnd", (zend_long) info.tcpi_snd_cwnd);
+	add_assoc_long(return_value, "ssthresh", (zend_long) info.tcpi_snd_ssthresh);
+	add_assoc_long(return_value, "mss", (zend_long) info.tcpi_snd_mss);
+	add_assoc_long(return_value, "pmtu", (zend_long) info.tcpi_pmtu);
+	add_assoc_long(return_value, "unacked", (zend_long) info.tcpi_unacked);
+	add_assoc_long(return_value, "lost", (zend_long) info.tcpi_lost);
+	add_assoc_long(return_value, "retransmits", (zend_long) info.tcpi_retransmits);
+	add_assoc_long(return_value, "total_retransmits", (zend_long) info.tcpi_total_retrans);
+#else
+	zend_throw_exception_ex(async_socket_exception_ce, 0, "TCP_INFO is not supported by the OS");
+#endif
+}
+
+static inline void call_read(async_tcp_socket *socket, zval *return_value, zend_execute_data *execute_data)
+{
+	zend_string *str;
+	zval *hint;
+	size_t len;
+	int code;
+	
+	hint = NULL;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(hint)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	if (hint == NULL || Z_TYPE_P(hint) == IS_NULL) {
+		len = socket->stream->buffer.size;
+	} else if (Z_LVAL_P(hint) < 1) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Invalid read length: %d", (int) Z_LVAL_P(hint));
+		return;
+	} else {
+		len = (size_t) Z_LVAL_P(hint);
+	}
+
+	if (Z_TYPE_P(&socket->read_error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->read_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->read_error);
+		execute_data->opline++;
+
+		return;
+	}
+
+	if (socket->read_timeout > 0) {
+		async_timer_wheel_start(&socket->scheduler->wheel, &socket->read_timer, socket->read_timeout);
+	}
+
+	code = async_stream_read_string(socket->stream, &str, len, 0);
+	
+	async_timer_wheel_stop(&socket->scheduler->wheel, &socket->read_timer);
+	
+	if (UNEXPECTED(EG(exception))) {
+		return;
+	}
+	
+	if (code > 0) {
+		touch_socket(socket);
+	
+		RETURN_STR(str);
+	}
+	
+	if (code == UV_ECANCELED && Z_TYPE_P(&socket->read_error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->read_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->read_error);
+		execute_data->opline++;
+
+		return;
+	}
+	
+	ASYNC_CHECK_EXCEPTION(code == UV_ETIMEDOUT, async_stream_exception_ce, "Read operation timed out");
+	ASYNC_CHECK_EXCEPTION(socket->stream->read.error != NULL, async_stream_exception_ce, "Reading from socket failed: %s", socket->stream->read.error);
+	ASYNC_CHECK_EXCEPTION(code < 0, async_stream_exception_ce, "Reading from socket failed: %s", uv_strerror(code));
+}
+
+ZEND_METHOD(TcpSocket, read)
+{
+	call_read((async_tcp_socket *) Z_OBJ_P(getThis()), return_value, execute_data);
+}
+
+ZEND_METHOD(TcpSocket, getReadableStream)
+{
+	async_tcp_socket *socket;
+
+	zval obj;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+
+	ZVAL_OBJ(&obj, async_socket_delegate_create(async_tcp_socket_reader_ce, &socket->std));
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+static int flush_broadcast(async_tcp_socket *socket);
+
+static void fail_broadcast(async_tcp_socket *socket, int code)
+{
+	zval error;
+	
+	// Broadcast data has been accepted already, a failed write leaves the peer with a gap in the stream.
+	if (socket->cancel.func != NULL) {
+		ASYNC_PREPARE_EXCEPTION(&error, async_stream_exception_ce, "Write operation failed: %s", uv_strerror(code));
+		
+		ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
+		
+		socket->cancel.func(socket, &error);
+		
+		zval_ptr_dtor(&error);
+	}
+}
+
+static void broadcast_cb(uv_write_t *req, int status)
+{
+	async_tcp_broadcast_batch *batch;
+	async_tcp_socket *socket;
+	
+	batch = (async_tcp_broadcast_batch *) req->data;
+	socket = (async_tcp_socket *) batch->socket;
+	
+	free_broadcast_batch(batch);
+	
+	socket->broadcasts--;
+	
+	if (UNEXPECTED(status < 0)) {
+		fail_broadcast(socket, status);
+	} else if (socket->broadcasts == 0 && socket->broadcast != NULL && socket->cancel.func != NULL) {
+		// Data that has been collected while the write was in progress is sent using a single write.
+		status = flush_broadcast(socket);
+		
+		if (UNEXPECTED(status < 0)) {
+			fail_broadcast(socket, status);
+		}
+	}
+	
+	ASYNC_DELREF(&socket->std);
+}
+
+static int flush_broadcast(async_tcp_socket *socket)
+{
+	async_tcp_broadcast_batch *batch;
+	
+	int code;
+	
+	batch = socket->broadcast;
+	
+	if (batch == NULL) {
+		return 0;
+	}
+	
+	socket->broadcast = NULL;
+	
+	batch->req.data = batch;
+	
+	code = uv_write(&batch->req, (uv_stream_t *) &socket->handle, batch->bufs, batch->count, broadcast_cb);
+	
+	if (UNEXPECTED(code < 0)) {
+		free_broadcast_batch(batch);
+		
+		return code;
+	}
+	
+	socket->broadcasts++;
+	
+	ASYNC_ADDREF(&socket->std);
+	
+	return 0;
+}
+
+static int broadcast_to(async_tcp_socket *socket, zend_string *data)
+{
+	async_tcp_broadcast_batch *batch;
+	
+	uv_buf_t bufs[1];
+	size_t offset;
+	int code;
+	
+	offset = 0;
+	
+	if (socket->broadcasts == 0 && socket->broadcast == NULL && socket->stream->writes.first == NULL) {
+		bufs[0] = uv_buf_init(ZSTR_VAL(data), (unsigned int) ZSTR_LEN(data));
+		
+		while (bufs[0].len > 0) {
+			code = uv_try_write((uv_stream_t *) &socket->handle, bufs, 1);
+			
+			if (code == UV_EAGAIN) {
+				break;
+			}
+			
+			if (code < 0) {
+				return code;
+			}
+			
+			bufs[0].base += code;
+			bufs[0].len -= code;
+			
+			offset += code;
+		}
+		
+		if (offset == ZSTR_LEN(data)) {
+			return 0;
+		}
+	}
+	
+	batch = socket->broadcast;
+	
+	if (batch == NULL) {
+		batch = ecalloc(1, sizeof(async_tcp_broadcast_batch));
+		batch->socket = socket;
+		
+		socket->broadcast = batch;
+	}
+	
+	batch->bufs[batch->count] = uv_buf_init(ZSTR_VAL(data) + offset, (unsigned int) (ZSTR_LEN(data) - offset));
+	batch->strs[batch->count] = zend_string_copy(data);
+	batch->count++;
+	batch->size += ZSTR_LEN(data) - offset;
+	
+	// Batches are sent once the previous write completes or the batch is full.
+	if (socket->broadcasts == 0 || batch->count == ASYNC_TCP_BROADCAST_BATCH) {
+		return flush_broadcast(socket);
+	}
+	
+	return 0;
+}
+
+static int flush_pending_broadcast(async_tcp_socket *socket, zend_execute_data *execute_data)
+{
+	int code;
+	
+	if (socket->broadcast == NULL) {
+		return SUCCESS;
+	}
+	
+	code = flush_broadcast(socket);
+	
+	if (EXPECTED(code >= 0)) {
+		return SUCCESS;
+	}
+	
+	fail_broadcast(socket, code);
+	
+	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->write_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->write_error);
+		execute_data->opline++;
+	} else {
+		zend_throw_exception_ex(async_stream_exception_ce, 0, "Write operation failed: %s", uv_strerror(code));
+	}
+	
+	return FAILURE;
+}
+
+static void write_data(async_tcp_socket *socket, zend_string *data, zend_execute_data *execute_data)
+{
+	if (UNEXPECTED(flush_pending_broadcast(socket, execute_data) == FAILURE)) {
+		return;
+	}
+	
+#ifdef ASYNC_TCP_ZEROCOPY
+	// Zero-copy is only used if no other writes are queued to preserve the order of the sent data.
+	if (socket->zerocopy > 0 && ZSTR_LEN(data) >= socket->zerocopy && !(socket->stream->flags & (ASYNC_STREAM_CLOSED | ASYNC_STREAM_SHUT_WR))
+		&& socket->stream->writes.first == NULL && socket->handle.write_queue_size == 0) {
+#ifdef HAVE_ASYNC_SSL
+		if (socket->stream->ssl.ssl == NULL) {
+			zerocopy_write(socket, data);
+			
+			return;
+		}
+#else
+		zerocopy_write(socket, data);
+		
+		return;
+#endif
+	}
+#endif
+	
+	async_stream_write(socket->stream, ZSTR_VAL(data), ZSTR_LEN(data));
+}
+
+static inline void call_write(async_tcp_socket *socket, zval *return_value, zend_execute_data *execute_data)
+{
+	zend_string *data;
+	zend_bool timer;
+	zend_bool timed_out;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_STR(data)
+	ZEND_PARSE_PARAMETERS_END();
+
+	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->write_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->write_error);
+		execute_data->opline++;
+
+		return;
+	}
+	
+	// Concurrent writes share the timer, it is started by the first write and stopped when no write is pending.
+	timer = (socket->write_timeout > 0);
+	
+	if (timer && socket->writing++ == 0) {
+		async_timer_wheel_start(&socket->scheduler->wheel, &socket->write_timer, socket->write_timeout);
+	}
+	
+	write_data(socket, data, execute_data);
+	
+	if (timer) {
+		timed_out = !socket->write_timer.active;
+		
+		// Completing a write is progress, the timer is restarted for writes that are still queued.
+		if (--socket->writing == 0) {
+			async_timer_wheel_stop(&socket->scheduler->wheel, &socket->write_timer);
+		} else if (!timed_out && socket->write_timeout > 0 && socket->handle.write_queue_size > 0) {
+			async_timer_wheel_start(&socket->scheduler->wheel, &socket->write_timer, socket->write_timeout);
+		}
+	} else {
+		timed_out = 0;
+	}
+	
+	if (timed_out && Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		// Report the timeout instead of the failure caused by closing the socket.
+		zend_clear_exception();
+		
+		Z_ADDREF_P(&socket->write_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->write_error);
+		execute_data->opline++;
+		
+		return;
+	}
+	
+	if (EXPECTED(EG(exception) == NULL)) {
+		touch_socket(socket);
+	}
+}
+
+ZEND_METHOD(TcpSocket, write)
+{
+	call_write((async_tcp_socket *) Z_OBJ_P(getThis()), return_value, execute_data);
+}
+
+static void write_async_cb(void *arg)
+{
+	async_tcp_socket *socket;
+	
+	socket = (async_tcp_socket *) arg;
+	
+	ZEND_ASSERT(socket != NULL);
+	
+	ASYNC_DELREF(&socket->std);
+}
+
+ZEND_METHOD(TcpSocket, writeAsync)
+{
+	async_tcp_socket *socket;
+	
+	zend_string *data;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_STR(data)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+
+	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->write_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->write_error);
+		execute_data->opline++;
+
+		return;
+	}
+	
+	if (UNEXPECTED(flush_pending_broadcast(socket, execute_data) == FAILURE)) {
+		return;
+	}
+	
+	ASYNC_ADDREF(&socket->std);
+	
+	async_stream_async_write_string(socket->stream, data, write_async_cb, socket);
+	
+	if (EXPECTED(EG(exception) == NULL)) {
+		touch_socket(socket);
+		
+		RETURN_LONG(socket->handle.write_queue_size);
+	} else {
+		ASYNC_DELREF(&socket->std);
+	}
+}
+
+ZEND_METHOD(TcpSocket, broadcast)
+{
+	async_tcp_socket *socket;
+	
+	zend_string *data;
+	zend_long limit;
+	zend_bool drop;
+	zend_ulong i;
+	zend_string *k;
+	zval *sockets;
+	zval *entry;
+	zval error;
+	zval key;
+	
+	size_t queued;
+	int code;
+	
+	limit = 0;
+	drop = 0;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 4)
+		Z_PARAM_ARRAY(sockets)
+		Z_PARAM_STR(data)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_LONG(limit)
+		Z_PARAM_BOOL(drop)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(sockets), entry) {
+		if (Z_TYPE_P(entry) != IS_OBJECT || Z_OBJCE_P(entry) != async_tcp_socket_ce) {
+			zend_throw_error(zend_ce_type_error, "All sockets must be TcpSocket objects");
+			return;
+		}
+	} ZEND_HASH_FOREACH_END();
+	
+	array_init(return_value);
+	
+	if (ZSTR_LEN(data) == 0) {
+		return;
+	}
+	
+	ZEND_HASH_FOREACH_KEY_VAL(Z_ARRVAL_P(sockets), i, k, entry) {
+		socket = (async_tcp_socket *) Z_OBJ_P(entry);
+		
+		if (k == NULL) {
+			ZVAL_LONG(&key, i);
+		} else {
+			ZVAL_STR_COPY(&key, k);
+		}
+		
+		if (Z_TYPE_P(&socket->write_error) != IS_UNDEF || socket->cancel.func == NULL || (socket->stream->flags & ASYNC_STREAM_SHUT_WR)) {
+			add_next_index_zval(return_value, &key);
+			continue;
+		}
+		
+		queued = socket->handle.write_queue_size + ((socket->broadcast == NULL) ? 0 : socket->broadcast->size);
+		
+		// Slow subscribers are skipped (or disconnected) instead of growing their write queues.
+		if (limit > 0 && (queued + ZSTR_LEN(data)) > (size_t) limit) {
+			if (drop) {
+				ASYNC_PREPARE_EXCEPTION(&error, async_stream_closed_exception_ce, "Socket has been closed due to exceeding the broadcast queue limit");
+				
+				ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
+				
+				socket->cancel.func(socket, &error);
+				
+				zval_ptr_dtor(&error);
+			}
+			
+			add_next_index_zval(return_value, &key);
+			continue;
+		}
+		
+#ifdef HAVE_ASYNC_SSL
+		// Encrypted sockets need their own copy of the data (records are encrypted per connection).
+		if (socket->stream->ssl.ssl != NULL) {
+			if (socket->broadcast != NULL) {
+				code = flush_broadcast(socket);
+				
+				if (UNEXPECTED(code < 0)) {
+					fail_broadcast(socket, code);
+					
+					add_next_index_zval(return_value, &key);
+					continue;
+				}
+			}
+			
+			ASYNC_ADDREF(&socket->std);
+			
+			async_stream_async_write_string(socket->stream, data, write_async_cb, socket);
+			
+			if (UNEXPECTED(EG(exception))) {
+				ASYNC_DELREF(&socket->std);
+				
+				zend_clear_exception();
+				
+				add_next_index_zval(return_value, &key);
+			} else {
+				zval_ptr_dtor(&key);
+			}
+			
+			continue;
+		}
+#endif
+		
+		code = broadcast_to(socket, data);
+		
+		if (code < 0) {
+			fail_broadcast(socket, code);
+			
+			add_next_index_zval(return_value, &key);
+		} else {
+			zval_ptr_dtor(&key);
+		}
+	} ZEND_HASH_FOREACH_END();
+}
+
+ZEND_METHOD(TcpSocket, getWriteQueueSize)
+{
+	async_tcp_socket *socket;
+	
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	
+	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		RETURN_LONG(0);
+	}
+	
+	RETURN_LONG(socket->handle.write_queue_size + ((socket->broadcast == NULL) ? 0 : socket->broadcast->size));
+}
+
+ZEND_METHOD(TcpSocket, getWritableStream)
+{
+	async_tcp_socket *socket;
+
+	zval obj;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+
+	ZVAL_OBJ(&obj, async_socket_delegate_create(async_tcp_socket_writer_ce, &socket->std));
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(TcpSocket, encrypt)
+{
+#ifndef HAVE_ASYNC_SSL
+	zend_throw_exception_ex(async_socket_exception_ce, 0, "Async extension was not compiled with SSL support");
+#else
+
+	async_tcp_socket *socket;
+	async_tls_server_encryption *encryption;
+	async_ssl_handshake_data handshake;
+	
+	int code;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+	encryption = NULL;
+	
+	ZEND_SECURE_ZERO(&handshake, sizeof(async_ssl_handshake_data));
+	
+	if (socket->server == NULL) {
+		socket->stream->ssl.ctx = async_ssl_create_context();
+		
+		async_ssl_setup_verify_callback(socket->stream->ssl.ctx, &socket->encryption->settings);
+		
+		handshake.settings = &socket->encryption->settings;
+		handshake.host = socket->name;
+	} else {
+		ASYNC_CHECK_EXCEPTION(socket->server->encryption == NULL, async_socket_exception_ce, "No encryption settings have been passed to TcpServer::listen()");
+
+		// SNI callback of the context refers to the encryption object, it must not be released during the handshake.
+		encryption = socket->server->encryption;
+		
+		ASYNC_ADDREF(&encryption->std);
+
+		socket->stream->ssl.ctx = socket->server->ctx;
+		
+		// The SSL engine keeps a pointer to the settings, they must outlive an encryption update of the server.
+		socket->server_settings = socket->server->settings;
+		socket->server_settings->refcount++;
+		
+		handshake.settings = &socket->server_settings->settings;
+		handshake.ref = &encryption->std;
+	}
+	
+	async_ssl_create_engine(&socket->stream->ssl);
+	async_ssl_setup_encryption(socket->stream->ssl.ssl, handshake.settings);
+	
+	uv_tcp_nodelay(&socket->handle, 1);
+	
+	code = async_stream_ssl_handshake(socket->stream, &handshake);
+
+	uv_tcp_nodelay(&socket->handle, 0);
+	
+	if (encryption != NULL) {
+		ASYNC_DELREF(&encryption->std);
+	}
+	
+	if (code == FAILURE) {
+		if (handshake.error != NULL) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "SSL handshake failed: %s", ZSTR_VAL(handshake.error));
+			zend_string_release(handshake.error);
+			return;
+		}
+	
+		if (handshake.uv_error < 0) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "SSL handshake failed due to network error: %s", uv_strerror(handshake.uv_error));
+			return;
+		}
+		
+		if (handshake.ssl_error != SSL_ERROR_NONE) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "SSL handshake failed [%d]: %s", handshake.ssl_error, ERR_reason_error_string(handshake.ssl_error));
+			return;
+		}
+	}
+	
+	if (handshake.error != NULL) {
+		zend_string_release(handshake.error);
+	}
+	
+#endif
+}
+
+ZEND_METHOD(TcpSocket, getAlpnProtocol)
+{
+	async_tcp_socket *socket;
+	
+#ifdef ASYNC_TLS_ALPN
+	const unsigned char *protocol;
+	unsigned int len;
+#endif
+	
+	ZEND_PARSE_PARAMETERS_NONE();
+	
+	socket = (async_tcp_socket *) Z_OBJ_P(getThis());
+
+#ifdef ASYNC_TLS_ALPN
+	if (socket->stream->ssl.ssl != NULL) {
+		SSL_get0_alpn_selected(socket->stream->ssl.ssl, &protocol, &len);
+		
+		if (len > 0) {
+			RETURN_STRINGL((const char *) protocol, len);
+		}
+	}
+#endif
+}
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tcp_socket_connect, 0, 2, Concurrent\\Network\\TcpSocket, 0)
+	ZEND_ARG_TYPE_INFO(0, host, IS_STRING, 0)
+	ZEND_ARG_TYPE_INFO(0, port, IS_LONG, 0)
+	ZEND_ARG_OBJ_INFO(0, tls, Concurrent\\Network\\TlsClientEncryption, 1)
+	ZEND_ARG_TYPE_INFO(0, timeout, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_pair, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_close, 0, 0, IS_VOID, 0)
+	ZEND_ARG_OBJ_INFO(0, error, Throwable, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_address, 0, 0, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_port, 0, 0, IS_LONG, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_alpn_protocol, 0, 0, IS_STRING, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_remote_address, 0, 0, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_remote_port, 0, 0, IS_LONG, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_set_option, 0, 2, _IS_BOOL, 0)
+	ZEND_ARG_TYPE_INFO(0, option, IS_LONG, 0)
+	ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_tcp_socket_get_option, 0, 0, 1)
+	ZEND_ARG_TYPE_INFO(0, option, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_tcp_info, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_read, 0, 0, IS_STRING, 1)
+	ZEND_ARG_TYPE_INFO(0, length, IS_LONG, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tcp_socket_get_readable_stream, 0, 0, Concurrent\\Stream\\ReadableStream, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_write, 0, 1, IS_VOID, 0)
+	ZEND_ARG_TYPE_INFO(0, data, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_write_async, 0, 1, IS_LONG, 0)
+	ZEND_ARG_TYPE_INFO(0, data, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_broadcast, 0, 2, IS_ARRAY, 0)
+	ZEND_ARG_TYPE_INFO(0, sockets, IS_ARRAY, 0)
+	ZEND_ARG_TYPE_INFO(0, data, IS_STRING, 0)
+	ZEND_ARG_TYPE_INFO(0, limit, IS_LONG, 0)
+	ZEND_ARG_TYPE_INFO(0, drop, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_get_write_queue_size, 0, 0, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tcp_socket_get_writable_stream, 0, 0, Concurrent\\Stream\\WritableStream, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_socket_encrypt, 0, 0, IS_VOID, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry async_tcp_socket_functions[] = {
+	ZEND_ME(TcpSocket, connect, arginfo_tcp_socket_connect, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	ZEND_ME(TcpSocket, pair, arginfo_tcp_socket_pair, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	ZEND_ME(TcpSocket, close, arginfo_tcp_socket_close, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, getAddress, arginfo_tcp_socket_get_address, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, getPort, arginfo_tcp_socket_get_port, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, setOption, arginfo_tcp_socket_set_option, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, getOption, arginfo_tcp_socket_get_option, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, getTcpInfo, arginfo_tcp_socket_get_tcp_info, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, getRemoteAddress, arginfo_tcp_socket_get_remote_address, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, getRemotePort, arginfo_tcp_socket_get_remote_port, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, read, arginfo_tcp_socket_read, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, getReadableStream, arginfo_tcp_socket_get_readable_stream, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, write, arginfo_tcp_socket_write, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, writeAsync, arginfo_tcp_socket_write_async, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, broadcast, arginfo_tcp_socket_broadcast, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	ZEND_ME(TcpSocket, getWriteQueueSize, arginfo_tcp_socket_get_write_queue_size, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, getWritableStream, arginfo_tcp_socket_get_writable_stream, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, encrypt, arginfo_tcp_socket_encrypt, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocket, getAlpnProtocol, arginfo_tcp_socket_get_alpn_protocol, ZEND_ACC_PUBLIC)
+	ZEND_FE_END
+};
+
+
+ZEND_METHOD(TcpSocketReader, close)
+{
+	async_tcp_socket *socket;
+
+	zval *val;
+
+	val = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = ASYNC_SOCKET_DELEGATE(Z_OBJ_P(getThis()), async_tcp_socket);
+
+	if (Z_TYPE_P(&socket->read_error) != IS_UNDEF) {
+		return;
+	}
+
+	async_socket_closed_error(&socket->read_error, val);
+	
+	async_stream_shutdown(socket->stream, ASYNC_STREAM_SHUT_RD);
+}
+
+ZEND_METHOD(TcpSocketReader, read)
+{
+	call_read(ASYNC_SOCKET_DELEGATE(Z_OBJ_P(getThis()), async_tcp_socket), return_value, execute_data);
+}
+
+static const zend_function_entry async_tcp_socket_reader_functions[] = {
+	ZEND_ME(TcpSocketReader, close, arginfo_tcp_socket_close, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocketReader, read, arginfo_tcp_socket_read, ZEND_ACC_PUBLIC)
+	ZEND_FE_END
+};
+
+
+ZEND_METHOD(TcpSocketWriter, close)
+{
+	async_tcp_socket *socket;
+
+	zval *val;
+
+	val = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = ASYNC_SOCKET_DELEGATE(Z_OBJ_P(getThis()), async_tcp_socket);
+
+	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		return;
+	}
+
+	if (UNEXPECTED(flush_pending_broadcast(socket, execute_data) == FAILURE)) {
+		return;
+	}
+	
+	async_socket_closed_error(&socket->write_error, val);
+	
+	async_stream_shutdown(socket->stream, ASYNC_STREAM_SHUT_WR);
+}
+
+ZEND_METHOD(TcpSocketWriter, write)
+{
+	call_write(ASYNC_SOCKET_DELEGATE(Z_OBJ_P(getThis()), async_tcp_socket), return_value, execute_data);
+}
+
+static const zend_function_entry async_tcp_socket_writer_functions[] = {
+	ZEND_ME(TcpSocketWriter, close, arginfo_tcp_socket_close, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpSocketWriter, write, arginfo_tcp_socket_write, ZEND_ACC_PUBLIC)
+	ZEND_FE_END
+};
+
+
+static void server_disposed(uv_handle_t *handle)
+{
+	async_tcp_server *server;
+
+	server = (async_tcp_server *) handle->data;
+	
+	ZEND_ASSERT(server != NULL);
+
+	ASYNC_DELREF(&server->std);
+}
+
+static void shutdown_server(void *obj, zval *error)
+{
+	async_tcp_server *server;
+	async_tcp_accept_op *op;
+	
 	server = (async_tcp_server *) obj;
 	
 	ZEND_ASSERT(server != NULL);
 	
-	server->cancel.func = NULL;
+	server->cancel.func = NULL;
+	server->batch = NULL;
+	
+	if (error != NULL && Z_TYPE_P(&server->error) == IS_UNDEF) {
+		ZVAL_COPY(&server->error, error);
+	}
+	
+	while (server->accepts.first != NULL) {
+		ASYNC_DEQUEUE_CUSTOM_OP(&server->accepts, op, async_tcp_accept_op);
+		
+		if (Z_TYPE_P(&server->error) != IS_UNDEF) {
+			ASYNC_FAIL_OP(op, &server->error);
+		} else {
+			op->code = UV_ECANCELED;
+		
+			ASYNC_FINISH_OP(op);
+		}
+	}
+	
+	if (!uv_is_closing((uv_handle_t *) &server->handle)) {
+		ASYNC_ADDREF(&server->std);
+
+		uv_close((uv_handle_t *) &server->handle, server_disposed);
+	}
+}
+
+static async_tcp_server *async_tcp_server_object_create(unsigned int af)
+{
+	async_tcp_server *server;
+
+	server = emalloc(sizeof(async_tcp_server));
+	ZEND_SECURE_ZERO(server, sizeof(async_tcp_server));
+
+	zend_object_std_init(&server->std, async_tcp_server_ce);
+	server->std.handlers = &async_tcp_server_handlers;
+	
+	server->scheduler = async_task_scheduler_get();
+	
+	ASYNC_ADDREF(&server->scheduler->std);
+	
+	server->cancel.object = server;
+	server->cancel.func = shutdown_server;
+	
+	ASYNC_Q_ENQUEUE(&server->scheduler->shutdown, &server->cancel);
+
+	// Creating the socket eagerly allows for socket options to be set before bind.
+	uv_tcp_init_ex(&server->scheduler->loop, &server->handle, af);
+
+	server->handle.data = server;
+	
+	return server;
+}
+
+static void async_tcp_server_object_dtor(zend_object *object)
+{
+	async_tcp_server *server;
+
+	server = (async_tcp_server *) object;
+
+	if (server->cancel.func != NULL) {
+		ASYNC_Q_DETACH(&server->scheduler->shutdown, &server->cancel);
+	
+		server->cancel.func(server, NULL);
+	}
+}
+
+static void async_tcp_server_object_destroy(zend_object *object)
+{
+	async_tcp_server *server;
+
+	server = (async_tcp_server *) object;
+
+#ifdef HAVE_ASYNC_SSL
+	if (server->ctx != NULL) {
+		SSL_CTX_free(server->ctx);
+	}
+	
+	if (server->settings != NULL) {
+		release_server_settings(server->settings);
+	}
+
+	if (server->encryption != NULL) {
+		ASYNC_DELREF(&server->encryption->std);
+	}
+#endif
+
+	ASYNC_DELREF(&server->scheduler->std);
+	
+	zval_ptr_dtor(&server->error);
+	
+	if (server->name != NULL) {
+		zend_string_release(server->name);
+	}
+	
+	if (server->addr != NULL) {
+		zend_string_release(server->addr);
+	}
+
+	zend_object_std_dtor(&server->std);
+}
+
+static void register_socket(async_tcp_server *server, async_tcp_socket *socket)
+{
+	socket->server = server;
+	
+	ASYNC_ADDREF(&server->std);
+	
+	server->accepted++;
+	
+	if (++server->connections >= server->max_connections && server->max_connections > 0) {
+		server->paused = 1;
+	}
+}
+
+static int accept_socket(async_tcp_server *server, async_tcp_socket **result)
+{
+	async_tcp_socket *socket;
+	
+	int code;
+	
+	socket = async_tcp_socket_object_create();
+
+	code = uv_accept((uv_stream_t *) &server->handle, (uv_stream_t *) &socket->handle);
+
+	if (UNEXPECTED(code != 0)) {
+		ASYNC_DELREF(&socket->std);
+		
+		return code;
+	}
+
+	register_socket(server, socket);
+	
+	*result = socket;
+	
+	return 0;
+}
+
+#ifndef PHP_WIN32
+/* Accepts a connection from the backlog directly, libuv only accepts a single connection per loop iteration. */
+static int accept_ready_socket(async_tcp_server *server, async_tcp_socket **result)
+{
+	async_tcp_socket *socket;
+	
+	uv_os_fd_t lfd;
+	int code;
+	int fd;
+	
+	if (0 != (code = uv_fileno((const uv_handle_t *) &server->handle, &lfd))) {
+		return code;
+	}
+	
+	do {
+#ifdef __linux__
+		fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+		fd = accept(lfd, NULL, NULL);
+#endif
+	} while (fd < 0 && errno == EINTR);
+	
+	if (fd < 0) {
+		return uv_translate_sys_error(errno);
+	}
+	
+#ifndef __linux__
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+	
+	socket = async_tcp_socket_object_create();
+	
+	code = uv_tcp_open(&socket->handle, (uv_os_sock_t) fd);
+	
+	if (UNEXPECTED(code != 0)) {
+		close(fd);
+		
+		ASYNC_DELREF(&socket->std);
+		
+		return code;
+	}
+	
+	register_socket(server, socket);
+	
+	*result = socket;
+	
+	return 0;
+}
+#endif
+
+static void dispatch_connection(async_tcp_server *server, async_tcp_accept_op *op, int status)
+{
+	op->code = status;
+	
+	if (status == 0) {
+		op->code = accept_socket(server, &op->sockets[0]);
+		
+		if (op->code == 0 && ++op->count < op->max && !server->paused) {
+			server->batch = op;
+		}
+	}
+	
+	ASYNC_FINISH_OP(op);
+}
+
+static void server_connected(uv_stream_t *stream, int status)
+{
+	async_tcp_server *server;
+	async_tcp_accept_op *op;
+
+	server = (async_tcp_server *) stream->data;
+	
+	ZEND_ASSERT(server != NULL);
+	
+	if (server->batch != NULL) {
+		op = (async_tcp_accept_op *) server->batch;
+		
+		// Accepting within the callback allows libuv to keep draining the listen socket in the same loop iteration.
+		if (status == 0 && 0 == accept_socket(server, &op->sockets[op->count])) {
+			if (++op->count == op->max || server->paused) {
+				server->batch = NULL;
+			}
+			
+			return;
+		}
+		
+		server->batch = NULL;
+	}
 	
-	if (error != NULL && Z_TYPE_P(&server->error) == IS_UNDEF) {
-		ZVAL_COPY(&server->error, error);
+	// Connections are not accepted while paused, libuv stops polling the listen socket until uv_accept() is called.
+	// Further connection attempts are queued in the kernel backlog (limited by ListenOptions::withBacklog()).
+	if (server->accepts.first == NULL || (status == 0 && server->paused)) {
+		server->pending++;
+	} else {
+		ASYNC_DEQUEUE_CUSTOM_OP(&server->accepts, op, async_tcp_accept_op);
+		
+		dispatch_connection(server, op, status);
 	}
+}
+
+static void release_connection(async_tcp_server *server)
+{
+	async_tcp_accept_op *op;
+
+	server->connections--;
 	
-	while (server->accepts.first != NULL) {
-		ASYNC_DEQUEUE_CUSTOM_OP(&server->accepts, op, async_uv_op);
+	if (!server->paused || server->connections >= server->low_watermark) {
+		return;
+	}
+	
+	server->paused = 0;
+	
+	if (server->cancel.func == NULL) {
+		return;
+	}
+	
+	while (server->pending > 0 && server->accepts.first != NULL && !server->paused) {
+		ASYNC_DEQUEUE_CUSTOM_OP(&server->accepts, op, async_tcp_accept_op);
 		
-		if (Z_TYPE_P(&server->error) != IS_UNDEF) {
-			ASYNC_FAIL_OP(op, &server->error);
-		} else {
-			op->code = UV_ECANCELED;
+		server->pending--;
 		
-			ASYNC_FINISH_OP(op);
+		dispatch_connection(server, op, 0);
+	}
+}
+
+#ifdef HAVE_ASYNC_SSL
+
+static int setup_server_encryption(async_tcp_server *server, async_tls_server_encryption *encryption)
+{
+	async_tcp_server_settings *settings;
+	SSL_CTX *ctx;
+	
+	ctx = async_ssl_get_server_context(encryption);
+	
+	if (ctx == NULL) {
+		return FAILURE;
+	}
+	
+	// Settings are rebuilt because handshakes in progress keep using the previous settings.
+	settings = ecalloc(1, sizeof(async_tcp_server_settings));
+	settings->refcount = 1;
+	
+	settings->settings.mode = ASYNC_SSL_MODE_SERVER;
+	settings->settings.kernel_tls = encryption->settings.kernel_tls;
+	settings->settings.offload_handshake = encryption->settings.offload_handshake;
+	
+	if (encryption->settings.alpn != NULL) {
+		settings->settings.alpn = zend_string_copy(encryption->settings.alpn);
+	}
+	
+	// Established connections keep a reference to the SSL context they have been created with.
+	if (server->ctx != NULL) {
+		SSL_CTX_free(server->ctx);
+	}
+	
+	if (server->encryption != NULL) {
+		ASYNC_DELREF(&server->encryption->std);
+	}
+	
+	if (server->settings != NULL) {
+		release_server_settings(server->settings);
+	}
+	
+	server->ctx = ctx;
+	server->encryption = encryption;
+	server->settings = settings;
+	
+	ASYNC_ADDREF(&encryption->std);
+	
+	return SUCCESS;
+}
+
+#endif
+
+static int setup_server_socket(async_tcp_server *server, async_listen_options *options)
+{
+	uv_os_fd_t fd;
+	int code;
+	int val;
+	
+	code = uv_fileno((const uv_handle_t *) &server->handle, &fd);
+	
+	if (UNEXPECTED(code < 0)) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to access server socket: %s", uv_strerror(code));
+		return FAILURE;
+	}
+	
+	if (options->reuse_port) {
+#ifdef SO_REUSEPORT
+		val = 1;
+		
+		if (UNEXPECTED(0 != setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (const char *) &val, sizeof(int)))) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to enable SO_REUSEPORT: %s", strerror(errno));
+			return FAILURE;
+		}
+#else
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "SO_REUSEPORT is not supported by the OS");
+		return FAILURE;
+#endif
+	}
+	
+	// Deferred accept and fast open are optimizations, they are silently skipped if not supported by the OS.
+#ifdef TCP_DEFER_ACCEPT
+	if (options->defer_accept > 0) {
+		val = options->defer_accept;
+		
+		if (UNEXPECTED(0 != setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, (const char *) &val, sizeof(int)))) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to enable TCP_DEFER_ACCEPT: %s", strerror(errno));
+			return FAILURE;
+		}
+	}
+#endif
+
+#if defined(TCP_FASTOPEN) && !defined(PHP_WIN32)
+	if (options->fast_open > 0) {
+		val = options->fast_open;
+		
+		if (UNEXPECTED(0 != setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, (const char *) &val, sizeof(int)))) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to enable TCP_FASTOPEN: %s", strerror(errno));
+			return FAILURE;
+		}
+	}
+#endif
+
+	return SUCCESS;
+}
+
+ZEND_METHOD(TcpServer, listen)
+{
+	async_tcp_server *server;
+	async_listen_options defaults;
+	async_listen_options *options;
+
+	zend_string *name;
+	zend_long port;
+
+	zval *tls;
+	zval *opts;
+	zval obj;
+
+	struct sockaddr_storage bind;
+	unsigned int flags;
+	int code;
+
+	tls = NULL;
+	opts = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 4)
+		Z_PARAM_STR(name)
+		Z_PARAM_LONG(port)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(tls)
+		Z_PARAM_OBJECT_OF_CLASS_EX(opts, async_listen_options_ce, 1, 0)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	if (opts == NULL || Z_TYPE_P(opts) == IS_NULL) {
+		ZEND_SECURE_ZERO(&defaults, sizeof(async_listen_options));
+		defaults.backlog = ASYNC_TCP_DEFAULT_BACKLOG;
+		
+		options = &defaults;
+	} else {
+		options = (async_listen_options *) Z_OBJ_P(opts);
+	}
+	
+	ZEND_SECURE_ZERO(&bind, sizeof(struct sockaddr_storage));
+	
+	// IP literals are used as-is, names are resolved preferring IPv4.
+	if (0 == uv_ip4_addr(ZSTR_VAL(name), (int) port, (struct sockaddr_in *) &bind)) {
+		code = 0;
+	} else if (0 == uv_ip6_addr(ZSTR_VAL(name), (int) port, (struct sockaddr_in6 *) &bind)) {
+		code = 0;
+	} else if (0 == (code = async_dns_lookup_ipv4(ZSTR_VAL(name), (struct sockaddr_in *) &bind, IPPROTO_TCP))) {
+		((struct sockaddr_in *) &bind)->sin_port = htons(port);
+	} else if (0 == (code = async_dns_lookup_ipv6(ZSTR_VAL(name), (struct sockaddr_in6 *) &bind, IPPROTO_TCP))) {
+		((struct sockaddr_in6 *) &bind)->sin6_port = htons(port);
+	}
+	
+	ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to assemble IP address: %s", uv_strerror(code));
+
+	server = async_tcp_server_object_create(bind.ss_family);
+	server->name = zend_string_copy(name);
+	server->port = (uint16_t) port;
+	server->max_connections = options->max_connections;
+	server->low_watermark = options->low_watermark;
+	
+	if (FAILURE == setup_server_socket(server, options)) {
+		ASYNC_DELREF(&server->std);
+		return;
+	}
+	
+	flags = (bind.ss_family == AF_INET6 && options->ipv6_only) ? UV_TCP_IPV6ONLY : 0;
+
+	code = uv_tcp_bind(&server->handle, (const struct sockaddr *) &bind, flags);
+
+	if (UNEXPECTED(code != 0)) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to bind server: %s", uv_strerror(code));
+		ASYNC_DELREF(&server->std);
+		return;
+	}
+
+	code = uv_listen((uv_stream_t *) &server->handle, options->backlog, server_connected);
+
+	if (UNEXPECTED(code != 0)) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Server failed to listen: %s", uv_strerror(code));
+		ASYNC_DELREF(&server->std);
+		return;
+	}
+
+	uv_unref((uv_handle_t *) &server->handle);
+
+	if (tls != NULL && Z_TYPE_P(tls) != IS_NULL) {
+#ifdef HAVE_ASYNC_SSL
+		if (FAILURE == setup_server_encryption(server, (async_tls_server_encryption *) Z_OBJ_P(tls))) {
+			ASYNC_DELREF(&server->std);
+			return;
 		}
+#else
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Server encryption requires async extension to be compiled with SSL support");
+		ASYNC_DELREF(&server->std);
+		return;
+#endif
 	}
 	
-	if (!uv_is_closing((uv_handle_t *) &server->handle)) {
-		ASYNC_ADDREF(&server->std);
+	assemble_peer(&server->handle, 0, &server->addr, &server->port);
 
-		uv_close((uv_handle_t *) &server->handle, server_disposed);
-	}
+	ZVAL_OBJ(&obj, &server->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
 }
 
-static async_tcp_server *async_tcp_server_object_create()
+ZEND_METHOD(TcpServer, close)
 {
 	async_tcp_server *server;
 
-	server = emalloc(sizeof(async_tcp_server));
-	ZEND_SECURE_ZERO(server, sizeof(async_tcp_server));
+	zval error;
+	zval *val;
 
-	zend_object_std_init(&server->std, async_tcp_server_ce);
-	server->std.handlers = &async_tcp_server_handlers;
-	
-	server->scheduler = async_task_scheduler_get();
-	
-	ASYNC_ADDREF(&server->scheduler->std);
+	val = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	server = (async_tcp_server *) Z_OBJ_P(getThis());
+
+	if (server->cancel.func == NULL) {
+		return;
+	}
+
+	ASYNC_PREPARE_EXCEPTION(&error, async_socket_exception_ce, "Server has been closed");
+
+	if (val != NULL && Z_TYPE_P(val) != IS_NULL) {
+		zend_exception_set_previous(Z_OBJ_P(&error), Z_OBJ_P(val));
+		GC_ADDREF(Z_OBJ_P(val));
+	}
 	
-	server->cancel.object = server;
-	server->cancel.func = shutdown_server;
+	ASYNC_Q_DETACH(&server->scheduler->shutdown, &server->cancel);
 	
-	ASYNC_Q_ENQUEUE(&server->scheduler->shutdown, &server->cancel);
+	server->cancel.func(server, &error);
 
-	uv_tcp_init(&server->scheduler->loop, &server->handle);
+	zval_ptr_dtor(&error);
+}
 
-	server->handle.data = server;
-	
-#ifdef HAVE_ASYNC_SSL
-	server->settings.mode = ASYNC_SSL_MODE_SERVER;
-#endif
+ZEND_METHOD(TcpServer, getAddress)
+{
+	async_tcp_server *server;
 
-	return server;
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	server = (async_tcp_server *) Z_OBJ_P(getThis());
+
+	RETURN_STR_COPY(server->name);
 }
 
-static void async_tcp_server_object_dtor(zend_object *object)
+ZEND_METHOD(TcpServer, getPort)
 {
 	async_tcp_server *server;
 
-	server = (async_tcp_server *) object;
+	ZEND_PARSE_PARAMETERS_NONE();
 
-	if (server->cancel.func != NULL) {
-		ASYNC_Q_DETACH(&server->scheduler->shutdown, &server->cancel);
+	server = (async_tcp_server *) Z_OBJ_P(getThis());
 	
-		server->cancel.func(server, NULL);
-	}
+	RETURN_LONG(server->port);
 }
 
-static void async_tcp_server_object_destroy(zend_object *object)
+ZEND_METHOD(TcpServer, setOption)
 {
 	async_tcp_server *server;
 
-	server = (async_tcp_server *) object;
+	zend_long option;
+	zval *val;
 
-#ifdef HAVE_ASYNC_SSL
-	if (server->ctx != NULL) {
-		SSL_CTX_free(server->ctx);
-	}
+	int code;
 
-	if (server->encryption != NULL) {
-		ASYNC_DELREF(&server->encryption->std);
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 2)
+		Z_PARAM_LONG(option)
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	server = (async_tcp_server *) Z_OBJ_P(getThis());
+	code = 0;
+
+	switch ((int) option) {
+	case ASYNC_SOCKET_TCP_SIMULTANEOUS_ACCEPTS:
+		code = uv_tcp_simultaneous_accepts(&server->handle, Z_LVAL_P(val) ? 1 : 0);
+		break;
 	}
-#endif
 
-	ASYNC_DELREF(&server->scheduler->std);
+	RETURN_BOOL((code < 0) ? 0 : 1);
+}
+
+ZEND_METHOD(TcpServer, updateEncryption)
+{
+	async_tcp_server *server;
 	
-	zval_ptr_dtor(&server->error);
+	zval *tls;
 	
-	if (server->name != NULL) {
-		zend_string_release(server->name);
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_OBJECT_OF_CLASS(tls, async_tls_server_encryption_ce)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	server = (async_tcp_server *) Z_OBJ_P(getThis());
+	
+#ifdef HAVE_ASYNC_SSL
+	if (server->cancel.func == NULL) {
+		if (Z_TYPE_P(&server->error) != IS_UNDEF) {
+			Z_ADDREF_P(&server->error);
+
+			execute_data->opline--;
+			zend_throw_exception_internal(&server->error);
+			execute_data->opline++;
+		} else {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Server has been closed");
+		}
+
+		return;
 	}
 	
-	if (server->addr != NULL) {
-		zend_string_release(server->addr);
+	// The previous settings remain active if the new certificates cannot be loaded.
+	if (UNEXPECTED(setup_server_encryption(server, (async_tls_server_encryption *) Z_OBJ_P(tls)) == FAILURE)) {
+		ASYNC_CHECK_EXCEPTION(EG(exception) == NULL, async_socket_exception_ce, "Failed to update server encryption");
+		return;
 	}
-
-	zend_object_std_dtor(&server->std);
+#else
+	zend_throw_exception_ex(async_socket_exception_ce, 0, "Server encryption requires async extension to be compiled with SSL support");
+#endif
 }
 
-static void server_connected(uv_stream_t *stream, int status)
+static int await_connection(async_tcp_server *server, async_tcp_accept_op *op, zend_execute_data *execute_data)
 {
-	async_tcp_server *server;
-	async_uv_op *op;
+	async_context *context;
+	
+	int code;
+	
+	if (Z_TYPE_P(&server->error) != IS_UNDEF) {
+		Z_ADDREF_P(&server->error);
 
-	server = (async_tcp_server *) stream->data;
+		execute_data->opline--;
+		zend_throw_exception_internal(&server->error);
+		execute_data->opline++;
+
+		return FAILURE;
+	}
 	
-	ZEND_ASSERT(server != NULL);
+	ASYNC_ENQUEUE_OP(&server->accepts, op);
 	
-	if (server->accepts.first == NULL) {
-		server->pending++;
-	} else {
-		ASYNC_DEQUEUE_CUSTOM_OP(&server->accepts, op, async_uv_op);
+	context = async_context_get();
+	
+	ASYNC_UNREF_ENTER(context, server);
+	code = async_await_op((async_op *) op);
+	ASYNC_UNREF_EXIT(context, server);
+	
+	if (server->batch == op) {
+		server->batch = NULL;
+	}
+	
+	if (code == FAILURE) {
+		ASYNC_FORWARD_OP_ERROR(op);
 		
-		op->code = status;
-				
-		ASYNC_FINISH_OP(op);
+		return FAILURE;
 	}
+	
+	return SUCCESS;
 }
 
-ZEND_METHOD(TcpServer, listen)
+ZEND_METHOD(TcpServer, getConnectionStats)
 {
 	async_tcp_server *server;
+	
+	ZEND_PARSE_PARAMETERS_NONE();
+	
+	server = (async_tcp_server *) Z_OBJ_P(getThis());
+	
+	array_init(return_value);
+	
+	add_assoc_long(return_value, "connections", (zend_long) server->connections);
+	add_assoc_long(return_value, "pending", (zend_long) server->pending);
+	add_assoc_long(return_value, "accepted", (zend_long) server->accepted);
+	add_assoc_bool(return_value, "paused", server->paused);
+}
 
-	zend_string *name;
-	zend_long port;
+ZEND_METHOD(TcpServer, accept)
+{
+	async_tcp_server *server;
+	async_tcp_socket *socket;
+	async_tcp_accept_op *op;
 
-	zval *tls;
 	zval obj;
-
-	struct sockaddr_in bind;
 	int code;
 
-	tls = NULL;
-
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 3)
-		Z_PARAM_STR(name)
-		Z_PARAM_LONG(port)
-		Z_PARAM_OPTIONAL
-		Z_PARAM_ZVAL(tls)
-	ZEND_PARSE_PARAMETERS_END();
-
-	code = async_dns_lookup_ipv4(ZSTR_VAL(name), &bind, IPPROTO_TCP);
-	
-	ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to assemble IP address: %s", uv_strerror(code));
-	
-	bind.sin_port = htons(port);
-
-	server = async_tcp_server_object_create();
-	server->name = zend_string_copy(name);
-	server->port = (uint16_t) port;
-
-	code = uv_tcp_bind(&server->handle, (const struct sockaddr *) &bind, 0);
+	ZEND_PARSE_PARAMETERS_NONE();
 
-	if (UNEXPECTED(code != 0)) {
-		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to bind server: %s", uv_strerror(code));
-		ASYNC_DELREF(&server->std);
-		return;
-	}
+	server = (async_tcp_server *) Z_OBJ_P(getThis());
 
-	code = uv_listen((uv_stream_t *) &server->handle, 128, server_connected);
+	if (server->pending == 0 || server->paused) {
+		ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_tcp_accept_op));
+		
+		op->max = 1;
+		op->sockets = &socket;
+		
+		if (FAILURE == await_connection(server, op, execute_data)) {
+			ASYNC_FREE_OP(op);
+			
+			return;
+		}
+		
+		code = op->code;
+		
+		ASYNC_FREE_OP(op);
+		
+		ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to accept socket connection: %s", uv_strerror(code));
+	} else {
+		server->pending--;
+		
+		code = accept_socket(server, &socket);
 
-	if (UNEXPECTED(code != 0)) {
-		zend_throw_exception_ex(async_socket_exception_ce, 0, "Server failed to listen: %s", uv_strerror(code));
-		ASYNC_DELREF(&server->std);
-		return;
+		ASYNC_CHECK_EXCEPTION(code != 0, async_socket_exception_ce, "Failed to accept socket connection: %s", uv_strerror(code));
 	}
+	
+	assemble_peer(&socket->handle, 0, &socket->local_addr, &socket->local_port);
+	assemble_peer(&socket->handle, 1, &socket->remote_addr, &socket->remote_port);
 
-	uv_unref((uv_handle_t *) &server->handle);
-
-	if (tls != NULL && Z_TYPE_P(tls) != IS_NULL) {
-#ifdef HAVE_ASYNC_SSL
-		server->encryption = (async_tls_server_encryption *) Z_OBJ_P(tls);
-
-		ASYNC_ADDREF(&server->encryption->std);
-
-		server->ctx = async_ssl_create_context();
-
-		SSL_CTX_set_default_passwd_cb_userdata(server->ctx, &server->encryption->cert);
+	ZVAL_OBJ(&obj, &socket->std);
 
-		SSL_CTX_use_certificate_chain_file(server->ctx, ZSTR_VAL(server->encryption->cert.file));
-		SSL_CTX_use_PrivateKey_file(server->ctx, ZSTR_VAL(server->encryption->cert.key), SSL_FILETYPE_PEM);
+	RETURN_ZVAL(&obj, 1, 1);
+}
 
-		async_ssl_setup_sni(server->ctx, server->encryption);
+ZEND_METHOD(TcpServer, acceptMany)
+{
+	async_tcp_server *server;
+	async_tcp_socket *socket;
+	async_tcp_accept_op *op;
+	
+	zend_long max;
+	
+	zval obj;
+	uint32_t i;
+	int code;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_LONG(max)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	ASYNC_CHECK_ERROR(max < 1 || max > UINT16_MAX, "Maximum number of connections must be between 1 and %d", UINT16_MAX);
+	
+	server = (async_tcp_server *) Z_OBJ_P(getThis());
+	
+	array_init(return_value);
+	
+	if (server->pending > 0 && !server->paused) {
+		// Connections that are already pending can be accepted without suspending the task.
+		while (!server->paused && zend_hash_num_elements(Z_ARRVAL_P(return_value)) < max) {
+			if (server->pending > 0) {
+				server->pending--;
+				
+				code = accept_socket(server, &socket);
+			} else {
+#ifdef PHP_WIN32
+				break;
 #else
-		zend_throw_exception_ex(async_socket_exception_ce, 0, "Server encryption requires async extension to be compiled with SSL support");
-		ASYNC_DELREF(&server->std);
-		return;
+				// Further connections in the backlog are drained until it would block.
+				code = accept_ready_socket(server, &socket);
+				
+				if (code == UV_EAGAIN) {
+					break;
+				}
 #endif
+			}
+			
+			if (UNEXPECTED(code != 0)) {
+				// Sockets that have been accepted already are returned, the error is only reported if there are none.
+				if (zend_hash_num_elements(Z_ARRVAL_P(return_value)) == 0) {
+					zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to accept socket connection: %s", uv_strerror(code));
+				}
+				
+				return;
+			}
+			
+			assemble_peer(&socket->handle, 0, &socket->local_addr, &socket->local_port);
+			assemble_peer(&socket->handle, 1, &socket->remote_addr, &socket->remote_port);
+			
+			ZVAL_OBJ(&obj, &socket->std);
+			zend_hash_next_index_insert(Z_ARRVAL_P(return_value), &obj);
+		}
+		
+		return;
+	}
+	
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_tcp_accept_op));
+	
+	op->base.flags |= ASYNC_OP_FLAG_DEFER;
+	op->max = (uint32_t) max;
+	op->sockets = emalloc(sizeof(async_tcp_socket *) * op->max);
+	
+	code = await_connection(server, op, execute_data);
+	
+	for (i = 0; i < op->count; i++) {
+		socket = op->sockets[i];
+		
+		if (code == SUCCESS) {
+			assemble_peer(&socket->handle, 0, &socket->local_addr, &socket->local_port);
+			assemble_peer(&socket->handle, 1, &socket->remote_addr, &socket->remote_port);
+			
+			ZVAL_OBJ(&obj, &socket->std);
+			zend_hash_next_index_insert(Z_ARRVAL_P(return_value), &obj);
+		} else {
+			ASYNC_DELREF(&socket->std);
+		}
 	}
 	
-	assemble_peer(&server->handle, 0, &server->addr, &server->port);
-
-	ZVAL_OBJ(&obj, &server->std);
-
-	RETURN_ZVAL(&obj, 1, 1);
+	code = (code == SUCCESS && op->count == 0) ? op->code : 0;
+	
+	efree(op->sockets);
+	ASYNC_FREE_OP(op);
+	
+	ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to accept socket connection: %s", uv_strerror(code));
 }
 
-ZEND_METHOD(TcpServer, close)
+/* Provides the handle of a TCP socket or server that is about to be transferred to another process. */
+ASYNC_API int async_tcp_export(zend_object *object, uv_stream_t **handle)
 {
+	async_tcp_socket *socket;
 	async_tcp_server *server;
 
-	zval error;
-	zval *val;
+	if (object->ce == async_tcp_socket_ce) {
+		socket = (async_tcp_socket *) object;
 
-	val = NULL;
+		if (UNEXPECTED(socket->cancel.func == NULL)) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Cannot transfer a closed socket");
+			return FAILURE;
+		}
 
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
-		Z_PARAM_OPTIONAL
-		Z_PARAM_ZVAL(val)
-	ZEND_PARSE_PARAMETERS_END();
+#ifdef HAVE_ASYNC_SSL
+		// TLS session state cannot be transferred along with the socket.
+		if (UNEXPECTED(socket->stream->ssl.ssl != NULL)) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Cannot transfer an encrypted socket");
+			return FAILURE;
+		}
+#endif
 
-	server = (async_tcp_server *) Z_OBJ_P(getThis());
+		*handle = (uv_stream_t *) &socket->handle;
 
-	if (server->cancel.func == NULL) {
-		return;
+		return SUCCESS;
 	}
 
-	ASYNC_PREPARE_EXCEPTION(&error, async_socket_exception_ce, "Server has been closed");
-
-	if (val != NULL && Z_TYPE_P(val) != IS_NULL) {
-		zend_exception_set_previous(Z_OBJ_P(&error), Z_OBJ_P(val));
-		GC_ADDREF(Z_OBJ_P(val));
-	}
-	
-	ASYNC_Q_DETACH(&server->scheduler->shutdown, &server->cancel);
-	
-	server->cancel.func(server, &error);
+	if (object->ce == async_tcp_server_ce) {
+		server = (async_tcp_server *) object;
 
-	zval_ptr_dtor(&error);
-}
+		if (UNEXPECTED(server->cancel.func == NULL)) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Cannot transfer a closed server");
+			return FAILURE;
+		}
 
-ZEND_METHOD(TcpServer, getAddress)
-{
-	async_tcp_server *server;
+		*handle = (uv_stream_t *) &server->handle;
 
-	ZEND_PARSE_PARAMETERS_NONE();
+		return SUCCESS;
+	}
 
-	server = (async_tcp_server *) Z_OBJ_P(getThis());
+	zend_throw_exception_ex(async_socket_exception_ce, 0, "Only TCP sockets and servers can be transferred");
 
-	RETURN_STR_COPY(server->name);
+	return FAILURE;
 }
 
-ZEND_METHOD(TcpServer, getPort)
+/* Accepts a TCP handle that has been received by the given IPC pipe, listening sockets are wrapped in a TcpServer. */
+ASYNC_API int async_tcp_import(zval *result, uv_stream_t *pipe)
 {
-	async_tcp_server *server;
-
-	ZEND_PARSE_PARAMETERS_NONE();
-
-	server = (async_tcp_server *) Z_OBJ_P(getThis());
-	
-	RETURN_LONG(server->port);
-}
+	async_tcp_socket *socket;
 
-ZEND_METHOD(TcpServer, setOption)
-{
+#if !defined(PHP_WIN32) && defined(SO_ACCEPTCONN)
 	async_tcp_server *server;
 
-	zend_long option;
-	zval *val;
+	uv_os_fd_t fd;
+	socklen_t len;
+	int listening;
+	int sock;
+#endif
 
 	int code;
 
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 2)
-		Z_PARAM_LONG(option)
-		Z_PARAM_ZVAL(val)
-	ZEND_PARSE_PARAMETERS_END();
+	socket = async_tcp_socket_object_create();
 
-	server = (async_tcp_server *) Z_OBJ_P(getThis());
-	code = 0;
+	code = uv_accept(pipe, (uv_stream_t *) &socket->handle);
 
-	switch ((int) option) {
-	case ASYNC_SOCKET_TCP_SIMULTANEOUS_ACCEPTS:
-		code = uv_tcp_simultaneous_accepts(&server->handle, Z_LVAL_P(val) ? 1 : 0);
-		break;
+	if (UNEXPECTED(code != 0)) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to receive handle: %s", uv_strerror(code));
+		ASYNC_DELREF(&socket->std);
+		return FAILURE;
 	}
 
-	RETURN_BOOL((code < 0) ? 0 : 1);
-}
+#if !defined(PHP_WIN32) && defined(SO_ACCEPTCONN)
+	listening = 0;
+	len = sizeof(int);
 
-ZEND_METHOD(TcpServer, accept)
-{
-	async_tcp_server *server;
-	async_tcp_socket *socket;
-	async_context *context;
-	async_uv_op *op;
+	if (0 == uv_fileno((const uv_handle_t *) &socket->handle, &fd) && 0 == getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) && listening) {
+		server = async_tcp_server_object_create(AF_UNSPEC);
 
-	zval obj;
-	int code;
+		// The listen socket is moved into the server, it keeps the backlog that has been queued by the sending process.
+		if (0 > (sock = dup(fd))) {
+			code = -errno;
+		} else if (0 != (code = uv_tcp_open(&server->handle, sock))) {
+			close(sock);
+		} else {
+			code = uv_listen((uv_stream_t *) &server->handle, ASYNC_TCP_DEFAULT_BACKLOG, server_connected);
+		}
 
-	ZEND_PARSE_PARAMETERS_NONE();
+		ASYNC_DELREF(&socket->std);
 
-	server = (async_tcp_server *) Z_OBJ_P(getThis());
+		if (UNEXPECTED(code != 0)) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to receive server: %s", uv_strerror(code));
+			ASYNC_DELREF(&server->std);
+			return FAILURE;
+		}
 
-	if (server->pending == 0) {
-		if (Z_TYPE_P(&server->error) != IS_UNDEF) {
-			Z_ADDREF_P(&server->error);
+		uv_unref((uv_handle_t *) &server->handle);
 
-			execute_data->opline--;
-			zend_throw_exception_internal(&server->error);
-			execute_data->opline++;
+		assemble_peer(&server->handle, 0, &server->addr, &server->port);
 
-			return;
-		}
-		
-		ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_uv_op));
-		ASYNC_ENQUEUE_OP(&server->accepts, op);
-		
-		context = async_context_get();
-		
-		ASYNC_UNREF_ENTER(context, server);
-		code = async_await_op((async_op *) op);
-		ASYNC_UNREF_EXIT(context, server);
-		
-		if (code == FAILURE) {
-			ASYNC_FORWARD_OP_ERROR(op);
-			ASYNC_FREE_OP(op);
-			
-			return;
+		if (UNEXPECTED(EG(exception))) {
+			ASYNC_DELREF(&server->std);
+			return FAILURE;
 		}
-		
-		code = op->code;
-		
-		ASYNC_FREE_OP(op);
-		
-		ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to await socket connection: %s", uv_strerror(code));
-	} else {
-		server->pending--;
-	}
 
-	socket = async_tcp_socket_object_create();
+		server->name = zend_string_copy(server->addr);
 
-	code = uv_accept((uv_stream_t *) &server->handle, (uv_stream_t *) &socket->handle);
+		ZVAL_OBJ(result, &server->std);
 
-	if (UNEXPECTED(code != 0)) {
-		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to accept socket connection: %s", uv_strerror(code));
-		ASYNC_DELREF(&socket->std);
-		return;
+		return SUCCESS;
 	}
+#endif
 
-	socket->server = server;
-	
 	assemble_peer(&socket->handle, 0, &socket->local_addr, &socket->local_port);
 	assemble_peer(&socket->handle, 1, &socket->remote_addr, &socket->remote_port);
 
-	ASYNC_ADDREF(&server->std);
+	if (UNEXPECTED(EG(exception))) {
+		ASYNC_DELREF(&socket->std);
+		return FAILURE;
+	}
 
-	ZVAL_OBJ(&obj, &socket->std);
+	ZVAL_OBJ(result, &socket->std);
 
-	RETURN_ZVAL(&obj, 1, 1);
+	return SUCCESS;
 }
 
 ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tcp_server_listen, 0, 2, Concurrent\\Network\\TcpServer, 0)
 	ZEND_ARG_TYPE_INFO(0, host, IS_STRING, 0)
 	ZEND_ARG_TYPE_INFO(0, port, IS_LONG, 0)
 	ZEND_ARG_OBJ_INFO(0, tls, Concurrent\\Network\\TlsServerEncryption, 1)
+	ZEND_ARG_OBJ_INFO(0, options, Concurrent\\Network\\ListenOptions, 1)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_server_close, 0, 0, IS_VOID, 0)
@@ -1421,6 +3621,17 @@ ZEND_END_ARG_INFO()
 ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_tcp_server_accept, 0, 0, Concurrent\\Network\\SocketStream, 0)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_server_get_connection_stats, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_server_accept_many, 0, 1, IS_ARRAY, 0)
+	ZEND_ARG_TYPE_INFO(0, max, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_tcp_server_update_encryption, 0, 1, IS_VOID, 0)
+	ZEND_ARG_OBJ_INFO(0, tls, Concurrent\\Network\\TlsServerEncryption, 0)
+ZEND_END_ARG_INFO()
+
 static const zend_function_entry async_tcp_server_functions[] = {
 	ZEND_ME(TcpServer, listen, arginfo_tcp_server_listen, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 	ZEND_ME(TcpServer, close, arginfo_tcp_server_close, ZEND_ACC_PUBLIC)
@@ -1428,6 +3639,219 @@ static const zend_function_entry async_tcp_server_functions[] = {
 	ZEND_ME(TcpServer, getPort, arginfo_tcp_server_get_port, ZEND_ACC_PUBLIC)
 	ZEND_ME(TcpServer, setOption, arginfo_tcp_server_set_option, ZEND_ACC_PUBLIC)
 	ZEND_ME(TcpServer, accept, arginfo_tcp_server_accept, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpServer, acceptMany, arginfo_tcp_server_accept_many, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpServer, getConnectionStats, arginfo_tcp_server_get_connection_stats, ZEND_ACC_PUBLIC)
+	ZEND_ME(TcpServer, updateEncryption, arginfo_tcp_server_update_encryption, ZEND_ACC_PUBLIC)
+	ZEND_FE_END
+};
+
+
+static zend_object *async_listen_options_object_create(zend_class_entry *ce)
+{
+	async_listen_options *options;
+
+	options = emalloc(sizeof(async_listen_options));
+	ZEND_SECURE_ZERO(options, sizeof(async_listen_options));
+
+	zend_object_std_init(&options->std, ce);
+	options->std.handlers = &async_listen_options_handlers;
+	
+	options->backlog = ASYNC_TCP_DEFAULT_BACKLOG;
+
+	return &options->std;
+}
+
+static async_listen_options *clone_listen_options(async_listen_options *options)
+{
+	async_listen_options *result;
+	
+	result = (async_listen_options *) async_listen_options_object_create(async_listen_options_ce);
+	
+	result->backlog = options->backlog;
+	result->reuse_port = options->reuse_port;
+	result->defer_accept = options->defer_accept;
+	result->fast_open = options->fast_open;
+	result->ipv6_only = options->ipv6_only;
+	result->max_connections = options->max_connections;
+	result->low_watermark = options->low_watermark;
+	
+	return result;
+}
+
+static void async_listen_options_object_destroy(zend_object *object)
+{
+	zend_object_std_dtor(object);
+}
+
+ZEND_METHOD(ListenOptions, withBacklog)
+{
+	async_listen_options *options;
+	
+	zend_long backlog;
+	zval obj;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_LONG(backlog)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	ASYNC_CHECK_ERROR(backlog < 1 || backlog > INT_MAX, "Backlog must be a positive integer");
+	
+	options = clone_listen_options((async_listen_options *) Z_OBJ_P(getThis()));
+	options->backlog = (int) backlog;
+	
+	ZVAL_OBJ(&obj, &options->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(ListenOptions, withReusePort)
+{
+	async_listen_options *options;
+	
+	zend_bool reuse;
+	zval obj;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_BOOL(reuse)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	options = clone_listen_options((async_listen_options *) Z_OBJ_P(getThis()));
+	options->reuse_port = reuse;
+	
+	ZVAL_OBJ(&obj, &options->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(ListenOptions, withDeferAccept)
+{
+	async_listen_options *options;
+	
+	zend_long seconds;
+	zval obj;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_LONG(seconds)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	ASYNC_CHECK_ERROR(seconds < 0 || seconds > INT_MAX, "Defer accept timeout must not be negative");
+	
+	options = clone_listen_options((async_listen_options *) Z_OBJ_P(getThis()));
+	options->defer_accept = (int) seconds;
+	
+	ZVAL_OBJ(&obj, &options->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(ListenOptions, withFastOpen)
+{
+	async_listen_options *options;
+	
+	zend_long queue;
+	zval obj;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_LONG(queue)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	ASYNC_CHECK_ERROR(queue < 0 || queue > INT_MAX, "Fast open queue length must not be negative");
+	
+	options = clone_listen_options((async_listen_options *) Z_OBJ_P(getThis()));
+	options->fast_open = (int) queue;
+	
+	ZVAL_OBJ(&obj, &options->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(ListenOptions, withIpv6Only)
+{
+	async_listen_options *options;
+	
+	zend_bool only;
+	zval obj;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_BOOL(only)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	options = clone_listen_options((async_listen_options *) Z_OBJ_P(getThis()));
+	options->ipv6_only = only;
+	
+	ZVAL_OBJ(&obj, &options->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(ListenOptions, withMaxConnections)
+{
+	async_listen_options *options;
+	
+	zend_long max;
+	zend_long low;
+	zend_bool nolow;
+	
+	zval obj;
+	
+	low = 0;
+	nolow = 1;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 2)
+		Z_PARAM_LONG(max)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_LONG_EX(low, nolow, 1, 0)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	ASYNC_CHECK_ERROR(max < 0 || max > UINT32_MAX, "Maximum number of connections must not be negative");
+	
+	if (nolow) {
+		low = max;
+	} else {
+		ASYNC_CHECK_ERROR(low < 1 || low > max, "Low watermark must be between 1 and the maximum number of connections");
+	}
+	
+	options = clone_listen_options((async_listen_options *) Z_OBJ_P(getThis()));
+	options->max_connections = (uint32_t) max;
+	options->low_watermark = (uint32_t) low;
+	
+	ZVAL_OBJ(&obj, &options->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_listen_options_with_backlog, 0, 1, Concurrent\\Network\\ListenOptions, 0)
+	ZEND_ARG_TYPE_INFO(0, backlog, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_listen_options_with_reuse_port, 0, 1, Concurrent\\Network\\ListenOptions, 0)
+	ZEND_ARG_TYPE_INFO(0, reuse, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_listen_options_with_defer_accept, 0, 1, Concurrent\\Network\\ListenOptions, 0)
+	ZEND_ARG_TYPE_INFO(0, seconds, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_listen_options_with_fast_open, 0, 1, Concurrent\\Network\\ListenOptions, 0)
+	ZEND_ARG_TYPE_INFO(0, queue, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_listen_options_with_ipv6_only, 0, 1, Concurrent\\Network\\ListenOptions, 0)
+	ZEND_ARG_TYPE_INFO(0, only, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_listen_options_with_max_connections, 0, 1, Concurrent\\Network\\ListenOptions, 0)
+	ZEND_ARG_TYPE_INFO(0, max, IS_LONG, 0)
+	ZEND_ARG_TYPE_INFO(0, lowWatermark, IS_LONG, 1)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry async_listen_options_functions[] = {
+	ZEND_ME(ListenOptions, withBacklog, arginfo_listen_options_with_backlog, ZEND_ACC_PUBLIC)
+	ZEND_ME(ListenOptions, withReusePort, arginfo_listen_options_with_reuse_port, ZEND_ACC_PUBLIC)
+	ZEND_ME(ListenOptions, withDeferAccept, arginfo_listen_options_with_defer_accept, ZEND_ACC_PUBLIC)
+	ZEND_ME(ListenOptions, withFastOpen, arginfo_listen_options_with_fast_open, ZEND_ACC_PUBLIC)
+	ZEND_ME(ListenOptions, withIpv6Only, arginfo_listen_options_with_ipv6_only, ZEND_ACC_PUBLIC)
+	ZEND_ME(ListenOptions, withMaxConnections, arginfo_listen_options_with_max_connections, ZEND_ACC_PUBLIC)
 	ZEND_FE_END
 };
 
@@ -1436,6 +3860,15 @@ void async_tcp_ce_register()
 {
 	zend_class_entry ce;
 	
+	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\ListenOptions", async_listen_options_functions);
+	async_listen_options_ce = zend_register_internal_class(&ce);
+	async_listen_options_ce->ce_flags |= ZEND_ACC_FINAL;
+	async_listen_options_ce->create_object = async_listen_options_object_create;
+
+	memcpy(&async_listen_options_handlers, &std_object_handlers, sizeof(zend_object_handlers));
+	async_listen_options_handlers.free_obj = async_listen_options_object_destroy;
+	async_listen_options_handlers.clone_obj = NULL;
+	
 	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\TcpSocket", async_tcp_socket_functions);
 	async_tcp_socket_ce = zend_register_internal_class(&ce);
 	async_tcp_socket_ce->ce_flags |= ZEND_ACC_FINAL;
@@ -1451,6 +3884,18 @@ void async_tcp_ce_register()
 
 	ASYNC_TCP_SOCKET_CONST("NODELAY", ASYNC_SOCKET_TCP_NODELAY);
 	ASYNC_TCP_SOCKET_CONST("KEEPALIVE", ASYNC_SOCKET_TCP_KEEPALIVE);
+	ASYNC_TCP_SOCKET_CONST("SNDBUF", ASYNC_SOCKET_TCP_SNDBUF);
+	ASYNC_TCP_SOCKET_CONST("RCVBUF", ASYNC_SOCKET_TCP_RCVBUF);
+	ASYNC_TCP_SOCKET_CONST("QUICKACK", ASYNC_SOCKET_TCP_QUICKACK);
+	ASYNC_TCP_SOCKET_CONST("NOTSENT_LOWAT", ASYNC_SOCKET_TCP_NOTSENT_LOWAT);
+	ASYNC_TCP_SOCKET_CONST("USER_TIMEOUT", ASYNC_SOCKET_TCP_USER_TIMEOUT);
+	ASYNC_TCP_SOCKET_CONST("BUSY_POLL", ASYNC_SOCKET_TCP_BUSY_POLL);
+	ASYNC_TCP_SOCKET_CONST("LINGER", ASYNC_SOCKET_TCP_LINGER);
+	ASYNC_TCP_SOCKET_CONST("TOS", ASYNC_SOCKET_TCP_TOS);
+	ASYNC_TCP_SOCKET_CONST("ZEROCOPY", ASYNC_SOCKET_TCP_ZEROCOPY);
+	ASYNC_TCP_SOCKET_CONST("READ_TIMEOUT", ASYNC_SOCKET_TCP_READ_TIMEOUT);
+	ASYNC_TCP_SOCKET_CONST("WRITE_TIMEOUT", ASYNC_SOCKET_TCP_WRITE_TIMEOUT);
+	ASYNC_TCP_SOCKET_CONST("IDLE_TIMEOUT", ASYNC_SOCKET_TCP_IDLE_TIMEOUT);
 
 	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\TcpSocketReader", async_tcp_socket_reader_functions);
 	async_tcp_socket_reader_ce = zend_register_internal_class(&ce);
@@ -1460,10 +3905,6 @@ void async_tcp_ce_register()
 
 	zend_class_implements(async_tcp_socket_reader_ce, 1, async_readable_stream_ce);
 
-	memcpy(&async_tcp_socket_reader_handlers, &std_object_handlers, sizeof(zend_object_handlers));
-	async_tcp_socket_reader_handlers.free_obj = async_tcp_socket_reader_object_destroy;
-	async_tcp_socket_reader_handlers.clone_obj = NULL;
-
 	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\TcpSocketWriter", async_tcp_socket_writer_functions);
 	async_tcp_socket_writer_ce = zend_register_internal_class(&ce);
 	async_tcp_socket_writer_ce->ce_flags |= ZEND_ACC_FINAL;
@@ -1472,10 +3913,6 @@ void async_tcp_ce_register()
 
 	zend_class_implements(async_tcp_socket_writer_ce, 1, async_writable_stream_ce);
 
-	memcpy(&async_tcp_socket_writer_handlers, &std_object_handlers, sizeof(zend_object_handlers));
-	async_tcp_socket_writer_handlers.free_obj = async_tcp_socket_writer_object_destroy;
-	async_tcp_socket_writer_handlers.clone_obj = NULL;
-
 	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\TcpServer", async_tcp_server_functions);
 	async_tcp_server_ce = zend_register_internal_class(&ce);
 	async_tcp_server_ce->ce_flags |= ZEND_ACC_FINAL;
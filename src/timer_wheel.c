@@ -0,0 +1,168 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-2018 The PHP Group                                |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Martin Schröder <m.schroeder2007@gmail.com>                 |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_async.h"
+
+#define ASYNC_TIMER_WHEEL_EXPIRED ASYNC_TIMER_WHEEL_SLOTS
+
+static void link_entry(async_timer_wheel *wheel, async_timer_wheel_entry *entry, uint16_t slot)
+{
+	entry->slot = slot;
+	entry->prev = NULL;
+	entry->next = wheel->slots[slot];
+	
+	if (entry->next != NULL) {
+		entry->next->prev = entry;
+	}
+	
+	wheel->slots[slot] = entry;
+}
+
+static void unlink_entry(async_timer_wheel *wheel, async_timer_wheel_entry *entry)
+{
+	if (entry->prev == NULL) {
+		wheel->slots[entry->slot] = entry->next;
+	} else {
+		entry->prev->next = entry->next;
+	}
+	
+	if (entry->next != NULL) {
+		entry->next->prev = entry->prev;
+	}
+	
+	entry->prev = NULL;
+	entry->next = NULL;
+}
+
+static void process_slot(async_timer_wheel *wheel, uint32_t slot)
+{
+	async_timer_wheel_entry *entry;
+	async_timer_wheel_entry *next;
+	
+	entry = wheel->slots[slot];
+	
+	// Expired entries are moved to a separate list first, callbacks may stop or reschedule any entry.
+	while (entry != NULL) {
+		next = entry->next;
+		
+		if (entry->rounds == 0) {
+			unlink_entry(wheel, entry);
+			link_entry(wheel, entry, ASYNC_TIMER_WHEEL_EXPIRED);
+		} else {
+			entry->rounds--;
+		}
+		
+		entry = next;
+	}
+	
+	while (NULL != (entry = wheel->slots[ASYNC_TIMER_WHEEL_EXPIRED])) {
+		unlink_entry(wheel, entry);
+		
+		entry->active = 0;
+		wheel->count--;
+		
+		entry->func(entry);
+	}
+}
+
+static void advance_wheel(uv_timer_t *timer)
+{
+	async_timer_wheel *wheel;
+	
+	uint64_t now;
+	
+	wheel = (async_timer_wheel *) timer->data;
+	
+	ZEND_ASSERT(wheel != NULL);
+	
+	now = uv_now(timer->loop);
+	
+	// Catch up with all ticks that have passed if the loop has been blocked.
+	while (wheel->count > 0 && (wheel->now + ASYNC_TIMER_WHEEL_RESOLUTION) <= now) {
+		wheel->now += ASYNC_TIMER_WHEEL_RESOLUTION;
+		wheel->cursor = (wheel->cursor + 1) % ASYNC_TIMER_WHEEL_SLOTS;
+		
+		process_slot(wheel, wheel->cursor);
+	}
+	
+	if (wheel->count == 0) {
+		uv_timer_stop(timer);
+	}
+}
+
+ASYNC_API void async_timer_wheel_init(async_timer_wheel *wheel, uv_loop_t *loop)
+{
+	uv_timer_init(loop, &wheel->timer);
+	uv_unref((uv_handle_t *) &wheel->timer);
+	
+	wheel->timer.data = wheel;
+}
+
+ASYNC_API void async_timer_wheel_close(async_timer_wheel *wheel)
+{
+	if (!uv_is_closing((uv_handle_t *) &wheel->timer)) {
+		uv_close((uv_handle_t *) &wheel->timer, NULL);
+	}
+}
+
+ASYNC_API void async_timer_wheel_start(async_timer_wheel *wheel, async_timer_wheel_entry *entry, uint64_t timeout)
+{
+	uint64_t ticks;
+	
+	ZEND_ASSERT(entry->func != NULL);
+	
+	if (entry->active) {
+		unlink_entry(wheel, entry);
+	} else {
+		entry->active = 1;
+		
+		if (wheel->count++ == 0) {
+			wheel->now = uv_now(wheel->timer.loop);
+			
+			uv_timer_start(&wheel->timer, advance_wheel, ASYNC_TIMER_WHEEL_RESOLUTION, ASYNC_TIMER_WHEEL_RESOLUTION);
+		}
+	}
+	
+	// Timeouts are rounded up to the next tick, the time since the last tick is added to never expire early.
+	ticks = (timeout + (uv_now(wheel->timer.loop) - wheel->now) + ASYNC_TIMER_WHEEL_RESOLUTION - 1) / ASYNC_TIMER_WHEEL_RESOLUTION;
+	
+	if (ticks == 0) {
+		ticks = 1;
+	}
+	
+	entry->rounds = (ticks - 1) / ASYNC_TIMER_WHEEL_SLOTS;
+	
+	link_entry(wheel, entry, (uint16_t) ((wheel->cursor + ticks) % ASYNC_TIMER_WHEEL_SLOTS));
+}
+
+ASYNC_API int async_timer_wheel_stop(async_timer_wheel *wheel, async_timer_wheel_entry *entry)
+{
+	if (!entry->active) {
+		return 0;
+	}
+	
+	unlink_entry(wheel, entry);
+	
+	entry->active = 0;
+	
+	if (--wheel->count == 0) {
+		uv_timer_stop(&wheel->timer);
+	}
+	
+	return 1;
+}
@@ -20,7 +20,13 @@
 
 #include "async_task.h"
 
+#ifndef PHP_WIN32
+#include <fcntl.h>
+#endif
+
 #define ASYNC_SOCKET_UDP_TTL 200
+#define ASYNC_SOCKET_UDP_SEGMENT_SIZE 201
+#define ASYNC_SOCKET_UDP_MAX_DATAGRAM_SIZE 202
 #define ASYNC_SOCKET_UDP_MULTICAST_LOOP 250
 #define ASYNC_SOCKET_UDP_MULTICAST_TTL 251
 
@@ -36,6 +42,35 @@ static zend_object *async_udp_datagram_object_create(zend_class_entry *ce);
 	zend_declare_class_constant_long(async_udp_socket_ce, name, sizeof(name)-1, (zend_long)value);
 
 #define ASYNC_UDP_FLAG_RECEIVING 1
+#define ASYNC_UDP_FLAG_CONNECTED 2
+
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define ASYNC_UDP_RECVMMSG 1
+#define ASYNC_UDP_SENDMMSG 1
+#include <netinet/udp.h>
+#endif
+
+#if defined(ASYNC_UDP_SENDMMSG) && defined(UDP_SEGMENT)
+#define ASYNC_UDP_GSO 1
+#endif
+
+/* Maximum number of segments being sent using a single GSO send (kernel limit). */
+#define ASYNC_UDP_GSO_MAX_SEGMENTS 64
+
+/* Maximum payload size of a UDP datagram over IPv4. */
+#define ASYNC_UDP_MAX_PAYLOAD 65507
+
+/* Maximum number of datagrams being received by a single recvmmsg() call. */
+#define ASYNC_UDP_BATCH_SIZE 32
+
+/* Default (and maximum) size of a received datagram. */
+#define ASYNC_UDP_MAX_DATAGRAM_SIZE 65536
+
+/* Maximum amount of memory being retained by pooled receive buffers of a socket. */
+#define ASYNC_UDP_POOL_MEMORY 262144
+
+/* Maximum number of peer addresses being cached by a socket. */
+#define ASYNC_UDP_PEER_CACHE_SIZE 256
 
 typedef struct {
 	zend_object std;
@@ -45,6 +80,25 @@ typedef struct {
 	zend_long port;
 } async_udp_datagram;
 
+typedef struct _async_udp_peer async_udp_peer;
+
+struct _async_udp_peer {
+	/* Binary IP address (4 bytes for IPv4, 16 bytes for IPv6). */
+	char key[16];
+	uint8_t len;
+	
+	/* Formatted IP address being shared by all datagrams received from the peer. */
+	zend_string *address;
+	
+	async_udp_peer *prev;
+	async_udp_peer *next;
+};
+
+typedef struct {
+	async_udp_peer *first;
+	async_udp_peer *last;
+} async_udp_peer_list;
+
 typedef struct {
 	zend_object std;
 	
@@ -63,8 +117,56 @@ typedef struct {
 	async_op_queue receivers;
 	async_op_queue senders;
 	async_cancel_cb cancel;
+	
+	/* Size of receive buffers, larger datagrams are truncated. */
+	uint32_t max_size;
+	
+	/* Pool of reusable receive buffers (strings of max_size bytes). */
+	zend_string *pool[ASYNC_UDP_BATCH_SIZE];
+	uint32_t pooled;
+	
+	/* Segment size being used to coalesce equal-size datagrams into GSO sends (0 = disabled). */
+	uint16_t segment_size;
+	
+	/* Address of the remote peer of a connected socket. */
+	struct sockaddr_in remote;
+	
+	/* Datagrams of an interrupted batch receive that are returned by the next receive call. */
+	zval backlog;
+	
+	/* Receive error that is reported by the next receive call (after a batch receive returned partial results). */
+	int receive_error;
+	
+#ifndef PHP_WIN32
+	/* Poll handle (using a duplicated descriptor) that reports a connected socket becoming writable. */
+	uv_poll_t *poll;
+	uv_os_fd_t poll_fd;
+	
+	/* Queue of tasks waiting to write to a connected socket. */
+	async_op_queue writers;
+#endif
+	
+	/* Cached peer addresses indexed by binary IP address. */
+	HashTable peers;
+	
+	/* Cached peer addresses ordered from least to most recently used. */
+	async_udp_peer_list lru;
 } async_udp_socket;
 
+typedef struct {
+	async_op base;
+	int code;
+	
+	/* Maximum number of datagrams to be received (0 = receive a single datagram). */
+	uint32_t max;
+	
+	/* Receive the payload of a single datagram as string (skips creation of a datagram object). */
+	zend_bool raw;
+	
+	/* Array of datagrams that have been received by a batch receive operation. */
+	zval datagrams;
+} async_udp_receive_op;
+
 typedef struct {
 	async_op base;
 	async_udp_socket *socket;
@@ -106,6 +208,124 @@ static void assemble_peer(async_udp_socket *socket, zval *return_value, zend_exe
 	socket->port = port;
 }
 
+static zend_always_inline uint32_t pool_capacity(async_udp_socket *socket)
+{
+	return MAX(1, MIN(ASYNC_UDP_BATCH_SIZE, ASYNC_UDP_POOL_MEMORY / socket->max_size));
+}
+
+static zend_always_inline zend_string *acquire_buffer(async_udp_socket *socket)
+{
+	if (socket->pooled > 0) {
+		return socket->pool[--socket->pooled];
+	}
+	
+	return zend_string_alloc(socket->max_size, 0);
+}
+
+static zend_always_inline void release_buffer(async_udp_socket *socket, zend_string *str)
+{
+	if (socket->pooled < pool_capacity(socket)) {
+		socket->pool[socket->pooled++] = str;
+	} else {
+		zend_string_efree(str);
+	}
+}
+
+static zend_string *take_buffer(async_udp_socket *socket, zend_string *str, size_t len)
+{
+	zend_string *data;
+	
+	// Large datagrams keep the receive buffer as payload, small datagrams are copied to avoid wasting memory.
+	if ((len * 2) >= socket->max_size) {
+		ZSTR_LEN(str) = len;
+		ZSTR_VAL(str)[len] = '\0';
+		
+		return str;
+	}
+	
+	data = zend_string_init(ZSTR_VAL(str), len, 0);
+	
+	release_buffer(socket, str);
+	
+	return data;
+}
+
+static void flush_pool(async_udp_socket *socket)
+{
+	while (socket->pooled > 0) {
+		zend_string_efree(socket->pool[--socket->pooled]);
+	}
+}
+
+static zend_string *peer_address(async_udp_socket *socket, const struct sockaddr *addr)
+{
+	async_udp_peer *peer;
+	
+	char name[64] = { 0 };
+	char key[16];
+	uint8_t len;
+	
+	if (addr->sa_family == AF_INET6) {
+		memcpy(key, &((const struct sockaddr_in6 *) addr)->sin6_addr, 16);
+		len = 16;
+	} else {
+		memcpy(key, &((const struct sockaddr_in *) addr)->sin_addr, 4);
+		len = 4;
+	}
+	
+	peer = (async_udp_peer *) zend_hash_str_find_ptr(&socket->peers, key, len);
+	
+	if (EXPECTED(peer != NULL)) {
+		if (peer != socket->lru.last) {
+			ASYNC_Q_DETACH(&socket->lru, peer);
+			ASYNC_Q_ENQUEUE(&socket->lru, peer);
+		}
+		
+		return peer->address;
+	}
+	
+	if (addr->sa_family == AF_INET6) {
+		uv_ip6_name((const struct sockaddr_in6 *) addr, name, sizeof(name) - 1);
+	} else {
+		uv_ip4_name((const struct sockaddr_in *) addr, name, sizeof(name) - 1);
+	}
+	
+	// The least recently used peer is replaced once the cache is full.
+	if (zend_hash_num_elements(&socket->peers) < ASYNC_UDP_PEER_CACHE_SIZE) {
+		peer = emalloc(sizeof(async_udp_peer));
+	} else {
+		ASYNC_Q_DEQUEUE(&socket->lru, peer);
+		
+		zend_hash_str_del(&socket->peers, peer->key, peer->len);
+		zend_string_release(peer->address);
+	}
+	
+	memcpy(peer->key, key, len);
+	
+	peer->len = len;
+	peer->address = zend_string_init(name, strlen(name), 0);
+	
+	zend_hash_str_add_ptr(&socket->peers, key, len, peer);
+	
+	ASYNC_Q_ENQUEUE(&socket->lru, peer);
+	
+	return peer->address;
+}
+
+static void flush_peers(async_udp_socket *socket)
+{
+	async_udp_peer *peer;
+	
+	zend_hash_clean(&socket->peers);
+	
+	while (socket->lru.first != NULL) {
+		ASYNC_Q_DEQUEUE(&socket->lru, peer);
+		
+		zend_string_release(peer->address);
+		efree(peer);
+	}
+}
+
 static void socket_closed(uv_handle_t *handle)
 {
 	async_udp_socket *socket;
@@ -117,6 +337,25 @@ static void socket_closed(uv_handle_t *handle)
 	ASYNC_DELREF(&socket->std);
 }
 
+#ifndef PHP_WIN32
+static void poll_closed(uv_handle_t *handle)
+{
+	async_udp_socket *socket;
+	
+	socket = (async_udp_socket *) handle->data;
+	
+	ZEND_ASSERT(socket != NULL);
+	
+	close(socket->poll_fd);
+	
+	socket->poll = NULL;
+	
+	efree(handle);
+	
+	ASYNC_DELREF(&socket->std);
+}
+#endif
+
 static void socket_shutdown(void *obj, zval *error)
 {
 	async_udp_socket *socket;
@@ -141,7 +380,13 @@ static void socket_shutdown(void *obj, zval *error)
 	if (error != NULL) {
 		while (socket->receivers.first != NULL) {
 			ASYNC_DEQUEUE_OP(&socket->receivers, op);
-			ASYNC_FAIL_OP(op, &socket->error);
+			
+			// Batch receive operations return the datagrams received so far, the error is thrown by the next call.
+			if (Z_TYPE_P(&((async_udp_receive_op *) op)->datagrams) == IS_ARRAY) {
+				ASYNC_FINISH_OP(op);
+			} else {
+				ASYNC_FAIL_OP(op, &socket->error);
+			}
 		}
 		
 		while (socket->senders.first != NULL) {
@@ -149,6 +394,26 @@ static void socket_shutdown(void *obj, zval *error)
 			ASYNC_FAIL_OP(op, &socket->error);
 		}
 	}
+	
+#ifndef PHP_WIN32
+	while (socket->writers.first != NULL) {
+		ASYNC_DEQUEUE_OP(&socket->writers, op);
+		
+		if (Z_TYPE_P(&socket->error) != IS_UNDEF) {
+			ASYNC_FAIL_OP(op, &socket->error);
+		} else {
+			((async_udp_send_op *) op)->code = UV_ECANCELED;
+			
+			ASYNC_FINISH_OP(op);
+		}
+	}
+	
+	if (socket->poll != NULL && !uv_is_closing((uv_handle_t *) socket->poll)) {
+		ASYNC_ADDREF(&socket->std);
+		
+		uv_close((uv_handle_t *) socket->poll, poll_closed);
+	}
+#endif
 }
 
 
@@ -169,9 +434,14 @@ static async_udp_socket *async_udp_socket_object_create()
 	uv_udp_init(&socket->scheduler->loop, &socket->handle);
 	socket->handle.data = socket;
 	
+	socket->max_size = ASYNC_UDP_MAX_DATAGRAM_SIZE;
+	
+	zend_hash_init(&socket->peers, 0, NULL, NULL, 0);
+	
 	uv_unref((uv_handle_t *) &socket->handle);
 	
 	ZVAL_UNDEF(&socket->error);
+	ZVAL_UNDEF(&socket->backlog);
 	
 	socket->cancel.object = socket;
 	socket->cancel.func = socket_shutdown;
@@ -201,6 +471,7 @@ static void async_udp_socket_object_destroy(zend_object *object)
 	socket = (async_udp_socket *) object;
 	
 	zval_ptr_dtor(&socket->error);
+	zval_ptr_dtor(&socket->backlog);
 
 	if (socket->name != NULL) {
 		zend_string_release(socket->name);
@@ -210,6 +481,11 @@ static void async_udp_socket_object_destroy(zend_object *object)
 		zend_string_release(socket->ip);
 	}
 	
+	flush_pool(socket);
+	flush_peers(socket);
+	
+	zend_hash_destroy(&socket->peers);
+	
 	ASYNC_DELREF(&socket->scheduler->std);
 	
 	zend_object_std_dtor(&socket->std);
@@ -224,7 +500,7 @@ ZEND_METHOD(UdpSocket, bind)
 	
 	zval obj;
 	
-	struct sockaddr_in dest;
+	struct sockaddr_storage dest;
 	int code;
 	
 	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 2)
@@ -232,11 +508,14 @@ ZEND_METHOD(UdpSocket, bind)
 		Z_PARAM_LONG(port)
 	ZEND_PARSE_PARAMETERS_END();
 	
-	code = async_dns_lookup_ipv4(ZSTR_VAL(name), &dest, IPPROTO_UDP);
-	
-	ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to assemble IP address: %s", uv_strerror(code));
-	
-	dest.sin_port = htons(port);
+	// IPv6 addresses are bound as given, host names are resolved to an IPv4 address.
+	if (0 != uv_ip6_addr(ZSTR_VAL(name), (int) port, (struct sockaddr_in6 *) &dest)) {
+		code = async_dns_lookup_ipv4(ZSTR_VAL(name), (struct sockaddr_in *) &dest, IPPROTO_UDP);
+		
+		ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to assemble IP address: %s", uv_strerror(code));
+		
+		((struct sockaddr_in *) &dest)->sin_port = htons(port);
+	}
 	
 	socket = async_udp_socket_object_create();
 	socket->name = zend_string_copy(name);
@@ -317,6 +596,76 @@ ZEND_METHOD(UdpSocket, multicast)
 	RETURN_ZVAL(&obj, 1, 1);
 }
 
+ZEND_METHOD(UdpSocket, connect)
+{
+	async_udp_socket *socket;
+
+	zend_string *name;
+	zend_long port;
+	
+	zval obj;
+	
+	struct sockaddr_in local;
+	struct sockaddr_in dest;
+	uv_os_fd_t fd;
+	int code;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 2)
+		Z_PARAM_STR(name)
+		Z_PARAM_LONG(port)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	code = async_dns_lookup_ipv4(ZSTR_VAL(name), &dest, IPPROTO_UDP);
+	
+	ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to assemble IP address: %s", uv_strerror(code));
+	
+	dest.sin_port = htons(port);
+	
+	socket = async_udp_socket_object_create();
+	socket->name = zend_string_copy(name);
+	
+	uv_ip4_addr("0.0.0.0", 0, &local);
+	
+	code = uv_udp_bind(&socket->handle, (const struct sockaddr *) &local, 0);
+	
+	if (UNEXPECTED(code != 0)) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to bind UDP socket: %s", uv_strerror(code));
+		ASYNC_DELREF(&socket->std);
+		return;
+	}
+	
+	// libuv does not support connected UDP sockets yet, the socket is connected using the OS API.
+	if (0 == (code = uv_fileno((const uv_handle_t *) &socket->handle, &fd))) {
+		if (0 != connect((uv_os_sock_t) fd, (const struct sockaddr *) &dest, sizeof(struct sockaddr_in))) {
+#ifdef PHP_WIN32
+			code = uv_translate_sys_error(WSAGetLastError());
+#else
+			code = uv_translate_sys_error(errno);
+#endif
+		}
+	}
+	
+	if (UNEXPECTED(code != 0)) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to connect UDP socket: %s", uv_strerror(code));
+		ASYNC_DELREF(&socket->std);
+		return;
+	}
+	
+	socket->remote = dest;
+	socket->flags |= ASYNC_UDP_FLAG_CONNECTED;
+	
+	assemble_peer(socket, return_value, execute_data);
+	
+	if (UNEXPECTED(EG(exception))) {
+		ASYNC_DELREF(&socket->std);
+		return;
+	}
+	
+	ZVAL_OBJ(&obj, &socket->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
 ZEND_METHOD(UdpSocket, close)
 {
 	async_udp_socket *socket;
@@ -380,6 +729,11 @@ ZEND_METHOD(UdpSocket, setOption)
 	zend_long option;
 	zval *val;
 
+#ifdef ASYNC_UDP_GSO
+	uv_os_fd_t fd;
+	socklen_t len;
+	int num;
+#endif
 	int code;
 
 	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 2)
@@ -400,45 +754,125 @@ ZEND_METHOD(UdpSocket, setOption)
 	case ASYNC_SOCKET_UDP_MULTICAST_TTL:
 		code = uv_udp_set_multicast_ttl(&socket->handle, (int) Z_LVAL_P(val));
 		break;
+	case ASYNC_SOCKET_UDP_MAX_DATAGRAM_SIZE:
+		if (zval_get_long(val) < 1 || zval_get_long(val) > ASYNC_UDP_MAX_DATAGRAM_SIZE) {
+			code = UV_EINVAL;
+		} else if (socket->max_size != (uint32_t) zval_get_long(val)) {
+			socket->max_size = (uint32_t) zval_get_long(val);
+			
+			flush_pool(socket);
+		}
+		break;
+	case ASYNC_SOCKET_UDP_SEGMENT_SIZE:
+#ifdef ASYNC_UDP_GSO
+		if (zval_get_long(val) < 0 || zval_get_long(val) > ASYNC_UDP_MAX_PAYLOAD) {
+			code = UV_EINVAL;
+		} else if (0 == (code = uv_fileno((const uv_handle_t *) &socket->handle, &fd))) {
+			len = sizeof(int);
+			
+			// Probe for kernel support of UDP GSO, segments are only sent if the socket option is known.
+			if (0 != getsockopt(fd, SOL_UDP, UDP_SEGMENT, &num, &len)) {
+				code = -errno;
+			} else {
+				socket->segment_size = (uint16_t) zval_get_long(val);
+			}
+		}
+#else
+		code = UV_ENOTSUP;
+#endif
+		break;
 	}
 
 	RETURN_BOOL((code < 0) ? 0 : 1);
 }
 
+static async_udp_datagram *create_datagram(async_udp_socket *socket, zend_string *data, const struct sockaddr *addr)
+{
+	async_udp_datagram *datagram;
+	
+	datagram = (async_udp_datagram *) async_udp_datagram_object_create(async_udp_datagram_ce);
+	datagram->data = data;
+	datagram->address = zend_string_copy(peer_address(socket, addr));
+	
+	if (addr->sa_family == AF_INET6) {
+		datagram->port = ntohs(((const struct sockaddr_in6 *) addr)->sin6_port);
+	} else {
+		datagram->port = ntohs(((const struct sockaddr_in *) addr)->sin_port);
+	}
+	
+	return datagram;
+}
+
 static void socket_received(uv_udp_t *udp, ssize_t nread, const uv_buf_t *buffer, const struct sockaddr* addr, unsigned int flags)
 {
 	async_udp_socket *socket;
 	async_udp_datagram *datagram;
-	async_uv_op *op;
+	async_udp_receive_op *op;
 	
-	char peer[17] = { 0 };
+	zend_string *str;
+	zval obj;
 	
 	socket = (async_udp_socket *) udp->data;
 	
 	ZEND_ASSERT(socket != NULL);
 	ZEND_ASSERT(socket->receivers.first != NULL);
 	
+	op = (async_udp_receive_op *) socket->receivers.first;
+	str = (zend_string *) (buffer->base - XtOffsetOf(zend_string, val));
+	
 	if (nread == 0) {
-		efree(buffer->base);
+		release_buffer(socket, str);
+		
+		// No more datagrams are available, batch receive operations are completed with all datagrams received so far.
+		if (addr == NULL && op->max > 0 && Z_TYPE_P(&op->datagrams) == IS_ARRAY) {
+			ASYNC_DEQUEUE_CUSTOM_OP(&socket->receivers, op, async_udp_receive_op);
+			ASYNC_FINISH_OP(op);
+			
+			if (socket->receivers.first == NULL) {
+				uv_udp_recv_stop(udp);
+				
+				socket->flags &= ~ASYNC_UDP_FLAG_RECEIVING;
+			}
+		}
 		
 		return;
 	}
 	
-	ASYNC_DEQUEUE_CUSTOM_OP(&socket->receivers, op, async_uv_op);
-	
 	if (nread > 0) {
-		uv_ip4_name((struct sockaddr_in *) addr, peer, 16);
-		
-		datagram = (async_udp_datagram *) async_udp_datagram_object_create(async_udp_datagram_ce);
-		datagram->data = zend_string_init(buffer->base, (int) nread, 0);
-		datagram->address = zend_string_init(peer, strlen(peer), 0);
-		datagram->port = ntohs(((struct sockaddr_in *) addr)->sin_port);
-		
-		efree(buffer->base);
+		if (op->raw) {
+			ZVAL_STR(&op->base.result, take_buffer(socket, str, (size_t) nread));
+		} else if (op->max == 0) {
+			datagram = create_datagram(socket, take_buffer(socket, str, (size_t) nread), addr);
+			
+			ZVAL_OBJ(&op->base.result, &datagram->std);
+		} else {
+			datagram = create_datagram(socket, take_buffer(socket, str, (size_t) nread), addr);
+			
+			if (Z_TYPE_P(&op->datagrams) != IS_ARRAY) {
+				array_init(&op->datagrams);
+			}
+			
+			ZVAL_OBJ(&obj, &datagram->std);
+			
+			zend_hash_next_index_insert(Z_ARRVAL_P(&op->datagrams), &obj);
+			
+			if (zend_hash_num_elements(Z_ARRVAL_P(&op->datagrams)) < op->max) {
+				return;
+			}
+		}
+	} else {
+		release_buffer(socket, str);
 		
-		ZVAL_OBJ(&op->base.result, &datagram->std);
+		// Batch receive operations return the datagrams received so far, the error is reported by the next call.
+		if (Z_TYPE_P(&op->datagrams) == IS_ARRAY) {
+			socket->receive_error = (int) nread;
+			
+			nread = 0;
+		}
 	}
 	
+	ASYNC_DEQUEUE_CUSTOM_OP(&socket->receivers, op, async_udp_receive_op);
+	
 	op->code = (int) nread;
 	
 	ASYNC_FINISH_OP(op);
@@ -452,32 +886,83 @@ static void socket_received(uv_udp_t *udp, ssize_t nread, const uv_buf_t *buffer
 
 static void socket_alloc_buffer(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buffer)
 {
-	buffer->base = emalloc(8192);
-	buffer->len = 8192;
+	async_udp_socket *socket;
+	
+	zend_string *str;
+	
+	socket = (async_udp_socket *) handle->data;
+	
+	ZEND_ASSERT(socket != NULL);
+	
+	str = acquire_buffer(socket);
+	
+	buffer->base = ZSTR_VAL(str);
+	buffer->len = socket->max_size;
 }
 
-ZEND_METHOD(UdpSocket, receive)
+/* Returns datagrams or an error left behind by a batch receive, returns 1 if the receive call has been completed. */
+static int receive_pending(async_udp_socket *socket, zval *return_value, uint32_t max, zend_bool raw)
 {
-	async_udp_socket *socket;
-	async_context *context;
-	async_uv_op *op;
+	HashTable *backlog;
 	
+	zend_ulong idx;
+	zval *entry;
 	int code;
 	
-	ZEND_PARSE_PARAMETERS_NONE();
-	
-	socket = (async_udp_socket *) Z_OBJ_P(getThis());
+	if (Z_TYPE_P(&socket->backlog) == IS_ARRAY) {
+		backlog = Z_ARRVAL_P(&socket->backlog);
+		
+		if (max > 0) {
+			array_init(return_value);
+		}
+		
+		ZEND_HASH_FOREACH_NUM_KEY_VAL(backlog, idx, entry) {
+			if (max == 0) {
+				if (raw) {
+					RETVAL_STR_COPY(((async_udp_datagram *) Z_OBJ_P(entry))->data);
+				} else {
+					ZVAL_COPY(return_value, entry);
+				}
+			} else {
+				Z_ADDREF_P(entry);
+				
+				zend_hash_next_index_insert(Z_ARRVAL_P(return_value), entry);
+			}
+			
+			zend_hash_index_del(backlog, idx);
+			
+			if (max == 0 || zend_hash_num_elements(Z_ARRVAL_P(return_value)) >= max) {
+				break;
+			}
+		} ZEND_HASH_FOREACH_END();
+		
+		if (zend_hash_num_elements(backlog) == 0) {
+			zval_ptr_dtor(&socket->backlog);
+			ZVAL_UNDEF(&socket->backlog);
+		}
+		
+		return 1;
+	}
 	
-	if (Z_TYPE_P(&socket->error) != IS_UNDEF) {
-		Z_ADDREF_P(&socket->error);
-
-		execute_data->opline--;
-		zend_throw_exception_internal(&socket->error);
-		execute_data->opline++;
-
-		return;
+	if (socket->receive_error < 0) {
+		code = socket->receive_error;
+		socket->receive_error = 0;
+		
+		zend_throw_exception_ex(async_stream_exception_ce, 0, "UDP receive error: %s", uv_strerror(code));
+		
+		return 1;
 	}
+	
+	return 0;
+}
 
+static void await_datagram(async_udp_socket *socket, async_udp_receive_op *op, zval *return_value, zend_execute_data *execute_data)
+{
+	async_context *context;
+	
+	zval *entry;
+	int code;
+	
 	if (!(socket->flags & ASYNC_UDP_FLAG_RECEIVING)) {
 		code = uv_udp_recv_start(&socket->handle, socket_alloc_buffer, socket_received);
 		
@@ -488,13 +973,39 @@ ZEND_METHOD(UdpSocket, receive)
 	
 	context = async_context_get();
 	
-	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_uv_op));
 	ASYNC_ENQUEUE_OP(&socket->receivers, op);
 	
 	ASYNC_UNREF_ENTER(context, socket);
 	
 	if (async_await_op((async_op *) op) == FAILURE) {
 		ASYNC_FORWARD_OP_ERROR(op);
+		
+		if (op->base.q != NULL) {
+			ASYNC_Q_DETACH(op->base.q, (async_op *) op);
+			op->base.q = NULL;
+		}
+		
+		if (socket->receivers.first == NULL && (socket->flags & ASYNC_UDP_FLAG_RECEIVING)) {
+			uv_udp_recv_stop(&socket->handle);
+			
+			socket->flags &= ~ASYNC_UDP_FLAG_RECEIVING;
+		}
+		
+		// Datagrams received by a cancelled batch operation are returned by the next receive call.
+		if (Z_TYPE_P(&op->datagrams) == IS_ARRAY) {
+			if (Z_TYPE_P(&socket->backlog) != IS_ARRAY) {
+				array_init(&socket->backlog);
+			}
+			
+			ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(&op->datagrams), entry) {
+				Z_ADDREF_P(entry);
+				
+				zend_hash_next_index_insert(Z_ARRVAL_P(&socket->backlog), entry);
+			} ZEND_HASH_FOREACH_END();
+			
+			zval_ptr_dtor(&op->datagrams);
+			ZVAL_UNDEF(&op->datagrams);
+		}
 	}
 	
 	ASYNC_UNREF_EXIT(context, socket);
@@ -503,51 +1014,149 @@ ZEND_METHOD(UdpSocket, receive)
 		if (op->code < 0) {
 			zend_throw_exception_ex(async_stream_exception_ce, 0,  "UDP receive error: %s", uv_strerror(op->code));
 		} else if (USED_RET()) {
-			ZVAL_COPY(return_value, &op->base.result);
+			if (op->max == 0) {
+				ZVAL_COPY(return_value, &op->base.result);
+			} else {
+				ZVAL_COPY(return_value, &op->datagrams);
+			}
 		}
 	}
-	
-	ASYNC_FREE_OP(op);
 }
 
-static void socket_sent(uv_udp_send_t *req, int status)
+ZEND_METHOD(UdpSocket, receive)
 {
-	async_udp_send_op *op;
+	async_udp_socket *socket;
+	async_udp_receive_op *op;
 	
-	op = (async_udp_send_op *) req->data;
+	ZEND_PARSE_PARAMETERS_NONE();
 	
-	ZEND_ASSERT(op != NULL);
+	socket = (async_udp_socket *) Z_OBJ_P(getThis());
 	
-	ASYNC_DELREF(&op->datagram->std);
-	ASYNC_DELREF(&op->socket->std);
+	if (receive_pending(socket, return_value, 0, 0)) {
+		return;
+	}
 	
-	if (op->base.flags & ASYNC_OP_FLAG_CANCELLED) {
-		ASYNC_FREE_OP(op);
-	} else {
-		op->code = status;
-		
-		ASYNC_FINISH_OP(op);
-	}	
+	if (Z_TYPE_P(&socket->error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->error);
+		execute_data->opline++;
+
+		return;
+	}
+	
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_udp_receive_op));
+	
+	await_datagram(socket, op, return_value, execute_data);
+	
+	ASYNC_FREE_OP(op);
 }
 
-ZEND_METHOD(UdpSocket, send)
+#ifdef ASYNC_UDP_RECVMMSG
+
+static int receive_batch(async_udp_socket *socket, zval *datagrams, uint32_t max)
 {
-	async_udp_socket *socket;
 	async_udp_datagram *datagram;
-	async_udp_send_op *op;
 	
-	struct sockaddr_in dest;
-	uv_buf_t buffers[1];
+	struct sockaddr_storage addrs[ASYNC_UDP_BATCH_SIZE];
+	struct mmsghdr msgs[ASYNC_UDP_BATCH_SIZE];
+	struct iovec iov[ASYNC_UDP_BATCH_SIZE];
+	zend_string *bufs[ASYNC_UDP_BATCH_SIZE];
+	
+	uv_os_fd_t fd;
+	zval obj;
+	int count;
 	int code;
+	int num;
+	int i;
 	
-	zval *val;
+	if (0 != (code = uv_fileno((const uv_handle_t *) &socket->handle, &fd))) {
+		return code;
+	}
+	
+	count = 0;
+	
+	while (count < (int) max) {
+		// Batches are limited to the number of pooled buffers to bound memory usage of large receive buffers.
+		num = (int) MIN(max - count, pool_capacity(socket));
+		
+		for (i = 0; i < num; i++) {
+			bufs[i] = acquire_buffer(socket);
+			
+			iov[i].iov_base = ZSTR_VAL(bufs[i]);
+			iov[i].iov_len = socket->max_size;
+			
+			ZEND_SECURE_ZERO(&msgs[i], sizeof(struct mmsghdr));
+			
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		
+		do {
+			code = recvmmsg(fd, msgs, num, MSG_DONTWAIT, NULL);
+		} while (code < 0 && errno == EINTR);
+		
+		if (code < 0) {
+			code = (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -errno;
+		}
+		
+		for (i = 0; i < num; i++) {
+			if (i >= code || msgs[i].msg_len == 0 || msgs[i].msg_hdr.msg_namelen == 0) {
+				release_buffer(socket, bufs[i]);
+				continue;
+			}
+			
+			datagram = create_datagram(socket, take_buffer(socket, bufs[i], msgs[i].msg_len), (const struct sockaddr *) &addrs[i]);
+			
+			ZVAL_OBJ(&obj, &datagram->std);
+			
+			zend_hash_next_index_insert(Z_ARRVAL_P(datagrams), &obj);
+			
+			count++;
+		}
+		
+		if (code < 0) {
+			// The error is reported by the next receive call if datagrams have been received.
+			if (count > 0) {
+				socket->receive_error = code;
+				
+				return count;
+			}
+			
+			return code;
+		}
+		
+		if (code < num) {
+			break;
+		}
+	}
+	
+	return count;
+}
+
+#endif
+
+ZEND_METHOD(UdpSocket, receiveMany)
+{
+	async_udp_socket *socket;
+	async_udp_receive_op *op;
+	
+	zend_long max;
 	
 	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
-		Z_PARAM_ZVAL(val)
+		Z_PARAM_LONG(max)
 	ZEND_PARSE_PARAMETERS_END();
 	
+	ASYNC_CHECK_ERROR(max < 1, "Number of datagrams must be at least 1");
+	
 	socket = (async_udp_socket *) Z_OBJ_P(getThis());
-	datagram = (async_udp_datagram *) Z_OBJ_P(val);
+	
+	if (receive_pending(socket, return_value, (uint32_t) MIN(max, UINT32_MAX), 0)) {
+		return;
+	}
 	
 	if (Z_TYPE_P(&socket->error) != IS_UNDEF) {
 		Z_ADDREF_P(&socket->error);
@@ -559,14 +1168,149 @@ ZEND_METHOD(UdpSocket, send)
 		return;
 	}
 	
-	code = uv_ip4_addr(ZSTR_VAL(datagram->address), (int) datagram->port, &dest);
+#ifdef ASYNC_UDP_RECVMMSG
+	// Datagrams that are ready are received without suspending the task (only if no other task is waiting).
+	if (socket->receivers.first == NULL) {
+		int code;
+		
+		array_init(return_value);
+		
+		code = receive_batch(socket, return_value, (uint32_t) MIN(max, UINT32_MAX));
+		
+		if (code > 0) {
+			return;
+		}
+		
+		zval_ptr_dtor(return_value);
+		ZVAL_NULL(return_value);
+		
+		ASYNC_CHECK_EXCEPTION(code < 0, async_stream_exception_ce, "UDP receive error: %s", uv_strerror(code));
+	}
+#endif
 	
-	ASYNC_CHECK_EXCEPTION(code != 0, async_socket_exception_ce, "Failed to assemble remote IP address: %s", uv_strerror(code));
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_udp_receive_op));
+	
+	op->max = (uint32_t) MIN(max, UINT32_MAX);
+	
+	await_datagram(socket, op, return_value, execute_data);
+	
+	zval_ptr_dtor(&op->datagrams);
+	
+	ASYNC_FREE_OP(op);
+}
+
+ZEND_METHOD(UdpSocket, read)
+{
+	async_udp_socket *socket;
+	async_udp_receive_op *op;
+	
+#ifndef PHP_WIN32
+	zend_string *str;
+	uv_os_fd_t fd;
+	ssize_t len;
+	int code;
+#endif
+	
+	ZEND_PARSE_PARAMETERS_NONE();
+	
+	socket = (async_udp_socket *) Z_OBJ_P(getThis());
+	
+	ASYNC_CHECK_ERROR(!(socket->flags & ASYNC_UDP_FLAG_CONNECTED), "UDP socket is not connected");
+	
+	if (receive_pending(socket, return_value, 0, 1)) {
+		return;
+	}
+	
+	if (Z_TYPE_P(&socket->error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->error);
+		execute_data->opline++;
+
+		return;
+	}
+	
+#ifndef PHP_WIN32
+	// A datagram that is ready is received without suspending the task (only if no other task is waiting).
+	if (socket->receivers.first == NULL && 0 == uv_fileno((const uv_handle_t *) &socket->handle, &fd)) {
+		str = acquire_buffer(socket);
+		
+		do {
+			len = recv(fd, ZSTR_VAL(str), socket->max_size, MSG_DONTWAIT);
+		} while (len < 0 && errno == EINTR);
+		
+		if (len > 0) {
+			RETURN_STR(take_buffer(socket, str, (size_t) len));
+		}
+		
+		code = (len < 0) ? uv_translate_sys_error(errno) : 0;
+		
+		release_buffer(socket, str);
+		
+		// An empty datagram has been consumed, the task must not wait for the next one.
+		if (len == 0) {
+			RETURN_EMPTY_STRING();
+		}
+		
+		ASYNC_CHECK_EXCEPTION(code != UV_EAGAIN, async_stream_exception_ce, "UDP receive error: %s", uv_strerror(code));
+	}
+#endif
+	
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_udp_receive_op));
+	
+	op->raw = 1;
+	
+	await_datagram(socket, op, return_value, execute_data);
+	
+	ASYNC_FREE_OP(op);
+}
+
+static void socket_sent(uv_udp_send_t *req, int status)
+{
+	async_udp_send_op *op;
+	
+	op = (async_udp_send_op *) req->data;
+	
+	ZEND_ASSERT(op != NULL);
+	
+	ASYNC_DELREF(&op->datagram->std);
+	ASYNC_DELREF(&op->socket->std);
+	
+	if (op->base.flags & ASYNC_OP_FLAG_CANCELLED) {
+		ASYNC_FREE_OP(op);
+	} else {
+		op->code = status;
+		
+		ASYNC_FINISH_OP(op);
+	}	
+}
+
+/* Parses the destination of a datagram, addresses that are not valid IPv4 addresses are parsed as IPv6 addresses. */
+static int assemble_dest(async_udp_datagram *datagram, struct sockaddr_storage *dest)
+{
+	int code;
+	
+	code = uv_ip4_addr(ZSTR_VAL(datagram->address), (int) datagram->port, (struct sockaddr_in *) dest);
+	
+	if (code != 0 && 0 == uv_ip6_addr(ZSTR_VAL(datagram->address), (int) datagram->port, (struct sockaddr_in6 *) dest)) {
+		code = 0;
+	}
+	
+	return code;
+}
+
+static void send_datagram(async_udp_socket *socket, async_udp_datagram *datagram, const struct sockaddr *dest, zval *return_value, zend_execute_data *execute_data)
+{
+	async_udp_send_op *op;
+	
+	uv_buf_t buffers[1];
+	int code;
 	
 	buffers[0] = uv_buf_init(ZSTR_VAL(datagram->data), ZSTR_LEN(datagram->data));
 	
 	if (0 && socket->senders.first == NULL) {
-	    code = uv_udp_try_send(&socket->handle, buffers, 1, (const struct sockaddr *)&dest);
+	    code = uv_udp_try_send(&socket->handle, buffers, 1, dest);
 	    
 	    if (code >= 0) {
 	        return;
@@ -582,7 +1326,7 @@ ZEND_METHOD(UdpSocket, send)
 	op->datagram = datagram;
 	op->context = async_context_get();
 	
-	code = uv_udp_send(&op->req, &socket->handle, buffers, 1, (const struct sockaddr *)&dest, socket_sent);
+	code = uv_udp_send(&op->req, &socket->handle, buffers, 1, dest, socket_sent);
 	
 	if (UNEXPECTED(code < 0)) {	
 		ASYNC_FREE_OP(op);
@@ -608,6 +1352,197 @@ ZEND_METHOD(UdpSocket, send)
 	}
 }
 
+ZEND_METHOD(UdpSocket, send)
+{
+	async_udp_socket *socket;
+	async_udp_datagram *datagram;
+	
+	struct sockaddr_storage dest;
+	int code;
+	
+	zval *val;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	socket = (async_udp_socket *) Z_OBJ_P(getThis());
+	datagram = (async_udp_datagram *) Z_OBJ_P(val);
+	
+	if (Z_TYPE_P(&socket->error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->error);
+		execute_data->opline++;
+
+		return;
+	}
+	
+	code = assemble_dest(datagram, &dest);
+	
+	ASYNC_CHECK_EXCEPTION(code != 0, async_socket_exception_ce, "Failed to assemble remote IP address: %s", uv_strerror(code));
+	
+	send_datagram(socket, datagram, (const struct sockaddr *) &dest, return_value, execute_data);
+}
+
+#ifndef PHP_WIN32
+static void socket_writable(uv_poll_t *handle, int status, int events)
+{
+	async_udp_socket *socket;
+	async_udp_send_op *op;
+	
+	socket = (async_udp_socket *) handle->data;
+	
+	ZEND_ASSERT(socket != NULL);
+	
+	// Tasks are resumed one at a time, each of them retries its send before the next one is resumed.
+	if (socket->writers.first != NULL) {
+		ASYNC_DEQUEUE_CUSTOM_OP(&socket->writers, op, async_udp_send_op);
+		
+		op->code = status;
+		
+		ASYNC_FINISH_OP(op);
+	}
+	
+	if (socket->writers.first == NULL) {
+		uv_poll_stop(handle);
+	}
+}
+
+static int await_writable(async_udp_socket *socket, uv_os_fd_t fd, zend_execute_data *execute_data)
+{
+	async_udp_send_op *op;
+	
+	int code;
+	
+	if (socket->poll == NULL) {
+		// A duplicated descriptor is polled to avoid interfering with the watcher of the UDP handle.
+		if (0 > (fd = fcntl(fd, F_DUPFD_CLOEXEC, 0))) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to send UDP data: %s", uv_strerror(uv_translate_sys_error(errno)));
+			return FAILURE;
+		}
+		
+		socket->poll = emalloc(sizeof(uv_poll_t));
+		
+		if (0 != (code = uv_poll_init(&socket->scheduler->loop, socket->poll, fd))) {
+			close(fd);
+			efree(socket->poll);
+			
+			socket->poll = NULL;
+			
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to send UDP data: %s", uv_strerror(code));
+			return FAILURE;
+		}
+		
+		socket->poll->data = socket;
+		socket->poll_fd = fd;
+		
+		uv_unref((uv_handle_t *) socket->poll);
+	}
+	
+	if (!uv_is_active((uv_handle_t *) socket->poll)) {
+		uv_poll_start(socket->poll, UV_WRITABLE, socket_writable);
+	}
+	
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_udp_send_op));
+	
+	op->socket = socket;
+	op->context = async_context_get();
+	
+	ASYNC_ENQUEUE_OP(&socket->writers, op);
+	ASYNC_UNREF_ENTER(op->context, socket);
+	
+	code = async_await_op((async_op *) op);
+	
+	ASYNC_UNREF_EXIT(op->context, socket);
+	
+	if (UNEXPECTED(code == FAILURE)) {
+		ASYNC_FORWARD_OP_ERROR(op);
+		ASYNC_FREE_OP(op);
+		
+		return FAILURE;
+	}
+	
+	code = op->code;
+	
+	ASYNC_FREE_OP(op);
+	
+	if (UNEXPECTED(code < 0)) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to send UDP data: %s", uv_strerror(code));
+		return FAILURE;
+	}
+	
+	return SUCCESS;
+}
+#endif
+
+ZEND_METHOD(UdpSocket, write)
+{
+	async_udp_socket *socket;
+	
+	zend_string *data;
+	
+#ifdef PHP_WIN32
+	async_udp_datagram *datagram;
+#else
+	uv_os_fd_t fd;
+	ssize_t len;
+	int code;
+#endif
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_STR(data)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	socket = (async_udp_socket *) Z_OBJ_P(getThis());
+	
+	ASYNC_CHECK_ERROR(!(socket->flags & ASYNC_UDP_FLAG_CONNECTED), "UDP socket is not connected");
+	
+	if (Z_TYPE_P(&socket->error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->error);
+		execute_data->opline++;
+
+		return;
+	}
+	
+#ifndef PHP_WIN32
+	code = uv_fileno((const uv_handle_t *) &socket->handle, &fd);
+	
+	ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to send UDP data: %s", uv_strerror(code));
+	
+	// Data is sent to the connected peer without passing an address, the task waits while the send buffer is full.
+	while (1) {
+		if (socket->writers.first == NULL) {
+			do {
+				len = send(fd, ZSTR_VAL(data), ZSTR_LEN(data), MSG_DONTWAIT);
+			} while (len < 0 && errno == EINTR);
+			
+			if (len >= 0) {
+				return;
+			}
+			
+			code = uv_translate_sys_error(errno);
+			
+			ASYNC_CHECK_EXCEPTION(code != UV_EAGAIN, async_socket_exception_ce, "Failed to send UDP data: %s", uv_strerror(code));
+		}
+		
+		if (FAILURE == await_writable(socket, fd, execute_data)) {
+			return;
+		}
+	}
+#else
+	datagram = create_datagram(socket, zend_string_copy(data), (const struct sockaddr *) &socket->remote);
+	
+	send_datagram(socket, datagram, (const struct sockaddr *) &socket->remote, return_value, execute_data);
+	
+	ASYNC_DELREF(&datagram->std);
+#endif
+}
+
 static void socket_sent_async(uv_udp_send_t *req, int status)
 {
 	async_udp_send_op *op;
@@ -627,13 +1562,46 @@ static void socket_sent_async(uv_udp_send_t *req, int status)
 	ASYNC_FREE_OP(op);
 }
 
+static int queue_datagram(async_udp_socket *socket, async_udp_datagram *datagram, const struct sockaddr *dest)
+{
+	async_udp_send_op *op;
+	
+	uv_buf_t buffers[1];
+	int code;
+	
+	buffers[0] = uv_buf_init(ZSTR_VAL(datagram->data), ZSTR_LEN(datagram->data));
+	
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_udp_send_op));
+	
+	op->req.data = op;
+	op->socket = socket;
+	op->datagram = datagram;
+	op->context = async_context_get();
+	
+	code = uv_udp_send(&op->req, &socket->handle, buffers, 1, dest, socket_sent_async);
+	
+	if (code != 0) {
+		ASYNC_FREE_OP(op);
+		
+		return code;
+	}
+	
+	ASYNC_ADDREF(&socket->std);
+	ASYNC_ADDREF(&datagram->std);
+	ASYNC_ADDREF(&op->context->std);
+	
+	ASYNC_ENQUEUE_OP(&socket->senders, op);
+	ASYNC_UNREF_ENTER(op->context, socket);
+	
+	return 0;
+}
+
 ZEND_METHOD(UdpSocket, sendAsync)
 {
 	async_udp_socket *socket;
 	async_udp_datagram *datagram;
-	async_udp_send_op *op;
 	
-	struct sockaddr_in dest;
+	struct sockaddr_storage dest;
 	uv_buf_t buffers[1];
 	int code;
 	
@@ -656,7 +1624,7 @@ ZEND_METHOD(UdpSocket, sendAsync)
 		return;
 	}
 	
-	code = uv_ip4_addr(ZSTR_VAL(datagram->address), (int) datagram->port, &dest);
+	code = assemble_dest(datagram, &dest);
 	
 	ASYNC_CHECK_EXCEPTION(code != 0, async_socket_exception_ce, "Failed to assemble remote IP address: %s", uv_strerror(code));
 	
@@ -672,30 +1640,250 @@ ZEND_METHOD(UdpSocket, sendAsync)
 	    ASYNC_CHECK_EXCEPTION(code != UV_EAGAIN, async_socket_exception_ce, "Failed to send UDP data: %s", uv_strerror(code));
 	}
 	
-	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_udp_send_op));
+	code = queue_datagram(socket, datagram, (const struct sockaddr *) &dest);
 	
-	op->req.data = op;
-	op->socket = socket;
-	op->datagram = datagram;
-	op->context = async_context_get();
+	ASYNC_CHECK_EXCEPTION(code != 0, async_socket_exception_ce, "Failed to send UDP data: %s", uv_strerror(code));
 	
-	code = uv_udp_send(&op->req, &socket->handle, buffers, 1, (const struct sockaddr *)&dest, socket_sent_async);
+	RETURN_LONG(socket->handle.send_queue_size);
+}
+
+#ifdef ASYNC_UDP_SENDMMSG
+
+static zend_always_inline int same_peer(const struct sockaddr_storage *a, const struct sockaddr_storage *b)
+{
+	if (a->ss_family != b->ss_family) {
+		return 0;
+	}
 	
-	if (code != 0) {
-		ASYNC_FREE_OP(op);		
-		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to send UDP data: %s", uv_strerror(code));
+	if (a->ss_family == AF_INET6) {
+		return ((const struct sockaddr_in6 *) a)->sin6_port == ((const struct sockaddr_in6 *) b)->sin6_port
+			&& 0 == memcmp(&((const struct sockaddr_in6 *) a)->sin6_addr, &((const struct sockaddr_in6 *) b)->sin6_addr, sizeof(struct in6_addr))
+			&& ((const struct sockaddr_in6 *) a)->sin6_scope_id == ((const struct sockaddr_in6 *) b)->sin6_scope_id;
+	}
+	
+	return ((const struct sockaddr_in *) a)->sin_addr.s_addr == ((const struct sockaddr_in *) b)->sin_addr.s_addr
+		&& ((const struct sockaddr_in *) a)->sin_port == ((const struct sockaddr_in *) b)->sin_port;
+}
+
+static int send_batch(async_udp_socket *socket, async_udp_datagram **datagrams, struct sockaddr_storage *dests, uint32_t count)
+{
+	struct mmsghdr msgs[ASYNC_UDP_BATCH_SIZE];
+	uint32_t groups[ASYNC_UDP_BATCH_SIZE];
+	struct iovec *iov;
+	
+#ifdef ASYNC_UDP_GSO
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} control[ASYNC_UDP_BATCH_SIZE];
+	
+	struct cmsghdr *cm;
+	size_t total;
+	size_t len;
+#endif
+	
+	uv_os_fd_t fd;
+	uint32_t entries;
+	uint32_t sent;
+	uint32_t segs;
+	uint32_t pos;
+	int error;
+	int code;
+	int i;
+	
+	if (0 != uv_fileno((const uv_handle_t *) &socket->handle, &fd)) {
+		return 0;
+	}
+	
+	iov = safe_emalloc(count, sizeof(struct iovec), 0);
+	
+	for (pos = 0; pos < count; pos++) {
+		iov[pos].iov_base = ZSTR_VAL(datagrams[pos]->data);
+		iov[pos].iov_len = ZSTR_LEN(datagrams[pos]->data);
+	}
+	
+	sent = 0;
+	error = 0;
+	
+	while (sent < count) {
+		entries = 0;
+		pos = sent;
+		
+		while (entries < ASYNC_UDP_BATCH_SIZE && pos < count) {
+			segs = 1;
+			
+			ZEND_SECURE_ZERO(&msgs[entries], sizeof(struct mmsghdr));
+			
+#ifdef ASYNC_UDP_GSO
+			// Consecutive datagrams of segment size sent to the same peer are coalesced, only the last segment may be shorter.
+			if (socket->segment_size > 0 && iov[pos].iov_len == socket->segment_size) {
+				total = iov[pos].iov_len;
+				
+				while ((pos + segs) < count && segs < ASYNC_UDP_GSO_MAX_SEGMENTS && same_peer(&dests[pos], &dests[pos + segs])) {
+					len = iov[pos + segs].iov_len;
+					
+					if (len == 0 || len > socket->segment_size || (total + len) > ASYNC_UDP_MAX_PAYLOAD) {
+						break;
+					}
+					
+					total += len;
+					segs++;
+					
+					if (len < socket->segment_size) {
+						break;
+					}
+				}
+				
+				if (segs > 1) {
+					msgs[entries].msg_hdr.msg_control = control[entries].buf;
+					msgs[entries].msg_hdr.msg_controllen = sizeof(control[entries].buf);
+					
+					cm = CMSG_FIRSTHDR(&msgs[entries].msg_hdr);
+					cm->cmsg_level = SOL_UDP;
+					cm->cmsg_type = UDP_SEGMENT;
+					cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+					
+					*((uint16_t *) CMSG_DATA(cm)) = socket->segment_size;
+				}
+			}
+#endif
+			
+			msgs[entries].msg_hdr.msg_name = &dests[pos];
+			msgs[entries].msg_hdr.msg_namelen = (dests[pos].ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+			msgs[entries].msg_hdr.msg_iov = &iov[pos];
+			msgs[entries].msg_hdr.msg_iovlen = segs;
+			
+			groups[entries++] = segs;
+			pos += segs;
+		}
+		
+		do {
+			code = sendmmsg(fd, msgs, entries, MSG_DONTWAIT);
+		} while (code < 0 && errno == EINTR);
 		
+		if (code < 0) {
+			// Errors are only reported if no datagram has been sent, remaining datagrams are queued otherwise.
+			if (errno != EAGAIN && errno != EWOULDBLOCK && sent == 0) {
+				error = -errno;
+			}
+			
+			break;
+		}
+		
+		for (i = 0; i < code; i++) {
+			sent += groups[i];
+		}
+		
+		if ((uint32_t) code < entries) {
+			break;
+		}
+	}
+	
+	efree(iov);
+	
+	return (error < 0) ? error : (int) sent;
+}
+
+#endif
+
+ZEND_METHOD(UdpSocket, sendMany)
+{
+	async_udp_socket *socket;
+	async_udp_datagram **datagrams;
+	
+	struct sockaddr_storage *dests;
+	uint32_t count;
+	uint32_t sent;
+	uint32_t i;
+	int code;
+	
+	zval *list;
+	zval *entry;
+	
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_ARRAY(list)
+	ZEND_PARSE_PARAMETERS_END();
+	
+	socket = (async_udp_socket *) Z_OBJ_P(getThis());
+	
+	if (Z_TYPE_P(&socket->error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->error);
+		execute_data->opline++;
+
 		return;
 	}
 	
-	ASYNC_ADDREF(&socket->std);
-	ASYNC_ADDREF(&datagram->std);
-	ASYNC_ADDREF(&op->context->std);
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(list), entry) {
+		if (Z_TYPE_P(entry) != IS_OBJECT || Z_OBJCE_P(entry) != async_udp_datagram_ce) {
+			zend_throw_error(zend_ce_type_error, "All input elements must be UDP datagrams");
+			return;
+		}
+	} ZEND_HASH_FOREACH_END();
 	
-	ASYNC_ENQUEUE_OP(&socket->senders, op);
-	ASYNC_UNREF_ENTER(op->context, socket);
+	count = zend_hash_num_elements(Z_ARRVAL_P(list));
 	
-	RETURN_LONG(socket->handle.send_queue_size);
+	if (count == 0) {
+		RETURN_LONG(socket->handle.send_queue_size);
+	}
+	
+	datagrams = safe_emalloc(count, sizeof(async_udp_datagram *), 0);
+	dests = safe_emalloc(count, sizeof(struct sockaddr_storage), 0);
+	
+	i = 0;
+	
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(list), entry) {
+		datagrams[i] = (async_udp_datagram *) Z_OBJ_P(entry);
+		
+		code = assemble_dest(datagrams[i], &dests[i]);
+		
+		if (UNEXPECTED(code != 0)) {
+			efree(datagrams);
+			efree(dests);
+			
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to assemble remote IP address: %s", uv_strerror(code));
+			return;
+		}
+		
+		i++;
+	} ZEND_HASH_FOREACH_END();
+	
+	sent = 0;
+	
+#ifdef ASYNC_UDP_SENDMMSG
+	// Sending directly is only possible if no datagrams are queued, the order of datagrams must be preserved.
+	if (socket->senders.first == NULL && socket->handle.send_queue_count == 0) {
+		code = send_batch(socket, datagrams, dests, count);
+		
+		if (UNEXPECTED(code < 0)) {
+			efree(datagrams);
+			efree(dests);
+			
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to send UDP data: %s", uv_strerror(code));
+			return;
+		}
+		
+		sent = (uint32_t) code;
+	}
+#endif
+	
+	for (i = sent; i < count; i++) {
+		code = queue_datagram(socket, datagrams[i], (const struct sockaddr *) &dests[i]);
+		
+		if (UNEXPECTED(code != 0)) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to send UDP data: %s", uv_strerror(code));
+			break;
+		}
+	}
+	
+	efree(datagrams);
+	efree(dests);
+	
+	if (EXPECTED(EG(exception) == NULL)) {
+		RETURN_LONG(socket->handle.send_queue_size);
+	}
 }
 
 ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_udp_socket_bind, 0, 2, Concurrent\\Network\\UdpSocket, 0)
@@ -708,6 +1896,11 @@ ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_udp_socket_multicast, 0, 2, Concu
 	ZEND_ARG_TYPE_INFO(0, port, IS_LONG, 0)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_udp_socket_connect, 0, 2, Concurrent\\Network\\UdpSocket, 0)
+	ZEND_ARG_TYPE_INFO(0, host, IS_STRING, 0)
+	ZEND_ARG_TYPE_INFO(0, port, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_udp_socket_close, 0, 0, IS_VOID, 0)
 	ZEND_ARG_OBJ_INFO(0, error, Throwable, 1)
 ZEND_END_ARG_INFO()
@@ -726,6 +1919,13 @@ ZEND_END_ARG_INFO()
 ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_udp_socket_receive, 0, 0, Concurrent\\Network\\UdpDatagram, 0)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_udp_socket_receive_many, 0, 1, IS_ARRAY, 0)
+	ZEND_ARG_TYPE_INFO(0, max, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_udp_socket_read, 0, 0, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_udp_socket_send, 0, 1, IS_VOID, 0)
 	ZEND_ARG_OBJ_INFO(0, datagram, Concurrent\\Network\\UdpDatagram, 0)
 ZEND_END_ARG_INFO()
@@ -734,16 +1934,29 @@ ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_udp_socket_send_async, 0, 1, IS_
 	ZEND_ARG_OBJ_INFO(0, datagram, Concurrent\\Network\\UdpDatagram, 0)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_udp_socket_send_many, 0, 1, IS_LONG, 0)
+	ZEND_ARG_TYPE_INFO(0, datagrams, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_udp_socket_write, 0, 1, IS_VOID, 0)
+	ZEND_ARG_TYPE_INFO(0, data, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
 static const zend_function_entry async_udp_socket_functions[] = {
 	ZEND_ME(UdpSocket, bind, arginfo_udp_socket_bind, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 	ZEND_ME(UdpSocket, multicast, arginfo_udp_socket_multicast, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	ZEND_ME(UdpSocket, connect, arginfo_udp_socket_connect, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 	ZEND_ME(UdpSocket, close, arginfo_udp_socket_close, ZEND_ACC_PUBLIC)
 	ZEND_ME(UdpSocket, getAddress, arginfo_udp_socket_get_address, ZEND_ACC_PUBLIC)
 	ZEND_ME(UdpSocket, getPort, arginfo_udp_socket_get_port, ZEND_ACC_PUBLIC)
 	ZEND_ME(UdpSocket, setOption, arginfo_udp_socket_set_option, ZEND_ACC_PUBLIC)
 	ZEND_ME(UdpSocket, receive, arginfo_udp_socket_receive, ZEND_ACC_PUBLIC)
+	ZEND_ME(UdpSocket, receiveMany, arginfo_udp_socket_receive_many, ZEND_ACC_PUBLIC)
+	ZEND_ME(UdpSocket, read, arginfo_udp_socket_read, ZEND_ACC_PUBLIC)
 	ZEND_ME(UdpSocket, send, arginfo_udp_socket_send, ZEND_ACC_PUBLIC)
 	ZEND_ME(UdpSocket, sendAsync, arginfo_udp_socket_send_async, ZEND_ACC_PUBLIC)
+	ZEND_ME(UdpSocket, sendMany, arginfo_udp_socket_send_many, ZEND_ACC_PUBLIC)
+	ZEND_ME(UdpSocket, write, arginfo_udp_socket_write, ZEND_ACC_PUBLIC)
 	ZEND_FE_END
 };
 
@@ -953,6 +2166,8 @@ void async_udp_socket_ce_register()
 	zend_class_implements(async_udp_socket_ce, 1, async_socket_ce);
 
 	ASYNC_UDP_SOCKET_CONST("TTL", ASYNC_SOCKET_UDP_TTL);
+	ASYNC_UDP_SOCKET_CONST("SEGMENT_SIZE", ASYNC_SOCKET_UDP_SEGMENT_SIZE);
+	ASYNC_UDP_SOCKET_CONST("MAX_DATAGRAM_SIZE", ASYNC_SOCKET_UDP_MAX_DATAGRAM_SIZE);
 	ASYNC_UDP_SOCKET_CONST("MULTICAST_LOOP", ASYNC_SOCKET_UDP_MULTICAST_LOOP);
 	ASYNC_UDP_SOCKET_CONST("MULTICAST_TTL", ASYNC_SOCKET_UDP_MULTICAST_TTL);
 
@@ -0,0 +1,1407 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-2018 The PHP Group                                |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Martin Schröder <m.schroeder2007@gmail.com>                 |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_async.h"
+#include "async_stream.h"
+#include "async_task.h"
+#include "zend_inheritance.h"
+
+#ifndef ZEND_WIN32
+#include <sys/un.h>
+#endif
+
+ASYNC_API zend_class_entry *async_unix_server_ce;
+ASYNC_API zend_class_entry *async_unix_socket_ce;
+ASYNC_API zend_class_entry *async_unix_socket_reader_ce;
+ASYNC_API zend_class_entry *async_unix_socket_writer_ce;
+
+static zend_object_handlers async_unix_server_handlers;
+static zend_object_handlers async_unix_socket_handlers;
+
+#define ASYNC_UNIX_DEFAULT_BACKLOG 128
+
+#define ASYNC_SOCKET_UNIX_SNDBUF 102
+#define ASYNC_SOCKET_UNIX_RCVBUF 103
+#define ASYNC_SOCKET_UNIX_ACCESS 150
+
+#define ASYNC_UNIX_SOCKET_CONST(name, value) \
+	zend_declare_class_constant_long(async_unix_socket_ce, name, sizeof(name)-1, (zend_long)value);
+
+#define ASYNC_UNIX_SERVER_CONST(name, value) \
+	zend_declare_class_constant_long(async_unix_server_ce, name, sizeof(name)-1, (zend_long)value);
+
+/* Handles can only be passed over IPC pipes, Windows IPC pipes use a framing protocol that only libuv understands. */
+#ifdef PHP_WIN32
+#define ASYNC_UNIX_IPC 0
+#else
+#define ASYNC_UNIX_IPC 1
+#endif
+
+typedef struct {
+	/* PHP object handle. */
+	zend_object std;
+
+	/* Task scheduler being used. */
+	async_task_scheduler *scheduler;
+
+	/* UV pipe handle. */
+	uv_pipe_t handle;
+
+	/* Path of the socket file (or abstract socket name starting with a NUL byte). */
+	zend_string *name;
+
+	/* Number of pending connection attempts queued in the backlog. */
+	uint32_t pending;
+
+	/* Error being used to close the server. */
+	zval error;
+
+	/* Number of referenced accept operations. */
+	uint32_t ref_count;
+
+	/* Queue of tasks waiting to accept a socket connection. */
+	async_op_queue accepts;
+
+	async_cancel_cb cancel;
+} async_unix_server;
+
+typedef struct {
+	/* PHP object handle. */
+	zend_object std;
+
+	/* UV pipe handle. */
+	uv_pipe_t handle;
+
+	/* Task scheduler being used. */
+	async_task_scheduler *scheduler;
+
+	async_cancel_cb cancel;
+
+	zend_string *local_addr;
+	zend_string *remote_addr;
+
+	/* Refers to the (local) server that accepted the socket connection. */
+	async_unix_server *server;
+
+	async_stream *stream;
+
+	/* Error being used to close the read stream. */
+	zval read_error;
+
+	/* Error being used to close the write stream. */
+	zval write_error;
+} async_unix_socket;
+
+typedef struct {
+	/* Async operation structure, must be first element to allow for casting to async_op. */
+	async_op base;
+
+	uv_connect_t req;
+
+	/* Result status code provided by libuv. */
+	int code;
+
+	/* Is set if the awaiting task is gone, the connect callback has to free the operation. */
+	zend_bool abandoned;
+} async_unix_connect_op;
+
+typedef struct {
+	/* Async operation structure, must be first element to allow for casting to async_op. */
+	async_op base;
+
+	uv_write_t req;
+
+	/* Result status code provided by libuv. */
+	int code;
+
+	/* Is set if the awaiting task is gone, the write callback has to free the operation. */
+	zend_bool abandoned;
+} async_unix_send_op;
+
+/* Every transferred handle is attached to a single marker byte, a stream cannot carry ancillary data without payload. */
+static const char handle_marker[] = { 'H' };
+
+static async_unix_socket *async_unix_socket_object_create();
+
+
+static inline zend_string *assemble_name(uv_pipe_t *pipe, zend_bool remote)
+{
+	char name[1024];
+	size_t len;
+	int code;
+
+	len = sizeof(name);
+
+	if (remote) {
+		code = uv_pipe_getpeername(pipe, name, &len);
+	} else {
+		code = uv_pipe_getsockname(pipe, name, &len);
+	}
+
+	if (code != 0) {
+		return ZSTR_EMPTY_ALLOC();
+	}
+
+	return zend_string_init(name, len, 0);
+}
+
+/* Abstract socket names are not supported by libuv, the socket is created manually and opened as pipe. */
+static int open_abstract(uv_pipe_t *handle, const char *path, size_t len, zend_bool server)
+{
+#ifndef __linux__
+	return UV_EINVAL;
+#else
+	struct sockaddr_un addr;
+	socklen_t size;
+	int code;
+	int fd;
+
+	if (len > sizeof(addr.sun_path)) {
+		return UV_ENAMETOOLONG;
+	}
+
+	ZEND_SECURE_ZERO(&addr, sizeof(struct sockaddr_un));
+
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, path, len);
+
+	size = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + len);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+
+	if (UNEXPECTED(fd < 0)) {
+		return -errno;
+	}
+
+	if (server) {
+		code = bind(fd, (const struct sockaddr *) &addr, size);
+	} else {
+		code = connect(fd, (const struct sockaddr *) &addr, size);
+	}
+
+	if (UNEXPECTED(code != 0)) {
+		code = -errno;
+
+		close(fd);
+
+		return code;
+	}
+
+	if (UNEXPECTED(0 != (code = uv_pipe_open(handle, fd)))) {
+		close(fd);
+	}
+
+	return code;
+#endif
+}
+
+/* Checks the length of a socket path, libuv would silently truncate paths that do not fit into sun_path. */
+static inline int check_path(const char *path, size_t len)
+{
+	if (len == 0 || strlen(path) != len) {
+		return UV_EINVAL;
+	}
+
+#ifndef PHP_WIN32
+	if (len >= sizeof(((struct sockaddr_un *) NULL)->sun_path)) {
+		return UV_ENAMETOOLONG;
+	}
+#endif
+
+	return 0;
+}
+
+static void connect_cb(uv_connect_t *req, int status)
+{
+	async_unix_connect_op *op;
+
+	op = (async_unix_connect_op *) req->data;
+
+	ZEND_ASSERT(op != NULL);
+
+	if (op->abandoned) {
+		ASYNC_FREE_OP(op);
+
+		return;
+	}
+
+	op->code = status;
+
+	ASYNC_FINISH_OP(op);
+}
+
+ASYNC_API int async_unix_connect(uv_pipe_t *handle, const char *path, size_t len)
+{
+	async_unix_connect_op *op;
+	async_context *context;
+
+	int code;
+
+	if (len > 0 && path[0] == '\0') {
+		return open_abstract(handle, path, len, 0);
+	}
+
+	if (0 != (code = check_path(path, len))) {
+		return code;
+	}
+
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_unix_connect_op));
+
+	op->req.data = op;
+
+	uv_pipe_connect(&op->req, handle, path, connect_cb);
+
+	context = async_context_get();
+
+	// The handle has to be referenced while it is being connected.
+	if (context->background || uv_has_ref((uv_handle_t *) handle)) {
+		code = async_await_op((async_op *) op);
+	} else {
+		uv_ref((uv_handle_t *) handle);
+		code = async_await_op((async_op *) op);
+		uv_unref((uv_handle_t *) handle);
+	}
+
+	if (code == FAILURE) {
+		ASYNC_FORWARD_OP_ERROR(op);
+
+		// Closing the handle will invoke the connect callback with UV_ECANCELED.
+		op->abandoned = 1;
+
+		return UV_ECANCELED;
+	}
+
+	code = op->code;
+
+	ASYNC_FREE_OP(op);
+
+	return code;
+}
+
+ASYNC_API int async_unix_bind(uv_pipe_t *handle, const char *path, size_t len)
+{
+	int code;
+
+	if (len > 0 && path[0] == '\0') {
+		return open_abstract(handle, path, len, 1);
+	}
+
+	if (0 != (code = check_path(path, len))) {
+		return code;
+	}
+
+	return uv_pipe_bind(handle, path);
+}
+
+
+static void socket_disposed(uv_handle_t *handle)
+{
+	async_unix_socket *socket;
+
+	socket = (async_unix_socket *) handle->data;
+
+	ZEND_ASSERT(socket != NULL);
+
+	ASYNC_DELREF(&socket->std);
+}
+
+static void shutdown_socket(void *arg, zval *error)
+{
+	async_unix_socket *socket;
+
+	socket = (async_unix_socket *) arg;
+
+	ZEND_ASSERT(socket != NULL);
+
+	socket->cancel.func = NULL;
+
+	if (error != NULL) {
+		if (Z_TYPE_P(&socket->read_error) == IS_UNDEF) {
+			ZVAL_COPY(&socket->read_error, error);
+		}
+
+		if (Z_TYPE_P(&socket->write_error) == IS_UNDEF) {
+			ZVAL_COPY(&socket->write_error, error);
+		}
+	}
+
+	if (!(socket->stream->flags & ASYNC_STREAM_CLOSED)) {
+		ASYNC_ADDREF(&socket->std);
+
+		async_stream_close(socket->stream, socket_disposed, socket);
+	}
+}
+
+static async_unix_socket *async_unix_socket_object_create()
+{
+	async_unix_socket *socket;
+
+	socket = emalloc(sizeof(async_unix_socket));
+	ZEND_SECURE_ZERO(socket, sizeof(async_unix_socket));
+
+	zend_object_std_init(&socket->std, async_unix_socket_ce);
+	socket->std.handlers = &async_unix_socket_handlers;
+
+	socket->scheduler = async_task_scheduler_get();
+
+	ASYNC_ADDREF(&socket->scheduler->std);
+
+	socket->cancel.object = socket;
+	socket->cancel.func = shutdown_socket;
+
+	ASYNC_Q_ENQUEUE(&socket->scheduler->shutdown, &socket->cancel);
+
+	uv_pipe_init(&socket->scheduler->loop, &socket->handle, ASYNC_UNIX_IPC);
+
+	socket->stream = async_stream_init((uv_stream_t *) &socket->handle, 0);
+
+	return socket;
+}
+
+static void async_unix_socket_object_dtor(zend_object *object)
+{
+	async_unix_socket *socket;
+
+	socket = (async_unix_socket *) object;
+
+	if (socket->cancel.func != NULL) {
+		ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
+
+		socket->cancel.func(socket, NULL);
+	}
+}
+
+static void async_unix_socket_object_destroy(zend_object *object)
+{
+	async_unix_socket *socket;
+
+	socket = (async_unix_socket *) object;
+
+	async_stream_free(socket->stream);
+
+	if (socket->server != NULL) {
+		ASYNC_DELREF(&socket->server->std);
+	}
+
+	ASYNC_DELREF(&socket->scheduler->std);
+
+	zval_ptr_dtor(&socket->read_error);
+	zval_ptr_dtor(&socket->write_error);
+
+	if (socket->local_addr != NULL) {
+		zend_string_release(socket->local_addr);
+	}
+
+	if (socket->remote_addr != NULL) {
+		zend_string_release(socket->remote_addr);
+	}
+
+	zend_object_std_dtor(&socket->std);
+}
+
+ZEND_METHOD(UnixSocket, connect)
+{
+	async_unix_socket *socket;
+
+	zend_string *path;
+	zval obj;
+
+	int code;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_STR(path)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = async_unix_socket_object_create();
+
+	code = async_unix_connect(&socket->handle, ZSTR_VAL(path), ZSTR_LEN(path));
+
+	if (UNEXPECTED(code < 0)) {
+		if (!EG(exception)) {
+			zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to connect socket: %s", uv_strerror(code));
+		}
+
+		ASYNC_DELREF(&socket->std);
+		return;
+	}
+
+	socket->local_addr = assemble_name(&socket->handle, 0);
+	socket->remote_addr = zend_string_copy(path);
+
+	ZVAL_OBJ(&obj, &socket->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(UnixSocket, close)
+{
+	async_unix_socket *socket;
+
+	zval error;
+	zval *val;
+
+	val = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = (async_unix_socket *) Z_OBJ_P(getThis());
+
+	if (socket->cancel.func == NULL) {
+		return;
+	}
+
+	async_socket_closed_error(&error, val);
+
+	ASYNC_Q_DETACH(&socket->scheduler->shutdown, &socket->cancel);
+
+	socket->cancel.func(socket, &error);
+
+	zval_ptr_dtor(&error);
+}
+
+ZEND_METHOD(UnixSocket, getAddress)
+{
+	async_unix_socket *socket;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_unix_socket *) Z_OBJ_P(getThis());
+
+	RETURN_STR_COPY(socket->local_addr);
+}
+
+ZEND_METHOD(UnixSocket, getPort)
+{
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	// Unix sockets are addressed by path only, the Socket interface allows for NULL in this case.
+	RETURN_NULL();
+}
+
+ZEND_METHOD(UnixSocket, getRemoteAddress)
+{
+	async_unix_socket *socket;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_unix_socket *) Z_OBJ_P(getThis());
+
+	RETURN_STR_COPY(socket->remote_addr);
+}
+
+ZEND_METHOD(UnixSocket, getRemotePort)
+{
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	RETURN_NULL();
+}
+
+ZEND_METHOD(UnixSocket, setOption)
+{
+	async_unix_socket *socket;
+
+	zend_long option;
+	zval *val;
+
+	int code;
+	int num;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 2)
+		Z_PARAM_LONG(option)
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = (async_unix_socket *) Z_OBJ_P(getThis());
+	num = (int) zval_get_long(val);
+
+	switch ((int) option) {
+	case ASYNC_SOCKET_UNIX_SNDBUF:
+		code = (num < 1) ? UV_EINVAL : uv_send_buffer_size((uv_handle_t *) &socket->handle, &num);
+		break;
+	case ASYNC_SOCKET_UNIX_RCVBUF:
+		code = (num < 1) ? UV_EINVAL : uv_recv_buffer_size((uv_handle_t *) &socket->handle, &num);
+		break;
+	default:
+		code = UV_ENOTSUP;
+	}
+
+	RETURN_BOOL((code < 0) ? 0 : 1);
+}
+
+static inline void call_read(async_unix_socket *socket, zval *return_value, zend_execute_data *execute_data)
+{
+	zend_string *str;
+	zval *hint;
+	size_t len;
+	int code;
+
+	hint = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(hint)
+	ZEND_PARSE_PARAMETERS_END();
+
+	if (hint == NULL || Z_TYPE_P(hint) == IS_NULL) {
+		len = socket->stream->buffer.size;
+	} else if (Z_LVAL_P(hint) < 1) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Invalid read length: %d", (int) Z_LVAL_P(hint));
+		return;
+	} else {
+		len = (size_t) Z_LVAL_P(hint);
+	}
+
+	if (Z_TYPE_P(&socket->read_error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->read_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->read_error);
+		execute_data->opline++;
+
+		return;
+	}
+
+	code = async_stream_read_string(socket->stream, &str, len, 0);
+
+	if (UNEXPECTED(EG(exception))) {
+		return;
+	}
+
+	if (code > 0) {
+		RETURN_STR(str);
+	}
+
+	ASYNC_CHECK_EXCEPTION(socket->stream->read.error != NULL, async_stream_exception_ce, "Reading from socket failed: %s", socket->stream->read.error);
+	ASYNC_CHECK_EXCEPTION(code < 0, async_stream_exception_ce, "Reading from socket failed: %s", uv_strerror(code));
+}
+
+ZEND_METHOD(UnixSocket, read)
+{
+	call_read((async_unix_socket *) Z_OBJ_P(getThis()), return_value, execute_data);
+}
+
+ZEND_METHOD(UnixSocket, getReadableStream)
+{
+	async_unix_socket *socket;
+
+	zval obj;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_unix_socket *) Z_OBJ_P(getThis());
+
+	ZVAL_OBJ(&obj, async_socket_delegate_create(async_unix_socket_reader_ce, &socket->std));
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+static inline void call_write(async_unix_socket *socket, zval *return_value, zend_execute_data *execute_data)
+{
+	zend_string *data;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_STR(data)
+	ZEND_PARSE_PARAMETERS_END();
+
+	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->write_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->write_error);
+		execute_data->opline++;
+
+		return;
+	}
+
+	async_stream_write(socket->stream, ZSTR_VAL(data), ZSTR_LEN(data));
+}
+
+ZEND_METHOD(UnixSocket, write)
+{
+	call_write((async_unix_socket *) Z_OBJ_P(getThis()), return_value, execute_data);
+}
+
+static void write_async_cb(void *arg)
+{
+	async_unix_socket *socket;
+
+	socket = (async_unix_socket *) arg;
+
+	ZEND_ASSERT(socket != NULL);
+
+	ASYNC_DELREF(&socket->std);
+}
+
+ZEND_METHOD(UnixSocket, writeAsync)
+{
+	async_unix_socket *socket;
+
+	zend_string *data;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_STR(data)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = (async_unix_socket *) Z_OBJ_P(getThis());
+
+	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->write_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->write_error);
+		execute_data->opline++;
+
+		return;
+	}
+
+	ASYNC_ADDREF(&socket->std);
+
+	async_stream_async_write_string(socket->stream, data, write_async_cb, socket);
+
+	if (EXPECTED(EG(exception) == NULL)) {
+		RETURN_LONG(socket->handle.write_queue_size);
+	} else {
+		ASYNC_DELREF(&socket->std);
+	}
+}
+
+ZEND_METHOD(UnixSocket, getWriteQueueSize)
+{
+	async_unix_socket *socket;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_unix_socket *) Z_OBJ_P(getThis());
+
+	RETURN_LONG((Z_TYPE_P(&socket->write_error) == IS_UNDEF) ? socket->handle.write_queue_size : 0);
+}
+
+ZEND_METHOD(UnixSocket, getWritableStream)
+{
+	async_unix_socket *socket;
+
+	zval obj;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_unix_socket *) Z_OBJ_P(getThis());
+
+	ZVAL_OBJ(&obj, async_socket_delegate_create(async_unix_socket_writer_ce, &socket->std));
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+static void send_handle_cb(uv_write_t *req, int status)
+{
+	async_unix_send_op *op;
+
+	op = (async_unix_send_op *) req->data;
+
+	ZEND_ASSERT(op != NULL);
+
+	if (op->abandoned) {
+		ASYNC_FREE_OP(op);
+
+		return;
+	}
+
+	op->code = status;
+
+	ASYNC_FINISH_OP(op);
+}
+
+ZEND_METHOD(UnixSocket, sendHandle)
+{
+	async_unix_socket *socket;
+	async_unix_send_op *op;
+	async_context *context;
+
+	uv_stream_t *handle;
+	uv_buf_t buf;
+	zval *val;
+
+	int code;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_OBJECT_OF_CLASS(val, async_socket_ce)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = (async_unix_socket *) Z_OBJ_P(getThis());
+
+#ifdef PHP_WIN32
+	zend_throw_exception_ex(async_socket_exception_ce, 0, "Passing handles is not supported on Windows");
+#else
+	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->write_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->write_error);
+		execute_data->opline++;
+
+		return;
+	}
+
+	if (FAILURE == async_tcp_export(Z_OBJ_P(val), &handle)) {
+		return;
+	}
+
+	ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_unix_send_op));
+
+	op->req.data = op;
+
+	buf = uv_buf_init((char *) handle_marker, sizeof(handle_marker));
+
+	code = uv_write2(&op->req, (uv_stream_t *) &socket->handle, &buf, 1, handle, send_handle_cb);
+
+	if (UNEXPECTED(code != 0)) {
+		ASYNC_FREE_OP(op);
+
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to send handle: %s", uv_strerror(code));
+		return;
+	}
+
+	context = async_context_get();
+
+	if (context->background || uv_has_ref((uv_handle_t *) &socket->handle)) {
+		code = async_await_op((async_op *) op);
+	} else {
+		uv_ref((uv_handle_t *) &socket->handle);
+		code = async_await_op((async_op *) op);
+		uv_unref((uv_handle_t *) &socket->handle);
+	}
+
+	if (code == FAILURE) {
+		ASYNC_FORWARD_OP_ERROR(op);
+
+		op->abandoned = 1;
+
+		return;
+	}
+
+	code = op->code;
+
+	ASYNC_FREE_OP(op);
+
+	ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to send handle: %s", uv_strerror(code));
+#endif
+}
+
+ZEND_METHOD(UnixSocket, receiveHandle)
+{
+	async_unix_socket *socket;
+
+	zend_string *str;
+	zval obj;
+
+	int code;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	socket = (async_unix_socket *) Z_OBJ_P(getThis());
+
+#ifdef PHP_WIN32
+	zend_throw_exception_ex(async_socket_exception_ce, 0, "Passing handles is not supported on Windows");
+#else
+	if (Z_TYPE_P(&socket->read_error) != IS_UNDEF) {
+		Z_ADDREF_P(&socket->read_error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&socket->read_error);
+		execute_data->opline++;
+
+		return;
+	}
+
+	// Received handles are queued by libuv, they become available as soon as the marker byte has been read.
+	code = async_stream_read_string(socket->stream, &str, sizeof(handle_marker), 0);
+
+	if (UNEXPECTED(EG(exception))) {
+		return;
+	}
+
+	ASYNC_CHECK_EXCEPTION(socket->stream->read.error != NULL, async_stream_exception_ce, "Reading from socket failed: %s", socket->stream->read.error);
+	ASYNC_CHECK_EXCEPTION(code < 0, async_stream_exception_ce, "Reading from socket failed: %s", uv_strerror(code));
+	ASYNC_CHECK_EXCEPTION(code == 0, async_socket_exception_ce, "Failed to receive handle: %s", uv_strerror(UV_EOF));
+
+	code = (ZSTR_VAL(str)[0] == handle_marker[0]) ? 0 : 1;
+
+	zend_string_release(str);
+
+	ASYNC_CHECK_EXCEPTION(code != 0, async_socket_exception_ce, "Received data is not a handle");
+	ASYNC_CHECK_EXCEPTION(uv_pipe_pending_count(&socket->handle) == 0, async_socket_exception_ce, "Received data is not a handle");
+	ASYNC_CHECK_EXCEPTION(uv_pipe_pending_type(&socket->handle) != UV_TCP, async_socket_exception_ce, "Received handle is not supported");
+
+	if (SUCCESS == async_tcp_import(&obj, (uv_stream_t *) &socket->handle)) {
+		RETURN_ZVAL(&obj, 1, 1);
+	}
+#endif
+}
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_unix_socket_connect, 0, 1, Concurrent\\Network\\UnixSocket, 0)
+	ZEND_ARG_TYPE_INFO(0, path, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_close, 0, 0, IS_VOID, 0)
+	ZEND_ARG_OBJ_INFO(0, error, Throwable, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_get_address, 0, 0, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_get_port, 0, 0, IS_LONG, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_get_remote_address, 0, 0, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_get_remote_port, 0, 0, IS_LONG, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_set_option, 0, 2, _IS_BOOL, 0)
+	ZEND_ARG_TYPE_INFO(0, option, IS_LONG, 0)
+	ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_read, 0, 0, IS_STRING, 1)
+	ZEND_ARG_TYPE_INFO(0, length, IS_LONG, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_unix_socket_get_readable_stream, 0, 0, Concurrent\\Stream\\ReadableStream, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_write, 0, 1, IS_VOID, 0)
+	ZEND_ARG_TYPE_INFO(0, data, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_write_async, 0, 1, IS_LONG, 0)
+	ZEND_ARG_TYPE_INFO(0, data, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_get_write_queue_size, 0, 0, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_unix_socket_get_writable_stream, 0, 0, Concurrent\\Stream\\WritableStream, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_socket_send_handle, 0, 1, IS_VOID, 0)
+	ZEND_ARG_OBJ_INFO(0, handle, Concurrent\\Network\\Socket, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_unix_socket_receive_handle, 0, 0, Concurrent\\Network\\Socket, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry async_unix_socket_functions[] = {
+	ZEND_ME(UnixSocket, connect, arginfo_unix_socket_connect, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	ZEND_ME(UnixSocket, close, arginfo_unix_socket_close, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, getAddress, arginfo_unix_socket_get_address, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, getPort, arginfo_unix_socket_get_port, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, setOption, arginfo_unix_socket_set_option, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, getRemoteAddress, arginfo_unix_socket_get_remote_address, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, getRemotePort, arginfo_unix_socket_get_remote_port, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, read, arginfo_unix_socket_read, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, getReadableStream, arginfo_unix_socket_get_readable_stream, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, write, arginfo_unix_socket_write, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, writeAsync, arginfo_unix_socket_write_async, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, getWriteQueueSize, arginfo_unix_socket_get_write_queue_size, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, getWritableStream, arginfo_unix_socket_get_writable_stream, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, sendHandle, arginfo_unix_socket_send_handle, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocket, receiveHandle, arginfo_unix_socket_receive_handle, ZEND_ACC_PUBLIC)
+	ZEND_FE_END
+};
+
+
+ZEND_METHOD(UnixSocketReader, close)
+{
+	async_unix_socket *socket;
+
+	zval *val;
+
+	val = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = ASYNC_SOCKET_DELEGATE(Z_OBJ_P(getThis()), async_unix_socket);
+
+	if (Z_TYPE_P(&socket->read_error) != IS_UNDEF) {
+		return;
+	}
+
+	async_socket_closed_error(&socket->read_error, val);
+
+	async_stream_shutdown(socket->stream, ASYNC_STREAM_SHUT_RD);
+}
+
+ZEND_METHOD(UnixSocketReader, read)
+{
+	call_read(ASYNC_SOCKET_DELEGATE(Z_OBJ_P(getThis()), async_unix_socket), return_value, execute_data);
+}
+
+static const zend_function_entry async_unix_socket_reader_functions[] = {
+	ZEND_ME(UnixSocketReader, close, arginfo_unix_socket_close, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocketReader, read, arginfo_unix_socket_read, ZEND_ACC_PUBLIC)
+	ZEND_FE_END
+};
+
+
+ZEND_METHOD(UnixSocketWriter, close)
+{
+	async_unix_socket *socket;
+
+	zval *val;
+
+	val = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	socket = ASYNC_SOCKET_DELEGATE(Z_OBJ_P(getThis()), async_unix_socket);
+
+	if (Z_TYPE_P(&socket->write_error) != IS_UNDEF) {
+		return;
+	}
+
+	async_socket_closed_error(&socket->write_error, val);
+
+	async_stream_shutdown(socket->stream, ASYNC_STREAM_SHUT_WR);
+}
+
+ZEND_METHOD(UnixSocketWriter, write)
+{
+	call_write(ASYNC_SOCKET_DELEGATE(Z_OBJ_P(getThis()), async_unix_socket), return_value, execute_data);
+}
+
+static const zend_function_entry async_unix_socket_writer_functions[] = {
+	ZEND_ME(UnixSocketWriter, close, arginfo_unix_socket_close, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixSocketWriter, write, arginfo_unix_socket_write, ZEND_ACC_PUBLIC)
+	ZEND_FE_END
+};
+
+
+static void server_disposed(uv_handle_t *handle)
+{
+	async_unix_server *server;
+
+	server = (async_unix_server *) handle->data;
+
+	ZEND_ASSERT(server != NULL);
+
+	ASYNC_DELREF(&server->std);
+}
+
+static void shutdown_server(void *obj, zval *error)
+{
+	async_unix_server *server;
+	async_uv_op *op;
+
+	server = (async_unix_server *) obj;
+
+	ZEND_ASSERT(server != NULL);
+
+	server->cancel.func = NULL;
+
+	if (error != NULL && Z_TYPE_P(&server->error) == IS_UNDEF) {
+		ZVAL_COPY(&server->error, error);
+	}
+
+	while (server->accepts.first != NULL) {
+		ASYNC_DEQUEUE_CUSTOM_OP(&server->accepts, op, async_uv_op);
+
+		if (Z_TYPE_P(&server->error) != IS_UNDEF) {
+			ASYNC_FAIL_OP(op, &server->error);
+		} else {
+			op->code = UV_ECANCELED;
+
+			ASYNC_FINISH_OP(op);
+		}
+	}
+
+	// Closing a pipe that has been bound to a path will also unlink the socket file.
+	if (!uv_is_closing((uv_handle_t *) &server->handle)) {
+		ASYNC_ADDREF(&server->std);
+
+		uv_close((uv_handle_t *) &server->handle, server_disposed);
+	}
+}
+
+static async_unix_server *async_unix_server_object_create()
+{
+	async_unix_server *server;
+
+	server = emalloc(sizeof(async_unix_server));
+	ZEND_SECURE_ZERO(server, sizeof(async_unix_server));
+
+	zend_object_std_init(&server->std, async_unix_server_ce);
+	server->std.handlers = &async_unix_server_handlers;
+
+	server->scheduler = async_task_scheduler_get();
+
+	ASYNC_ADDREF(&server->scheduler->std);
+
+	server->cancel.object = server;
+	server->cancel.func = shutdown_server;
+
+	ASYNC_Q_ENQUEUE(&server->scheduler->shutdown, &server->cancel);
+
+	uv_pipe_init(&server->scheduler->loop, &server->handle, 0);
+
+	server->handle.data = server;
+
+	return server;
+}
+
+static void async_unix_server_object_dtor(zend_object *object)
+{
+	async_unix_server *server;
+
+	server = (async_unix_server *) object;
+
+	if (server->cancel.func != NULL) {
+		ASYNC_Q_DETACH(&server->scheduler->shutdown, &server->cancel);
+
+		server->cancel.func(server, NULL);
+	}
+}
+
+static void async_unix_server_object_destroy(zend_object *object)
+{
+	async_unix_server *server;
+
+	server = (async_unix_server *) object;
+
+	ASYNC_DELREF(&server->scheduler->std);
+
+	zval_ptr_dtor(&server->error);
+
+	if (server->name != NULL) {
+		zend_string_release(server->name);
+	}
+
+	zend_object_std_dtor(&server->std);
+}
+
+static void server_connected(uv_stream_t *stream, int status)
+{
+	async_unix_server *server;
+	async_uv_op *op;
+
+	server = (async_unix_server *) stream->data;
+
+	ZEND_ASSERT(server != NULL);
+
+	// libuv stops polling the listen socket until uv_accept() is called.
+	if (server->accepts.first == NULL) {
+		if (status == 0) {
+			server->pending++;
+		}
+	} else {
+		ASYNC_DEQUEUE_CUSTOM_OP(&server->accepts, op, async_uv_op);
+
+		op->code = status;
+
+		ASYNC_FINISH_OP(op);
+	}
+}
+
+ZEND_METHOD(UnixServer, listen)
+{
+	async_unix_server *server;
+
+	zend_string *path;
+	zval obj;
+
+	int code;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_STR(path)
+	ZEND_PARSE_PARAMETERS_END();
+
+	server = async_unix_server_object_create();
+	server->name = zend_string_copy(path);
+
+	code = async_unix_bind(&server->handle, ZSTR_VAL(path), ZSTR_LEN(path));
+
+	if (UNEXPECTED(code != 0)) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to bind server: %s", uv_strerror(code));
+		ASYNC_DELREF(&server->std);
+		return;
+	}
+
+	code = uv_listen((uv_stream_t *) &server->handle, ASYNC_UNIX_DEFAULT_BACKLOG, server_connected);
+
+	if (UNEXPECTED(code != 0)) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Server failed to listen: %s", uv_strerror(code));
+		ASYNC_DELREF(&server->std);
+		return;
+	}
+
+	uv_unref((uv_handle_t *) &server->handle);
+
+	ZVAL_OBJ(&obj, &server->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_METHOD(UnixServer, close)
+{
+	async_unix_server *server;
+
+	zval error;
+	zval *val;
+
+	val = NULL;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 0, 1)
+		Z_PARAM_OPTIONAL
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	server = (async_unix_server *) Z_OBJ_P(getThis());
+
+	if (server->cancel.func == NULL) {
+		return;
+	}
+
+	ASYNC_PREPARE_EXCEPTION(&error, async_socket_exception_ce, "Server has been closed");
+
+	if (val != NULL && Z_TYPE_P(val) != IS_NULL) {
+		zend_exception_set_previous(Z_OBJ_P(&error), Z_OBJ_P(val));
+		GC_ADDREF(Z_OBJ_P(val));
+	}
+
+	ASYNC_Q_DETACH(&server->scheduler->shutdown, &server->cancel);
+
+	server->cancel.func(server, &error);
+
+	zval_ptr_dtor(&error);
+}
+
+ZEND_METHOD(UnixServer, getAddress)
+{
+	async_unix_server *server;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	server = (async_unix_server *) Z_OBJ_P(getThis());
+
+	RETURN_STR_COPY(server->name);
+}
+
+ZEND_METHOD(UnixServer, getPort)
+{
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	// Unix sockets are addressed by path only, the Socket interface allows for NULL in this case.
+	RETURN_NULL();
+}
+
+ZEND_METHOD(UnixServer, setOption)
+{
+	async_unix_server *server;
+
+	zend_long option;
+	zval *val;
+
+	int code;
+	int flags;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 2, 2)
+		Z_PARAM_LONG(option)
+		Z_PARAM_ZVAL(val)
+	ZEND_PARSE_PARAMETERS_END();
+
+	server = (async_unix_server *) Z_OBJ_P(getThis());
+
+	switch ((int) option) {
+	case ASYNC_SOCKET_UNIX_ACCESS:
+		// Grants read and / or write access to all users, abstract sockets have no file and cannot be changed.
+		flags = (int) zval_get_long(val);
+		code = (flags == 0 || (flags & ~(UV_READABLE | UV_WRITABLE))) ? UV_EINVAL : uv_pipe_chmod(&server->handle, flags);
+		break;
+	default:
+		code = UV_ENOTSUP;
+	}
+
+	RETURN_BOOL((code < 0) ? 0 : 1);
+}
+
+ZEND_METHOD(UnixServer, accept)
+{
+	async_unix_server *server;
+	async_unix_socket *socket;
+	async_context *context;
+	async_uv_op *op;
+
+	zval obj;
+	int code;
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	server = (async_unix_server *) Z_OBJ_P(getThis());
+
+	if (Z_TYPE_P(&server->error) != IS_UNDEF) {
+		Z_ADDREF_P(&server->error);
+
+		execute_data->opline--;
+		zend_throw_exception_internal(&server->error);
+		execute_data->opline++;
+
+		return;
+	}
+
+	if (server->pending == 0) {
+		ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_uv_op));
+		ASYNC_ENQUEUE_OP(&server->accepts, op);
+
+		context = async_context_get();
+
+		ASYNC_UNREF_ENTER(context, server);
+		code = async_await_op((async_op *) op);
+		ASYNC_UNREF_EXIT(context, server);
+
+		if (code == FAILURE) {
+			ASYNC_FORWARD_OP_ERROR(op);
+			ASYNC_FREE_OP(op);
+
+			return;
+		}
+
+		code = op->code;
+
+		ASYNC_FREE_OP(op);
+
+		ASYNC_CHECK_EXCEPTION(code < 0, async_socket_exception_ce, "Failed to accept socket connection: %s", uv_strerror(code));
+	} else {
+		server->pending--;
+	}
+
+	socket = async_unix_socket_object_create();
+
+	code = uv_accept((uv_stream_t *) &server->handle, (uv_stream_t *) &socket->handle);
+
+	if (UNEXPECTED(code != 0)) {
+		zend_throw_exception_ex(async_socket_exception_ce, 0, "Failed to accept socket connection: %s", uv_strerror(code));
+		ASYNC_DELREF(&socket->std);
+		return;
+	}
+
+	socket->server = server;
+
+	ASYNC_ADDREF(&server->std);
+
+	socket->local_addr = zend_string_copy(server->name);
+	socket->remote_addr = assemble_name(&socket->handle, 1);
+
+	ZVAL_OBJ(&obj, &socket->std);
+
+	RETURN_ZVAL(&obj, 1, 1);
+}
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_unix_server_listen, 0, 1, Concurrent\\Network\\UnixServer, 0)
+	ZEND_ARG_TYPE_INFO(0, path, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_server_close, 0, 0, IS_VOID, 0)
+	ZEND_ARG_OBJ_INFO(0, error, Throwable, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_server_get_address, 0, 0, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_server_get_port, 0, 0, IS_LONG, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unix_server_set_option, 0, 2, _IS_BOOL, 0)
+	ZEND_ARG_TYPE_INFO(0, option, IS_LONG, 0)
+	ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_unix_server_accept, 0, 0, Concurrent\\Network\\SocketStream, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry async_unix_server_functions[] = {
+	ZEND_ME(UnixServer, listen, arginfo_unix_server_listen, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	ZEND_ME(UnixServer, close, arginfo_unix_server_close, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixServer, getAddress, arginfo_unix_server_get_address, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixServer, getPort, arginfo_unix_server_get_port, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixServer, setOption, arginfo_unix_server_set_option, ZEND_ACC_PUBLIC)
+	ZEND_ME(UnixServer, accept, arginfo_unix_server_accept, ZEND_ACC_PUBLIC)
+	ZEND_FE_END
+};
+
+
+void async_unix_ce_register()
+{
+	zend_class_entry ce;
+
+	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\UnixSocket", async_unix_socket_functions);
+	async_unix_socket_ce = zend_register_internal_class(&ce);
+	async_unix_socket_ce->ce_flags |= ZEND_ACC_FINAL;
+	async_unix_socket_ce->serialize = zend_class_serialize_deny;
+	async_unix_socket_ce->unserialize = zend_class_unserialize_deny;
+
+	zend_class_implements(async_unix_socket_ce, 1, async_socket_stream_ce);
+
+	memcpy(&async_unix_socket_handlers, &std_object_handlers, sizeof(zend_object_handlers));
+	async_unix_socket_handlers.dtor_obj = async_unix_socket_object_dtor;
+	async_unix_socket_handlers.free_obj = async_unix_socket_object_destroy;
+	async_unix_socket_handlers.clone_obj = NULL;
+
+	ASYNC_UNIX_SOCKET_CONST("SNDBUF", ASYNC_SOCKET_UNIX_SNDBUF);
+	ASYNC_UNIX_SOCKET_CONST("RCVBUF", ASYNC_SOCKET_UNIX_RCVBUF);
+
+	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\UnixSocketReader", async_unix_socket_reader_functions);
+	async_unix_socket_reader_ce = zend_register_internal_class(&ce);
+	async_unix_socket_reader_ce->ce_flags |= ZEND_ACC_FINAL;
+	async_unix_socket_reader_ce->serialize = zend_class_serialize_deny;
+	async_unix_socket_reader_ce->unserialize = zend_class_unserialize_deny;
+
+	zend_class_implements(async_unix_socket_reader_ce, 1, async_readable_stream_ce);
+
+	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\UnixSocketWriter", async_unix_socket_writer_functions);
+	async_unix_socket_writer_ce = zend_register_internal_class(&ce);
+	async_unix_socket_writer_ce->ce_flags |= ZEND_ACC_FINAL;
+	async_unix_socket_writer_ce->serialize = zend_class_serialize_deny;
+	async_unix_socket_writer_ce->unserialize = zend_class_unserialize_deny;
+
+	zend_class_implements(async_unix_socket_writer_ce, 1, async_writable_stream_ce);
+
+	INIT_CLASS_ENTRY(ce, "Concurrent\\Network\\UnixServer", async_unix_server_functions);
+	async_unix_server_ce = zend_register_internal_class(&ce);
+	async_unix_server_ce->ce_flags |= ZEND_ACC_FINAL;
+	async_unix_server_ce->serialize = zend_class_serialize_deny;
+	async_unix_server_ce->unserialize = zend_class_unserialize_deny;
+
+	zend_class_implements(async_unix_server_ce, 1, async_server_ce);
+
+	memcpy(&async_unix_server_handlers, &std_object_handlers, sizeof(zend_object_handlers));
+	async_unix_server_handlers.dtor_obj = async_unix_server_object_dtor;
+	async_unix_server_handlers.free_obj = async_unix_server_object_destroy;
+	async_unix_server_handlers.clone_obj = NULL;
+
+	ASYNC_UNIX_SERVER_CONST("ACCESS", ASYNC_SOCKET_UNIX_ACCESS);
+	ASYNC_UNIX_SERVER_CONST("READABLE", UV_READABLE);
+	ASYNC_UNIX_SERVER_CONST("WRITABLE", UV_WRITABLE);
+}
@@ -119,36 +119,10 @@ static int tcp_socket_listen(php_stream *stream, async_xp_socket_data *data, php
 	return code;
 }
 
-static void tcp_socket_connect_cb(uv_connect_t *req, int status)
-{
-	async_uv_op *op;	
-	
-	op = (async_uv_op *) req->data;
-	
-	ZEND_ASSERT(op != NULL);
-	
-	op->code = (status == UV_ECANCELED) ? UV_ETIMEDOUT : status;
-	
-	ASYNC_FINISH_OP(op);
-}
-
-static void connect_timer_cb(uv_timer_t *timer)
-{
-	async_xp_socket_data_tcp *tcp;
-	
-	tcp = (async_xp_socket_data_tcp *) timer->data;
-	
-	// Need to close the socket right here to cancel connect, anything else will segfault later...
-	uv_close((uv_handle_t *) &tcp->handle, NULL);
-}
-
 static int tcp_socket_connect(php_stream *stream, async_xp_socket_data *data, php_stream_xport_param *xparam)
 {
 	async_xp_socket_data_tcp *tcp;
-	async_uv_op *op;
 	
-	uv_connect_t req;
-	struct sockaddr_in dest;
 	uint64_t timeout;
 	
 	char *ip;
@@ -159,48 +133,23 @@ static int tcp_socket_connect(php_stream *stream, async_xp_socket_data *data, ph
 	
 	ip = NULL;
 	ip = async_xp_parse_ip(xparam->inputs.name, xparam->inputs.namelen, &port, xparam->want_errortext, &xparam->outputs.error_text);
-	code = async_dns_lookup_ipv4(ip, &dest, IPPROTO_TCP);
 	
-	if (ip != NULL) {
-		efree(ip);
+	if (UNEXPECTED(ip == NULL)) {
+		return FAILURE;
 	}
 	
-	if (UNEXPECTED(code != 0)) {
-		return FAILURE;
+	timeout = 0;
+	
+	if (xparam->inputs.timeout != NULL) {
+		timeout = ((uint64_t) xparam->inputs.timeout->tv_sec) * 1000 + ((uint64_t) xparam->inputs.timeout->tv_usec) / 1000;
 	}
 	
-	dest.sin_port = htons(port);
+	code = async_tcp_connect((uv_tcp_t *) &data->handle, ip, port, timeout);
 	
-	code = uv_tcp_connect(&req, (uv_tcp_t *) &data->handle, (const struct sockaddr *) &dest, tcp_socket_connect_cb);
+	efree(ip);
 	
-	if (EXPECTED(code == 0)) {
-		ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_uv_op));
-		ASYNC_ENQUEUE_OP(&tcp->ops, op);
-		
-		req.data = op;
-		
-		timeout = ((uint64_t) xparam->inputs.timeout->tv_sec) * 1000 + ((uint64_t) xparam->inputs.timeout->tv_usec) / 1000;
-		
-		if (timeout > 0) {
-			uv_timer_start(&data->timer, connect_timer_cb, timeout, 0);
-		}
-		
-		code = async_await_op((async_op *) op);
-		
-		if (timeout > 0) {
-			uv_timer_stop(&data->timer);
-		}
-		
-		if (code == FAILURE) {
-			ASYNC_FORWARD_OP_ERROR(op);
-			ASYNC_FREE_OP(op);
-			
-			return FAILURE;
-		}
-		
-		code = op->code;
-		
-		ASYNC_FREE_OP(op);
+	if (UNEXPECTED(EG(exception))) {
+		return FAILURE;
 	}
 	
 	if (UNEXPECTED(code < 0)) {
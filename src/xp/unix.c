@@ -0,0 +1,296 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 7                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-2018 The PHP Group                                |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.01 of the PHP license,      |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_01.txt                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Martin Schröder <m.schroeder2007@gmail.com>                 |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_async.h"
+#include "async_xp.h"
+
+static php_stream_transport_factory orig_unix_factory;
+
+static php_stream_ops unix_socket_ops;
+
+typedef struct {
+	ASYNC_XP_SOCKET_DATA_BASE
+    uv_pipe_t handle;
+    uint16_t pending;
+    async_op_queue ops;
+} async_xp_socket_data_unix;
+
+
+static void free_cb(uv_handle_t *handle)
+{
+	efree(handle->data);
+}
+
+static int unix_socket_bind(php_stream *stream, async_xp_socket_data *data, php_stream_xport_param *xparam)
+{
+	char *path;
+	int code;
+	
+	path = estrndup(xparam->inputs.name, xparam->inputs.namelen);
+	code = async_unix_bind((uv_pipe_t *) &data->handle, path, xparam->inputs.namelen);
+	
+	efree(path);
+	
+	if (UNEXPECTED(code < 0)) {
+		ASYNC_XP_SOCKET_REPORT_NETWORK_ERROR(code, xparam);
+		
+		return FAILURE;
+	}
+	
+	return SUCCESS;
+}
+
+static void unix_socket_listen_cb(uv_stream_t *server, int status)
+{
+	async_xp_socket_data_unix *pipe;
+	async_uv_op *op;
+	
+	pipe = (async_xp_socket_data_unix *) server->data;
+	
+	if (status == 0) {
+		pipe->pending++;
+	}
+	
+	while (pipe->ops.first != NULL) {
+		ASYNC_DEQUEUE_CUSTOM_OP(&pipe->ops, op, async_uv_op);
+		
+		op->code = status;
+		
+		ASYNC_FINISH_OP(op);
+	}
+}
+
+static int unix_socket_listen(php_stream *stream, async_xp_socket_data *data, php_stream_xport_param *xparam)
+{
+	int code;
+	
+	code = uv_listen((uv_stream_t *) &data->handle, xparam->inputs.backlog, unix_socket_listen_cb);
+	
+	if (UNEXPECTED(code < 0)) {
+		ASYNC_XP_SOCKET_REPORT_NETWORK_ERROR(code, xparam);
+		
+		return FAILURE;
+	}
+
+	return code;
+}
+
+static int unix_socket_connect(php_stream *stream, async_xp_socket_data *data, php_stream_xport_param *xparam)
+{
+	char *path;
+	int code;
+	
+	// Resource names are not guaranteed to be terminated after the socket path.
+	path = estrndup(xparam->inputs.name, xparam->inputs.namelen);
+	code = async_unix_connect((uv_pipe_t *) &data->handle, path, xparam->inputs.namelen);
+	
+	efree(path);
+	
+	if (UNEXPECTED(EG(exception))) {
+		return FAILURE;
+	}
+	
+	if (UNEXPECTED(code < 0)) {
+		ASYNC_XP_SOCKET_REPORT_NETWORK_ERROR(code, xparam);
+		
+		return FAILURE;
+	}
+	
+	data->astream = async_stream_init((uv_stream_t *) &data->handle, 0);
+	
+	return SUCCESS;
+}
+
+static int unix_socket_shutdown(async_xp_socket_data *data, int how)
+{
+	int flag;
+	
+	switch (how) {
+	case ASYNC_XP_SOCKET_SHUT_RD:
+		flag = ASYNC_STREAM_SHUT_RD;
+		break;
+	case ASYNC_XP_SOCKET_SHUT_WR:
+		flag = ASYNC_STREAM_SHUT_WR;
+		break;
+	default:
+		flag = ASYNC_STREAM_SHUT_RDWR;
+	}
+	
+	async_stream_shutdown(data->astream, flag);
+	
+	return SUCCESS;
+}
+
+static int unix_socket_get_peer(async_xp_socket_data *data, zend_bool remote, zend_string **textaddr, struct sockaddr **addr, socklen_t *len)
+{
+#ifdef PHP_WIN32
+	return FAILURE;
+#else
+	php_sockaddr_storage sa;
+	socklen_t sl;
+	uv_os_fd_t fd;
+	int code;
+	
+	code = uv_fileno((const uv_handle_t *) &data->handle, &fd);
+	
+	if (UNEXPECTED(code < 0)) {
+		return code;
+	}
+	
+	memset(&sa, 0, sizeof(php_sockaddr_storage));
+	sl = sizeof(php_sockaddr_storage);
+	
+	if (remote) {
+		code = getpeername(fd, (struct sockaddr *) &sa, &sl);
+	} else {
+		code = getsockname(fd, (struct sockaddr *) &sa, &sl);
+	}
+	
+	if (UNEXPECTED(code != 0)) {
+		return -errno;
+	}
+
+	php_network_populate_name_from_sockaddr((struct sockaddr *) &sa, sl, textaddr, addr, len);
+	
+	return SUCCESS;
+#endif
+}
+
+static int unix_socket_accept(php_stream *stream, async_xp_socket_data *data, php_stream_xport_param *xparam)
+{
+	async_xp_socket_data_unix *server;
+	async_xp_socket_data_unix *client;
+	async_uv_op *op;
+	
+	int code;
+	
+	server = (async_xp_socket_data_unix *) data;
+	code = 0;
+	
+	client = emalloc(sizeof(async_xp_socket_data_unix));
+	ZEND_SECURE_ZERO(client, sizeof(async_xp_socket_data_unix));
+	
+	uv_pipe_init(&server->scheduler->loop, &client->handle, 0);
+	
+	client->handle.data = client;
+
+	do {
+		if (server->pending > 0) {
+			server->pending--;
+			
+			code = uv_accept((uv_stream_t *) &server->handle, (uv_stream_t *) &client->handle);
+			
+			if (code == 0) {
+				xparam->outputs.client = async_xp_socket_create((async_xp_socket_data *) client, &unix_socket_ops, NULL STREAMS_CC);
+				
+				break;
+			}
+		}
+		
+		ASYNC_ALLOC_CUSTOM_OP(op, sizeof(async_uv_op));
+		ASYNC_ENQUEUE_OP(&server->ops, op);
+		
+		if (async_await_op((async_op *) op) == FAILURE) {
+			ASYNC_FORWARD_OP_ERROR(op);
+			ASYNC_FREE_OP(op);
+			
+			break;
+		}
+		
+		code = op->code;
+		
+		ASYNC_FREE_OP(op);
+		
+		if (code < 0) {
+			break;
+		}
+	} while (xparam->outputs.client == NULL);
+	
+	if (UNEXPECTED(xparam->outputs.client == NULL)) {
+		uv_close((uv_handle_t *) &client->handle, free_cb);
+	
+		return code;
+	}
+	
+	xparam->outputs.client->ctx = stream->ctx;
+	
+	if (stream->ctx) {
+		GC_ADDREF(stream->ctx);
+	}
+	
+	client->flags |= ASYNC_XP_SOCKET_FLAG_ACCEPTED;
+	client->astream = async_stream_init((uv_stream_t *) &client->handle, 0);
+	
+	client->shutdown = unix_socket_shutdown;
+	client->get_peer = unix_socket_get_peer;
+
+	return SUCCESS;
+}
+
+static php_stream *unix_socket_factory(const char *proto, size_t plen, const char *res, size_t reslen,
+	const char *pid, int options, int flags, struct timeval *timeout, php_stream_context *context STREAMS_DC)
+{
+	async_xp_socket_data_unix *data;
+	php_stream *stream;
+
+	data = emalloc(sizeof(async_xp_socket_data_unix));
+	ZEND_SECURE_ZERO(data, sizeof(async_xp_socket_data_unix));
+	
+	stream = async_xp_socket_create((async_xp_socket_data *) data, &unix_socket_ops, pid STREAMS_CC);
+
+	if (UNEXPECTED(stream == NULL)) {
+		efree(data);
+	
+		return NULL;
+	}
+ 	
+ 	uv_pipe_init(&data->scheduler->loop, &data->handle, 0);
+ 	
+ 	data->connect = unix_socket_connect;
+ 	data->bind = unix_socket_bind;
+ 	data->listen = unix_socket_listen;
+ 	data->accept = unix_socket_accept;
+	data->shutdown = unix_socket_shutdown;
+	data->get_peer = unix_socket_get_peer;
+	
+	return stream;
+}
+
+void async_unix_socket_init()
+{
+	async_xp_socket_populate_ops(&unix_socket_ops, "unix_socket/async");
+
+	if (ASYNC_G(unix_enabled)) {
+		orig_unix_factory = async_xp_socket_register("unix", unix_socket_factory);
+	}
+	
+	php_stream_xport_register("async-unix", unix_socket_factory);
+}
+
+void async_unix_socket_shutdown()
+{
+	php_stream_xport_unregister("async-unix");
+
+	if (ASYNC_G(unix_enabled)) {
+		if (orig_unix_factory == NULL) {
+			php_stream_xport_unregister("unix");
+		} else {
+			php_stream_xport_register("unix", orig_unix_factory);
+		}
+	}
+}
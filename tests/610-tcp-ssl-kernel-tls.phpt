@@ -0,0 +1,66 @@
+--TEST--
+TCP socket SSL connection with kernel TLS offload.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$file = dirname(__DIR__) . '/examples/cert/localhost.';
+
+$tls = new TlsServerEncryption();
+$tls = $tls->withDefaultCertificate($file . 'crt', $file . 'key', 'localhost');
+$tls = $tls->withKernelTls(true);
+
+$server = TcpServer::listen('127.0.0.1', 0, $tls);
+
+try {
+    $host = $server->getAddress();
+    $port = $server->getPort();
+    
+    Task::async(function () use ($host, $port) {
+        $tls = new TlsClientEncryption();
+        $tls = $tls->withPeerName('localhost');
+        $tls = $tls->withAllowSelfSigned(true);
+        $tls = $tls->withKernelTls(true);
+        
+        $socket = TcpSocket::connect($host, $port, $tls);
+        
+        try {
+            $socket->encrypt();
+            
+            var_dump($socket->read());
+            $socket->write(str_repeat('B', 100000));
+        } finally {
+            $socket->close();
+        }
+    });
+    
+    $socket = $server->accept();
+    
+    try {
+        $socket->encrypt();
+        $socket->write('Hello');
+        
+        $len = 0;
+        
+        while (null !== ($chunk = $socket->read())) {
+            $len += strlen($chunk);
+        }
+        
+        var_dump($len);
+    } finally {
+        $socket->close();
+    }
+} finally {
+    $server->close();
+}
+
+--EXPECT--
+string(5) "Hello"
+int(100000)
@@ -0,0 +1,79 @@
+--TEST--
+TCP socket SSL connection with handshake offloaded to the thread pool.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$file = dirname(__DIR__) . '/examples/cert/localhost.';
+
+$tls = new TlsServerEncryption();
+$tls = $tls->withDefaultCertificate($file . 'crt', $file . 'key', 'localhost');
+$tls = $tls->withHandshakeOffload(true);
+
+$server = TcpServer::listen('127.0.0.1', 0, $tls);
+
+try {
+    $host = $server->getAddress();
+    $port = $server->getPort();
+    
+    $tasks = [];
+    
+    for ($i = 0; $i < 3; $i++) {
+        $tasks[] = Task::async(function () use ($host, $port, $i) {
+            $tls = new TlsClientEncryption();
+            $tls = $tls->withPeerName('localhost');
+            $tls = $tls->withAllowSelfSigned(true);
+            
+            $socket = TcpSocket::connect($host, $port, $tls);
+            
+            try {
+                $socket->encrypt();
+                $socket->write('Client ' . $i);
+                
+                return $socket->read();
+            } finally {
+                $socket->close();
+            }
+        });
+    }
+    
+    for ($i = 0; $i < 3; $i++) {
+        $socket = $server->accept();
+        
+        Task::async(function () use ($socket) {
+            try {
+                $socket->encrypt();
+                $socket->write(strtoupper($socket->read()));
+            } finally {
+                $socket->close();
+            }
+        });
+    }
+    
+    $result = [];
+    
+    foreach ($tasks as $t) {
+        $result[] = Task::await($t);
+    }
+    
+    sort($result);
+    
+    print_r($result);
+} finally {
+    $server->close();
+}
+
+--EXPECT--
+Array
+(
+    [0] => CLIENT 0
+    [1] => CLIENT 1
+    [2] => CLIENT 2
+)
@@ -0,0 +1,76 @@
+--TEST--
+TCP server SSL certificate can be loaded from PEM strings and updated.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$file = dirname(__DIR__) . '/examples/cert/localhost.';
+
+$tls = new TlsServerEncryption();
+$tls = $tls->withDefaultCertificate($file . 'crt', $file . 'key');
+
+$server = TcpServer::listen('127.0.0.1', 0, $tls);
+
+$connect = function () use ($server) {
+    return Task::async(function () use ($server) {
+        $tls = new TlsClientEncryption();
+        $tls = $tls->withPeerName('localhost');
+        $tls = $tls->withAllowSelfSigned(true);
+        
+        $socket = TcpSocket::connect($server->getAddress(), $server->getPort(), $tls);
+        
+        try {
+            $socket->encrypt();
+            
+            return $socket->read();
+        } finally {
+            $socket->close();
+        }
+    });
+};
+
+try {
+    $t = $connect();
+    
+    $socket = $server->accept();
+    $socket->encrypt();
+    
+    $pem = new TlsServerEncryption();
+    $pem = $pem->withDefaultCertificate(file_get_contents($file . 'crt'), file_get_contents($file . 'key'));
+    
+    $server->updateEncryption($pem);
+    
+    $socket->write('A');
+    $socket->close();
+    
+    var_dump(Task::await($t));
+    
+    $t = $connect();
+    
+    $socket = $server->accept();
+    $socket->encrypt();
+    $socket->write('B');
+    $socket->close();
+    
+    var_dump(Task::await($t));
+    
+    try {
+        $server->updateEncryption((new TlsServerEncryption())->withDefaultCertificate('-----BEGIN CERTIFICATE-----', 'foo'));
+    } catch (SocketException $e) {
+        var_dump('FAILED');
+    }
+} finally {
+    $server->close();
+}
+
+--EXPECT--
+string(1) "A"
+string(1) "B"
+string(6) "FAILED"
@@ -0,0 +1,83 @@
+--TEST--
+TCP socket SSL connection negotiates application protocol using ALPN.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$file = dirname(__DIR__) . '/examples/cert/localhost.';
+
+$tls = new TlsServerEncryption();
+$tls = $tls->withDefaultCertificate($file . 'crt', $file . 'key');
+$tls = $tls->withAlpnProtocols(['h2', 'http/1.1']);
+
+$server = TcpServer::listen('127.0.0.1', 0, $tls);
+
+$connect = function (array $protocols) use ($server) {
+    return Task::async(function () use ($server, $protocols) {
+        $tls = new TlsClientEncryption();
+        $tls = $tls->withPeerName('localhost');
+        $tls = $tls->withAllowSelfSigned(true);
+        $tls = $tls->withAlpnProtocols($protocols);
+        
+        $socket = TcpSocket::connect($server->getAddress(), $server->getPort(), $tls);
+        
+        try {
+            $socket->encrypt();
+            
+            return $socket->getAlpnProtocol();
+        } finally {
+            $socket->close();
+        }
+    });
+};
+
+try {
+    foreach ([['http/1.1', 'h2'], ['http/1.1'], []] as $protocols) {
+        $t = $connect($protocols);
+        
+        $socket = $server->accept();
+        $socket->encrypt();
+        
+        var_dump($socket->getAlpnProtocol());
+        var_dump(Task::await($t));
+        
+        $socket->close();
+    }
+} finally {
+    $server->close();
+}
+
+try {
+    (new TlsClientEncryption())->withAlpnProtocols(['']);
+} catch (\Error $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    (new TlsClientEncryption())->withAlpnProtocols(array_fill(0, 300, str_repeat('a', 255)));
+} catch (\Error $e) {
+    var_dump($e->getMessage());
+}
+
+$protocols = ['h2'];
+$ref = &$protocols[0];
+
+var_dump((new TlsClientEncryption())->withAlpnProtocols($protocols) instanceof TlsClientEncryption);
+
+--EXPECT--
+string(2) "h2"
+string(2) "h2"
+string(8) "http/1.1"
+string(8) "http/1.1"
+NULL
+NULL
+string(56) "ALPN protocol names must be between 1 and 255 bytes long"
+string(46) "ALPN protocol list must not exceed 65535 bytes"
+bool(true)
@@ -0,0 +1,59 @@
+--TEST--
+TCP server applies listen options.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+if (DIRECTORY_SEPARATOR == '\\') echo 'Test requires SO_REUSEPORT support';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$options = new ListenOptions();
+$options = $options->withBacklog(1024);
+$options = $options->withReusePort(true);
+$options = $options->withDeferAccept(1);
+$options = $options->withFastOpen(16);
+
+$a = TcpServer::listen('127.0.0.1', 0, null, $options);
+$b = TcpServer::listen('127.0.0.1', $a->getPort(), null, $options);
+
+var_dump($a->getPort() == $b->getPort());
+
+$b->close();
+
+try {
+    Task::async(function () use ($a) {
+        $socket = TcpSocket::connect($a->getAddress(), $a->getPort());
+        
+        try {
+            $socket->write('Hello');
+        } finally {
+            $socket->close();
+        }
+    });
+    
+    $socket = $a->accept();
+    
+    try {
+        var_dump($socket->read());
+    } finally {
+        $socket->close();
+    }
+} finally {
+    $a->close();
+}
+
+try {
+    (new ListenOptions())->withBacklog(0);
+} catch (\Error $e) {
+    var_dump($e->getMessage());
+}
+
+--EXPECT--
+bool(true)
+string(5) "Hello"
+string(34) "Backlog must be a positive integer"
@@ -0,0 +1,77 @@
+--TEST--
+TCP server can accept multiple connections at once.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$server = TcpServer::listen('127.0.0.1', 0);
+
+try {
+    for ($i = 0; $i < 3; $i++) {
+        Task::async(function () use ($server, $i) {
+            $socket = TcpSocket::connect($server->getAddress(), $server->getPort());
+            
+            try {
+                $socket->write('Hello ' . $i);
+            } finally {
+                $socket->close();
+            }
+        });
+    }
+    
+    $received = [];
+    $valid = true;
+    
+    while (count($received) < 3) {
+        $sockets = $server->acceptMany(8);
+        
+        $valid = $valid && count($sockets) > 0 && count($sockets) <= 3;
+        
+        foreach ($sockets as $socket) {
+            try {
+                $received[] = $socket->read();
+            } finally {
+                $socket->close();
+            }
+        }
+    }
+    
+    sort($received);
+    
+    var_dump($valid);
+    var_dump($received);
+} finally {
+    $server->close();
+}
+
+try {
+    TcpServer::listen('127.0.0.1', 0)->acceptMany(0);
+} catch (\Error $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    TcpServer::listen('127.0.0.1', 0)->acceptMany(65536);
+} catch (\Error $e) {
+    var_dump($e->getMessage());
+}
+
+--EXPECT--
+bool(true)
+array(3) {
+  [0]=>
+  string(7) "Hello 0"
+  [1]=>
+  string(7) "Hello 1"
+  [2]=>
+  string(7) "Hello 2"
+}
+string(58) "Maximum number of connections must be between 1 and 65535"
+string(58) "Maximum number of connections must be between 1 and 65535"
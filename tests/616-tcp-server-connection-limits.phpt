@@ -0,0 +1,88 @@
+--TEST--
+TCP server pauses accepting connections when the connection limit is reached.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+use Concurrent\Timer;
+
+$options = (new ListenOptions())->withMaxConnections(1);
+
+$server = TcpServer::listen('127.0.0.1', 0, null, $options);
+
+try {
+    $client = TcpSocket::connect($server->getAddress(), $server->getPort());
+    $client->write('Hello 0');
+    
+    $a = $server->accept();
+    
+    $stats = $server->getConnectionStats();
+    
+    var_dump($stats['connections'], $stats['accepted'], $stats['paused']);
+    
+    $accepted = false;
+    
+    $t = Task::async(function () use ($server, &$accepted) {
+        $socket = $server->accept();
+        $accepted = true;
+        
+        return $socket;
+    });
+    
+    // The connection is established by the kernel but must not be accepted while the server is paused.
+    $other = TcpSocket::connect($server->getAddress(), $server->getPort());
+    $other->write('Hello 1');
+    
+    (new Timer(50))->awaitTimeout();
+    
+    $stats = $server->getConnectionStats();
+    
+    var_dump($accepted, $stats['connections'], $stats['accepted'], $stats['pending'], $stats['paused']);
+    
+    var_dump($a->read());
+    $a->close();
+    
+    $b = Task::await($t);
+    
+    var_dump($accepted, $b->read());
+    
+    $stats = $server->getConnectionStats();
+    
+    var_dump($stats['connections'], $stats['accepted'], $stats['pending'], $stats['paused']);
+    
+    $b->close();
+    $client->close();
+    $other->close();
+} finally {
+    $server->close();
+}
+
+try {
+    (new ListenOptions())->withMaxConnections(2, 3);
+} catch (\Error $e) {
+    var_dump($e->getMessage());
+}
+
+--EXPECT--
+int(1)
+int(1)
+bool(true)
+bool(false)
+int(1)
+int(1)
+int(1)
+bool(true)
+string(7) "Hello 0"
+bool(true)
+string(7) "Hello 1"
+int(1)
+int(2)
+int(0)
+bool(true)
+string(69) "Low watermark must be between 1 and the maximum number of connections"
@@ -0,0 +1,87 @@
+--TEST--
+Connection pool reuses idle sockets.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$server = TcpServer::listen('127.0.0.1', 0);
+
+$t = Task::async(function () use ($server) {
+    $count = 0;
+
+    while ($count < 2) {
+        $socket = $server->accept();
+        $count++;
+        
+        Task::async(function () use ($socket) {
+            try {
+                while (null !== ($chunk = $socket->read())) {
+                    $socket->write(strtoupper($chunk));
+                }
+            } finally {
+                $socket->close();
+            }
+        });
+    }
+    
+    return $count;
+});
+
+$pool = new ConnectionPool(1);
+
+$a = $pool->checkout($server->getAddress(), $server->getPort());
+$a->write('a');
+var_dump($a->read());
+$pool->release($a);
+
+$b = $pool->checkout($server->getAddress(), $server->getPort());
+var_dump($a === $b);
+
+$w = Task::async(function () use ($pool, $server) {
+    $socket = $pool->checkout($server->getAddress(), $server->getPort());
+    $socket->write('b');
+    
+    try {
+        return $socket->read();
+    } finally {
+        $pool->release($socket, false);
+    }
+});
+
+$pool->release($b);
+
+var_dump(Task::await($w));
+
+$c = $pool->checkout($server->getAddress(), $server->getPort());
+var_dump($c === $a);
+$c->write('c');
+var_dump($c->read());
+$pool->release($c);
+unset($c);
+
+var_dump(Task::await($t));
+
+try {
+    $pool->release($a);
+} catch (\Error $e) {
+    var_dump($e->getMessage());
+}
+
+$pool->close();
+$server->close();
+
+--EXPECT--
+string(1) "A"
+bool(true)
+string(1) "B"
+bool(false)
+string(1) "C"
+int(2)
+string(57) "Socket has not been checked out from this connection pool"
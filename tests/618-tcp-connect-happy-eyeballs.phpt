@@ -0,0 +1,49 @@
+--TEST--
+TCP socket connect falls back to other addresses of a dual-stack host.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$server = TcpServer::listen('127.0.0.1', 0);
+
+try {
+    Task::async(function () use ($server) {
+        $socket = $server->accept();
+        
+        try {
+            $socket->write('Hello');
+        } finally {
+            $socket->close();
+        }
+    });
+    
+    // localhost may resolve to ::1 first, the IPv6 attempt is refused because the server only listens on IPv4.
+    $socket = TcpSocket::connect('localhost', $server->getPort(), null, 1000);
+    
+    try {
+        var_dump($socket->getRemoteAddress());
+        var_dump($socket->read());
+    } finally {
+        $socket->close();
+    }
+} finally {
+    $server->close();
+}
+
+try {
+    TcpSocket::connect('localhost', 80, null, -1);
+} catch (\Error $e) {
+    var_dump($e->getMessage());
+}
+
+--EXPECT--
+string(9) "127.0.0.1"
+string(5) "Hello"
+string(36) "Connect timeout must not be negative"
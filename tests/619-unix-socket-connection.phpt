@@ -0,0 +1,77 @@
+--TEST--
+Unix domain socket connection.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+if (DIRECTORY_SEPARATOR == '\\') echo 'Test requires Unix domain sockets';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$path = sys_get_temp_dir() . '/async-619-' . getmypid() . '.sock';
+
+$server = UnixServer::listen($path);
+
+try {
+    var_dump($server->getAddress() == $path);
+    var_dump($server->getPort());
+    
+    Task::async(function () use ($path) {
+        $socket = UnixSocket::connect($path);
+        
+        try {
+            var_dump($socket->getRemoteAddress() == $path);
+            
+            $socket->write('Hello');
+            $socket->getWritableStream()->close();
+            
+            var_dump($socket->read());
+        } finally {
+            $socket->close();
+        }
+    });
+    
+    $socket = $server->accept();
+    
+    try {
+        var_dump($socket instanceof SocketStream);
+        var_dump($socket->getAddress() == $path);
+        
+        $buffer = '';
+        
+        while (null !== ($chunk = $socket->read())) {
+            $buffer .= $chunk;
+        }
+        
+        var_dump($buffer);
+        
+        $socket->write('World');
+    } finally {
+        $socket->close();
+    }
+} finally {
+    $server->close();
+}
+
+var_dump(file_exists($path));
+
+try {
+    UnixSocket::connect($path);
+} catch (SocketException $e) {
+    echo "Connect failed\n";
+}
+
+--EXPECT--
+bool(true)
+NULL
+bool(true)
+bool(true)
+bool(true)
+string(5) "Hello"
+string(5) "World"
+bool(false)
+Connect failed
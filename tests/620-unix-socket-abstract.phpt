@@ -0,0 +1,44 @@
+--TEST--
+Unix domain socket using the Linux abstract namespace.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+if (PHP_OS != 'Linux') echo 'Test requires Linux';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$name = "\0async-620-" . getmypid();
+
+$server = UnixServer::listen($name);
+
+try {
+    Task::async(function () use ($name) {
+        $socket = UnixSocket::connect($name);
+        
+        try {
+            $socket->write('Hello');
+        } finally {
+            $socket->close();
+        }
+    });
+    
+    $socket = $server->accept();
+    
+    try {
+        var_dump($socket->getAddress() === $name);
+        var_dump($socket->read());
+    } finally {
+        $socket->close();
+    }
+} finally {
+    $server->close();
+}
+
+--EXPECT--
+bool(true)
+string(5) "Hello"
@@ -0,0 +1,81 @@
+--TEST--
+Unix domain socket can transfer TCP servers and sockets.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+if (DIRECTORY_SEPARATOR == '\\') echo 'Test requires Unix domain sockets';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$path = sys_get_temp_dir() . '/async-621-' . getmypid() . '.sock';
+
+$ipc = UnixServer::listen($path);
+
+$t = Task::async(function () use ($path) {
+    $server = TcpServer::listen('127.0.0.1', 0);
+    $sender = UnixSocket::connect($path);
+    
+    try {
+        $sender->sendHandle($server);
+    } finally {
+        $server->close();
+    }
+    
+    $client = TcpSocket::connect('127.0.0.1', $server->getPort());
+    
+    try {
+        $client->write('Hello');
+        
+        $sender->sendHandle($client);
+    } finally {
+        $client->close();
+        $sender->close();
+    }
+});
+
+$receiver = $ipc->accept();
+
+try {
+    $server = $receiver->receiveHandle();
+    
+    var_dump($server instanceof TcpServer);
+    var_dump($server->getPort() > 0);
+    
+    $socket = $server->accept();
+    
+    try {
+        var_dump($socket->read());
+    } finally {
+        $socket->close();
+        $server->close();
+    }
+    
+    $client = $receiver->receiveHandle();
+    
+    var_dump($client instanceof TcpSocket);
+    
+    $client->close();
+    
+    try {
+        $receiver->sendHandle($receiver);
+    } catch (SocketException $e) {
+        var_dump($e->getMessage());
+    }
+} finally {
+    $receiver->close();
+    $ipc->close();
+}
+
+Task::await($t);
+
+--EXPECT--
+bool(true)
+bool(true)
+string(5) "Hello"
+bool(true)
+string(47) "Only TCP sockets and servers can be transferred"
@@ -0,0 +1,73 @@
+--TEST--
+TCP socket options and TCP_INFO.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+if (PHP_OS != 'Linux') echo 'Test requires Linux';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+$server = TcpServer::listen('127.0.0.1', 0);
+
+try {
+    $socket = TcpSocket::connect('127.0.0.1', $server->getPort());
+    
+    try {
+        var_dump($socket->setOption(TcpSocket::NODELAY, true));
+        var_dump($socket->getOption(TcpSocket::NODELAY));
+        
+        var_dump($socket->setOption(TcpSocket::SNDBUF, 65536));
+        var_dump($socket->getOption(TcpSocket::SNDBUF) >= 65536);
+        
+        var_dump($socket->setOption(TcpSocket::LINGER, 5));
+        var_dump($socket->getOption(TcpSocket::LINGER));
+        var_dump($socket->setOption(TcpSocket::LINGER, false));
+        var_dump($socket->getOption(TcpSocket::LINGER));
+        
+        var_dump($socket->setOption(TcpSocket::USER_TIMEOUT, 5000));
+        var_dump($socket->getOption(TcpSocket::USER_TIMEOUT));
+        
+        var_dump($socket->setOption(TcpSocket::NOTSENT_LOWAT, 16384));
+        var_dump($socket->getOption(TcpSocket::NOTSENT_LOWAT));
+        
+        var_dump($socket->setOption(TcpSocket::TOS, 0x10));
+        var_dump($socket->getOption(TcpSocket::TOS));
+        
+        var_dump($socket->getOption(12345));
+        
+        $info = $socket->getTcpInfo();
+        
+        var_dump($info['state']);
+        var_dump($info['rtt'] >= 0);
+        var_dump($info['cwnd'] > 0);
+        var_dump($info['retransmits']);
+    } finally {
+        $socket->close();
+    }
+} finally {
+    $server->close();
+}
+
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+int(5)
+bool(true)
+bool(false)
+bool(true)
+int(5000)
+bool(true)
+int(16384)
+bool(true)
+int(16)
+NULL
+int(1)
+bool(true)
+bool(true)
+int(0)
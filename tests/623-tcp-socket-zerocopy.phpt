@@ -0,0 +1,67 @@
+--TEST--
+TCP socket zero-copy sends.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+if (PHP_OS != 'Linux') echo 'Test requires Linux';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$server = TcpServer::listen('127.0.0.1', 0);
+
+try {
+    $t = Task::async(function () use ($server) {
+        $socket = $server->accept();
+        $len = 0;
+        
+        try {
+            while (null !== ($chunk = $socket->read())) {
+                $len += strlen($chunk);
+            }
+        } finally {
+            $socket->close();
+        }
+        
+        return $len;
+    });
+
+    $socket = TcpSocket::connect('127.0.0.1', $server->getPort());
+    
+    try {
+        var_dump($socket->getOption(TcpSocket::ZEROCOPY));
+        var_dump($socket->setOption(TcpSocket::ZEROCOPY, 16384));
+        var_dump($socket->getOption(TcpSocket::ZEROCOPY));
+        
+        $data = str_repeat('A', 1024 * 1024);
+        
+        for ($i = 0; $i < 4; $i++) {
+            $socket->write($data);
+        }
+        
+        $socket->write('done');
+        
+        var_dump($socket->setOption(TcpSocket::ZEROCOPY, 0));
+        var_dump($socket->getOption(TcpSocket::ZEROCOPY));
+        
+        $socket->write($data);
+    } finally {
+        $socket->close();
+    }
+    
+    var_dump(Task::await($t));
+} finally {
+    $server->close();
+}
+
+--EXPECT--
+int(0)
+bool(true)
+int(16384)
+bool(true)
+int(0)
+int(5242884)
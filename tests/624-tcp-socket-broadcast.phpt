@@ -0,0 +1,75 @@
+--TEST--
+TCP socket broadcast.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+$a = TcpSocket::pair();
+$b = TcpSocket::pair();
+$c = TcpSocket::pair();
+
+$sockets = [
+    'a' => $a[0],
+    'b' => $b[0],
+    'c' => $c[0]
+];
+
+var_dump(TcpSocket::broadcast($sockets, 'Hello'));
+var_dump(TcpSocket::broadcast($sockets, ' World'));
+
+var_dump($a[1]->read(), $b[1]->read(), $c[1]->read());
+
+$c[0]->close();
+
+var_dump(TcpSocket::broadcast($sockets, 'A'));
+var_dump(TcpSocket::broadcast($sockets, 'Too large', 4));
+var_dump(TcpSocket::broadcast([$a[0]], 'Drop', 2, true));
+
+var_dump($a[1]->read());
+var_dump($b[1]->read());
+
+try {
+    $a[0]->write('X');
+} catch (\Throwable $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    TcpSocket::broadcast([$a[0], 'foo'], 'X');
+} catch (\TypeError $e) {
+    var_dump($e->getMessage());
+}
+
+--EXPECT--
+array(0) {
+}
+array(0) {
+}
+string(11) "Hello World"
+string(11) "Hello World"
+string(11) "Hello World"
+array(1) {
+  [0]=>
+  string(1) "c"
+}
+array(3) {
+  [0]=>
+  string(1) "a"
+  [1]=>
+  string(1) "b"
+  [2]=>
+  string(1) "c"
+}
+array(1) {
+  [0]=>
+  int(0)
+}
+string(1) "A"
+string(1) "A"
+string(65) "Socket has been closed due to exceeding the broadcast queue limit"
+string(37) "All sockets must be TcpSocket objects"
@@ -0,0 +1,62 @@
+--TEST--
+TCP socket read, write and idle timeouts.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+list ($a, $b) = TcpSocket::pair();
+
+var_dump($a->setOption(TcpSocket::READ_TIMEOUT, 50));
+var_dump($a->getOption(TcpSocket::READ_TIMEOUT));
+var_dump($a->setOption(TcpSocket::READ_TIMEOUT, -1));
+
+try {
+    $a->read();
+} catch (\Concurrent\Stream\StreamException $e) {
+    var_dump($e->getMessage());
+}
+
+$b->write('A');
+
+var_dump($a->read());
+
+var_dump($a->setOption(TcpSocket::WRITE_TIMEOUT, 1000));
+var_dump($a->getOption(TcpSocket::WRITE_TIMEOUT));
+
+$a->write('B');
+
+var_dump($b->read());
+
+var_dump($a->setOption(TcpSocket::READ_TIMEOUT, 0));
+var_dump($a->setOption(TcpSocket::IDLE_TIMEOUT, 50));
+var_dump($a->getOption(TcpSocket::IDLE_TIMEOUT));
+
+try {
+    $a->read();
+} catch (\Concurrent\Stream\StreamClosedException $e) {
+    var_dump($e->getMessage());
+}
+
+var_dump($b->read());
+
+$b->close();
+
+--EXPECT--
+bool(true)
+int(50)
+bool(false)
+string(24) "Read operation timed out"
+string(1) "A"
+bool(true)
+int(1000)
+string(1) "B"
+bool(true)
+bool(true)
+int(50)
+string(40) "Socket has been closed due to inactivity"
+NULL
@@ -0,0 +1,62 @@
+--TEST--
+TCP SSL records split across reads.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+use Concurrent\Timer;
+
+require_once __DIR__ . '/ssl.inc';
+
+list ($a, $b) = sslPair();
+
+$t = Task::async(function () use ($a) {
+    try {
+        $timer = new Timer(1);
+        $ctx = hash_init('md5');
+        $len = 0;
+        $i = 0;
+
+        while (null !== ($chunk = $a->read(1337))) {
+            if (++$i % 50 == 0) {
+                $timer->awaitTimeout();
+            }
+
+            hash_update($ctx, $chunk);
+            $len += strlen($chunk);
+        }
+
+        return [$len, hash_final($ctx)];
+    } finally {
+        $a->close();
+    }
+});
+
+$ctx = hash_init('md5');
+
+try {
+    for ($i = 0; $i < 200; $i++) {
+        $chunk = str_repeat(md5((string) $i, true), 1250 + $i);
+
+        hash_update($ctx, $chunk);
+
+        $b->write($chunk);
+    }
+} finally {
+    $b->close();
+}
+
+list ($len, $hash) = Task::await($t);
+
+var_dump($len);
+var_dump($hash === hash_final($ctx));
+
+--EXPECT--
+int(4318400)
+bool(true)
@@ -0,0 +1,79 @@
+--TEST--
+Unix domain socket options and path validation.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+if (DIRECTORY_SEPARATOR == '\\') echo 'Test requires Unix domain sockets';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+$path = sys_get_temp_dir() . '/async-627-' . getmypid() . '.sock';
+$long = sys_get_temp_dir() . '/' . str_repeat('a', 200) . '.sock';
+
+try {
+    UnixServer::listen($long);
+} catch (SocketException $e) {
+    var_dump($e->getMessage());
+}
+
+try {
+    UnixSocket::connect($long);
+} catch (SocketException $e) {
+    var_dump($e->getMessage());
+}
+
+var_dump(file_exists($long));
+
+$server = UnixServer::listen($path);
+
+try {
+    var_dump($server->setOption(UnixServer::ACCESS, UnixServer::READABLE | UnixServer::WRITABLE));
+    
+    clearstatcache();
+    var_dump((fileperms($path) & 0006) == 0006);
+    
+    var_dump($server->setOption(UnixServer::ACCESS, 0));
+    var_dump($server->setOption(9999, 1));
+    
+    Task::async(function () use ($path) {
+        $socket = UnixSocket::connect($path);
+        
+        try {
+            var_dump($socket->setOption(UnixSocket::SNDBUF, 1 << 16));
+            var_dump($socket->setOption(UnixSocket::RCVBUF, 0));
+            var_dump($socket->setOption(9999, 1));
+            
+            $socket->write('Hello');
+        } finally {
+            $socket->close();
+        }
+    });
+    
+    $socket = $server->accept();
+    
+    try {
+        var_dump($socket->read());
+    } finally {
+        $socket->close();
+    }
+} finally {
+    $server->close();
+}
+
+--EXPECT--
+string(36) "Failed to bind server: name too long"
+string(39) "Failed to connect socket: name too long"
+bool(false)
+bool(true)
+bool(true)
+bool(false)
+bool(false)
+bool(true)
+bool(false)
+bool(false)
+string(5) "Hello"
@@ -0,0 +1,49 @@
+--TEST--
+TCP socket write timeout applies to all pending writes if the peer does not read.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+use Concurrent\Stream\StreamException;
+
+list ($a, $b) = TcpSocket::pair();
+
+var_dump($a->setOption(TcpSocket::WRITE_TIMEOUT, 100));
+
+$chunk = str_repeat('A', 1024 * 1024 * 8);
+
+$t = Task::async(function () use ($a, $chunk) {
+    try {
+        $a->write($chunk);
+    } catch (StreamException $e) {
+        return $e->getMessage();
+    }
+});
+
+try {
+    $a->write($chunk);
+} catch (StreamException $e) {
+    var_dump($e->getMessage());
+}
+
+var_dump(Task::await($t));
+
+try {
+    $a->write('B');
+} catch (StreamException $e) {
+    var_dump($e->getMessage());
+}
+
+$b->close();
+
+--EXPECT--
+bool(true)
+string(25) "Write operation timed out"
+string(25) "Write operation timed out"
+string(25) "Write operation timed out"
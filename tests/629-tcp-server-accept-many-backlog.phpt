@@ -0,0 +1,66 @@
+--TEST--
+TCP server accepts all connections queued in the backlog with a single call.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+if (DIRECTORY_SEPARATOR == '\\') echo 'skip Test requires direct backlog access';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Timer;
+
+$server = TcpServer::listen('127.0.0.1', 0);
+$clients = [];
+
+try {
+    for ($i = 0; $i < 5; $i++) {
+        $clients[] = TcpSocket::connect($server->getAddress(), $server->getPort());
+    }
+    
+    (new Timer(50))->awaitTimeout();
+    
+    var_dump($server->getConnectionStats()['pending']);
+    
+    $sockets = $server->acceptMany(10);
+    
+    var_dump(count($sockets));
+    
+    $ports = array_map(function (TcpSocket $socket) {
+        return $socket->getRemotePort();
+    }, $sockets);
+    
+    sort($ports);
+    
+    $expected = array_map(function (TcpSocket $socket) {
+        return $socket->getPort();
+    }, $clients);
+    
+    sort($expected);
+    
+    var_dump($ports === $expected);
+    
+    $stats = $server->getConnectionStats();
+    
+    var_dump($stats['pending'], $stats['accepted'], $stats['connections']);
+    
+    foreach ($sockets as $socket) {
+        $socket->close();
+    }
+} finally {
+    foreach ($clients as $client) {
+        $client->close();
+    }
+    
+    $server->close();
+}
+
+--EXPECT--
+int(1)
+int(5)
+bool(true)
+int(0)
+int(5)
+int(5)
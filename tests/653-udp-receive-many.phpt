@@ -0,0 +1,77 @@
+--TEST--
+UDP batch receive.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+use Concurrent\Timer;
+
+$a = UdpSocket::bind('127.0.0.1', 0);
+$b = UdpSocket::bind('127.0.0.1', 0);
+
+try {
+    $t = Task::async(function () use ($a) {
+        $received = [];
+        
+        while (count($received) < 8) {
+            foreach ($a->receiveMany(5) as $datagram) {
+                $received[] = $datagram->data;
+            }
+        }
+        
+        return $received;
+    });
+    
+    for ($i = 0; $i < 8; $i++) {
+        $b->send(new UdpDatagram('D' . $i, '127.0.0.1', $a->getPort()));
+    }
+    
+    print_r(Task::await($t));
+    
+    for ($i = 0; $i < 3; $i++) {
+        $b->send(new UdpDatagram('X' . $i, '127.0.0.1', $a->getPort()));
+    }
+    
+    (new Timer(50))->awaitTimeout();
+    
+    $batch = $a->receiveMany(2);
+    
+    var_dump(count($batch));
+    var_dump($batch[0]->data, $batch[0]->address, $batch[0]->port == $b->getPort());
+    
+    var_dump($a->receiveMany(10)[0]->data);
+    
+    try {
+        $a->receiveMany(0);
+    } catch (\Error $e) {
+        var_dump($e->getMessage());
+    }
+} finally {
+    $a->close();
+    $b->close();
+}
+
+--EXPECT--
+Array
+(
+    [0] => D0
+    [1] => D1
+    [2] => D2
+    [3] => D3
+    [4] => D4
+    [5] => D5
+    [6] => D6
+    [7] => D7
+)
+int(2)
+string(2) "X0"
+string(9) "127.0.0.1"
+bool(true)
+string(2) "X2"
+string(38) "Number of datagrams must be at least 1"
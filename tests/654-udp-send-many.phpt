@@ -0,0 +1,67 @@
+--TEST--
+UDP batch send.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Timer;
+
+$a = UdpSocket::bind('127.0.0.1', 0);
+$b = UdpSocket::bind('127.0.0.1', 0);
+
+function receive(UdpSocket $socket, int $num): array
+{
+    $received = [];
+    
+    while (count($received) < $num) {
+        foreach ($socket->receiveMany($num) as $datagram) {
+            $received[] = $datagram->data;
+        }
+    }
+    
+    return $received;
+}
+
+try {
+    var_dump($b->sendMany([]));
+    var_dump($b->sendMany([
+        new UdpDatagram('A', '127.0.0.1', $a->getPort()),
+        new UdpDatagram('B', '127.0.0.1', $a->getPort()),
+        new UdpDatagram('C', '127.0.0.1', $a->getPort())
+    ]) >= 0);
+    
+    echo implode(', ', receive($a, 3)), "\n";
+    
+    // GSO is used only if supported by the OS, datagrams are received separately in both cases.
+    $b->setOption(UdpSocket::SEGMENT_SIZE, 4);
+    
+    $b->sendMany([
+        new UdpDatagram('1111', '127.0.0.1', $a->getPort()),
+        new UdpDatagram('2222', '127.0.0.1', $a->getPort()),
+        new UdpDatagram('33', '127.0.0.1', $a->getPort()),
+        new UdpDatagram('4444', '127.0.0.1', $a->getPort())
+    ]);
+    
+    echo implode(', ', receive($a, 4)), "\n";
+    
+    try {
+        $b->sendMany(['foo']);
+    } catch (\TypeError $e) {
+        var_dump($e->getMessage());
+    }
+} finally {
+    $a->close();
+    $b->close();
+}
+
+--EXPECT--
+int(0)
+bool(true)
+A, B, C
+1111, 2222, 33, 4444
+string(40) "All input elements must be UDP datagrams"
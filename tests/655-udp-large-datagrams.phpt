@@ -0,0 +1,50 @@
+--TEST--
+UDP large datagrams and max datagram size.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Timer;
+
+$a = UdpSocket::bind('127.0.0.1', 0);
+$b = UdpSocket::bind('127.0.0.1', 0);
+
+try {
+    $b->send(new UdpDatagram(str_repeat('A', 20000), '127.0.0.1', $a->getPort()));
+    
+    var_dump(strlen($a->receive()->data));
+    
+    $b->send(new UdpDatagram(str_repeat('B', 30000), '127.0.0.1', $a->getPort()));
+    $b->send(new UdpDatagram('C', '127.0.0.1', $a->getPort()));
+    
+    (new Timer(50))->awaitTimeout();
+    
+    foreach ($a->receiveMany(2) as $datagram) {
+        var_dump(strlen($datagram->data), $datagram->data[0]);
+    }
+    
+    var_dump($a->setOption(UdpSocket::MAX_DATAGRAM_SIZE, 0));
+    var_dump($a->setOption(UdpSocket::MAX_DATAGRAM_SIZE, 100));
+    
+    $b->send(new UdpDatagram(str_repeat('D', 200), '127.0.0.1', $a->getPort()));
+    
+    var_dump($a->receive()->data === str_repeat('D', 100));
+} finally {
+    $a->close();
+    $b->close();
+}
+
+--EXPECT--
+int(20000)
+int(30000)
+string(1) "B"
+int(1)
+string(1) "C"
+bool(false)
+bool(true)
+bool(true)
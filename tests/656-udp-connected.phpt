@@ -0,0 +1,67 @@
+--TEST--
+UDP connected socket.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+use Concurrent\Timer;
+
+$a = UdpSocket::bind('127.0.0.1', 0);
+$b = UdpSocket::connect('127.0.0.1', $a->getPort());
+$c = UdpSocket::bind('127.0.0.1', 0);
+
+try {
+    var_dump($b->getAddress());
+    
+    $t = Task::async(function () use ($b) {
+        return $b->read();
+    });
+    
+    $b->write('hello');
+    
+    $datagram = $a->receive();
+    
+    var_dump($datagram->data, $datagram->port == $b->getPort());
+    
+    $c->send(new UdpDatagram('ignored', '127.0.0.1', $b->getPort()));
+    $a->send(new UdpDatagram('world', $datagram->address, $datagram->port));
+    
+    var_dump(Task::await($t));
+    
+    $a->send(new UdpDatagram('ready', $datagram->address, $datagram->port));
+    
+    (new Timer(50))->awaitTimeout();
+    
+    var_dump($b->read());
+    
+    $a->send(new UdpDatagram('', $datagram->address, $datagram->port));
+    
+    (new Timer(50))->awaitTimeout();
+    
+    var_dump($b->read());
+    
+    try {
+        $a->read();
+    } catch (\Error $e) {
+        var_dump($e->getMessage());
+    }
+} finally {
+    $a->close();
+    $b->close();
+    $c->close();
+}
+
+--EXPECT--
+string(9) "127.0.0.1"
+string(5) "hello"
+bool(true)
+string(5) "world"
+string(5) "ready"
+string(0) ""
+string(27) "UDP socket is not connected"
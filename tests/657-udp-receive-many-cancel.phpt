@@ -0,0 +1,69 @@
+--TEST--
+UDP batch receive can be cancelled without losing datagrams.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Context;
+use Concurrent\Task;
+use Concurrent\Timer;
+
+$a = UdpSocket::bind('127.0.0.1', 0);
+$b = UdpSocket::bind('127.0.0.1', 0);
+
+try {
+    $t = Task::asyncWithContext(Context::current()->withTimeout(50), function () use ($a) {
+        return $a->receiveMany(5);
+    });
+
+    try {
+        Task::await($t);
+    } catch (\Throwable $e) {
+        var_dump(get_class($e));
+    }
+
+    for ($i = 0; $i < 3; $i++) {
+        $b->send(new UdpDatagram('D' . $i, '127.0.0.1', $a->getPort()));
+    }
+
+    (new Timer(50))->awaitTimeout();
+
+    var_dump(array_map(function (UdpDatagram $datagram) {
+        return $datagram->data;
+    }, $a->receiveMany(10)));
+
+    $t = Task::async(function () use ($a) {
+        return $a->receiveMany(5);
+    });
+
+    (new Timer(50))->awaitTimeout();
+
+    $a->close(new \Error('FAIL'));
+
+    try {
+        Task::await($t);
+    } catch (\Throwable $e) {
+        var_dump($e->getMessage(), $e->getPrevious()->getMessage());
+    }
+} finally {
+    $a->close();
+    $b->close();
+}
+
+--EXPECT--
+string(32) "Concurrent\CancellationException"
+array(3) {
+  [0]=>
+  string(2) "D0"
+  [1]=>
+  string(2) "D1"
+  [2]=>
+  string(2) "D2"
+}
+string(22) "Socket has been closed"
+string(4) "FAIL"
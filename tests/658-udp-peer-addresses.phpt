@@ -0,0 +1,76 @@
+--TEST--
+UDP datagrams report IPv4 and IPv6 peer addresses and can be answered.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+if (PHP_OS != 'Linux') echo 'skip Test requires the whole 127.0.0.0/8 loopback range';
+if (!@stream_socket_server('udp://[::1]:0', $errno, $errstr, STREAM_SERVER_BIND)) echo 'skip IPv6 is not available';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+$v4 = UdpSocket::bind('127.0.0.1', 0);
+$v6 = UdpSocket::bind('::1', 0);
+
+var_dump($v6->getAddress());
+
+try {
+    $peer = stream_socket_client('udp://[::1]:' . $v6->getPort());
+    fwrite($peer, 'IPv6');
+
+    $datagram = $v6->receive();
+
+    var_dump($datagram->data, $datagram->address);
+
+    $name = stream_socket_get_name($peer, false);
+
+    var_dump((int) substr($name, strrpos($name, ':') + 1) === $datagram->port);
+
+    $v6->send($datagram->withData('reply'));
+    var_dump(fread($peer, 100));
+
+    fclose($peer);
+
+    // Use more peers than the cache can hold, evicted peers must be formatted again when they come back.
+    $ips = [];
+
+    for ($i = 0; $i < 300; $i++) {
+        $ips[] = sprintf('127.0.%d.%d', 1 + intdiv($i, 250), 1 + $i % 250);
+    }
+
+    $ips = array_merge($ips, array_slice($ips, 0, 50), array_slice($ips, 250));
+
+    $errors = 0;
+
+    foreach ($ips as $ip) {
+        $socket = UdpSocket::bind($ip, 0);
+
+        try {
+            $socket->send(new UdpDatagram($ip, '127.0.0.1', $v4->getPort()));
+        } finally {
+            $socket->close();
+        }
+
+        $datagram = $v4->receive();
+
+        if ($datagram->address !== $ip || $datagram->data !== $ip) {
+            $errors++;
+        }
+    }
+
+    var_dump(count($ips), $errors);
+} finally {
+    $v4->close();
+    $v6->close();
+}
+
+--EXPECT--
+string(3) "::1"
+string(4) "IPv6"
+string(3) "::1"
+bool(true)
+string(5) "reply"
+int(400)
+int(0)
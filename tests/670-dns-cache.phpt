@@ -0,0 +1,49 @@
+--TEST--
+DNS cache.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--INI--
+async.dns_cache_size=2
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+DnsCache::flush();
+
+$stats = DnsCache::getStats();
+
+var_dump($stats['capacity'], $stats['entries']);
+
+UdpSocket::bind('localhost', 0)->close();
+UdpSocket::bind('LocalHost', 0)->close();
+
+$current = DnsCache::getStats();
+
+var_dump($current['entries']);
+var_dump($current['misses'] - $stats['misses']);
+var_dump($current['hits'] - $stats['hits']);
+
+UdpSocket::bind('127.0.0.1', 0)->close();
+UdpSocket::bind('0.0.0.0', 0)->close();
+
+$current = DnsCache::getStats();
+
+var_dump($current['entries']);
+var_dump($current['evictions'] - $stats['evictions']);
+
+DnsCache::flush();
+
+var_dump(DnsCache::getStats()['entries']);
+
+--EXPECT--
+int(2)
+int(0)
+int(1)
+int(1)
+int(1)
+int(2)
+int(1)
+int(0)
@@ -0,0 +1,50 @@
+--TEST--
+DNS lookups of the same host are coalesced.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+DnsCache::flush();
+
+$stats = DnsCache::getStats();
+
+$tasks = [];
+
+for ($i = 0; $i < 5; $i++) {
+    $tasks[] = Task::async(function () {
+        $socket = UdpSocket::bind('localhost', 0);
+        
+        try {
+            return $socket->getAddress();
+        } finally {
+            $socket->close();
+        }
+    });
+}
+
+foreach ($tasks as $task) {
+    var_dump(Task::await($task));
+}
+
+$current = DnsCache::getStats();
+
+var_dump($current['misses'] - $stats['misses']);
+var_dump($current['coalesced'] - $stats['coalesced']);
+var_dump($current['entries']);
+
+--EXPECT--
+string(9) "127.0.0.1"
+string(9) "127.0.0.1"
+string(9) "127.0.0.1"
+string(9) "127.0.0.1"
+string(9) "127.0.0.1"
+int(5)
+int(4)
+int(1)
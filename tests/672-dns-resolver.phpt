@@ -0,0 +1,164 @@
+--TEST--
+DNS resolver queries name servers and caches answers.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+require_once __DIR__ . '/dns.inc';
+
+$zones = [
+    'example.test' => [
+        Resolver::A => [
+            [60, inet_pton('192.0.2.1')],
+            [30, inet_pton('192.0.2.2')]
+        ],
+        Resolver::AAAA => [
+            [60, inet_pton('2001:db8::1')]
+        ],
+        Resolver::TXT => [
+            [60, "\x06v=spf1\x05 -all"]
+        ]
+    ],
+    '_sip._udp.example.test' => [
+        Resolver::SRV => [
+            [60, pack('nnn', 10, 5, 5060) . dnsEncodeName('sip.example.test')]
+        ]
+    ],
+    'other.test' => [
+        Resolver::A => [
+            [60, inet_pton('192.0.2.3')]
+        ]
+    ]
+];
+
+$hosts = tempnam(sys_get_temp_dir(), 'hosts');
+file_put_contents($hosts, "# Static entries\n192.0.2.10 static.test alias.test\n::1 static.test\n");
+
+$server = UdpSocket::bind('127.0.0.1', 0);
+$queries = 0;
+
+dnsServer($server, $zones, $queries);
+
+try {
+    $resolver = new Resolver(['127.0.0.1:' . $server->getPort()], $hosts);
+
+    print_r($resolver->resolve('example.test'));
+    print_r($resolver->resolve('EXAMPLE.test.'));
+    var_dump($queries);
+
+    print_r($resolver->resolve('example.test', Resolver::AAAA));
+    print_r($resolver->resolve('_sip._udp.example.test', Resolver::SRV));
+    print_r($resolver->resolve('example.test', Resolver::TXT));
+
+    var_dump($resolver->resolve('alias.test')[0]['address']);
+    var_dump($resolver->resolve('static.test', Resolver::AAAA)[0]['address']);
+    var_dump($resolver->resolve('192.0.2.99')[0]['address']);
+
+    try {
+        $resolver->resolve('missing.test');
+    } catch (SocketException $e) {
+        var_dump($e->getMessage());
+    }
+
+    try {
+        $resolver->resolve('missing.test');
+    } catch (SocketException $e) {
+        var_dump($e->getMessage());
+    }
+
+    $a = Task::async([$resolver, 'resolve'], 'other.test');
+    $b = Task::async([$resolver, 'resolve'], 'other.test');
+
+    var_dump(Task::await($a)[0]['address']);
+    var_dump(Task::await($b)[0]['address']);
+    var_dump($queries);
+
+    try {
+        $resolver->resolve('example.test', 99);
+    } catch (\Error $e) {
+        var_dump($e->getMessage());
+    }
+} finally {
+    $server->close();
+
+    unlink($hosts);
+}
+
+--EXPECT--
+Array
+(
+    [0] => Array
+        (
+            [address] => 192.0.2.1
+            [ttl] => 60
+        )
+
+    [1] => Array
+        (
+            [address] => 192.0.2.2
+            [ttl] => 30
+        )
+
+)
+Array
+(
+    [0] => Array
+        (
+            [address] => 192.0.2.1
+            [ttl] => 60
+        )
+
+    [1] => Array
+        (
+            [address] => 192.0.2.2
+            [ttl] => 30
+        )
+
+)
+int(1)
+Array
+(
+    [0] => Array
+        (
+            [address] => 2001:db8::1
+            [ttl] => 60
+        )
+
+)
+Array
+(
+    [0] => Array
+        (
+            [target] => sip.example.test
+            [port] => 5060
+            [priority] => 10
+            [weight] => 5
+            [ttl] => 60
+        )
+
+)
+Array
+(
+    [0] => Array
+        (
+            [text] => v=spf1 -all
+            [ttl] => 60
+        )
+
+)
+string(10) "192.0.2.10"
+string(3) "::1"
+string(10) "192.0.2.99"
+string(58) "DNS query for missing.test failed: unknown node or service"
+string(58) "DNS query for missing.test failed: unknown node or service"
+string(9) "192.0.2.3"
+string(9) "192.0.2.3"
+int(6)
+string(31) "Unsupported DNS record type: 99"
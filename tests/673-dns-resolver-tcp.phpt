@@ -0,0 +1,74 @@
+--TEST--
+DNS resolver retries truncated responses using TCP.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+
+require_once __DIR__ . '/dns.inc';
+
+$zones = [
+    'large.test' => [
+        Resolver::TXT => [
+            [120, chr(255) . str_repeat('a', 255)],
+            [60, chr(255) . str_repeat('b', 255)],
+            [90, chr(255) . str_repeat('c', 255)]
+        ]
+    ]
+];
+
+$udp = UdpSocket::bind('127.0.0.1', 0);
+$tcp = TcpServer::listen('127.0.0.1', $udp->getPort());
+
+$queries = 0;
+
+dnsServer($udp, $zones, $queries, true);
+
+Task::async(function () use ($tcp, $zones) {
+    $socket = $tcp->accept();
+
+    try {
+        $buffer = '';
+
+        while (strlen($buffer) < 2 || strlen($buffer) < 2 + unpack('n', $buffer)[1]) {
+            $buffer .= $socket->read();
+        }
+
+        $response = dnsResponse(substr($buffer, 2), $zones);
+
+        $socket->write(pack('n', strlen($response)) . $response);
+    } finally {
+        $socket->close();
+    }
+});
+
+try {
+    $resolver = new Resolver(['127.0.0.1:' . $udp->getPort()], '');
+
+    foreach ($resolver->resolve('large.test', Resolver::TXT) as $record) {
+        var_dump(strlen($record['text']), $record['text'][0], $record['ttl']);
+    }
+
+    var_dump($queries);
+} finally {
+    $udp->close();
+    $tcp->close();
+}
+
+--EXPECT--
+int(255)
+string(1) "a"
+int(120)
+int(255)
+string(1) "b"
+int(60)
+int(255)
+string(1) "c"
+int(90)
+int(1)
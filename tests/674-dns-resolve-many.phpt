@@ -0,0 +1,94 @@
+--TEST--
+DNS resolver resolves multiple names in a single call.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+require_once __DIR__ . '/dns.inc';
+
+function dump(array $result)
+{
+    foreach ($result as $name => $records) {
+        if ($records instanceof SocketException) {
+            echo $name, ': ', $records->getMessage(), "\n";
+        } else {
+            echo $name, ': ', implode(', ', array_column($records, 'address')), "\n";
+        }
+    }
+}
+
+$zones = [
+    'a.test' => [
+        Resolver::A => [
+            [60, inet_pton('192.0.2.1')]
+        ]
+    ],
+    'b.test' => [
+        Resolver::A => [
+            [60, inet_pton('192.0.2.2')],
+            [60, inet_pton('192.0.2.3')]
+        ]
+    ],
+    'c.test' => [
+        Resolver::A => [
+            [60, inet_pton('192.0.2.4')]
+        ]
+    ]
+];
+
+$hosts = tempnam(sys_get_temp_dir(), 'hosts');
+file_put_contents($hosts, "192.0.2.10 static.test\n");
+
+$server = UdpSocket::bind('127.0.0.1', 0);
+$silent = UdpSocket::bind('127.0.0.1', 0);
+$queries = 0;
+
+dnsServer($server, $zones, $queries);
+
+try {
+    $resolver = new Resolver(['127.0.0.1:' . $server->getPort()], $hosts);
+
+    dump($resolver->resolveMany(['a.test', 'b.test', 'missing.test', 'static.test', 'a.test', '192.0.2.99']));
+    var_dump($queries);
+
+    dump($resolver->resolveMany(['a.test', 'c.test']));
+    var_dump($queries);
+
+    var_dump($resolver->resolveMany([]));
+
+    try {
+        $resolver->resolveMany(['a.test', 1]);
+    } catch (\Error $e) {
+        var_dump($e->getMessage());
+    }
+
+    $resolver = new Resolver(['127.0.0.1:' . $silent->getPort()], '');
+
+    dump($resolver->resolveMany(['a.test', '192.0.2.99'], Resolver::A, 50));
+} finally {
+    $server->close();
+    $silent->close();
+
+    unlink($hosts);
+}
+
+--EXPECT--
+a.test: 192.0.2.1
+b.test: 192.0.2.2, 192.0.2.3
+missing.test: DNS query for missing.test failed: unknown node or service
+static.test: 192.0.2.10
+192.0.2.99: 192.0.2.99
+int(3)
+a.test: 192.0.2.1
+c.test: 192.0.2.4
+int(4)
+array(0) {
+}
+string(35) "Host names must be given as strings"
+a.test: DNS query for a.test failed: connection timed out
+192.0.2.99: 192.0.2.99
@@ -0,0 +1,78 @@
+--TEST--
+DNS resolver can be used to resolve host names of sockets.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+?>
+--INI--
+async.dns=1
+--FILE--
+<?php
+
+namespace Concurrent\Network;
+
+use Concurrent\Task;
+use Concurrent\Timer;
+
+require_once __DIR__ . '/dns.inc';
+
+$zones = [
+    'example.test' => [
+        Resolver::A => [
+            [60, inet_pton('127.0.0.1')]
+        ]
+    ]
+];
+
+$server = UdpSocket::bind('127.0.0.1', 0);
+$tcp = TcpServer::listen('127.0.0.1', 0);
+$queries = 0;
+
+dnsServer($server, $zones, $queries);
+
+try {
+    $resolver = new Resolver(['127.0.0.1:' . $server->getPort()], '');
+
+    Resolver::setDefault($resolver);
+
+    var_dump(gethostbynamel('example.test'));
+    var_dump(gethostbyname('missing.test'));
+
+    $t = Task::async(function () use ($tcp) {
+        $tcp->accept()->close();
+    });
+
+    $socket = TcpSocket::connect('example.test', $tcp->getPort());
+    var_dump($socket->getRemoteAddress());
+    $socket->close();
+
+    Task::await($t);
+
+    var_dump($queries);
+
+    (new Timer(1100))->awaitTimeout();
+
+    var_dump($resolver->resolve('example.test')[0]['ttl']);
+    var_dump($queries);
+
+    Resolver::setDefault(null);
+
+    var_dump(gethostbyname('localhost'));
+} finally {
+    Resolver::setDefault(null);
+
+    $server->close();
+    $tcp->close();
+}
+
+--EXPECT--
+array(1) {
+  [0]=>
+  string(9) "127.0.0.1"
+}
+string(12) "missing.test"
+string(9) "127.0.0.1"
+int(4)
+int(59)
+int(4)
+string(9) "127.0.0.1"
@@ -0,0 +1,57 @@
+--TEST--
+XP socket Unix domain socket connection.
+--SKIPIF--
+<?php
+if (!extension_loaded('task')) echo 'Test requires the task extension to be loaded';
+if (DIRECTORY_SEPARATOR == '\\') echo 'Test requires Unix domain sockets';
+?>
+--FILE--
+<?php
+
+namespace Concurrent;
+
+$errno = null;
+$errstr = null;
+
+$path = sys_get_temp_dir() . '/async-703-' . getmypid() . '.sock';
+
+$server = stream_socket_server('async-unix://' . $path, $errno, $errstr, STREAM_SERVER_BIND | STREAM_SERVER_LISTEN);
+
+Task::async(function () use ($path) {
+    $errno = null;
+    $errstr = null;
+
+    $socket = stream_socket_client('async-unix://' . $path, $errno, $errstr, 1, STREAM_CLIENT_CONNECT);
+    
+    try {
+        var_dump(stream_socket_get_name($socket, true) == $path);
+    
+        fwrite($socket, "Hello\n");
+        
+        var_dump(fgets($socket));
+    } finally {
+        fclose($socket);
+    }
+});
+
+try {
+    var_dump(stream_socket_get_name($server, false) == $path);
+
+    $socket = stream_socket_accept($server);
+} finally {
+    fclose($server);
+}
+
+try {
+    var_dump(trim(fgets($socket)));
+    
+    fwrite($socket, 'World');
+} finally {
+    fclose($socket);
+}
+
+--EXPECT--
+bool(true)
+bool(true)
+string(5) "Hello"
+string(5) "World"